@@ -12,6 +12,7 @@
 
 // Resource loader
 #include "../../Imaging/Image.h"
+#include "../../Imaging/CompressedImage.h"
 #include "../../Text/Font.h"
 #include "../Audio/Sound.h"
 #include "../Audio/OggResource.h"
@@ -41,6 +42,7 @@ namespace Dream
 				Ref<Resources::Loader> loader = new Resources::Loader;
 
 				loader->add_loader(new Imaging::Image::Loader);
+				loader->add_loader(new Imaging::CompressedImage::Loader);
 				loader->add_loader(new Client::Audio::Sound::Loader);
 				loader->add_loader(new Client::Audio::OggResource::Loader);
 				loader->add_loader(new Text::Font::Loader);
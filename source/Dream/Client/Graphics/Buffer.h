@@ -138,7 +138,7 @@ namespace Dream {
 					}
 
 					void set_data(const ElementT * data, std::size_t size) {
-						_buffer_handle->_size = size;
+						_buffer_handle->_size = byte_offset(size);
 
 						glBufferData(TARGET, byte_offset(size), data, _buffer_handle->usage());
 					}
@@ -152,12 +152,19 @@ namespace Dream {
 						glBufferSubData(TARGET, byte_offset(offset), byte_offset(size), data);
 					}
 
+#ifndef DREAM_OPENGLES2
+					/// Copy elements on the GPU from the buffer bound to read_target, starting read_offset bytes into it.
+					void copy_data(GLenum read_target, std::size_t read_offset, std::size_t offset, std::size_t size) {
+						glCopyBufferSubData(read_target, TARGET, (GLintptr)read_offset, byte_offset(offset), byte_offset(size));
+					}
+#endif
+
 					ElementT * map(GLenum access = GL_WRITE_ONLY) {
 						return (ElementT *)glMapBuffer(TARGET, access);
 					}
 
 					ElementT * map(std::size_t offset, std::size_t size, GLenum access = GL_WRITE_ONLY) {
-						DREAM_ASSERT(offset + size < _buffer_handle->size());
+						DREAM_ASSERT((std::size_t)byte_offset(offset + size) <= _buffer_handle->size());
 
 						return (ElementT *)glMapBufferRange(TARGET, byte_offset(offset), byte_offset(size), access);
 					}
@@ -0,0 +1,624 @@
+//
+//  Client/Graphics/CommandBuffer.cpp
+//  This file is part of the "Dream" project, and is released under the MIT license.
+//
+//  Created by agent on 18/10/26.
+//  Copyright (c) 2026 agent. All rights reserved.
+//
+
+#include "CommandBuffer.h"
+
+#include <algorithm>
+
+#ifdef ENABLE_TESTING
+#include "../../Core/Timer.h"
+
+#include <random>
+#include <sstream>
+#include <thread>
+#endif
+
+namespace Dream {
+	namespace Client {
+		namespace Graphics {
+
+// MARK: -
+// MARK: class GLCommandBackend
+
+			bool update_uniform(UniformTable & uniforms, const UniformValue & uniform) {
+				return uniforms.update(uniforms.location(uniform.location), uniform.values, sizeof(GLfloat) * uniform.rows * uniform.columns);
+			}
+
+			ICommandBackend::~ICommandBackend() {
+			}
+
+			GLCommandBackend::GLCommandBackend(Ptr<TextureManager> texture_manager) : _texture_manager(texture_manager), _program(NULL), _vertex_array(NULL) {
+			}
+
+			GLCommandBackend::~GLCommandBackend() {
+			}
+
+			void GLCommandBackend::use_program(Program * program) {
+				_program = program;
+
+				if (_program)
+					_program->enable();
+				else
+					glUseProgram(0);
+			}
+
+			void GLCommandBackend::bind_vertex_array(VertexArray * vertex_array) {
+				_vertex_array = vertex_array;
+
+				if (_vertex_array)
+					_vertex_array->bind();
+			}
+
+			void GLCommandBackend::bind_texture(std::size_t unit, Texture * texture) {
+				_texture_manager->bind(unit, texture);
+			}
+
+			void GLCommandBackend::set_uniform(const UniformValue & uniform) {
+				// Values are set through the program's uniform table, so that it knows what was uploaded when the program is used directly:
+				if (_program && !update_uniform(_program->_uniforms, uniform))
+					return;
+
+				if (uniform.columns == 1) {
+					switch (uniform.rows) {
+						case 1: GLUniformTraits<1>::set(uniform.location, 1, uniform.values); break;
+						case 2: GLUniformTraits<2>::set(uniform.location, 1, uniform.values); break;
+						case 3: GLUniformTraits<3>::set(uniform.location, 1, uniform.values); break;
+						case 4: GLUniformTraits<4>::set(uniform.location, 1, uniform.values); break;
+					}
+				} else {
+					switch (uniform.rows) {
+						case 2: GLUniformMatrixTraits<2, 2>::set(uniform.location, 1, GL_FALSE, uniform.values); break;
+						case 3: GLUniformMatrixTraits<3, 3>::set(uniform.location, 1, GL_FALSE, uniform.values); break;
+						case 4: GLUniformMatrixTraits<4, 4>::set(uniform.location, 1, GL_FALSE, uniform.values); break;
+					}
+				}
+			}
+
+			void GLCommandBackend::draw(const DrawCommand & command) {
+				if (command.index_type)
+					glDrawElements(command.mode, command.count, command.index_type, (const GLvoid *)(std::ptrdiff_t)command.first);
+				else
+					glDrawArrays(command.mode, command.first, command.count);
+
+				check_graphics_error();
+			}
+
+			void GLCommandBackend::finish() {
+				if (_vertex_array) {
+					_vertex_array->unbind();
+					_vertex_array = NULL;
+				}
+
+				if (_program) {
+					_program->disable();
+					_program = NULL;
+				}
+			}
+
+// MARK: -
+// MARK: class CommandBuffer
+
+			CommandBuffer::CommandBuffer() {
+			}
+
+			CommandBuffer::~CommandBuffer() {
+			}
+
+			void CommandBuffer::clear() {
+				_commands.clear();
+				_uniforms.clear();
+			}
+
+			DrawCommand & CommandBuffer::record(std::uint8_t layer, GLfloat depth, Ptr<Program> program, VertexArray * vertex_array, GLenum mode) {
+				_commands.resize(_commands.size() + 1);
+
+				DrawCommand & command = _commands.back();
+				command.layer = layer;
+				command.depth = depth;
+				command.program = program.get();
+				command.vertex_array = vertex_array;
+				std::fill(command.textures, command.textures + DrawCommand::TEXTURE_UNITS, (Texture *)NULL);
+				command.mode = mode;
+				command.uniforms_begin = command.uniforms_end = (std::uint32_t)_uniforms.size();
+
+				return command;
+			}
+
+			UniformValue & CommandBuffer::record_uniform(GLint location, std::uint8_t rows, std::uint8_t columns) {
+				DREAM_ASSERT(!_commands.empty());
+
+				_uniforms.resize(_uniforms.size() + 1);
+				_commands.back().uniforms_end = (std::uint32_t)_uniforms.size();
+
+				UniformValue & uniform = _uniforms.back();
+				uniform.location = location;
+				uniform.rows = rows;
+				uniform.columns = columns;
+
+				return uniform;
+			}
+
+			DrawCommand & CommandBuffer::draw_elements(std::uint8_t layer, GLfloat depth, Ptr<Program> program, VertexArray * vertex_array, GLenum mode, GLsizei count, GLenum index_type, std::size_t offset) {
+				DrawCommand & command = record(layer, depth, program, vertex_array, mode);
+
+				command.index_type = index_type;
+				command.first = (GLint)offset;
+				command.count = count;
+
+				return command;
+			}
+
+			DrawCommand & CommandBuffer::draw_arrays(std::uint8_t layer, GLfloat depth, Ptr<Program> program, VertexArray * vertex_array, GLenum mode, GLint first, GLsizei count) {
+				DrawCommand & command = record(layer, depth, program, vertex_array, mode);
+
+				command.index_type = 0;
+				command.first = first;
+				command.count = count;
+
+				return command;
+			}
+
+			void CommandBuffer::set_texture(std::size_t unit, Ptr<Texture> texture) {
+				DREAM_ASSERT(!_commands.empty() && unit < DrawCommand::TEXTURE_UNITS);
+
+				_commands.back().textures[unit] = texture.get();
+			}
+
+// MARK: -
+// MARK: class CommandQueue
+
+			// A least significant digit radix sort, which keeps equal keys in their original order. Passes where every key has the same byte are skipped, which is common as most frames only use a few layers and programs.
+			static void radix_sort(std::vector<std::uint64_t> & keys, std::vector<std::uint32_t> & order, std::vector<std::uint64_t> & sorted_keys, std::vector<std::uint32_t> & sorted_order) {
+				const std::size_t count = keys.size();
+
+				if (count <= 1)
+					return;
+
+				sorted_keys.resize(count);
+				sorted_order.resize(count);
+
+				std::vector<std::size_t> histograms(8 * 256, 0);
+
+				for (std::size_t i = 0; i < count; i += 1) {
+					std::uint64_t key = keys[i];
+
+					for (std::size_t pass = 0; pass < 8; pass += 1)
+						histograms[pass * 256 + ((key >> (pass * 8)) & 0xFF)] += 1;
+				}
+
+				for (std::size_t pass = 0; pass < 8; pass += 1) {
+					std::size_t * histogram = &histograms[pass * 256];
+					std::size_t shift = pass * 8;
+
+					if (histogram[(keys[0] >> shift) & 0xFF] == count)
+						continue;
+
+					// Convert the counts to offsets:
+					std::size_t offset = 0;
+					for (std::size_t digit = 0; digit < 256; digit += 1) {
+						std::size_t size = histogram[digit];
+						histogram[digit] = offset;
+						offset += size;
+					}
+
+					for (std::size_t i = 0; i < count; i += 1) {
+						std::size_t destination = histogram[(keys[i] >> shift) & 0xFF]++;
+
+						sorted_keys[destination] = keys[i];
+						sorted_order[destination] = order[i];
+					}
+
+					keys.swap(sorted_keys);
+					order.swap(sorted_order);
+				}
+			}
+
+			CommandQueue::CommandQueue(std::size_t buffer_count) {
+				DREAM_ASSERT(buffer_count > 0);
+
+				for (std::size_t i = 0; i < buffer_count; i += 1)
+					_buffers.push_back(new CommandBuffer);
+			}
+
+			CommandQueue::~CommandQueue() {
+			}
+
+			std::uint64_t CommandQueue::sort_key(std::uint8_t layer, std::uint32_t program, std::uint32_t texture, std::uint32_t vertex_array, GLfloat depth, bool back_to_front) {
+				std::uint64_t depth_bits = (std::uint64_t)(std::min(std::max(depth, 0.0f), 1.0f) * 0xFFFFFF);
+
+				std::uint64_t key = (std::uint64_t)layer << 56;
+
+				if (back_to_front) {
+					key |= (0xFFFFFF - depth_bits) << 32;
+					key |= (std::uint64_t)(program & 0xFFF) << 20;
+					key |= (std::uint64_t)(texture & 0xFFF) << 8;
+					key |= (std::uint64_t)(vertex_array & 0xFF);
+				} else {
+					key |= (std::uint64_t)(program & 0xFFF) << 44;
+					key |= (std::uint64_t)(texture & 0xFFF) << 32;
+					key |= (std::uint64_t)(vertex_array & 0xFF) << 24;
+					key |= depth_bits;
+				}
+
+				return key;
+			}
+
+			static const std::uint32_t IDENTIFIER_LIMITS[] = {CommandQueue::PROGRAM_LIMIT, CommandQueue::TEXTURE_LIMIT, CommandQueue::VERTEX_ARRAY_LIMIT};
+			static const char * IDENTIFIER_KINDS[] = {"programs", "textures", "vertex arrays"};
+
+			std::uint32_t CommandQueue::identifier(std::size_t kind, const void * object) {
+				if (object == NULL)
+					return 0;
+
+				auto & identifiers = _identifiers[kind];
+				auto result = identifiers.insert(std::make_pair(object, (std::uint32_t)identifiers.size() + 1));
+
+				// Objects beyond the limit share the last identifier, rather than wrapping around and sorting amongst the first objects:
+				return std::min(result.first->second, IDENTIFIER_LIMITS[kind]);
+			}
+
+			CommandQueue::Statistics CommandQueue::submit(ICommandBackend * backend) {
+				Statistics statistics = {0, 0, 0, 0};
+
+				// Identifiers are assigned afresh each frame, so that objects which are no longer drawn don't use them up:
+				for (auto & identifiers : _identifiers)
+					identifiers.clear();
+
+				_entries.clear();
+				_keys.clear();
+				_order.clear();
+
+				for (auto & buffer : _buffers) {
+					const UniformValue * uniforms = buffer->uniforms().data();
+
+					for (auto & command : buffer->commands()) {
+						_order.push_back((std::uint32_t)_entries.size());
+						_entries.push_back((Entry){&command, uniforms});
+
+						std::uint32_t program = identifier(0, command.program);
+						std::uint32_t texture = identifier(1, command.textures[0]);
+						std::uint32_t vertex_array = identifier(2, command.vertex_array);
+
+						_keys.push_back(sort_key(command.layer, program, texture, vertex_array, command.depth, _back_to_front[command.layer]));
+					}
+				}
+
+				for (std::size_t kind = 0; kind < 3; kind += 1) {
+					if (_identifiers[kind].size() > IDENTIFIER_LIMITS[kind])
+						logger()->log(LOG_WARN, LogBuffer() << "Drawing " << _identifiers[kind].size() << " " << IDENTIFIER_KINDS[kind] << " in one frame, but only " << IDENTIFIER_LIMITS[kind] << " can be sorted by state");
+				}
+
+				radix_sort(_keys, _order, _sorted_keys, _sorted_order);
+
+				Program * program = NULL;
+				VertexArray * vertex_array = NULL;
+				Texture * textures[DrawCommand::TEXTURE_UNITS] = {NULL};
+
+				for (auto index : _order) {
+					const Entry & entry = _entries[index];
+					const DrawCommand & command = *entry.command;
+
+					if (command.program != program) {
+						program = command.program;
+						backend->use_program(program);
+						statistics.program_changes += 1;
+					}
+
+					if (command.vertex_array != vertex_array) {
+						vertex_array = command.vertex_array;
+						backend->bind_vertex_array(vertex_array);
+						statistics.vertex_array_changes += 1;
+					}
+
+					for (std::size_t unit = 0; unit < DrawCommand::TEXTURE_UNITS; unit += 1) {
+						if (command.textures[unit] && command.textures[unit] != textures[unit]) {
+							textures[unit] = command.textures[unit];
+							backend->bind_texture(unit, textures[unit]);
+							statistics.texture_changes += 1;
+						}
+					}
+
+					for (std::size_t i = command.uniforms_begin; i < command.uniforms_end; i += 1)
+						backend->set_uniform(entry.uniforms[i]);
+
+					backend->draw(command);
+					statistics.draws += 1;
+				}
+
+				backend->finish();
+
+				for (auto & buffer : _buffers)
+					buffer->clear();
+
+				return statistics;
+			}
+
+// MARK: -
+// MARK: Unit Tests
+
+#ifdef ENABLE_TESTING
+			// Logs the calls which would be made to OpenGL:
+			class LoggingCommandBackend : public ICommandBackend {
+			public:
+				std::vector<StringT> calls;
+
+				virtual void use_program(Program * program) {
+					calls.push_back(describe("program", program));
+				}
+
+				virtual void bind_vertex_array(VertexArray * vertex_array) {
+					calls.push_back(describe("vertex_array", vertex_array));
+				}
+
+				virtual void bind_texture(std::size_t unit, Texture * texture) {
+					calls.push_back(describe("texture", texture));
+				}
+
+				virtual void set_uniform(const UniformValue & uniform) {
+					std::stringstream buffer;
+					buffer << "uniform " << uniform.location << " " << uniform.values[0];
+					calls.push_back(buffer.str());
+				}
+
+				virtual void draw(const DrawCommand & command) {
+					std::stringstream buffer;
+					buffer << "draw " << command.first << " " << command.count;
+					calls.push_back(buffer.str());
+				}
+
+				virtual void finish() {
+					calls.push_back("finish");
+				}
+
+				static StringT describe(const char * name, const void * object) {
+					std::stringstream buffer;
+					buffer << name << " " << (std::size_t)object;
+					return buffer.str();
+				}
+			};
+
+			// Only counts the calls, for measuring the cost of sorting and replaying:
+			class CountingCommandBackend : public ICommandBackend {
+			public:
+				std::size_t calls;
+
+				CountingCommandBackend() : calls(0) {}
+
+				virtual void use_program(Program * program) { calls += 1; }
+				virtual void bind_vertex_array(VertexArray * vertex_array) { calls += 1; }
+				virtual void bind_texture(std::size_t unit, Texture * texture) { calls += 1; }
+				virtual void set_uniform(const UniformValue & uniform) { calls += 1; }
+				virtual void draw(const DrawCommand & command) { calls += 1; }
+				virtual void finish() { calls += 1; }
+			};
+
+			// Uploads uniforms through a table, as the OpenGL backend does with the table of each program:
+			class CachingCommandBackend : public CountingCommandBackend {
+			public:
+				UniformTable uniforms;
+				std::size_t uploads;
+
+				CachingCommandBackend() : uploads(0) {}
+
+				virtual void set_uniform(const UniformValue & uniform) {
+					if (update_uniform(uniforms, uniform))
+						uploads += 1;
+				}
+			};
+
+			// The command buffers never dereference the objects, so these can stand in for real programs and textures:
+			template <typename ObjectT>
+			static ObjectT * fake(std::size_t identifier) {
+				return reinterpret_cast<ObjectT *>(identifier);
+			}
+
+			UNIT_TEST(CommandQueueRadixSort)
+			{
+				testing("Stable Sorting");
+
+				std::minstd_rand random(11);
+				std::vector<std::uint64_t> keys, sorted_keys;
+				std::vector<std::uint32_t> order, sorted_order;
+
+				for (std::uint32_t i = 0; i < 10000; i += 1) {
+					// Few distinct keys, spread over all bytes, so that there are many equal keys:
+					std::uint64_t key = (std::uint64_t)(random() % 4) << 56 | (std::uint64_t)(random() % 3) << 20 | (random() % 5);
+
+					keys.push_back(key);
+					order.push_back(i);
+				}
+
+				std::vector<std::pair<std::uint64_t, std::uint32_t>> expected;
+				for (std::size_t i = 0; i < keys.size(); i += 1)
+					expected.push_back(std::make_pair(keys[i], order[i]));
+
+				std::stable_sort(expected.begin(), expected.end(), [](const std::pair<std::uint64_t, std::uint32_t> & a, const std::pair<std::uint64_t, std::uint32_t> & b) {
+					return a.first < b.first;
+				});
+
+				radix_sort(keys, order, sorted_keys, sorted_order);
+
+				bool matches = true;
+				for (std::size_t i = 0; i < keys.size(); i += 1)
+					matches = matches && keys[i] == expected[i].first && order[i] == expected[i].second;
+
+				check(matches) << "Radix sort matches a stable sort";
+
+				testing("Sort Keys");
+
+				check(CommandQueue::sort_key(1, 0, 0, 0, 0) > CommandQueue::sort_key(0, 0xFFF, 0xFFF, 0xFF, 1)) << "Layers are most significant";
+				check(CommandQueue::sort_key(0, 2, 0, 0, 0) > CommandQueue::sort_key(0, 1, 0xFFF, 0xFF, 1)) << "Programs are more significant than textures";
+				check(CommandQueue::sort_key(0, 1, 1, 1, 0.25) < CommandQueue::sort_key(0, 1, 1, 1, 0.5)) << "Opaque layers are drawn front to back";
+				check(CommandQueue::sort_key(0, 2, 2, 2, 0.5, true) < CommandQueue::sort_key(0, 1, 1, 1, 0.25, true)) << "Transparent layers are drawn back to front";
+			}
+
+			UNIT_TEST(CommandQueue)
+			{
+				testing("Eliding State Changes");
+
+				Ref<CommandQueue> queue = new CommandQueue;
+				CommandBuffer * buffer = queue->buffer(0);
+
+				// Interleaved programs and textures, as they would be in traversal order:
+				for (std::size_t i = 0; i < 100; i += 1) {
+					buffer->draw_arrays(0, 0, fake<Program>(1 + i % 2), fake<VertexArray>(1), GL_TRIANGLES, i * 6, 6);
+					buffer->set_texture(0, fake<Texture>(1 + (i / 2) % 2));
+				}
+
+				LoggingCommandBackend backend;
+				CommandQueue::Statistics statistics = queue->submit(&backend);
+
+				check(statistics.draws == 100) << "All commands were drawn";
+				check(statistics.program_changes == 2) << "Each program is used once";
+				check(statistics.vertex_array_changes == 1) << "The vertex array is bound once";
+				check(statistics.texture_changes == 4) << "Each texture is bound once per program";
+				check(backend.calls.size() == 100 + 2 + 1 + 4 + 1) << "Only the necessary calls were made";
+				check(queue->buffer(0)->size() == 0) << "Buffers are cleared after submitting";
+
+				testing("Layers and Uniforms");
+
+				backend.calls.clear();
+
+				buffer->draw_arrays(1, 0, fake<Program>(1), fake<VertexArray>(1), GL_TRIANGLES, 0, 3);
+				buffer->set_uniform(7, Vector<1, GLfloat>(1.0f));
+				buffer->draw_arrays(0, 0, fake<Program>(2), fake<VertexArray>(1), GL_TRIANGLES, 3, 3);
+				buffer->set_uniform(7, Vector<1, GLfloat>(2.0f));
+
+				queue->submit(&backend);
+
+				std::vector<StringT> expected = {
+					"program 2", "vertex_array 1", "uniform 7 2", "draw 3 3",
+					"program 1", "uniform 7 1", "draw 0 3",
+					"finish"
+				};
+
+				check(backend.calls == expected) << "Lower layers are drawn first with their own uniforms";
+
+				testing("Identifier Limits");
+
+				backend.calls.clear();
+
+				// More vertex arrays than the sort keys can distinguish, alternating between two programs:
+				const std::size_t VERTEX_ARRAYS = CommandQueue::VERTEX_ARRAY_LIMIT + 45;
+				for (std::size_t i = 0; i < VERTEX_ARRAYS; i += 1)
+					buffer->draw_arrays(0, 0, fake<Program>(1 + i % 2), fake<VertexArray>(1 + i), GL_TRIANGLES, i, 3);
+
+				statistics = queue->submit(&backend);
+
+				std::vector<GLint> drawn;
+				for (auto & call : backend.calls) {
+					if (call.compare(0, 5, "draw ") == 0)
+						drawn.push_back(std::stoi(call.substr(5)));
+				}
+
+				bool in_order = drawn.size() == VERTEX_ARRAYS;
+				for (std::size_t i = 0; in_order && i < VERTEX_ARRAYS; i += 1)
+					in_order = drawn[i] == (GLint)(i < VERTEX_ARRAYS / 2 ? i * 2 : (i - VERTEX_ARRAYS / 2) * 2 + 1);
+
+				check(statistics.draws == VERTEX_ARRAYS) << "All commands were drawn";
+				check(statistics.program_changes == 2) << "Commands are still grouped by program";
+				check(in_order) << "Objects beyond the limit are drawn in the order they were recorded";
+
+				testing("Uniforms Set Directly");
+
+				CachingCommandBackend caching_backend;
+				caching_backend.uniforms.add("tint", 7, GL_FLOAT, 1);
+
+				UniformLocation tint = caching_backend.uniforms.location("tint");
+				GLfloat one = 1, two = 2;
+
+				buffer->draw_arrays(0, 0, fake<Program>(1), fake<VertexArray>(1), GL_TRIANGLES, 0, 3);
+				buffer->set_uniform(7, Vector<1, GLfloat>(one));
+				queue->submit(&caching_backend);
+
+				check(caching_backend.uploads == 1) << "The recorded uniform was uploaded";
+				check(!caching_backend.uniforms.update(tint, &one, sizeof(one))) << "Setting the same value directly is not uploaded again";
+				check(caching_backend.uniforms.update(tint, &two, sizeof(two))) << "Setting a different value directly is uploaded";
+
+				buffer->draw_arrays(0, 0, fake<Program>(1), fake<VertexArray>(1), GL_TRIANGLES, 0, 3);
+				buffer->set_uniform(7, Vector<1, GLfloat>(one));
+				queue->submit(&caching_backend);
+
+				check(caching_backend.uploads == 2) << "The recorded uniform is uploaded again after it was set directly";
+
+				buffer->draw_arrays(0, 0, fake<Program>(1), fake<VertexArray>(1), GL_TRIANGLES, 0, 3);
+				buffer->set_uniform(7, Vector<1, GLfloat>(one));
+				queue->submit(&caching_backend);
+
+				check(caching_backend.uploads == 2) << "Unchanged uniforms are not uploaded again";
+			}
+
+			UNIT_TEST(CommandQueueThreads)
+			{
+				testing("Recording From Multiple Threads");
+
+				const std::size_t THREADS = 4, COMMANDS = 1000;
+
+				auto record = [&](CommandBuffer * buffer, std::size_t thread) {
+					std::minstd_rand random(thread);
+
+					for (std::size_t i = 0; i < COMMANDS; i += 1) {
+						buffer->draw_elements(random() % 3, (random() % 100) / 100.0f, fake<Program>(1 + random() % 4), fake<VertexArray>(1 + random() % 2), GL_TRIANGLES, 6, GL_UNSIGNED_SHORT, (thread * COMMANDS + i) * 12);
+						buffer->set_texture(0, fake<Texture>(1 + random() % 8));
+					}
+				};
+
+				Ref<CommandQueue> threaded = new CommandQueue(THREADS), serial = new CommandQueue(THREADS);
+				std::vector<std::thread> threads;
+
+				for (std::size_t t = 0; t < THREADS; t += 1)
+					threads.push_back(std::thread(record, threaded->buffer(t), t));
+
+				for (std::size_t t = 0; t < THREADS; t += 1)
+					record(serial->buffer(t), t);
+
+				for (auto & thread : threads)
+					thread.join();
+
+				LoggingCommandBackend threaded_backend, serial_backend;
+				CommandQueue::Statistics statistics = threaded->submit(&threaded_backend);
+				serial->submit(&serial_backend);
+
+				check(threaded_backend.calls == serial_backend.calls) << "The result doesn't depend on which thread recorded each buffer";
+				check(statistics.draws == THREADS * COMMANDS) << "All commands were drawn";
+				check(statistics.program_changes <= 3 * 4) << "Programs are only changed between layers";
+
+				testing("Performance");
+
+				// Something like a user interface, with a few layers and programs which each draw one kind of element from many textures:
+				std::minstd_rand random(5);
+				Stopwatch stopwatch;
+				const std::size_t FRAMES = 20, DRAWS = 20000;
+				std::size_t changes = 0;
+				CountingCommandBackend counting_backend;
+
+				for (std::size_t frame = 0; frame < FRAMES; frame += 1) {
+					CommandBuffer * buffer = serial->buffer(0);
+
+					for (std::size_t i = 0; i < DRAWS; i += 1) {
+						std::size_t program = 1 + random() % 8;
+
+						buffer->draw_arrays(random() % 4, 0, fake<Program>(program), fake<VertexArray>(program), GL_TRIANGLES, 0, 6);
+						buffer->set_texture(0, fake<Texture>(1 + random() % 64));
+					}
+
+					stopwatch.start();
+					CommandQueue::Statistics statistics = serial->submit(&counting_backend);
+					stopwatch.pause();
+
+					changes += statistics.program_changes + statistics.texture_changes + statistics.vertex_array_changes;
+				}
+
+				logger()->log(LOG_INFO, LogBuffer() << "Sorted and submitted " << (FRAMES * DRAWS) / stopwatch.time() / 1e6 << "M commands/s, with " << changes / FRAMES << " state changes per frame instead of up to " << DRAWS * 3);
+
+				check(changes / FRAMES < DRAWS) << "Sorting removes most state changes";
+			}
+#endif
+		}
+	}
+}
@@ -0,0 +1,192 @@
+//
+//  Client/Graphics/CommandBuffer.h
+//  This file is part of the "Dream" project, and is released under the MIT license.
+//
+//  Created by agent on 18/10/26.
+//  Copyright (c) 2026 agent. All rights reserved.
+//
+
+#ifndef _DREAM_CLIENT_GRAPHICS_COMMANDBUFFER_H
+#define _DREAM_CLIENT_GRAPHICS_COMMANDBUFFER_H
+
+#include "Graphics.h"
+#include "ShaderManager.h"
+#include "TextureManager.h"
+#include "VertexArray.h"
+
+#include <bitset>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace Dream {
+	namespace Client {
+		namespace Graphics {
+			/// A uniform value which is set before a draw. Vectors have one column, and matrices are square.
+			struct UniformValue {
+				GLint location;
+				std::uint8_t rows, columns;
+				GLfloat values[16];
+			};
+
+			/// Stores the value in the table, and returns true if it differs from the last value set by location or by name, and needs to be uploaded.
+			bool update_uniform(UniformTable & uniforms, const UniformValue & uniform);
+
+			/// Everything needed to issue one draw call. Objects are not retained, so they must remain valid until the commands are submitted.
+			struct DrawCommand {
+				static const std::size_t TEXTURE_UNITS = 4;
+
+				std::uint8_t layer;
+
+				/// The distance from the viewer in the range [0, 1].
+				GLfloat depth;
+
+				Program * program;
+				VertexArray * vertex_array;
+
+				/// Units without a texture are left as they are.
+				Texture * textures[TEXTURE_UNITS];
+
+				GLenum mode;
+
+				/// If zero, vertices are drawn with glDrawArrays starting from first. Otherwise, first is the byte offset into the index buffer.
+				GLenum index_type;
+				GLint first;
+				GLsizei count;
+
+				/// The range of uniforms in the buffer which recorded this command.
+				std::uint32_t uniforms_begin, uniforms_end;
+			};
+
+			/// The state changes and draw calls issued when commands are submitted. The command queue only calls the backend when state actually changes, so the sorting and elision can be tested without a graphics context.
+			class ICommandBackend {
+			public:
+				virtual ~ICommandBackend();
+
+				virtual void use_program(Program * program) = 0;
+				virtual void bind_vertex_array(VertexArray * vertex_array) = 0;
+				virtual void bind_texture(std::size_t unit, Texture * texture) = 0;
+				virtual void set_uniform(const UniformValue & uniform) = 0;
+				virtual void draw(const DrawCommand & command) = 0;
+
+				/// Called after the last command has been drawn.
+				virtual void finish() = 0;
+			};
+
+			/// Issues commands to OpenGL. Textures are bound through the texture manager so that its state remains consistent.
+			class GLCommandBackend : public Object, public ICommandBackend {
+			protected:
+				Ref<TextureManager> _texture_manager;
+
+				Program * _program;
+				VertexArray * _vertex_array;
+
+			public:
+				GLCommandBackend(Ptr<TextureManager> texture_manager);
+				virtual ~GLCommandBackend();
+
+				virtual void use_program(Program * program);
+				virtual void bind_vertex_array(VertexArray * vertex_array);
+				virtual void bind_texture(std::size_t unit, Texture * texture);
+				virtual void set_uniform(const UniformValue & uniform);
+				virtual void draw(const DrawCommand & command);
+				virtual void finish();
+			};
+
+			/// Records draw commands without calling OpenGL. A command buffer must only be used by one thread at a time, so each thread should record into its own buffer.
+			class CommandBuffer : public Object {
+			protected:
+				std::vector<DrawCommand> _commands;
+				std::vector<UniformValue> _uniforms;
+
+				DrawCommand & record(std::uint8_t layer, GLfloat depth, Ptr<Program> program, VertexArray * vertex_array, GLenum mode);
+				UniformValue & record_uniform(GLint location, std::uint8_t rows, std::uint8_t columns);
+
+			public:
+				CommandBuffer();
+				virtual ~CommandBuffer();
+
+				void clear();
+
+				std::size_t size() const { return _commands.size(); }
+				const std::vector<DrawCommand> & commands() const { return _commands; }
+				const std::vector<UniformValue> & uniforms() const { return _uniforms; }
+
+				/// Record a draw. Textures and uniforms which are set afterwards apply to the most recently recorded draw.
+				DrawCommand & draw_elements(std::uint8_t layer, GLfloat depth, Ptr<Program> program, VertexArray * vertex_array, GLenum mode, GLsizei count, GLenum index_type, std::size_t offset = 0);
+				DrawCommand & draw_arrays(std::uint8_t layer, GLfloat depth, Ptr<Program> program, VertexArray * vertex_array, GLenum mode, GLint first, GLsizei count);
+
+				void set_texture(std::size_t unit, Ptr<Texture> texture);
+
+				template <dimension E>
+				void set_uniform(GLint location, const Vector<E, GLfloat> & vector) {
+					UniformValue & uniform = record_uniform(location, E, 1);
+
+					for (dimension i = 0; i < E; i += 1)
+						uniform.values[i] = vector[i];
+				}
+
+				template <dimension N>
+				void set_uniform(GLint location, const Matrix<N, N, GLfloat> & matrix) {
+					UniformValue & uniform = record_uniform(location, N, N);
+
+					for (dimension i = 0; i < N * N; i += 1)
+						uniform.values[i] = matrix.data()[i];
+				}
+			};
+
+			/**
+			 Sorts the commands recorded in one or more command buffers and replays them, skipping redundant changes of program, vertex array and texture.
+
+			 Each command is given a 64-bit key. From the most significant bits, it contains the layer (8 bits), then the program (12 bits), the texture in unit 0 (12 bits), the vertex array (8 bits), and finally the depth (24 bits) so that commands with the same state are drawn front to back. Layers which are drawn back to front, e.g. for transparency, put the depth straight after the layer instead. Commands with the same key are drawn in the order they were recorded, taking the buffers in order.
+
+			 Identifiers are assigned to objects in the order they are first seen in each frame, so one frame can distinguish at most PROGRAM_LIMIT programs, TEXTURE_LIMIT textures and VERTEX_ARRAY_LIMIT vertex arrays. Any further objects share the last identifier and a warning is logged. They are still drawn correctly and in the order they were recorded, but are not grouped to avoid state changes.
+			 */
+			class CommandQueue : public Object {
+			public:
+				struct Statistics {
+					std::size_t draws;
+					std::size_t program_changes, vertex_array_changes, texture_changes;
+				};
+
+				/// The number of distinct objects of each kind which the sort keys can represent.
+				static const std::uint32_t PROGRAM_LIMIT = 0xFFF, TEXTURE_LIMIT = 0xFFF, VERTEX_ARRAY_LIMIT = 0xFF;
+
+			protected:
+				std::vector<Ref<CommandBuffer>> _buffers;
+				std::bitset<256> _back_to_front;
+
+				// Objects are given small identifiers in the order they are first seen in the current frame:
+				std::unordered_map<const void *, std::uint32_t> _identifiers[3];
+
+				struct Entry {
+					const DrawCommand * command;
+					const UniformValue * uniforms;
+				};
+
+				std::vector<Entry> _entries;
+				std::vector<std::uint64_t> _keys, _sorted_keys;
+				std::vector<std::uint32_t> _order, _sorted_order;
+
+				std::uint32_t identifier(std::size_t kind, const void * object);
+
+			public:
+				CommandQueue(std::size_t buffer_count = 1);
+				virtual ~CommandQueue();
+
+				/// Each thread which records commands should use a different buffer.
+				std::size_t buffer_count() const { return _buffers.size(); }
+				CommandBuffer * buffer(std::size_t index) { return _buffers[index].get(); }
+
+				void set_back_to_front(std::uint8_t layer, bool back_to_front = true) { _back_to_front[layer] = back_to_front; }
+
+				static std::uint64_t sort_key(std::uint8_t layer, std::uint32_t program, std::uint32_t texture, std::uint32_t vertex_array, GLfloat depth, bool back_to_front = false);
+
+				/// Submit all recorded commands in sorted order, and clear the buffers.
+				Statistics submit(ICommandBackend * backend);
+			};
+		}
+	}
+}
+
+#endif
@@ -10,9 +10,159 @@
 
 #include "Graphics.h"
 
+#ifdef ENABLE_TESTING
+#include <utility>
+#include <vector>
+#endif
+
 namespace Dream {
 	namespace Client {
 		namespace Graphics {
+
+// MARK: -
+// MARK: Unit Tests
+
+#ifdef ENABLE_TESTING
+			struct TestVertex {
+				GLfloat position[3];
+			};
+
+			typedef std::pair<std::size_t, std::size_t> ByteRangeT;
+
+			// Writes into memory rather than a buffer object, in the same way as a streaming ring:
+			class StubStagingBuffer {
+			public:
+				struct Handle {
+					struct Binding {
+						~Binding() {}
+					};
+
+					template <typename ElementT>
+					Binding binding() { return Binding(); }
+				};
+
+				Handle handle;
+				std::vector<ByteT> storage;
+				std::size_t head, fences;
+
+				StubStagingBuffer() : storage(4096), head(0), fences(0) {}
+
+				Handle & buffer() { return handle; }
+
+				StreamingRing::Range map(std::size_t size) {
+					if (head + size > storage.size())
+						head = 0;
+
+					StreamingRing::Range range = {head, size, &storage[head]};
+					head += size;
+
+					return range;
+				}
+
+				void unmap() {}
+				void fence() { fences += 1; }
+			};
+
+			// Keeps the contents of a buffer in memory, and records the byte ranges which were uploaded:
+			template <typename ElementT>
+			class RecordingBinding {
+			public:
+				StubStagingBuffer * staging_buffer;
+
+				std::vector<ElementT> contents;
+				std::vector<ByteRangeT> uploads, copies;
+
+				RecordingBinding(StubStagingBuffer * staging_buffer_ = NULL) : staging_buffer(staging_buffer_) {}
+
+				std::size_t size() { return contents.size(); }
+
+				template <typename ArrayT>
+				void set_data(const ArrayT & array) {
+					contents.assign(array.begin(), array.end());
+					uploads.push_back(ByteRangeT(0, sizeof(ElementT) * array.size()));
+				}
+
+				void set_partial_data(const void * data, std::size_t offset, std::size_t size) {
+					std::memcpy(&contents[offset], data, sizeof(ElementT) * size);
+					uploads.push_back(ByteRangeT(sizeof(ElementT) * offset, sizeof(ElementT) * size));
+				}
+
+				void copy_data(GLenum read_target, std::size_t read_offset, std::size_t offset, std::size_t size) {
+					std::memcpy(&contents[offset], &staging_buffer->storage[read_offset], sizeof(ElementT) * size);
+					copies.push_back(ByteRangeT(sizeof(ElementT) * offset, sizeof(ElementT) * size));
+				}
+
+				bool matches(const std::vector<ElementT> & array) const {
+					return contents.size() == array.size() && std::memcmp(contents.data(), array.data(), sizeof(ElementT) * array.size()) == 0;
+				}
+			};
+
+			static void modify(std::vector<TestVertex> & vertices, std::size_t first, std::size_t count, BufferChanges & changes) {
+				for (std::size_t i = first; i < first + count && i < vertices.size(); i += 1)
+					vertices[i].position[0] += 1;
+
+				changes.add(first, count);
+			}
+
+			UNIT_TEST(MeshBufferChanges)
+			{
+				testing("Partial Uploads");
+
+				const std::size_t STRIDE = sizeof(TestVertex);
+
+				std::vector<TestVertex> vertices(100);
+				for (std::size_t i = 0; i < vertices.size(); i += 1)
+					vertices[i].position[0] = vertices[i].position[1] = vertices[i].position[2] = (GLfloat)i;
+
+				RecordingBinding<TestVertex> binding;
+				BufferChanges changes;
+
+				changes.add_all();
+				upload_buffer_changes(binding, vertices, changes, (StubStagingBuffer *)NULL);
+				check(binding.uploads.back() == ByteRangeT(0, STRIDE * 100) && binding.matches(vertices)) << "The whole array is uploaded initially";
+
+				modify(vertices, 10, 5, changes);
+				modify(vertices, 40, 2, changes);
+				upload_buffer_changes(binding, vertices, changes, (StubStagingBuffer *)NULL);
+				check(binding.uploads.back() == ByteRangeT(STRIDE * 10, STRIDE * 32)) << "Changed ranges are merged into one upload";
+				check(binding.matches(vertices)) << "The buffer contains the changes";
+
+				upload_buffer_changes(binding, vertices, changes, (StubStagingBuffer *)NULL);
+				check(binding.uploads.size() == 2) << "Nothing is uploaded without changes";
+
+				modify(vertices, 90, 50, changes);
+				upload_buffer_changes(binding, vertices, changes, (StubStagingBuffer *)NULL);
+				check(binding.uploads.back() == ByteRangeT(STRIDE * 90, STRIDE * 10) && binding.matches(vertices)) << "Changes past the end of the array are clipped";
+
+				vertices.resize(120);
+				modify(vertices, 100, 20, changes);
+				upload_buffer_changes(binding, vertices, changes, (StubStagingBuffer *)NULL);
+				check(binding.uploads.back() == ByteRangeT(0, STRIDE * 120) && binding.matches(vertices)) << "The whole array is uploaded when it no longer fits";
+
+				testing("Staging Uploads");
+
+				StubStagingBuffer staging_buffer;
+				RecordingBinding<TestVertex> staged_binding(&staging_buffer);
+
+				changes.add_all();
+				upload_buffer_changes(staged_binding, vertices, changes, &staging_buffer);
+				check(staged_binding.uploads.size() == 1 && staged_binding.copies.empty()) << "The whole array is uploaded directly";
+
+				modify(vertices, 5, 3, changes);
+				upload_buffer_changes(staged_binding, vertices, changes, &staging_buffer);
+				check(staged_binding.copies.size() == 1 && staged_binding.copies.back() == ByteRangeT(STRIDE * 5, STRIDE * 3)) << "Partial changes are copied from the staging buffer";
+				check(staging_buffer.head == STRIDE * 3 && staging_buffer.fences == 1) << "Only the changes are staged, and then fenced";
+
+				modify(vertices, 110, 20, changes);
+				upload_buffer_changes(staged_binding, vertices, changes, &staging_buffer);
+				check(staged_binding.copies.back() == ByteRangeT(STRIDE * 110, STRIDE * 10)) << "Staged changes are clipped to the array";
+				check(staged_binding.uploads.size() == 1 && staged_binding.matches(vertices)) << "The buffer contains the staged changes";
+
+				changes.add_all();
+				upload_buffer_changes(staged_binding, vertices, changes, &staging_buffer);
+				check(staged_binding.uploads.size() == 2 && staged_binding.copies.size() == 2) << "Invalidating everything replaces the data rather than staging it";
+			}
+#endif
 		}
 	}
 }
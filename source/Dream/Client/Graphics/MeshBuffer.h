@@ -10,13 +10,88 @@
 #define _DREAM_CLIENT_GRAPHICS_MESHBUFFER_H
 
 #include "VertexArray.h"
+#include "StreamingBuffer.h"
 #include <Euclid/Geometry/Mesh.h>
 
+#include <cstring>
+#include <limits>
+
 namespace Dream {
 	namespace Client {
 		namespace Graphics {
 			using Euclid::Geometry::Mesh;
 
+			/// The range of elements which have changed since they were last uploaded.
+			struct BufferChanges {
+				std::size_t begin, end;
+
+				BufferChanges() : begin(0), end(0) {
+				}
+
+				bool empty() const {
+					return begin >= end;
+				}
+
+				void add(std::size_t first, std::size_t count) {
+					if (empty()) {
+						begin = first;
+						end = first + count;
+					} else {
+						begin = std::min(begin, first);
+						end = std::max(end, first + count);
+					}
+				}
+
+				void add_all() {
+					begin = 0;
+					end = std::numeric_limits<std::size_t>::max();
+				}
+
+				void clear() {
+					begin = end = 0;
+				}
+			};
+
+			/// Upload the changed range of the array using the binding, and clear the changes. If a staging buffer is given, partial changes are written into it and copied on the GPU.
+			template <typename BindingT, typename ArrayT, typename StagingT>
+			void upload_buffer_changes(BindingT & binding, const ArrayT & array, BufferChanges & changes, StagingT * staging_buffer) {
+				typedef typename ArrayT::value_type ElementT;
+
+				if (changes.empty())
+					return;
+
+				std::size_t size = array.size();
+				std::size_t begin = changes.begin, end = std::min(changes.end, size);
+
+				changes.clear();
+
+				if (size > binding.size() || (begin == 0 && end == size)) {
+					// Replacing all of the data lets the driver orphan the old storage rather than waiting for draws which still use it:
+					binding.set_data(array);
+				} else if (begin < end) {
+#ifndef DREAM_OPENGLES2
+					if (staging_buffer) {
+						StreamingRing::Range range = staging_buffer->map((end - begin) * sizeof(ElementT));
+						std::memcpy(range.data, &array[begin], range.size);
+						staging_buffer->unmap();
+
+						{
+							auto staging_binding = staging_buffer->buffer().template binding<ByteT>();
+							binding.copy_data(GL_COPY_READ_BUFFER, range.offset, begin, end - begin);
+						}
+
+						// The staged data can be overwritten once the copy is complete:
+						staging_buffer->fence();
+
+						return;
+					}
+#endif
+
+					binding.set_partial_data(&array[begin], begin, end - begin);
+				}
+			}
+
+			/// Uploads a mesh into vertex and index buffers and draws it. Partial changes are uploaded with glBufferSubData unless a staging buffer is given with set_staging_buffer(); no staging buffer is created by default, because it belongs to the graphics context of whoever creates it.
 			template <typename MeshT>
 			class MeshBuffer : public Object {
 			protected:
@@ -33,20 +108,34 @@ namespace Dream {
 				std::size_t _count;
 
 				bool _invalid;
+				BufferChanges _index_changes, _vertex_changes;
+
+#ifndef DREAM_OPENGLES2
+				Ref<StagingBuffer> _staging_buffer;
+#endif
+
+				template <typename BindingT, typename ArrayT>
+				void upload_changes(BindingT & binding, const ArrayT & array, BufferChanges & changes) {
+#ifndef DREAM_OPENGLES2
+					upload_buffer_changes(binding, array, changes, _staging_buffer.get());
+#else
+					upload_buffer_changes(binding, array, changes, (void *)NULL);
+#endif
+				}
 
 				void upload_buffers() {
 					DREAM_ASSERT(_mesh);
 
 					{
 						auto binding = _index_buffer.binding();
-						binding.set_data(_mesh->indices);
+						upload_changes(binding, _mesh->indices, _index_changes);
 
 						check_graphics_error();
 					}
 
 					{
 						auto binding = _vertex_buffer.binding();
-						binding.set_data(_mesh->vertices);
+						upload_changes(binding, _mesh->vertices, _vertex_changes);
 
 						check_graphics_error();
 					}
@@ -69,6 +158,7 @@ namespace Dream {
 
 			public:
 				MeshBuffer(Shared<MeshT> mesh = NULL) : _mesh(mesh), _invalid(true) {
+					invalidate();
 				}
 
 				virtual ~MeshBuffer() {
@@ -84,17 +174,42 @@ namespace Dream {
 						_mesh = mesh;
 					}
 
-					_invalid = true;
+					invalidate();
 				}
 
 				Shared<MeshT> mesh() {
 					return _mesh;
 				}
 
+				/// Upload the entire mesh before it is next drawn. If the mesh still fits in the buffers, they are not reallocated.
 				void invalidate() {
+					_index_changes.add_all();
+					_vertex_changes.add_all();
+
 					_invalid = true;
 				}
 
+				/// Upload only the given range of indices before the mesh is next drawn.
+				void invalidate_indices(std::size_t first, std::size_t count) {
+					_index_changes.add(first, count);
+
+					_invalid = true;
+				}
+
+				/// Upload only the given range of vertices before the mesh is next drawn.
+				void invalidate_vertices(std::size_t first, std::size_t count) {
+					_vertex_changes.add(first, count);
+
+					_invalid = true;
+				}
+
+#ifndef DREAM_OPENGLES2
+				/// Upload partial changes through the given staging buffer rather than with glBufferSubData, which may wait for draws using the buffer. This is opt-in; without it, every partial upload uses glBufferSubData. One staging buffer can be shared by many mesh buffers in the same context.
+				void set_staging_buffer(Ref<StagingBuffer> staging_buffer) {
+					_staging_buffer = staging_buffer;
+				}
+#endif
+
 				bool valid() {
 					return !_invalid;
 				}
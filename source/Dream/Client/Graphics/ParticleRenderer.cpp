@@ -15,6 +15,78 @@ namespace Dream
 	{
 		namespace Graphics
 		{
+			ParticleStoreRenderer::ParticleStoreRenderer() : _count(0), _vertex_offset(0) {
+				auto binding = _vertex_array.binding();
+
+				// Attach vertices buffer, the shared indices buffer is attached when drawing:
+				attach_vertices(binding, 0);
+			}
+
+			ParticleStoreRenderer::~ParticleStoreRenderer() {
+			}
+
+			void ParticleStoreRenderer::attach_vertices(VertexArray::Binding & binding, std::size_t first) {
+				auto attributes = binding.attach(_vertex_buffer.buffer(), _vertex_offset + first * sizeof(Vertex));
+				attributes[POSITION] = &Vertex::position;
+				attributes[OFFSET] = &Vertex::offset;
+				attributes[MAPPING] = &Vertex::mapping;
+				attributes[COLOR] = &Vertex::color;
+			}
+
+			ParticleStoreRenderer::Vertex * ParticleStoreRenderer::map_vertices(std::size_t count) {
+				// The quads are written into a part of the streaming buffer which isn't being drawn from:
+				StreamingRing::Range range = _vertex_buffer.map(count * 4 * sizeof(Vertex));
+
+				_vertex_offset = range.offset;
+
+				return (Vertex *)range.data;
+			}
+
+			void ParticleStoreRenderer::unmap_vertices(std::size_t count) {
+				_vertex_buffer.unmap(count * 4 * sizeof(Vertex));
+
+				// The vertices are somewhere else in the buffer each time:
+				auto binding = _vertex_array.binding();
+				attach_vertices(binding, 0);
+			}
+
+			void ParticleStoreRenderer::update(RealT dt, const Vec3 & force, RealT fade_timeout) {
+				if (_particles.size() == 0) {
+					_count = 0;
+					return;
+				}
+
+				// Each chunk of particles writes its quads into a separate part of the buffer:
+				Vertex * vertices = map_vertices(_particles.size());
+				_particles.update(dt, force, fade_timeout, 0, _worker_pool.get(), vertices);
+
+				_count = _particles.size();
+
+				unmap_vertices(_count);
+			}
+
+			void ParticleStoreRenderer::upload() {
+				_count = _particles.size();
+
+				if (_count == 0)
+					return;
+
+				_particles.expand_quads(map_vertices(_count));
+
+				unmap_vertices(_count);
+			}
+
+			void ParticleStoreRenderer::draw() {
+				// If there is nothing to draw, bail out quickly.
+				if (_count == 0)
+					return;
+
+				draw_quads(_vertex_array, _indices, _count, [&](VertexArray::Binding & binding, std::size_t first) {
+					attach_vertices(binding, first);
+				});
+
+				_vertex_buffer.fence();
+			}
 		}
 	}
 }
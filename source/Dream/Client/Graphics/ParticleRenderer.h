@@ -12,9 +12,14 @@
 
 #include "Graphics.h"
 #include "MeshBuffer.h"
+#include "QuadIndexBuffer.h"
 #include "ShaderManager.h"
+#include "StreamingBuffer.h"
 #include "../../Core/Timer.h"
 #include "../../Core/Algorithm.h"
+#include "../../Core/Random.h"
+#include "../../Events/Thread.h"
+#include "../../Simulation/ParticleStore.h"
 
 #include <Euclid/Numerics/Vector.h>
 
@@ -30,54 +35,14 @@ namespace Dream
 			using Euclid::Numerics::Vec4;
 			using Euclid::Numerics::radians;
 
-			/// Setup an array of indices for rendering quadrilaterals as triangles
-			template <typename IndexT>
-			std::size_t setup_triangle_indicies(std::size_t count, std::vector<IndexT> & indices) {
-				IndexT INDICES[] = {0, 3, 1, 1, 3, 2};
-
-				std::size_t base = indices.size() / 6;
-
-				if (count > base) {
-					count += 256;
-
-					logger()->log(LOG_DEBUG, LogBuffer() << "Generating " << (count - base) << " indices");
-
-					std::size_t added = 0;
-
-					while (base < count) {
-						for (unsigned j = 0; j < 6; j += 1) {
-							indices.push_back((base * 4) + INDICES[j]);
-						}
-
-						added += 6;
-						base += 1;
-					}
-
-					return added;
-				}
-
-				return 0;
-			}
-
-			inline RealT real_random () {
-				return (RealT)rand() / (RealT)RAND_MAX;
-			}
-
-			inline RealT real_random(RealT min, RealT max) {
-				return min + (real_random() * (max - min));
-			}
-
-			inline unsigned integral_random (unsigned max) {
-				return unsigned(real_random() * max) % max;
-			}
-
 			struct ParticleTraits {
 				// Additional data to be tracked per particle:
 				struct Particle {
 				};
 			};
 
-			template <typename DerivedT, typename TraitsT = ParticleTraits>
+			/// Particles are drawn with 16-bit indices by default, in batches of up to 16384 particles. 32-bit indices draw all particles at once, but need OES_element_index_uint on OpenGL ES 2.
+			template <typename DerivedT, typename TraitsT = ParticleTraits, typename IndexT = GLushort>
 			class ParticleRenderer : public Object, public TimedSystem<DerivedT>{
 			protected:
 				struct Vertex {
@@ -105,6 +70,11 @@ namespace Dream
 						color_modulator = real_random();
 					}
 
+					template <typename GeneratorT>
+					explicit Particle(GeneratorT & generator) : velocity(ZERO), color(1.0), life(0), age(0) {
+						color_modulator = real_random(generator);
+					}
+
 					void set_mapping(const Vec2u & count, const Vec2u index) {
 						Vec2 size = Vec2(IDENTITY) / count;
 						Vec2 offset = size * index;
@@ -115,8 +85,13 @@ namespace Dream
 						_vertices[3].mapping = offset;
 					}
 
+					template <typename GeneratorT>
+					void set_random_mapping(const Vec2u & count, GeneratorT & generator) {
+						set_mapping(count, Vec2u(integral_random(generator, count[X]), integral_random(generator, count[Y])));
+					}
+
 					void set_random_mapping(const Vec2u & count) {
-						set_mapping(count, Vec2u(integral_random(count[X]), integral_random(count[Y])));
+						set_random_mapping(count, thread_random());
 					}
 
 					void set_position(Vec3 center, Vec3 up, Vec3 forward, RealT rotation) {
@@ -202,17 +177,30 @@ namespace Dream
 				};
 
 				std::vector<Particle> _particles;
-				std::vector<GLushort> _indices;
+
+				// Each renderer draws from its own stream, so an effect can be reproduced from its seed regardless of other systems and threads.
+				PCG32 _random;
 
 				std::size_t _count;
 				VertexArray _vertex_array;
-				IndexBuffer<GLushort> _indices_buffer;
-				VertexBuffer<Vertex> _vertex_buffer;
+				Ref<QuadIndexBuffer<IndexT>> _indices;
+
+				// Vertices are written into a different part of the buffer each frame, so that writing doesn't wait for the previous frames to be drawn:
+				StreamingBuffer<GL_ARRAY_BUFFER> _vertex_buffer;
+				std::size_t _vertex_offset;
 
 				std::size_t required_vertices() {
 					return _particles.size() * 4;
 				}
 
+				void attach_vertices(VertexArray::Binding & binding, std::size_t first) {
+					auto attributes = binding.attach(_vertex_buffer.buffer(), _vertex_offset + first * sizeof(Vertex));
+					attributes[POSITION] = &Vertex::position;
+					attributes[OFFSET] = &Vertex::offset;
+					attributes[MAPPING] = &Vertex::mapping;
+					attributes[COLOR] = &Vertex::color;
+				}
+
 			public:
 				enum Attributes {
 					POSITION = 0,
@@ -221,18 +209,16 @@ namespace Dream
 					COLOR = 3
 				};
 
-				ParticleRenderer() : _count(0) {
-					auto binding = _vertex_array.binding();
+				ParticleRenderer() : _count(0), _vertex_offset(0) {
+					// The order in which arguments are evaluated is unspecified, so draw the seed and stream in sequence:
+					std::uint64_t seed = thread_random()();
+					std::uint64_t stream = thread_random()();
+					_random.seed(seed, stream);
 
-					// Attach vertices buffer:
-					auto attributes = binding.attach(_vertex_buffer);
-					attributes[POSITION] = &Vertex::position;
-					attributes[OFFSET] = &Vertex::offset;
-					attributes[MAPPING] = &Vertex::mapping;
-					attributes[COLOR] = &Vertex::color;
+					auto binding = _vertex_array.binding();
 
-					// Attach indices buffer:
-					binding.attach(_indices_buffer);
+					// Attach vertices buffer, the shared indices buffer is attached when drawing:
+					attach_vertices(binding, 0);
 				}
 
 				virtual ~ParticleRenderer() {
@@ -245,18 +231,8 @@ namespace Dream
 					if (_particles.size() == 0)
 						return;
 
-					auto binding = _vertex_buffer.binding();
-
-					// We try to avoid resizing the buffer as it turns out this is quite an expensive operation:
-					if (binding.size() < required_vertices()) {
-						binding.resize(required_vertices() * 2);
-
-						std::size_t byte_size = binding.size() * sizeof(Vertex);
-
-						logger()->log(LOG_DEBUG, LogBuffer() << "Allocating " << byte_size << " bytes to particle renderer for " << _particles.size() << " particles.");
-					}
-
-					auto buffer = binding.array();
+					StreamingRing::Range range = _vertex_buffer.map(required_vertices() * sizeof(Vertex));
+					Vertex * buffer = (Vertex *)range.data;
 
 					std::size_t i = 0;
 					while (i < _particles.size()) {
@@ -274,9 +250,14 @@ namespace Dream
 						}
 					}
 
-					binding.unmap();
+					// Only the vertices of the surviving particles were written:
+					_vertex_buffer.unmap(i * 4 * sizeof(Vertex));
 
 					_count = i;
+					_vertex_offset = range.offset;
+
+					auto binding = _vertex_array.binding();
+					attach_vertices(binding, 0);
 				}
 
 				void draw() {
@@ -284,21 +265,63 @@ namespace Dream
 					if (_count == 0)
 						return;
 
-					// Setup indices for drawing quadrilaterals as triangles:
-					std::size_t additions = setup_triangle_indicies(_count, _indices);
+					draw_quads(_vertex_array, _indices, _count, [&](VertexArray::Binding & binding, std::size_t first) {
+						attach_vertices(binding, first);
+					});
 
-					if (additions) {
-						auto binding = _indices_buffer.binding();
-						binding.set_data(_indices);
-					}
-
-					{
-						auto binding = _vertex_array.binding();
-						binding.draw_elements(GL_TRIANGLES, (GLsizei)(_count * 6), GLTypeTraits<GLushort>::TYPE);
-					}
+					_vertex_buffer.fence();
 				}
 
 				std::vector<Particle> & particles() { return _particles; }
+
+				PCG32 & random() { return _random; }
+				void seed_random(std::uint64_t seed, std::uint64_t stream = 0) { _random.seed(seed, stream); }
+			};
+
+			/// Renders particles kept in a Simulation::ParticleStore. Rather than updating each particle and its four vertices one at a time, the store is updated in bulk, and the particles are expanded into quads only when they are uploaded.
+			class ParticleStoreRenderer : public Object {
+			public:
+				typedef Simulation::ParticleVertex Vertex;
+
+				enum Attributes {
+					POSITION = 0,
+					OFFSET = 1,
+					MAPPING = 2,
+					COLOR = 3
+				};
+
+			protected:
+				Simulation::ParticleStore _particles;
+				Ref<Events::WorkerPool> _worker_pool;
+
+				std::size_t _count;
+				VertexArray _vertex_array;
+				Ref<QuadIndexBuffer<GLushort>> _indices;
+
+				StreamingBuffer<GL_ARRAY_BUFFER> _vertex_buffer;
+				std::size_t _vertex_offset;
+
+				void attach_vertices(VertexArray::Binding & binding, std::size_t first);
+
+				Vertex * map_vertices(std::size_t count);
+				void unmap_vertices(std::size_t count);
+
+			public:
+				ParticleStoreRenderer();
+				virtual ~ParticleStoreRenderer();
+
+				Simulation::ParticleStore & particles() { return _particles; }
+
+				/// Updates are spread across the given pool. The results are the same with or without a pool.
+				void set_worker_pool(Ref<Events::WorkerPool> worker_pool) { _worker_pool = worker_pool; }
+
+				/// Integrate, fade and expire all particles, and write the quads of the survivors into the vertex buffer.
+				void update(RealT dt, const Vec3 & force = ZERO, RealT fade_timeout = 0.5);
+
+				/// Expand the particles into quads in the vertex buffer, after they were changed other than by update.
+				void upload();
+
+				void draw();
 			};
 		}
 	}
@@ -8,74 +8,114 @@
 
 #include "PixelBufferRenderer.h"
 
+#include <algorithm>
+
+#ifdef ENABLE_TESTING
+#include "../../Imaging/Image.h"
+
+#include <sstream>
+#endif
+
 namespace Dream {
 	namespace Client {
 		namespace Graphics {
 			using namespace Euclid::Numerics::Constants;
 
-			PixelBufferRenderer::PixelBufferRenderer(Ptr<TextureManager> texture_manager) : _texture_manager(texture_manager) {
+			IPixelBufferBackend::~IPixelBufferBackend() {
+			}
+
+// MARK: -
+// MARK: class PixelBufferRenderer
+
+			PixelBufferRenderer::PixelBufferRenderer(Ptr<TextureManager> texture_manager) : PixelBufferRenderer((IPixelBufferBackend *)NULL) {
 				DREAM_ASSERT(texture_manager);
 
+				_gl_backend = new GLPixelBufferBackend(texture_manager);
+				_backend = _gl_backend.get();
+			}
+
+			PixelBufferRenderer::PixelBufferRenderer(IPixelBufferBackend * backend) : _backend(backend), _cache_limit(256), _generation(0), _queued_textures(0) {
 				_texture_parameters.target = GL_TEXTURE_2D;
 				_texture_parameters.wrap = GL_CLAMP_TO_EDGE;
 				_texture_parameters.min_filter = GL_NEAREST;
 				_texture_parameters.mag_filter = GL_NEAREST;
 				_texture_parameters.generate_mip_maps = false;
-
-				// Setup the vertex associations:
-				auto binding = _vertex_array.binding();
-				auto attributes = binding.attach(_vertex_buffer);
-				attributes[0] = &Vertex::position;
-				attributes[1] = &Vertex::mapping;
 			}
 
 			PixelBufferRenderer::~PixelBufferRenderer() {
 			}
 
-			Ref<Texture> PixelBufferRenderer::fetch(Ptr<IPixelBuffer> pixel_buffer, bool invalidate) {
+			const PixelBufferRenderer::CacheEntry & PixelBufferRenderer::fetch(Ptr<IPixelBuffer> pixel_buffer, bool queued) {
 				DREAM_ASSERT(pixel_buffer);
 
-				// We assume that the buffer doesn't need to be changed unless the pointers are different or invalidate is true.
+				// We assume that the buffer doesn't need to be changed unless the pointers are different or invalidate() was called.
 				// For mutable pixel buffers, this isn't such a good option - perhaps implementing a mutating count, or a running checksum?
 
-				TextureCacheT::iterator cache = _texture_cache.find(pixel_buffer);
+				TextureCacheT::iterator cache = _texture_cache.find(pixel_buffer.get());
 
 				if (cache != _texture_cache.end()) {
-					if (invalidate) {
-						// Update the texture data:
-						auto & binding = _texture_manager->bind(cache->second);
-						binding.update(pixel_buffer);
+					CacheEntriesT::iterator entry = cache->second;
+
+					// Move the entry to the front, as the most recently used:
+					_cache_entries.splice(_cache_entries.begin(), _cache_entries, entry);
+
+					if (queued && entry->generation != _generation) {
+						entry->generation = _generation;
+						entry->order = _queued_textures++;
 					}
 
 					// Return the cached texture:
-					return cache->second;
+					return *entry;
 				} else {
-					//logger()->log(LOG_DEBUG, LogBuffer() << "Fetch " << pixel_buffer << ": allocating new texture");
-
-					Ref<Texture> texture;
+					std::size_t texture = 0;
+					bool reused = false;
 
 					if (_available_textures.size() > 0) {
 						texture = _available_textures.back();
 						_available_textures.pop_back();
-						
-						auto & binding = _texture_manager->bind(texture);
-						binding.update(_texture_parameters, pixel_buffer);
+						reused = true;
+					}
+
+					// If the cache is full, reuse the texture of the least recently used pixel buffer which isn't used by queued quads. Any others over the limit are released:
+					CacheEntriesT::iterator last = _cache_entries.end();
+
+					while (_cache_entries.size() >= _cache_limit && last != _cache_entries.begin()) {
+						--last;
+
+						if (last->generation == _generation)
+							continue;
+
+						if (!reused) {
+							texture = last->texture;
+							reused = true;
+						} else {
+							_backend->release_texture(last->texture);
+						}
+
+						_texture_cache.erase(last->pixel_buffer);
+						last = _cache_entries.erase(last);
+					}
+
+					if (reused) {
+						_backend->update_texture(texture, &_texture_parameters, pixel_buffer);
 					} else {
 						// Create a new texture with the pixel buffer:
-						texture = _texture_manager->allocate(_texture_parameters, pixel_buffer);
+						texture = _backend->allocate_texture(_texture_parameters, pixel_buffer);
 					}
 
-					_texture_cache[pixel_buffer] = texture;
+					// Immediate draws have already been submitted, so their textures are given an earlier generation which can be reused:
+					if (queued)
+						_cache_entries.push_front((CacheEntry){pixel_buffer.get(), texture, _generation, _queued_textures++});
+					else
+						_cache_entries.push_front((CacheEntry){pixel_buffer.get(), texture, _generation - 1, 0});
 
-					return texture;
-				}
-			}
+					_texture_cache[pixel_buffer.get()] = _cache_entries.begin();
 
-			void PixelBufferRenderer::render(const AlignedBox2 & box, Ptr<IPixelBuffer> pixel_buffer) {
-				render(box, pixel_buffer, Vec2b(false, true), 0);
+					return _cache_entries.front();
+				}
 			}
 
-			void PixelBufferRenderer::render(const AlignedBox2 & box, Ptr<IPixelBuffer> pixel_buffer, Vec2b flip, RotationT rotation) {
+			PixelBufferRenderer::Sprite PixelBufferRenderer::make_sprite(const AlignedBox2 & box, Ptr<IPixelBuffer> pixel_buffer, Vec2b flip, RotationT rotation, int layer, bool queued) {
 				const Vec2b CORNERS[] = {
 					Vec2b(false, false),
 					Vec2b(true, false),
@@ -83,10 +123,15 @@ namespace Dream {
 					Vec2b(true, true)
 				};
 
-				std::vector<Vertex> vertices;
+				const CacheEntry & entry = fetch(pixel_buffer, queued);
+				AlignedBox2 mapping_box(ZERO, pixel_buffer->size().reduce() / _backend->texture_size(entry.texture).reduce());
 
-				Ref<Texture> texture = fetch(pixel_buffer);
-				AlignedBox2 mapping_box(ZERO, pixel_buffer->size().reduce() / texture->size().reduce());
+				Sprite sprite;
+				sprite.layer = layer;
+				sprite.texture = entry.texture;
+				sprite.order = entry.order;
+
+				Vertex * vertices = sprite.vertices;
 
 				for (std::size_t i = 0; i < 4; i += 1) {
 					Vertex vertex = {
@@ -94,7 +139,7 @@ namespace Dream {
 						.mapping = mapping_box.corner(CORNERS[(i+rotation) % 4])
 					};
 
-					vertices.push_back(vertex);
+					vertices[i] = vertex;
 				}
 
 				if (flip[X]) {
@@ -107,27 +152,329 @@ namespace Dream {
 					std::swap(vertices[1].mapping, vertices[3].mapping);
 				}
 
-				_texture_manager->bind(0, texture);
+				// The corners are in triangle strip order, but quads are drawn as triangles which expect them in order around the quad:
+				std::swap(vertices[2], vertices[3]);
 
-				{
-					auto binding = _vertex_array.binding();
-					auto buffer_binding = _vertex_buffer.binding();
+				return sprite;
+			}
+
+			std::size_t PixelBufferRenderer::draw(const Sprite * sprites, std::size_t count) {
+				std::vector<Vertex> vertices(count * 4);
+
+				for (std::size_t i = 0; i < count; i += 1)
+					std::copy(sprites[i].vertices, sprites[i].vertices + 4, &vertices[i * 4]);
+
+				_backend->upload_vertices(vertices.data(), count);
 
-					check_graphics_error();
+				std::size_t draws = 0;
 
-					buffer_binding.set_data(vertices);
-					binding.draw_arrays(GL_TRIANGLE_STRIP, 0, vertices.size());
+				for (std::size_t first = 0, run = 0; first < count; first += run) {
+					std::size_t texture = sprites[first].texture;
+
+					run = 1;
+					while (first + run < count && sprites[first + run].texture == texture)
+						run += 1;
+
+					draws += _backend->draw(texture, first, run);
 				}
+
+				_backend->finish();
+
+				return draws;
+			}
+
+			void PixelBufferRenderer::render(const AlignedBox2 & box, Ptr<IPixelBuffer> pixel_buffer) {
+				render(box, pixel_buffer, Vec2b(false, true), 0);
+			}
+
+			void PixelBufferRenderer::render(const AlignedBox2 & box, Ptr<IPixelBuffer> pixel_buffer, Vec2b flip, RotationT rotation) {
+				Sprite sprite = make_sprite(box, pixel_buffer, flip, rotation, 0, false);
+
+				draw(&sprite, 1);
+			}
+
+			void PixelBufferRenderer::queue(const AlignedBox2 & box, Ptr<IPixelBuffer> pixel_buffer, int layer) {
+				queue(box, pixel_buffer, Vec2b(false, true), 0, layer);
+			}
+
+			void PixelBufferRenderer::queue(const AlignedBox2 & box, Ptr<IPixelBuffer> pixel_buffer, Vec2b flip, RotationT rotation, int layer) {
+				_sprites.push_back(make_sprite(box, pixel_buffer, flip, rotation, layer, true));
+			}
+
+			std::size_t PixelBufferRenderer::flush() {
+				_generation += 1;
+				_queued_textures = 0;
+
+				if (_sprites.empty())
+					return 0;
+
+				// Layers are drawn in order, and the quads within each layer are grouped by texture, in the order each texture was first queued:
+				std::stable_sort(_sprites.begin(), _sprites.end(), [](const Sprite & a, const Sprite & b) {
+					if (a.layer != b.layer)
+						return a.layer < b.layer;
+
+					return a.order < b.order;
+				});
+
+				std::size_t draws = draw(_sprites.data(), _sprites.size());
+
+				_sprites.clear();
+
+				return draws;
 			}
 
 			void PixelBufferRenderer::invalidate(Ptr<IPixelBuffer> pixel_buffer) {
-				auto iterator = _texture_cache.find(pixel_buffer);
+				auto iterator = _texture_cache.find(pixel_buffer.get());
 
 				if (iterator != _texture_cache.end()) {
-					_available_textures.push_back(iterator->second);
+					CacheEntriesT::iterator entry = iterator->second;
+
+					// The texture will be reused, so queued quads must be drawn first:
+					if (entry->generation == _generation)
+						flush();
+
+					_available_textures.push_back(entry->texture);
+					_cache_entries.erase(entry);
 					_texture_cache.erase(iterator);
 				}
 			}
+
+// MARK: -
+// MARK: class GLPixelBufferBackend
+
+			GLPixelBufferBackend::GLPixelBufferBackend(Ptr<TextureManager> texture_manager) : _texture_manager(texture_manager), _vertex_offset(0) {
+			}
+
+			GLPixelBufferBackend::~GLPixelBufferBackend() {
+			}
+
+			std::size_t GLPixelBufferBackend::allocate_texture(const TextureParameters & parameters, Ptr<IPixelBuffer> pixel_buffer) {
+				Ref<Texture> texture = _texture_manager->allocate(parameters, pixel_buffer);
+
+				if (_released_textures.size() > 0) {
+					std::size_t index = _released_textures.back();
+					_released_textures.pop_back();
+
+					_textures[index] = texture;
+
+					return index;
+				}
+
+				_textures.push_back(texture);
+
+				return _textures.size() - 1;
+			}
+
+			void GLPixelBufferBackend::release_texture(std::size_t texture) {
+				_textures[texture] = NULL;
+				_released_textures.push_back(texture);
+			}
+
+			void GLPixelBufferBackend::update_texture(std::size_t texture, const TextureParameters * parameters, Ptr<IPixelBuffer> pixel_buffer) {
+				auto & binding = _texture_manager->bind(_textures[texture]);
+
+				if (parameters)
+					binding.update(*parameters, pixel_buffer);
+				else
+					binding.update(pixel_buffer);
+			}
+
+			Vec3u GLPixelBufferBackend::texture_size(std::size_t texture) {
+				return _textures[texture]->size();
+			}
+
+			void GLPixelBufferBackend::attach_vertices(VertexArray::Binding & binding, std::size_t first) {
+				auto attributes = binding.attach(_vertex_buffer.buffer(), _vertex_offset + first * sizeof(PixelBufferVertex));
+				attributes[PixelBufferRenderer::POSITION] = &PixelBufferVertex::position;
+				attributes[PixelBufferRenderer::MAPPING] = &PixelBufferVertex::mapping;
+			}
+
+			void GLPixelBufferBackend::upload_vertices(const PixelBufferVertex * vertices, std::size_t quads) {
+				StreamingRing::Range range = _vertex_buffer.map(quads * 4 * sizeof(PixelBufferVertex));
+				std::copy(vertices, vertices + quads * 4, (PixelBufferVertex *)range.data);
+
+				_vertex_buffer.unmap();
+				_vertex_offset = range.offset;
+			}
+
+			std::size_t GLPixelBufferBackend::draw(std::size_t texture, std::size_t first, std::size_t count) {
+				_texture_manager->bind(PixelBufferRenderer::DIFFUSE_TEXTURE, _textures[texture]);
+
+				{
+					auto binding = _vertex_array.binding();
+					attach_vertices(binding, first * 4);
+				}
+
+				return draw_quads(_vertex_array, _indices, count, [&](VertexArray::Binding & binding, std::size_t vertex) {
+					attach_vertices(binding, first * 4 + vertex);
+				});
+			}
+
+			void GLPixelBufferBackend::finish() {
+				check_graphics_error();
+
+				_vertex_buffer.fence();
+			}
+
+// MARK: -
+// MARK: Unit Tests
+
+#ifdef ENABLE_TESTING
+			// Records the texture operations and draw calls which would be made to OpenGL:
+			class RecordingPixelBufferBackend : public IPixelBufferBackend {
+			public:
+				std::vector<StringT> textures, draws;
+				std::size_t texture_count;
+
+				RecordingPixelBufferBackend() : texture_count(0) {}
+
+				virtual std::size_t allocate_texture(const TextureParameters & parameters, Ptr<IPixelBuffer> pixel_buffer) {
+					textures.push_back(describe("allocate", texture_count));
+
+					return texture_count++;
+				}
+
+				virtual void update_texture(std::size_t texture, const TextureParameters * parameters, Ptr<IPixelBuffer> pixel_buffer) {
+					textures.push_back(describe("update", texture));
+				}
+
+				virtual void release_texture(std::size_t texture) {
+					textures.push_back(describe("release", texture));
+				}
+
+				virtual Vec3u texture_size(std::size_t texture) {
+					return Vec3u(16, 16, 1);
+				}
+
+				virtual void upload_vertices(const PixelBufferVertex * vertices, std::size_t quads) {
+					draws.push_back(describe("upload", quads));
+				}
+
+				virtual std::size_t draw(std::size_t texture, std::size_t first, std::size_t count) {
+					std::stringstream buffer;
+					buffer << "draw " << texture << " " << first << " " << count;
+					draws.push_back(buffer.str());
+
+					return 1;
+				}
+
+				virtual void finish() {
+					draws.push_back("finish");
+				}
+
+				static StringT describe(const char * name, std::size_t value) {
+					std::stringstream buffer;
+					buffer << name << " " << value;
+					return buffer.str();
+				}
+			};
+
+			UNIT_TEST(PixelBufferRenderer)
+			{
+				using namespace Dream::Imaging;
+
+				std::vector<Ref<Image>> images;
+				for (std::size_t i = 0; i < 6; i += 1)
+					images.push_back(new Image(PixelCoordinateT(16, 16, 1), PixelFormat::RGBA, DataType::BYTE));
+
+				AlignedBox2 box(ZERO, Vec2(16, 16));
+
+				testing("Batching");
+
+				RecordingPixelBufferBackend backend;
+				Ref<PixelBufferRenderer> renderer = new PixelBufferRenderer(&backend);
+
+				renderer->queue(box, images[0]);
+				renderer->queue(box, images[1]);
+				renderer->queue(box, images[2], 1);
+				renderer->queue(box, images[0]);
+				renderer->queue(box, images[1]);
+
+				check(renderer->flush() == 3) << "One draw call for each texture in each layer";
+
+				std::vector<StringT> expected = {"upload 5", "draw 0 0 2", "draw 1 2 2", "draw 2 4 1", "finish"};
+				check(backend.draws == expected) << "Quads are grouped by texture within each layer";
+
+				backend.draws.clear();
+
+				renderer->queue(box, images[1]);
+				renderer->queue(box, images[0]);
+				renderer->queue(box, images[1]);
+				renderer->flush();
+
+				expected = {"upload 3", "draw 1 0 2", "draw 0 2 1", "finish"};
+				check(backend.draws == expected) << "Textures are drawn in the order they were first queued";
+				check(backend.textures.size() == 3) << "Each pixel buffer was uploaded once";
+
+				testing("Immediate Rendering");
+
+				backend.draws.clear();
+
+				renderer->queue(box, images[0]);
+				renderer->render(box, images[1]);
+
+				expected = {"upload 1", "draw 1 0 1", "finish"};
+				check(backend.draws == expected) << "Only the rendered pixel buffer was drawn";
+				check(renderer->queued() == 1) << "Queued quads remain queued";
+
+				renderer->flush();
+
+				testing("Least Recently Used Textures");
+
+				RecordingPixelBufferBackend cache_backend;
+				Ref<PixelBufferRenderer> cache_renderer = new PixelBufferRenderer(&cache_backend);
+				cache_renderer->set_cache_limit(2);
+
+				cache_renderer->queue(box, images[0]);
+				cache_renderer->flush();
+				cache_renderer->queue(box, images[1]);
+				cache_renderer->flush();
+
+				// The cache is full, so the least recently used textures are reused:
+				cache_renderer->queue(box, images[2]);
+				cache_renderer->queue(box, images[0]);
+
+				// Both cached textures are used by queued quads, so a new one is needed:
+				cache_renderer->queue(box, images[3]);
+				check(cache_renderer->cached_textures() == 3) << "Textures used by queued quads are not reused";
+
+				cache_renderer->flush();
+
+				// The least recently used texture is reused, and the other one over the limit is released:
+				cache_renderer->queue(box, images[4]);
+				check(cache_renderer->cached_textures() == 2) << "The cache shrinks back to its limit";
+
+				// Invalidated textures are reused before any others:
+				cache_renderer->invalidate(images[3]);
+				cache_renderer->queue(box, images[5]);
+				cache_renderer->flush();
+
+				expected = {"allocate 0", "allocate 1", "update 0", "update 1", "allocate 2", "release 1", "update 0", "update 2"};
+				check(cache_backend.textures == expected) << "Textures are reused from the least recently used pixel buffers";
+
+				testing("Immediate Textures");
+
+				RecordingPixelBufferBackend immediate_backend;
+				Ref<PixelBufferRenderer> immediate_renderer = new PixelBufferRenderer(&immediate_backend);
+				immediate_renderer->set_cache_limit(2);
+
+				for (std::size_t i = 0; i < 10; i += 1)
+					immediate_renderer->render(box, images[i % images.size()]);
+
+				check(immediate_renderer->cached_textures() == 2) << "The cache stays within its limit without flushing";
+				check(immediate_backend.texture_count == 2) << "Textures drawn immediately are reused";
+
+				// A texture used by a queued quad is not reused by an immediate draw:
+				immediate_renderer->queue(box, images[0]);
+				immediate_renderer->render(box, images[1]);
+				immediate_renderer->render(box, images[2]);
+
+				check(immediate_renderer->cached_textures() == 2 && immediate_backend.texture_count == 2) << "Immediate draws reuse the other texture";
+				check(immediate_backend.textures.back() == "update 1") << "The queued texture was kept";
+
+				immediate_renderer->flush();
+			}
+#endif
 		}
 	}
 }
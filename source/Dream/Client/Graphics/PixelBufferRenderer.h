@@ -10,8 +10,14 @@
 #define _DREAM_CLIENT_GRAPHICS_PIXELBUFFERRENDERER_H
 
 #include "MeshBuffer.h"
+#include "QuadIndexBuffer.h"
+#include "StreamingBuffer.h"
 #include "TextureManager.h"
 
+#include <list>
+#include <unordered_map>
+#include <vector>
+
 namespace Dream {
 	namespace Client {
 		namespace Graphics {
@@ -19,31 +25,94 @@ namespace Dream {
 			using Euclid::Numerics::Vec2;
 			using Euclid::Numerics::Vec2b;
 
-			/// Efficiently render pixel buffers as textured quads. Rendering pixel buffers is a common operation especially for user interfaces, text, certain graphical effects, etc. The PixelBufferRenderer provides an efficient implementation of this operation that avoids uploading pixel buffers to textures if they haven't changed.
+			struct PixelBufferVertex {
+				Vec2 position;
+				Vec2 mapping;
+			};
+
+			/// The textures and draw calls used by the pixel buffer renderer. Textures are identified by index, so that the caching and batching can be tested without a graphics context.
+			class IPixelBufferBackend {
+			public:
+				virtual ~IPixelBufferBackend();
+
+				/// Create a texture containing the pixel buffer, and return its index.
+				virtual std::size_t allocate_texture(const TextureParameters & parameters, Ptr<IPixelBuffer> pixel_buffer) = 0;
+
+				/// Replace the contents of an existing texture. If parameters is NULL, the existing parameters are used.
+				virtual void update_texture(std::size_t texture, const TextureParameters * parameters, Ptr<IPixelBuffer> pixel_buffer) = 0;
+
+				/// Release a texture which is no longer needed. Its index may be returned by a later allocation.
+				virtual void release_texture(std::size_t texture) = 0;
+
+				/// The size of the texture, which may be larger than the pixel buffer it contains.
+				virtual Vec3u texture_size(std::size_t texture) = 0;
+
+				/// Copy the vertices of the quads which are about to be drawn, four for each quad.
+				virtual void upload_vertices(const PixelBufferVertex * vertices, std::size_t quads) = 0;
+
+				/// Draw a range of the uploaded quads with the given texture. Returns the number of draw calls.
+				virtual std::size_t draw(std::size_t texture, std::size_t first, std::size_t count) = 0;
+
+				/// Called after the uploaded quads have been drawn.
+				virtual void finish() = 0;
+			};
+
+			class GLPixelBufferBackend;
+
+			/**
+			 Efficiently render pixel buffers as textured quads. Rendering pixel buffers is a common operation especially for user interfaces, text, certain graphical effects, etc. The PixelBufferRenderer provides an efficient implementation of this operation that avoids uploading pixel buffers to textures if they haven't changed.
+
+			 Quads can be queued and drawn together by flush(), which groups them by texture so that many quads using a few textures, e.g. the icons of a user interface, are drawn with a few draw calls. Quads in a lower layer are drawn before quads in a higher layer. Within a layer, quads are grouped by texture in the order each texture was first queued, so the order of quads within a layer is not preserved, and quads which overlap should be placed in different layers.
+			 */
 			class PixelBufferRenderer : public Object {
+			public:
+				typedef PixelBufferVertex Vertex;
+				typedef int RotationT;
+
 			protected:
-				Ref<TextureManager> _texture_manager;
+				Ref<GLPixelBufferBackend> _gl_backend;
+				IPixelBufferBackend * _backend;
 
-				// A cache of pixel-buffer -> texture mappings.
-				// typedef std::map<Ref<IPixelBuffer>, Ref<Texture>> TextureCacheT;
-				typedef std::map<Ptr<IPixelBuffer>, Ref<Texture>> TextureCacheT;
+				struct CacheEntry {
+					const IPixelBuffer * pixel_buffer;
+					std::size_t texture;
+
+					// The flush which last used the texture, and the order in which it was first queued since the previous flush:
+					std::size_t generation, order;
+				};
+
+				// A cache of pixel-buffer -> texture mappings, ordered from the most to the least recently used:
+				typedef std::list<CacheEntry> CacheEntriesT;
+				CacheEntriesT _cache_entries;
+
+				typedef std::unordered_map<const IPixelBuffer *, CacheEntriesT::iterator> TextureCacheT;
 				TextureCacheT _texture_cache;
-				std::vector<Ref<Texture>> _available_textures;
 
-				Ref<Texture> fetch(Ptr<IPixelBuffer> pixel_buffer, bool invalidate = false);
+				std::size_t _cache_limit, _generation, _queued_textures;
+				std::vector<std::size_t> _available_textures;
+
+				/// Find or allocate the texture for the pixel buffer. Textures for queued quads are kept until the next flush, but textures drawn immediately can be reused straight away.
+				const CacheEntry & fetch(Ptr<IPixelBuffer> pixel_buffer, bool queued);
 				TextureParameters _texture_parameters;
 
-				struct Vertex {
-					Vec2 position;
-					Vec2 mapping;
+				struct Sprite {
+					int layer;
+
+					// The texture, and the order in which it was first queued, so that sprites are grouped deterministically:
+					std::size_t texture, order;
+
+					// The corners in order around the quad:
+					Vertex vertices[4];
 				};
 
-				VertexArray _vertex_array;
-				VertexBuffer<Vertex> _vertex_buffer;
+				std::vector<Sprite> _sprites;
 
-			public:
-				typedef int RotationT;
+				Sprite make_sprite(const AlignedBox2 & box, Ptr<IPixelBuffer> pixel_buffer, Vec2b flip, RotationT rotation, int layer, bool queued);
 
+				/// Upload and draw the sprites, in order, with one draw call for each run of sprites with the same texture.
+				std::size_t draw(const Sprite * sprites, std::size_t count);
+
+			public:
 				enum Attributes {
 					POSITION = 0,
 					MAPPING = 1
@@ -54,16 +123,65 @@ namespace Dream {
 				};
 
 				PixelBufferRenderer(Ptr<TextureManager> texture_manager);
+
+				/// Use the given backend, which must remain valid for the lifetime of the renderer.
+				PixelBufferRenderer(IPixelBufferBackend * backend);
+
 				virtual ~PixelBufferRenderer();
 
 				TextureParameters & texture_parameters() { return _texture_parameters; }
 				const TextureParameters & texture_parameters() const { return _texture_parameters; }
 
+				/// The number of textures to keep for pixel buffers which haven't been used recently. Once the cache is full, the texture of the least recently used pixel buffer is reused. Textures used by queued quads are never reused before the next flush, so the cache may grow larger than this while quads are queued. Textures drawn by render() can be reused straight away.
+				std::size_t cache_limit() const { return _cache_limit; }
+				void set_cache_limit(std::size_t cache_limit) { _cache_limit = cache_limit; }
+
+				std::size_t cached_textures() const { return _cache_entries.size(); }
+
+				/// Draw a pixel buffer immediately. Queued quads are not drawn, and remain queued until the next flush.
 				void render(const AlignedBox2 & box, Ptr<IPixelBuffer> pixel_buffer);
 				void render(const AlignedBox2 & box, Ptr<IPixelBuffer> pixel_buffer, Vec2b flip, RotationT rotation);
 
+				/// Queue a pixel buffer to be drawn by the next flush.
+				void queue(const AlignedBox2 & box, Ptr<IPixelBuffer> pixel_buffer, int layer = 0);
+				void queue(const AlignedBox2 & box, Ptr<IPixelBuffer> pixel_buffer, Vec2b flip, RotationT rotation, int layer = 0);
+
+				std::size_t queued() const { return _sprites.size(); }
+
+				/// Draw the queued quads, using one draw call for each run of quads with the same texture. Returns the number of draw calls.
+				std::size_t flush();
+
 				void invalidate(Ptr<IPixelBuffer> pixel_buffer);
 			};
+
+			/// Draws pixel buffers using textures from the texture manager, and quads streamed into a vertex buffer.
+			class GLPixelBufferBackend : public Object, public IPixelBufferBackend {
+			protected:
+				Ref<TextureManager> _texture_manager;
+				std::vector<Ref<Texture>> _textures;
+				std::vector<std::size_t> _released_textures;
+
+				VertexArray _vertex_array;
+				StreamingBuffer<GL_ARRAY_BUFFER> _vertex_buffer;
+				std::size_t _vertex_offset;
+
+				Ref<QuadIndexBuffer<GLushort>> _indices;
+
+				void attach_vertices(VertexArray::Binding & binding, std::size_t first);
+
+			public:
+				GLPixelBufferBackend(Ptr<TextureManager> texture_manager);
+				virtual ~GLPixelBufferBackend();
+
+				virtual std::size_t allocate_texture(const TextureParameters & parameters, Ptr<IPixelBuffer> pixel_buffer);
+				virtual void update_texture(std::size_t texture, const TextureParameters * parameters, Ptr<IPixelBuffer> pixel_buffer);
+				virtual void release_texture(std::size_t texture);
+				virtual Vec3u texture_size(std::size_t texture);
+
+				virtual void upload_vertices(const PixelBufferVertex * vertices, std::size_t quads);
+				virtual std::size_t draw(std::size_t texture, std::size_t first, std::size_t count);
+				virtual void finish();
+			};
 		}
 	}
 }
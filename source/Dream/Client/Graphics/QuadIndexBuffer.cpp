@@ -0,0 +1,119 @@
+//
+//  Client/Graphics/QuadIndexBuffer.cpp
+//  This file is part of the "Dream" project, and is released under the MIT license.
+//
+//  Created by agent on 18/10/26.
+//  Copyright (c) 2026 agent. All rights reserved.
+//
+
+#include "QuadIndexBuffer.h"
+
+namespace Dream {
+	namespace Client {
+		namespace Graphics {
+
+// MARK: -
+// MARK: Unit Tests
+
+#ifdef ENABLE_TESTING
+			/// Records the indices which would be uploaded, so that buffers can be shared without a graphics context.
+			template <typename IndexT>
+			class RecordingQuadIndexBuffer : public Object {
+			public:
+				static std::size_t uploads;
+
+				std::size_t capacity;
+				std::vector<IndexT> indices;
+
+				RecordingQuadIndexBuffer(std::size_t capacity_) : capacity(capacity_) {
+					QuadIndexBuffer<IndexT>::generate_indices(indices, capacity);
+					uploads += 1;
+				}
+			};
+
+			template <typename IndexT>
+			std::size_t RecordingQuadIndexBuffer<IndexT>::uploads = 0;
+
+			/// Records the first quadrilateral and size of each batch.
+			struct RecordedBatches {
+				std::vector<std::size_t> first, count;
+
+				std::size_t draw(std::size_t quads, std::size_t capacity) {
+					first.clear();
+					count.clear();
+
+					return for_each_quad_batch(quads, capacity, [&](std::size_t first_, std::size_t count_) {
+						first.push_back(first_);
+						count.push_back(count_);
+					});
+				}
+			};
+
+			UNIT_TEST(QuadIndexBuffer)
+			{
+				testing("Batching");
+
+				typedef QuadIndexBuffer<GLushort> ShortIndicesT;
+				RecordedBatches batches;
+
+				check(ShortIndicesT::maximum_quads() == 16384) << "16-bit indices address 16384 quads";
+				check(ShortIndicesT::capacity_for(16383) == 16384) << "Capacity is rounded up to a power of two";
+				check(ShortIndicesT::capacity_for(100000) == 16384) << "Capacity is limited by the index type";
+
+				check(batches.draw(16383, ShortIndicesT::capacity_for(16383)) == 1) << "16383 quads are drawn at once";
+				check(batches.draw(16384, ShortIndicesT::capacity_for(16384)) == 1) << "16384 quads are drawn at once";
+
+				check(batches.draw(16385, ShortIndicesT::capacity_for(16385)) == 2) << "16385 quads are split into two batches";
+				check(batches.first[1] == 16384 && batches.count[0] == 16384 && batches.count[1] == 1) << "The second batch starts after the last addressable quad";
+
+				check(batches.draw(0, 1024) == 0) << "Nothing is drawn without quads";
+
+				std::vector<GLushort> short_indices;
+				ShortIndicesT::generate_indices(short_indices, 16384);
+				check(short_indices.back() == 65534) << "The last quad uses the largest indices";
+
+				testing("32-bit Indices");
+
+				typedef QuadIndexBuffer<GLuint> IntegerIndicesT;
+
+				check(IntegerIndicesT::capacity_for(16385) == 32768) << "32-bit indices are not limited to 16384 quads";
+				check(batches.draw(16385, IntegerIndicesT::capacity_for(16385)) == 1) << "16385 quads are drawn at once";
+
+				std::vector<GLuint> integer_indices;
+				IntegerIndicesT::generate_indices(integer_indices, 16385);
+				check(integer_indices.size() == 16385 * 6) << "Six indices per quad";
+				check(integer_indices[16384 * 6] == 65536 && integer_indices.back() == 65538) << "Indices beyond 16 bits are generated";
+
+				testing("Sharing");
+
+				typedef RecordingQuadIndexBuffer<GLushort> RecordingT;
+				Ref<RecordingT> survivor;
+
+				{
+					SharedBufferCache<RecordingT> cache;
+
+					Ref<RecordingT> a = cache.fetch(ShortIndicesT::capacity_for(100));
+					Ref<RecordingT> b = cache.fetch(ShortIndicesT::capacity_for(1000));
+					Ref<RecordingT> c = cache.fetch(ShortIndicesT::capacity_for(2000));
+
+					check(a == b) << "Renderers of similar sizes share a buffer";
+					check(a != c) << "Larger renderers use a larger buffer";
+					check(RecordingT::uploads == 2) << "Indices are uploaded once per capacity";
+					check(c->indices.size() == 2048 * 6) << "The buffer contains indices for its capacity";
+
+					a = b = nullptr;
+					check(cache.size() == 1) << "Buffers are released with their last renderer";
+
+					Ref<RecordingT> d = cache.fetch(1024);
+					check(RecordingT::uploads == 3) << "Released buffers are uploaded again when needed";
+
+					survivor = d;
+				}
+
+				// The cache no longer exists, so it must not be notified:
+				survivor = nullptr;
+			}
+#endif
+		}
+	}
+}
@@ -0,0 +1,162 @@
+//
+//  Client/Graphics/QuadIndexBuffer.h
+//  This file is part of the "Dream" project, and is released under the MIT license.
+//
+//  Created by agent on 18/10/26.
+//  Copyright (c) 2026 agent. All rights reserved.
+//
+
+#ifndef _DREAM_CLIENT_GRAPHICS_QUADINDEXBUFFER_H
+#define _DREAM_CLIENT_GRAPHICS_QUADINDEXBUFFER_H
+
+#include "Graphics.h"
+#include "VertexArray.h"
+
+#include <algorithm>
+#include <limits>
+#include <map>
+#include <vector>
+
+namespace Dream {
+	namespace Client {
+		namespace Graphics {
+			/// Shares buffers of the same capacity between renderers without keeping them alive. A buffer is released along with the last renderer which uses it, while its graphics context still exists, rather than when the process exits.
+			template <typename BufferT>
+			class SharedBufferCache : virtual protected IFinalizer {
+			protected:
+				std::map<std::size_t, BufferT *> _buffers;
+
+				virtual void finalize(Object * object) {
+					for (auto i = _buffers.begin(); i != _buffers.end(); ++i) {
+						if (static_cast<Object *>(i->second) == object) {
+							_buffers.erase(i);
+							break;
+						}
+					}
+				}
+
+			public:
+				virtual ~SharedBufferCache() {
+					for (auto & buffer : _buffers)
+						buffer.second->erase_finalizer(this);
+				}
+
+				/// Returns the buffer with the given capacity, creating it if no renderer is using one.
+				Ref<BufferT> fetch(std::size_t capacity) {
+					BufferT * & buffer = _buffers[capacity];
+
+					if (buffer)
+						return buffer;
+
+					Ref<BufferT> result = new BufferT(capacity);
+					result->insert_finalizer(this);
+					buffer = result.get();
+
+					return result;
+				}
+
+				std::size_t size() const { return _buffers.size(); }
+			};
+
+			/// Indices for drawing quadrilaterals as pairs of triangles. The indices only depend on the number of quadrilaterals, so the buffers are generated once and shared by every renderer which needs the same capacity.
+			template <typename IndexT>
+			class QuadIndexBuffer : public Object {
+			protected:
+				std::size_t _capacity;
+				IndexBuffer<IndexT> _buffer;
+
+			public:
+				/// The most quadrilaterals which the index type can address in a single draw call.
+				static std::size_t maximum_quads() {
+					return ((std::size_t)std::numeric_limits<IndexT>::max() + 1) / 4;
+				}
+
+				/// The capacity of the shared buffer used to draw the given number of quadrilaterals. Capacities are rounded up to a power of two so that renderers of similar sizes share the same buffer.
+				static std::size_t capacity_for(std::size_t count) {
+					std::size_t capacity = 1024;
+					while (capacity < count && capacity < maximum_quads())
+						capacity *= 2;
+
+					return std::min(capacity, maximum_quads());
+				}
+
+				static void generate_indices(std::vector<IndexT> & indices, std::size_t capacity) {
+					const IndexT INDICES[] = {0, 3, 1, 1, 3, 2};
+
+					DREAM_ASSERT(capacity <= maximum_quads());
+
+					indices.resize(capacity * 6);
+
+					for (std::size_t i = 0; i < capacity; i += 1) {
+						for (std::size_t j = 0; j < 6; j += 1) {
+							indices[i * 6 + j] = (IndexT)(i * 4 + INDICES[j]);
+						}
+					}
+				}
+
+				QuadIndexBuffer(std::size_t capacity) : _capacity(capacity), _buffer(GL_STATIC_DRAW) {
+					std::vector<IndexT> indices;
+					generate_indices(indices, capacity);
+
+					logger()->log(LOG_DEBUG, LogBuffer() << "Generating " << indices.size() << " indices for " << capacity << " quads");
+
+					auto binding = _buffer.binding();
+					binding.set_data(indices);
+				}
+
+				std::size_t capacity() const { return _capacity; }
+				IndexBuffer<IndexT> & buffer() { return _buffer; }
+
+				/// A shared buffer with enough indices to draw the given number of quadrilaterals in as few batches as possible.
+				static Ref<QuadIndexBuffer> for_quads(std::size_t count) {
+					static SharedBufferCache<QuadIndexBuffer> buffers;
+
+					return buffers.fetch(capacity_for(count));
+				}
+			};
+
+			/// Splits the quadrilaterals into batches of at most the given capacity, and calls draw(first, count) for each batch. Returns the number of batches.
+			template <typename DrawT>
+			std::size_t for_each_quad_batch(std::size_t count, std::size_t capacity, DrawT draw) {
+				std::size_t batches = 0;
+
+				for (std::size_t first = 0; first < count; first += capacity) {
+					draw(first, std::min(capacity, count - first));
+					batches += 1;
+				}
+
+				return batches;
+			}
+
+			/// Draw quadrilaterals from the vertex array using a shared index buffer. If there are more than the index type can address, they are drawn in batches, and attach(binding, first_vertex) is called before each batch to point the vertex attributes at its first vertex. Returns the number of draw calls.
+			template <typename IndexT, typename AttachT>
+			std::size_t draw_quads(VertexArray & vertex_array, Ref<QuadIndexBuffer<IndexT>> & indices, std::size_t count, AttachT attach) {
+				if (!indices || indices->capacity() < std::min(count, QuadIndexBuffer<IndexT>::maximum_quads())) {
+					indices = QuadIndexBuffer<IndexT>::for_quads(count);
+
+					// The index buffer is part of the state of the vertex array:
+					auto binding = vertex_array.binding();
+					binding.attach(indices->buffer());
+				}
+
+				auto binding = vertex_array.binding();
+				std::size_t batch = indices->capacity();
+
+				std::size_t draws = for_each_quad_batch(count, batch, [&](std::size_t first, std::size_t quads) {
+					if (count > batch)
+						attach(binding, first * 4);
+
+					binding.draw_elements(GL_TRIANGLES, (GLsizei)(quads * 6), GLTypeTraits<IndexT>::TYPE);
+				});
+
+				// Leave the attributes pointing at the start of the buffer:
+				if (count > batch)
+					attach(binding, 0);
+
+				return draws;
+			}
+		}
+	}
+}
+
+#endif
@@ -8,6 +8,7 @@
 
 #include "ShaderManager.h"
 
+#include <cstring>
 #include <exception>
 
 namespace Dream {
@@ -24,6 +25,195 @@ namespace Dream {
 
 // MARK: -
 
+			std::size_t uniform_type_size(GLenum type)
+			{
+				switch (type) {
+					case GL_FLOAT: case GL_INT: case GL_BOOL:
+						return 4;
+					case GL_FLOAT_VEC2: case GL_INT_VEC2: case GL_BOOL_VEC2:
+						return 8;
+					case GL_FLOAT_VEC3: case GL_INT_VEC3: case GL_BOOL_VEC3:
+						return 12;
+					case GL_FLOAT_VEC4: case GL_INT_VEC4: case GL_BOOL_VEC4: case GL_FLOAT_MAT2:
+						return 16;
+					case GL_FLOAT_MAT3:
+						return 36;
+					case GL_FLOAT_MAT4:
+						return 64;
+					case GL_SAMPLER_2D: case GL_SAMPLER_CUBE:
+						return 4;
+#ifndef DREAM_OPENGLES2
+					case GL_UNSIGNED_INT: case GL_SAMPLER_3D: case GL_SAMPLER_2D_SHADOW: case GL_SAMPLER_2D_ARRAY:
+						return 4;
+					case GL_UNSIGNED_INT_VEC2:
+						return 8;
+					case GL_UNSIGNED_INT_VEC3:
+						return 12;
+					case GL_UNSIGNED_INT_VEC4:
+						return 16;
+					case GL_FLOAT_MAT2x3: case GL_FLOAT_MAT3x2:
+						return 24;
+					case GL_FLOAT_MAT2x4: case GL_FLOAT_MAT4x2:
+						return 32;
+					case GL_FLOAT_MAT3x4: case GL_FLOAT_MAT4x3:
+						return 48;
+#endif
+					default:
+						return 0;
+				}
+			}
+
+			bool uniform_type_compatible(GLenum type, GLenum expected)
+			{
+				if (type == expected)
+					return true;
+
+				// Samplers and booleans are set using integers:
+				if (expected == GL_INT) {
+					switch (type) {
+						case GL_BOOL: case GL_SAMPLER_2D: case GL_SAMPLER_CUBE:
+#ifndef DREAM_OPENGLES2
+						case GL_SAMPLER_3D: case GL_SAMPLER_2D_SHADOW: case GL_SAMPLER_2D_ARRAY:
+#endif
+							return true;
+					}
+				}
+
+				return false;
+			}
+
+// MARK: -
+// MARK: class UniformTable
+
+			std::size_t UniformTable::NameHash::operator()(const char * name) const
+			{
+				// FNV-1a:
+				std::size_t hash = 2166136261U;
+
+				for (; *name; name += 1) {
+					hash ^= (unsigned char)*name;
+					hash *= 16777619U;
+				}
+
+				return hash;
+			}
+
+			bool UniformTable::NameEqual::operator()(const char * a, const char * b) const
+			{
+				return std::strcmp(a, b) == 0;
+			}
+
+			std::size_t UniformTable::add(const char * name, GLint location, GLenum type, GLint size)
+			{
+				std::size_t index = find(name);
+				// Setting an element of an array would leave the cached value of the whole array out of date:
+				std::size_t value_capacity = size == 1 ? uniform_type_size(type) : 0;
+
+				if (index == UniformLocation::NONE) {
+					index = _entries.size();
+
+					_names.push_back(name);
+					_indices[_names.back().c_str()] = index;
+
+					_entries.resize(index + 1);
+					_entries[index].value_capacity = 0;
+				}
+
+				Entry & entry = _entries[index];
+				entry.name = name;
+				entry.location = location;
+				entry.type = type;
+				entry.size = size;
+
+				// Only allocate more storage if the existing value doesn't fit:
+				if (value_capacity > entry.value_capacity) {
+					entry.value_offset = _values.size();
+					_values.resize(_values.size() + value_capacity);
+				}
+
+				entry.value_capacity = value_capacity;
+				entry.value_size = 0;
+
+				if (location != -1)
+					_locations.insert(std::make_pair(location, index));
+
+				return index;
+			}
+
+			std::size_t UniformTable::find(const char * name) const
+			{
+				auto i = _indices.find(name);
+
+				if (i != _indices.end())
+					return i->second;
+				else
+					return UniformLocation::NONE;
+			}
+
+			UniformLocation UniformTable::location(const char * name) const
+			{
+				std::size_t index = find(name);
+
+				if (index != UniformLocation::NONE)
+					return UniformLocation(_entries[index].location, index);
+				else
+					return UniformLocation();
+			}
+
+			UniformLocation UniformTable::location(GLint location) const
+			{
+				auto i = _locations.find(location);
+
+				if (i != _locations.end())
+					return UniformLocation(location, i->second);
+				else
+					return UniformLocation(location);
+			}
+
+			bool UniformTable::update(const UniformLocation & uniform, const void * data, std::size_t size)
+			{
+				// Setting an inactive uniform has no effect:
+				if (uniform.location == -1)
+					return false;
+
+				if (uniform.index == UniformLocation::NONE)
+					return true;
+
+				Entry & entry = _entries[uniform.index];
+
+				// The value can't be cached, e.g. because the type is not known:
+				if (size > entry.value_capacity)
+					return true;
+
+				ByteT * value = &_values[entry.value_offset];
+
+				if (entry.value_size == size && std::memcmp(value, data, size) == 0)
+					return false;
+
+				std::memcpy(value, data, size);
+				entry.value_size = size;
+
+				return true;
+			}
+
+			void UniformTable::invalidate()
+			{
+				for (auto & entry : _entries)
+					entry.value_size = 0;
+			}
+
+			void UniformTable::clear()
+			{
+				_names.clear();
+				_indices.clear();
+				_locations.clear();
+				_entries.clear();
+				_values.clear();
+			}
+
+// MARK: -
+// MARK: class Program
+
 			Program::Program()
 			{
 				_handle = glCreateProgram();
@@ -56,24 +246,95 @@ namespace Dream {
 					buffer << "Error linking program:" << std::endl;
 					buffer << StringT(log->begin(), log->end()) << std::endl;
 					logger()->log(LOG_ERROR, buffer);
+				} else {
+					reflect();
 				}
 
 				return status != 0;
 			}
 
+			void Program::reflect()
+			{
+				_uniforms.clear();
+				_uniform_blocks.clear();
+
+				GLint count = 0, maximum_length = 0;
+				property(GL_ACTIVE_UNIFORMS, &count);
+				property(GL_ACTIVE_UNIFORM_MAX_LENGTH, &maximum_length);
+
+				std::vector<GLchar> name(std::max(maximum_length, 1));
+
+				for (GLint i = 0; i < count; i += 1) {
+					GLsizei length = 0;
+					GLint size = 0;
+					GLenum type = 0;
+
+					glGetActiveUniform(_handle, i, (GLsizei)name.size(), &length, &size, &type, name.data());
+
+					// Arrays are reported by their first element, but are usually set by the name of the array:
+					if (length > 3 && std::strcmp(name.data() + length - 3, "[0]") == 0)
+						name[length - 3] = '\0';
+
+					GLint location = glGetUniformLocation(_handle, name.data());
+
+					// Uniforms in blocks don't have a location, and are set through buffers instead:
+					if (location != -1)
+						_uniforms.add(name.data(), location, type, size);
+				}
+
+#ifndef DREAM_OPENGLES2
+				property(GL_ACTIVE_UNIFORM_BLOCKS, &count);
+				property(GL_ACTIVE_UNIFORM_BLOCK_MAX_NAME_LENGTH, &maximum_length);
+
+				name.resize(std::max(maximum_length, 1));
+
+				for (GLint i = 0; i < count; i += 1) {
+					GLint data_size = 0;
+
+					glGetActiveUniformBlockName(_handle, i, (GLsizei)name.size(), NULL, name.data());
+					glGetActiveUniformBlockiv(_handle, i, GL_UNIFORM_BLOCK_DATA_SIZE, &data_size);
+
+					_uniform_blocks.add(name.data(), i, 0, data_size);
+				}
+#endif
+
+				check_graphics_error();
+			}
+
 			GLint Program::attribute_location(const char * name)
 			{
 				return glGetAttribLocation(_handle, name);
 			}
 
+			UniformLocation Program::uniform(const char * name)
+			{
+				UniformLocation location = _uniforms.location(name);
+
+				if (location.index == UniformLocation::NONE) {
+					// Remember the result, even if there is no such uniform, so that it is only looked up once:
+					GLint result = glGetUniformLocation(_handle, name);
+					location = UniformLocation(result, _uniforms.add(name, result, 0, 0));
+				}
+
+				return location;
+			}
+
 			GLint Program::uniform_location(const char * name)
 			{
-				return glGetUniformLocation(_handle, name);
+				return uniform(name).location;
 			}
 
 #ifndef DREAM_OPENGLES2
 			GLint Program::uniform_block_index(const char * name) {
-				return glGetUniformBlockIndex(_handle, name);
+				std::size_t index = _uniform_blocks.find(name);
+
+				if (index != UniformLocation::NONE)
+					return _uniform_blocks[index].location;
+
+				GLint result = glGetUniformBlockIndex(_handle, name);
+				_uniform_blocks.add(name, result, 0, 0);
+
+				return result;
 			}
 #endif
 
@@ -161,6 +422,96 @@ namespace Dream {
 
 				return shader;
 			}
+
+// MARK: -
+// MARK: Unit Tests
+
+#ifdef ENABLE_TESTING
+			UNIT_TEST(UniformTable)
+			{
+				testing("Finding Uniforms");
+
+				UniformTable table;
+				table.add("transform", 3, GL_FLOAT_MAT4, 1);
+				table.add("color", 5, GL_FLOAT_VEC4, 1);
+				table.add("lights", 7, GL_FLOAT_VEC3, 4);
+
+				// Use a copy of the name, so that it is found by content rather than by address:
+				char name[] = "color";
+				UniformLocation color = table.location(name);
+
+				check(color.location == 5 && table[color.index].name == "color") << "Uniform was found by name";
+				check(table.find("colour") == UniformLocation::NONE) << "Missing uniform was not found";
+
+				// Adding more names must not move the interned names:
+				for (std::size_t i = 0; i < 1000; i += 1) {
+					StringT extra = "extra" + std::to_string(i);
+					table.add(extra.c_str(), -1, 0, 0);
+				}
+
+				check(table.location("transform").location == 3 && table.location("extra999").index == 1002) << "Names are still found after adding more";
+
+				testing("Caching Values");
+
+				GLfloat red[] = {1, 0, 0, 1}, green[] = {0, 1, 0, 1};
+
+				check(table.update(color, red, sizeof(red))) << "The first value is uploaded";
+				check(!table.update(color, red, sizeof(red))) << "The same value is not uploaded again";
+				check(table.update(color, green, sizeof(green))) << "A different value is uploaded";
+
+				table.invalidate();
+				check(table.update(color, green, sizeof(green))) << "Values are uploaded after invalidating the table";
+
+				GLfloat lights[12] = {0};
+				UniformLocation lights_location = table.location("lights");
+				check(table.update(lights_location, lights, sizeof(lights)) && table.update(lights_location, lights, sizeof(lights))) << "Arrays are not cached, as their elements can be set separately";
+
+				GLfloat transform[32] = {0};
+				UniformLocation transform_location = table.location("transform");
+				check(table.update(transform_location, transform, sizeof(transform)) && table.update(transform_location, transform, sizeof(transform))) << "Values larger than the uniform are always uploaded";
+
+				check(!table.update(table.location("extra1"), red, sizeof(red))) << "Inactive uniforms are never uploaded";
+				check(table.update(UniformLocation(9), red, sizeof(red))) << "Uniforms without an entry are always uploaded";
+
+				testing("Finding Uniforms by Location");
+
+				check(table.location(5).index == color.index) << "Uniform was found by location";
+				check(table.location(9).index == UniformLocation::NONE && table.location(9).location == 9) << "Unknown locations have no entry";
+				check(table.update(table.location(5), red, sizeof(red)) && !table.update(color, red, sizeof(red))) << "Values set by location and by name share the cache";
+
+				testing("Adding Existing Uniforms");
+
+				std::size_t values_size = table.values_size();
+				std::size_t index = table.add("color", 5, GL_FLOAT_VEC4, 1);
+
+				check(index == color.index && table.values_size() == values_size) << "The existing storage is reused";
+				check(table.update(color, red, sizeof(red))) << "The value is uploaded after adding the uniform again";
+
+				table.add("color", 5, GL_FLOAT_MAT4, 1);
+				check(table.values_size() == values_size + sizeof(GLfloat) * 16) << "Larger values are given new storage";
+
+				table.add("color", 5, GL_FLOAT_VEC4, 1);
+
+				testing("Mixing Names and Locations");
+
+				// Bindings resolve raw locations through the table, so the value set by location replaces the cached value:
+				check(table.update(color, red, sizeof(red))) << "The value is set by name";
+				check(table.update(table.location(5), green, sizeof(green))) << "A different value is set by location";
+				check(table.update(color, red, sizeof(red))) << "Setting the old value by name is uploaded again";
+				check(!table.update(table.location(5), red, sizeof(red))) << "Setting the same value by location is not uploaded again";
+			}
+
+			UNIT_TEST(UniformTypes)
+			{
+				testing("Compatible Types");
+
+				check(uniform_type_compatible(GL_FLOAT_VEC4, GLUniformTypeTraits<Vector<4, GLfloat>>::TYPE)) << "Vectors match";
+				check(uniform_type_compatible(GL_SAMPLER_2D, GLUniformTypeTraits<GLint>::TYPE)) << "Samplers are set using integers";
+				check(!uniform_type_compatible(GL_FLOAT_MAT4, GLUniformTypeTraits<Vector<4, GLfloat>>::TYPE)) << "Matrices are not vectors";
+
+				check(uniform_type_size(GL_FLOAT_MAT3) == sizeof(GLfloat) * 9) << "Matrix size is correct";
+			}
+#endif
 		}
 	}
 }
@@ -13,6 +13,9 @@
 
 #include <Euclid/Numerics/Vector.h>
 
+#include <deque>
+#include <unordered_map>
+
 namespace Dream {
 	namespace Client {
 		namespace Graphics {
@@ -100,14 +103,110 @@ namespace Dream {
 				const char * what () const noexcept;
 			};
 
+			/// The number of bytes used by a single value of the given uniform type, or zero if the type is not known.
+			std::size_t uniform_type_size(GLenum type);
+
+			/// The location of a uniform and its index in the program's uniform table, if it has one.
+			struct UniformLocation {
+				static const std::size_t NONE = (std::size_t)-1;
+
+				GLint location;
+				std::size_t index;
+
+				UniformLocation(GLint location_ = -1, std::size_t index_ = NONE) : location(location_), index(index_) {
+				}
+
+				bool valid() const { return location != -1; }
+			};
+
+			/// A uniform which has been looked up once by name, and can then be set any number of times without a lookup.
+			template <typename ValueT>
+			struct UniformHandle : public UniformLocation {
+				UniformHandle(const UniformLocation & location = UniformLocation()) : UniformLocation(location) {
+				}
+			};
+
+			/**
+			 The uniforms of a program, which can be found by name without calling OpenGL.
+
+			 Names are interned when they are added, and looked up by hashing them in place, so lookups don't allocate. The table also keeps the last value set for each uniform, so that values which have not changed are not uploaded again. Arrays are not cached, as their elements can also be set individually by name or location.
+			 */
+			class UniformTable {
+			public:
+				struct Entry {
+					StringT name;
+					GLint location;
+					GLenum type;
+
+					/// The number of array elements.
+					GLint size;
+
+					std::size_t value_offset, value_capacity, value_size;
+				};
+
+			protected:
+				struct NameHash {
+					std::size_t operator()(const char * name) const;
+				};
+
+				struct NameEqual {
+					bool operator()(const char * a, const char * b) const;
+				};
+
+				// The names are stored separately from the entries, as their addresses must not change:
+				std::deque<StringT> _names;
+				std::unordered_map<const char *, std::size_t, NameHash, NameEqual> _indices;
+
+				// The first entry added for each location, so that values set by location share the same cache:
+				std::unordered_map<GLint, std::size_t> _locations;
+
+				std::vector<Entry> _entries;
+				std::vector<ByteT> _values;
+
+			public:
+				/// Adding a name which is already in the table replaces its entry, reusing the storage for its value if it is large enough.
+				std::size_t add(const char * name, GLint location, GLenum type, GLint size);
+
+				/// Returns UniformLocation::NONE if there is no uniform with the given name.
+				std::size_t find(const char * name) const;
+
+				UniformLocation location(const char * name) const;
+
+				/// The entry for a uniform which is only known by location, e.g. one recorded in a command buffer.
+				UniformLocation location(GLint location) const;
+
+				std::size_t size() const { return _entries.size(); }
+
+				/// The number of bytes used to keep the last values.
+				std::size_t values_size() const { return _values.size(); }
+
+				const Entry & operator[](std::size_t index) const { return _entries[index]; }
+
+				/// Stores the value and returns true if it differs from the last value, and needs to be uploaded.
+				bool update(const UniformLocation & uniform, const void * data, std::size_t size);
+
+				/// Forget the last values, e.g. if uniforms were set without using this table.
+				void invalidate();
+
+				void clear();
+			};
+
 			class Program : public Object {
 			protected:
 				// This is actually a program handle.
 				GLenum _handle;
 
+				// The active uniforms and uniform blocks, which are found when the program is linked:
+				UniformTable _uniforms, _uniform_blocks;
+
 				void enable();
 				void disable();
 
+				/// Enumerate the active uniforms and uniform blocks.
+				void reflect();
+
+				friend class GLCommandBackend;
+
 			public:
 				Program();
 				~Program();
@@ -116,9 +215,24 @@ namespace Dream {
 				bool link();
 
 				GLint attribute_location(const char * name);
+
+				/// Uniform locations are looked up in the table built when the program was linked. Names which were not active, such as individual array elements, are looked up once and then added to the table.
 				GLint uniform_location(const char * name);
 				GLint uniform_block_index(const char * name);
 
+				UniformLocation uniform(const char * name);
+
+				/// Look up a uniform once, so that it can be set without looking it up again. In debug builds, the type is checked against the type of the active uniform.
+				template <typename ValueT>
+				UniformHandle<ValueT> uniform(const char * name);
+
+				/// For uniform blocks, the location is the block index and the size is the size of the block's data in bytes.
+				const UniformTable & uniforms() const { return _uniforms; }
+				const UniformTable & uniform_blocks() const { return _uniform_blocks; }
+
+				/// Forget the cached uniform values, if uniforms were set directly using OpenGL.
+				void invalidate_uniforms() { _uniforms.invalidate(); }
+
 				void bind_fragment_location(const char * name, GLuint output = 0);
 
 			public:
@@ -130,12 +244,21 @@ namespace Dream {
 				protected:
 					Program * _program;
 
-					GLuint location_of(GLuint location) {
+					UniformLocation location_of(GLuint location) {
+						return _program->_uniforms.location((GLint)location);
+					}
+
+					UniformLocation location_of(const char * name) {
+						return _program->uniform(name);
+					}
+
+					UniformLocation location_of(const UniformLocation & location) {
 						return location;
 					}
 
-					GLuint location_of(const char * name) {
-						return _program->uniform_location(name);
+					// Values are only uploaded if they have changed since they were last set:
+					bool update(const UniformLocation & uniform, const void * data, std::size_t size) {
+						return _program->_uniforms.update(uniform, data, size);
 					}
 
 				public:
@@ -154,22 +277,53 @@ namespace Dream {
 
 					template <typename LocationT>
 					void set_texture_unit(LocationT name, GLuint unit) {
-						glUniform1i(location_of(name), unit);
+						set_uniform(name, (GLint)unit);
+					}
+
+					template <typename LocationT>
+					void set_uniform(LocationT name, GLint value) {
+						UniformLocation uniform = location_of(name);
+
+						if (update(uniform, &value, sizeof(value)))
+							glUniform1i(uniform.location, value);
+					}
+
+					template <typename LocationT>
+					void set_uniform(LocationT name, GLfloat value) {
+						UniformLocation uniform = location_of(name);
+
+						if (update(uniform, &value, sizeof(value)))
+							glUniform1f(uniform.location, value);
 					}
 
 					template <typename LocationT, dimension E, typename T>
 					void set_uniform(LocationT name, const Vector<E, T> & vector) {
-						GLUniformTraits<E>::set(location_of(name), 1, vector.data());
+						UniformLocation uniform = location_of(name);
+
+						if (update(uniform, vector.data(), sizeof(T) * E))
+							GLUniformTraits<E>::set(uniform.location, 1, vector.data());
 					}
 
 					template <typename LocationT, dimension E, typename T, dimension N>
 					void set_uniform(LocationT name, const Vector<E, T>(&vector)[N]) {
-						GLUniformTraits<E>::set(location_of(name), N, vector[0].data());
+						UniformLocation uniform = location_of(name);
+
+						if (update(uniform, vector[0].data(), sizeof(T) * E * N))
+							GLUniformTraits<E>::set(uniform.location, N, vector[0].data());
 					}
 
 					template <typename LocationT, dimension R, dimension C, typename T>
 					void set_uniform(LocationT name, const Matrix<R, C, T> & matrix, bool transpose = false) {
-						GLUniformMatrixTraits<R, C>::set(location_of(name), 1, transpose, matrix.data());
+						UniformLocation uniform = location_of(name);
+
+						// Transposed matrices are not cached, as the same data would be uploaded differently:
+						if (transpose || update(uniform, matrix.data(), sizeof(T) * R * C))
+							GLUniformMatrixTraits<R, C>::set(uniform.location, 1, transpose, matrix.data());
+					}
+
+					template <typename ValueT>
+					void set(const UniformHandle<ValueT> & uniform, const ValueT & value) {
+						set_uniform(uniform, value);
 					}
 				};
 
@@ -351,6 +505,48 @@ namespace Dream {
 					glUniformMatrix4fv(location, count, transpose, value);
 				}
 			};
+
+			// MARK: -
+			// MARK: Uniform Types
+
+			/// The type of uniform which can be set from a value of the given type.
+			template <typename ValueT>
+			struct GLUniformTypeTraits {
+			};
+
+#define GL_UNIFORM_TYPE_TRAITS(name, ...) template <> struct GLUniformTypeTraits<__VA_ARGS__>{ enum { TYPE = name }; };
+
+			GL_UNIFORM_TYPE_TRAITS(GL_INT, GLint)
+			GL_UNIFORM_TYPE_TRAITS(GL_FLOAT, GLfloat)
+			GL_UNIFORM_TYPE_TRAITS(GL_FLOAT, Vector<1, GLfloat>)
+			GL_UNIFORM_TYPE_TRAITS(GL_FLOAT_VEC2, Vector<2, GLfloat>)
+			GL_UNIFORM_TYPE_TRAITS(GL_FLOAT_VEC3, Vector<3, GLfloat>)
+			GL_UNIFORM_TYPE_TRAITS(GL_FLOAT_VEC4, Vector<4, GLfloat>)
+			GL_UNIFORM_TYPE_TRAITS(GL_INT, Vector<1, GLint>)
+			GL_UNIFORM_TYPE_TRAITS(GL_INT_VEC2, Vector<2, GLint>)
+			GL_UNIFORM_TYPE_TRAITS(GL_INT_VEC3, Vector<3, GLint>)
+			GL_UNIFORM_TYPE_TRAITS(GL_INT_VEC4, Vector<4, GLint>)
+			GL_UNIFORM_TYPE_TRAITS(GL_FLOAT_MAT2, Matrix<2, 2, GLfloat>)
+			GL_UNIFORM_TYPE_TRAITS(GL_FLOAT_MAT3, Matrix<3, 3, GLfloat>)
+			GL_UNIFORM_TYPE_TRAITS(GL_FLOAT_MAT4, Matrix<4, 4, GLfloat>)
+
+#undef GL_UNIFORM_TYPE_TRAITS
+
+			/// Whether a value of the expected type can be used to set a uniform of the given type. Integers can also set samplers and booleans.
+			bool uniform_type_compatible(GLenum type, GLenum expected);
+
+			template <typename ValueT>
+			UniformHandle<ValueT> Program::uniform(const char * name) {
+				UniformLocation location = uniform(name);
+
+				if (location.index != UniformLocation::NONE) {
+					GLenum type = _uniforms[location.index].type;
+
+					DREAM_ASSERT(type == 0 || uniform_type_compatible(type, GLUniformTypeTraits<ValueT>::TYPE));
+				}
+
+				return UniformHandle<ValueT>(location);
+			}
 		}
 	}
 }
@@ -0,0 +1,394 @@
+//
+//  Client/Graphics/StreamingBuffer.cpp
+//  This file is part of the "Dream" project, and is released under the MIT license.
+//
+//  Created by agent on 18/10/26.
+//  Copyright (c) 2026 agent. All rights reserved.
+//
+
+#include "StreamingBuffer.h"
+
+#include <algorithm>
+
+#ifdef ENABLE_TESTING
+#include <cstdint>
+#include <set>
+#endif
+
+namespace Dream {
+	namespace Client {
+		namespace Graphics {
+
+// MARK: -
+// MARK: class StreamingRing
+
+			IStreamingBackend::~IStreamingBackend() {
+			}
+
+			StreamingRing::StreamingRing(IStreamingBackend * backend, std::size_t capacity, std::size_t alignment) : _backend(backend), _capacity(capacity), _alignment(alignment), _allocated(false), _mapped(false), _head(0), _frame_begin(0), _frame_used(false) {
+				DREAM_ASSERT(alignment > 0 && (alignment & (alignment - 1)) == 0);
+
+				_statistics = (Statistics){0, 0, 0, 0};
+			}
+
+			StreamingRing::~StreamingRing() {
+				for (auto & region : _regions)
+					_backend->delete_fence(region.fence);
+			}
+
+			bool StreamingRing::overlaps(std::size_t begin, std::size_t end, std::size_t offset, std::size_t size) const {
+				std::size_t last = offset + size;
+
+				if (begin < end)
+					return offset < end && begin < last;
+
+				// The region wraps around, covering [begin, capacity) and [0, end):
+				return last > begin || offset < end;
+			}
+
+			bool StreamingRing::overlaps_pending(std::size_t offset, std::size_t size) const {
+				for (auto & region : _regions) {
+					if (overlaps(region.begin, region.end, offset, size))
+						return true;
+				}
+
+				return false;
+			}
+
+			void StreamingRing::retire_front(bool wait) {
+				// Fences are signalled in order, so the oldest region is always the first to become free:
+				while (!_regions.empty()) {
+					Region & region = _regions.front();
+
+					if (!_backend->wait_fence(region.fence, false)) {
+						if (!wait)
+							return;
+
+						_statistics.waits += 1;
+						_backend->wait_fence(region.fence, true);
+						wait = false;
+					}
+
+					_backend->delete_fence(region.fence);
+					_regions.pop_front();
+				}
+			}
+
+			void StreamingRing::reallocate(std::size_t capacity) {
+				// Draws which were issued before the storage was replaced continue to use the old storage, so there is no need to wait for them:
+				for (auto & region : _regions)
+					_backend->delete_fence(region.fence);
+
+				_regions.clear();
+
+				_backend->allocate_storage(capacity);
+				_statistics.reallocations += 1;
+
+				_capacity = capacity;
+				_allocated = true;
+				_head = _frame_begin = 0;
+				_frame_used = false;
+			}
+
+			StreamingRing::Range StreamingRing::map(std::size_t size) {
+				DREAM_ASSERT(!_mapped && size > 0);
+
+				std::size_t offset = (_head + _alignment - 1) & ~(_alignment - 1);
+
+				if (!_allocated || size > _capacity) {
+					std::size_t capacity = _capacity;
+
+					if (size > capacity) {
+						capacity = std::max<std::size_t>(capacity, 1024);
+
+						while (capacity < size * FRAMES)
+							capacity *= 2;
+
+						logger()->log(LOG_DEBUG, LogBuffer() << "Allocating " << capacity << " bytes to streaming buffer for " << size << " byte range.");
+					}
+
+					reallocate(capacity);
+					offset = 0;
+				} else {
+					retire_front(false);
+
+					if (offset + size > _capacity) {
+						_statistics.wraps += 1;
+						offset = 0;
+
+						if (!_backend->supports_fences())
+							reallocate(_capacity);
+					}
+
+					if (_backend->supports_fences()) {
+						// The ring has come around to data which hasn't been fenced yet, e.g. if a single frame writes more than the capacity, so it must be fenced before it can be waited on:
+						if (_frame_used && overlaps(_frame_begin, _head, offset, size))
+							fence();
+
+						while (overlaps_pending(offset, size))
+							retire_front(true);
+					}
+				}
+
+				if (!_frame_used)
+					_frame_begin = offset;
+
+				_range.offset = offset;
+				_range.size = size;
+				_range.data = _backend->map_range(offset, size);
+
+				_head = offset + size;
+				_mapped = true;
+
+				_statistics.allocations += 1;
+
+				return _range;
+			}
+
+			void StreamingRing::unmap() {
+				unmap(_range.size);
+			}
+
+			void StreamingRing::unmap(std::size_t used) {
+				DREAM_ASSERT(_mapped && used <= _range.size);
+
+				_backend->unmap_range();
+				_mapped = false;
+
+				_head = _range.offset + used;
+
+				if (used > 0)
+					_frame_used = true;
+			}
+
+			void StreamingRing::fence() {
+				DREAM_ASSERT(!_mapped);
+
+				if (!_backend->supports_fences()) {
+					_frame_used = false;
+				} else if (_frame_used) {
+					_regions.push_back((Region){_frame_begin, _head, _backend->insert_fence()});
+					_frame_used = false;
+				} else if (!_regions.empty()) {
+					Region & region = _regions.back();
+
+					_backend->delete_fence(region.fence);
+					region.fence = _backend->insert_fence();
+				}
+			}
+
+// MARK: -
+// MARK: class GLStreamingBackend
+
+			GLStreamingBackend::~GLStreamingBackend() {
+			}
+
+			bool GLStreamingBackend::supports_fences() const {
+#ifdef DREAM_OPENGLES2
+				return false;
+#else
+				return true;
+#endif
+			}
+
+			FenceT GLStreamingBackend::insert_fence() {
+#ifdef DREAM_OPENGLES2
+				return NULL;
+#else
+				return (FenceT)glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+#endif
+			}
+
+			bool GLStreamingBackend::wait_fence(FenceT fence, bool wait) {
+#ifdef DREAM_OPENGLES2
+				return true;
+#else
+				GLsync sync = (GLsync)fence;
+
+				// The commands are flushed so that the fence will eventually be signalled:
+				GLenum result = glClientWaitSync(sync, wait ? GL_SYNC_FLUSH_COMMANDS_BIT : 0, 0);
+
+				while (wait && result == GL_TIMEOUT_EXPIRED)
+					result = glClientWaitSync(sync, 0, 1000000);
+
+				if (result == GL_WAIT_FAILED) {
+					logger()->log(LOG_ERROR, "Waiting for streaming buffer fence failed!");
+
+					return true;
+				}
+
+				return result != GL_TIMEOUT_EXPIRED;
+#endif
+			}
+
+			void GLStreamingBackend::delete_fence(FenceT fence) {
+#ifndef DREAM_OPENGLES2
+				glDeleteSync((GLsync)fence);
+#endif
+			}
+
+// MARK: -
+// MARK: Unit Tests
+
+#ifdef ENABLE_TESTING
+			class StubStreamingBackend : public IStreamingBackend {
+			public:
+				bool fences;
+
+				std::vector<ByteT> storage;
+				std::size_t allocations, maps, waits;
+
+				std::uintptr_t last_fence;
+				std::set<std::uintptr_t> live, signalled;
+
+				StubStreamingBackend(bool fences_ = true) : fences(fences_), allocations(0), maps(0), waits(0), last_fence(0) {
+				}
+
+				virtual void allocate_storage(std::size_t capacity) {
+					storage.assign(capacity, 0);
+					allocations += 1;
+				}
+
+				virtual ByteT * map_range(std::size_t offset, std::size_t size) {
+					DREAM_ASSERT(offset + size <= storage.size());
+					maps += 1;
+
+					return &storage[offset];
+				}
+
+				virtual void unmap_range() {
+				}
+
+				virtual bool supports_fences() const {
+					return fences;
+				}
+
+				virtual FenceT insert_fence() {
+					last_fence += 1;
+					live.insert(last_fence);
+
+					return (FenceT)last_fence;
+				}
+
+				virtual bool wait_fence(FenceT fence, bool wait) {
+					std::uintptr_t identifier = (std::uintptr_t)fence;
+
+					if (signalled.count(identifier))
+						return true;
+
+					if (wait) {
+						waits += 1;
+						signalled.insert(identifier);
+					}
+
+					return wait;
+				}
+
+				virtual void delete_fence(FenceT fence) {
+					live.erase((std::uintptr_t)fence);
+				}
+
+				/// The GPU has finished everything which was submitted.
+				void finish() {
+					signalled.insert(live.begin(), live.end());
+				}
+			};
+
+			UNIT_TEST(StreamingRing)
+			{
+				testing("Allocation");
+
+				StubStreamingBackend backend;
+				StreamingRing ring(&backend, 4096, 256);
+
+				StreamingRing::Range first = ring.map(100);
+				ring.unmap();
+
+				StreamingRing::Range second = ring.map(100);
+				ring.unmap(50);
+
+				StreamingRing::Range third = ring.map(10);
+				ring.unmap();
+
+				check(backend.allocations == 1 && backend.storage.size() == 4096) << "Storage is allocated once";
+				check(first.offset == 0 && second.offset == 256 && third.offset == 512) << "Ranges are allocated in order and aligned";
+				check(first.data == &backend.storage[0] && second.data == &backend.storage[256]) << "Ranges are mapped where they were allocated";
+
+				testing("Fencing");
+
+				ring.fence();
+				check(ring.pending() == 1 && backend.live.size() == 1) << "The frame is protected by a fence";
+
+				ring.fence();
+				check(ring.pending() == 1 && backend.live.size() == 1) << "Fencing again replaces the fence of the last frame";
+
+				testing("Wrapping");
+
+				// Fill the remainder of the ring with a frame which is still in flight:
+				ring.map(3000);
+				ring.unmap();
+				ring.fence();
+
+				backend.finish();
+
+				StreamingRing::Range wrapped = ring.map(1024);
+				ring.unmap();
+
+				check(wrapped.offset == 0) << "The ring wraps around to the start";
+				check(ring.statistics().wraps == 1) << "The wrap was counted";
+				check(backend.waits == 0) << "Frames which are complete are reused without waiting";
+				check(ring.pending() == 0) << "Completed frames are retired";
+
+				ring.fence();
+
+				StreamingRing::Range next = ring.map(2560);
+				ring.unmap();
+				ring.fence();
+
+				StreamingRing::Range blocked = ring.map(1024);
+				ring.unmap();
+
+				check(next.offset == 1024) << "The next frame follows the previous one";
+				check(blocked.offset == 0 && backend.waits == 1) << "Reusing a frame which is still in flight waits for it";
+				check(ring.pending() == 1) << "Only the overlapping frame was retired";
+
+				testing("Frames Larger Than The Ring");
+
+				StubStreamingBackend large_backend;
+				StreamingRing large(&large_backend, 4096, 256);
+
+				for (std::size_t i = 0; i < 3; i += 1) {
+					large.map(2048);
+					large.unmap();
+				}
+
+				check(large_backend.live.size() == 0 && large_backend.waits == 1) << "Unfenced data is fenced and waited for before it is overwritten";
+				check(large.statistics().reallocations == 1) << "The storage was not reallocated";
+
+				testing("Growth");
+
+				StreamingRing::Range grown = large.map(10000);
+				large.unmap();
+
+				check(grown.offset == 0 && large.capacity() >= 10000 * StreamingRing::FRAMES) << "The ring grows to hold several frames of the new size";
+				check(large_backend.allocations == 2 && large_backend.storage.size() == large.capacity()) << "New storage was allocated";
+
+				testing("Orphaning");
+
+				StubStreamingBackend orphan_backend(false);
+				StreamingRing orphan(&orphan_backend, 4096, 256);
+
+				for (std::size_t i = 0; i < 8; i += 1) {
+					orphan.map(1024);
+					orphan.unmap();
+					orphan.fence();
+				}
+
+				check(orphan_backend.live.size() == 0 && orphan_backend.last_fence == 0) << "No fences are used";
+				check(orphan_backend.allocations == 2) << "Storage is orphaned when the ring wraps around";
+				check(orphan_backend.waits == 0) << "Nothing waits for the GPU";
+			}
+#endif
+		}
+	}
+}
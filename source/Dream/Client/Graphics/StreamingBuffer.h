@@ -0,0 +1,192 @@
+//
+//  Client/Graphics/StreamingBuffer.h
+//  This file is part of the "Dream" project, and is released under the MIT license.
+//
+//  Created by agent on 18/10/26.
+//  Copyright (c) 2026 agent. All rights reserved.
+//
+
+#ifndef _DREAM_CLIENT_GRAPHICS_STREAMINGBUFFER_H
+#define _DREAM_CLIENT_GRAPHICS_STREAMINGBUFFER_H
+
+#include "Buffer.h"
+
+#include <deque>
+#include <vector>
+
+namespace Dream {
+	namespace Client {
+		namespace Graphics {
+			typedef void * FenceT;
+
+			/// The storage, mapping and fences used by a streaming ring. The ring only calls the backend, so the allocation, fencing and wrapping can be tested without a graphics context.
+			class IStreamingBackend {
+			public:
+				virtual ~IStreamingBackend();
+
+				/// Replace the storage with a new allocation of the given size. Draws which have already been issued continue to use the old storage, which is released by the driver once they are complete.
+				virtual void allocate_storage(std::size_t capacity) = 0;
+
+				/// Map a range for writing. The ring only maps ranges which are not in use, so the previous contents can be discarded without synchronization.
+				virtual ByteT * map_range(std::size_t offset, std::size_t size) = 0;
+				virtual void unmap_range() = 0;
+
+				/// If fences are not supported, the ring orphans its storage each time it wraps around instead.
+				virtual bool supports_fences() const = 0;
+
+				virtual FenceT insert_fence() = 0;
+
+				/// Returns true if the fence has been signalled. If wait is true, blocks until it is.
+				virtual bool wait_fence(FenceT fence, bool wait) = 0;
+				virtual void delete_fence(FenceT fence) = 0;
+			};
+
+			/**
+			 Sub-allocates ranges from a large buffer for data which is written by the CPU and drawn once or a few times, e.g. dynamic geometry which changes every frame.
+
+			 Ranges are allocated one after another, and wrap around to the start of the buffer when they reach the end. Call fence() after issuing the draws which use the data: the ring only reuses a range once the fence which follows it has been signalled, so writing never waits for the GPU unless the ring is too small for the frames in flight.
+			 */
+			class StreamingRing {
+			public:
+				struct Range {
+					/// The offset in bytes from the start of the buffer.
+					std::size_t offset, size;
+					ByteT * data;
+				};
+
+				struct Statistics {
+					std::size_t allocations, wraps, waits, reallocations;
+				};
+
+				/// When the ring grows, it is made large enough for this many frames of the same size to be in flight.
+				static const std::size_t FRAMES = 3;
+
+			protected:
+				IStreamingBackend * _backend;
+
+				std::size_t _capacity, _alignment;
+				bool _allocated, _mapped;
+
+				// The next free offset, and the start of the data written since the last fence:
+				std::size_t _head, _frame_begin;
+				bool _frame_used;
+
+				Range _range;
+
+				// Regions wrap around if end <= begin:
+				struct Region {
+					std::size_t begin, end;
+					FenceT fence;
+				};
+
+				std::deque<Region> _regions;
+
+				Statistics _statistics;
+
+				bool overlaps(std::size_t begin, std::size_t end, std::size_t offset, std::size_t size) const;
+				bool overlaps_pending(std::size_t offset, std::size_t size) const;
+
+				void retire_front(bool wait);
+				void reallocate(std::size_t capacity);
+
+			public:
+				/// The alignment must be a power of two, and a multiple of the size of the elements which are written.
+				StreamingRing(IStreamingBackend * backend, std::size_t capacity, std::size_t alignment = 256);
+				~StreamingRing();
+
+				std::size_t capacity() const { return _capacity; }
+				std::size_t pending() const { return _regions.size(); }
+				const Statistics & statistics() const { return _statistics; }
+
+				/// Allocate and map size bytes. Only one range can be mapped at a time.
+				Range map(std::size_t size);
+
+				/// Finish writing the mapped range. If less than the whole range was used, the remainder is returned to the ring.
+				void unmap();
+				void unmap(std::size_t used);
+
+				/// Protect the data written since the last fence until the draws issued so far are complete. If nothing was written, the previous region is protected until the later draws are complete too, as it may have been drawn again.
+				void fence();
+			};
+
+			/// Implements fences with sync objects, which need OpenGL 3.2. On OpenGL ES 2 there are no fences, so the ring falls back to orphaning.
+			class GLStreamingBackend : public IStreamingBackend {
+			public:
+				virtual ~GLStreamingBackend();
+
+				virtual bool supports_fences() const;
+				virtual FenceT insert_fence();
+				virtual bool wait_fence(FenceT fence, bool wait);
+				virtual void delete_fence(FenceT fence);
+			};
+
+			/// A streaming ring which allocates from a buffer object bound to the given target.
+			template <GLenum TARGET>
+			class StreamingBuffer : public Object, public GLStreamingBackend {
+			protected:
+				BufferHandle<TARGET> _buffer;
+				StreamingRing _ring;
+
+#ifdef DREAM_OPENGLES2
+				// Without glMapBufferRange, data is written into memory and copied into the buffer when it is unmapped:
+				std::vector<ByteT> _staging;
+				std::size_t _staging_offset;
+#endif
+
+			public:
+				StreamingBuffer(std::size_t capacity = 0, std::size_t alignment = 256) : _buffer(GL_STREAM_DRAW), _ring(this, capacity, alignment) {
+				}
+
+				virtual ~StreamingBuffer() {
+				}
+
+				BufferHandle<TARGET> & buffer() { return _buffer; }
+				const StreamingRing::Statistics & statistics() const { return _ring.statistics(); }
+
+				StreamingRing::Range map(std::size_t size) { return _ring.map(size); }
+				void unmap() { _ring.unmap(); }
+				void unmap(std::size_t used) { _ring.unmap(used); }
+				void fence() { _ring.fence(); }
+
+				virtual void allocate_storage(std::size_t capacity) {
+					auto binding = _buffer.template binding<ByteT>();
+					binding.resize(capacity);
+
+					check_graphics_error();
+				}
+
+				virtual ByteT * map_range(std::size_t offset, std::size_t size) {
+#ifdef DREAM_OPENGLES2
+					_staging.resize(size);
+					_staging_offset = offset;
+
+					return _staging.data();
+#else
+					auto binding = _buffer.template binding<ByteT>();
+
+					return binding.map(offset, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+#endif
+				}
+
+				virtual void unmap_range() {
+					auto binding = _buffer.template binding<ByteT>();
+
+#ifdef DREAM_OPENGLES2
+					binding.set_partial_data(_staging.data(), _staging_offset, _staging.size());
+#else
+					binding.unmap();
+#endif
+
+					check_graphics_error();
+				}
+			};
+
+#ifndef DREAM_OPENGLES2
+			/// A streaming buffer for uploading data into other buffers: the data is written into free space in the ring and copied on the GPU, so the destination is neither reallocated nor mapped while earlier draws may still be reading it.
+			typedef StreamingBuffer<GL_COPY_READ_BUFFER> StagingBuffer;
+#endif
+		}
+	}
+}
+
+#endif
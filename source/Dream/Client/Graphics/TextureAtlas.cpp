@@ -0,0 +1,381 @@
+//
+//  Client/Graphics/TextureAtlas.cpp
+//  This file is part of the "Dream" project, and is released under the MIT license.
+//
+//  Created by agent on 18/10/26.
+//  Copyright (c) 2026 agent. All rights reserved.
+//
+
+#include "TextureAtlas.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace Dream {
+	namespace Client {
+		namespace Graphics {
+			using namespace Euclid::Numerics::Constants;
+			using Imaging::PixelCoordinateT;
+			using Imaging::DataType;
+
+			/// When a page has more dirty regions than this, they are merged into a single region.
+			const std::size_t MAXIMUM_DIRTY_REGIONS = 16;
+
+			TextureAtlas::TextureAtlas(const Vec2u & page_size, std::size_t maximum_pages, std::size_t padding, PixelFormat pixel_format) : _page_size(page_size), _maximum_pages(maximum_pages), _padding(padding), _pixel_format(pixel_format) {
+				DREAM_ASSERT(maximum_pages > 0);
+
+				_texture_parameters.target = GL_TEXTURE_2D;
+				_texture_parameters.wrap = GL_CLAMP_TO_EDGE;
+				_texture_parameters.min_filter = GL_LINEAR;
+				_texture_parameters.mag_filter = GL_LINEAR;
+				_texture_parameters.generate_mip_maps = false;
+			}
+
+			TextureAtlas::~TextureAtlas() {
+			}
+
+			void TextureAtlas::mark_dirty(Page & page, const AlignedBox2u & region) {
+				page.dirty_regions.push_back(region);
+
+				if (page.dirty_regions.size() > MAXIMUM_DIRTY_REGIONS) {
+					Vec2u min = page.dirty_regions[0].min(), max = page.dirty_regions[0].max();
+
+					for (auto & dirty_region : page.dirty_regions) {
+						for (std::size_t i = 0; i < 2; i += 1) {
+							min[i] = std::min(min[i], dirty_region.min()[i]);
+							max[i] = std::max(max[i], dirty_region.max()[i]);
+						}
+					}
+
+					page.dirty_regions.clear();
+					page.dirty_regions.push_back(AlignedBox2u(min, max));
+				}
+			}
+
+			bool TextureAtlas::allocate(std::vector<Page> & pages, const Vec2u & size, std::size_t & page, Vec2u & origin) {
+				if (size[X] > _page_size[X] || size[Y] > _page_size[Y])
+					return false;
+
+				for (page = 0; page < pages.size(); page += 1) {
+					if (pages[page].packer.allocate(size, origin))
+						return true;
+				}
+
+				if (pages.size() >= _maximum_pages)
+					return false;
+
+				pages.push_back(Page(_page_size));
+
+				Page & new_page = pages.back();
+				new_page.image = new Image(_page_size << 1U, _pixel_format, DataType::BYTE);
+				new_page.image->clear();
+
+				mark_dirty(new_page, AlignedBox2u(Vec2u(ZERO), _page_size));
+
+				return new_page.packer.allocate(size, origin);
+			}
+
+			void TextureAtlas::copy(Page & page, const Vec2u & origin, const IPixelBuffer & source, const Vec2u & source_origin, const Vec2u & size) {
+				const std::size_t pixel_size = source.bytes_per_pixel(), row_length = size[X] * pixel_size;
+
+				// The padding above and below repeats the first and last rows, and the padding to the left and right repeats the first and last pixels of each row:
+				for (std::size_t y = 0; y < size[Y] + _padding * 2; y += 1) {
+					std::size_t source_y = std::min(std::max(y, _padding) - _padding, size[Y] - 1);
+
+					const ByteT * row = source.pixel_data_at(PixelCoordinateT(source_origin[X], source_origin[Y] + source_y, 0));
+					ByteT * destination = page.image->pixel_data_at(PixelCoordinateT(origin[X] - _padding, origin[Y] - _padding + y, 0));
+
+					for (std::size_t x = 0; x < _padding; x += 1) {
+						memcpy(destination + x * pixel_size, row, pixel_size);
+						memcpy(destination + (_padding + size[X] + x) * pixel_size, row + row_length - pixel_size, pixel_size);
+					}
+
+					memcpy(destination + _padding * pixel_size, row, row_length);
+				}
+			}
+
+			TextureAtlas::Entry TextureAtlas::make_entry(std::size_t page, const Vec2u & origin, const Vec2u & size) const {
+				Entry entry;
+
+				entry.page = page;
+				entry.bounds = AlignedBox2u(origin, origin + size);
+
+				for (std::size_t i = 0; i < 2; i += 1) {
+					entry.uv.min()[i] = RealT(origin[i]) / _page_size[i];
+					entry.uv.max()[i] = RealT(origin[i] + size[i]) / _page_size[i];
+				}
+
+				return entry;
+			}
+
+			const TextureAtlas::Entry * TextureAtlas::lookup(KeyT key) const {
+				auto iterator = _entries.find(key);
+
+				if (iterator == _entries.end())
+					return NULL;
+
+				return &iterator->second;
+			}
+
+			const TextureAtlas::Entry * TextureAtlas::insert(KeyT key, const IPixelBuffer & pixel_buffer) {
+				DREAM_ASSERT(pixel_buffer.pixel_format() == _pixel_format && pixel_buffer.pixel_data_type() == DataType::BYTE);
+
+				const Entry * existing = lookup(key);
+				if (existing) return existing;
+
+				Vec2u size(pixel_buffer.size()[X], pixel_buffer.size()[Y]), origin;
+				std::size_t page;
+
+				if (size[X] == 0 || size[Y] == 0)
+					return NULL;
+
+				if (!allocate(_pages, size + (_padding * 2), page, origin))
+					return NULL;
+
+				copy(_pages[page], origin + _padding, pixel_buffer, Vec2u(ZERO), size);
+				mark_dirty(_pages[page], AlignedBox2u(origin, origin + size + (_padding * 2)));
+
+				return &(_entries[key] = make_entry(page, origin + _padding, size));
+			}
+
+			bool TextureAtlas::remove(KeyT key) {
+				auto iterator = _entries.find(key);
+
+				if (iterator == _entries.end())
+					return false;
+
+				const Entry & entry = iterator->second;
+
+				// The pixels are left in place, as nothing refers to them, so the page doesn't need to be uploaded again:
+				_pages[entry.page].packer.release(entry.bounds.min() - _padding, entry.bounds.size() + (_padding * 2));
+				_entries.erase(iterator);
+
+				return true;
+			}
+
+			std::size_t TextureAtlas::defragment() {
+				std::vector<std::pair<KeyT, Entry *>> entries;
+
+				for (auto & iterator : _entries)
+					entries.push_back(std::make_pair(iterator.first, &iterator.second));
+
+				// Packing the largest images first wastes the least space:
+				std::sort(entries.begin(), entries.end(), [](const std::pair<KeyT, Entry *> & a, const std::pair<KeyT, Entry *> & b) {
+					Vec2u a_size = a.second->bounds.size(), b_size = b.second->bounds.size();
+					std::size_t a_side = std::max(a_size[X], a_size[Y]), b_side = std::max(b_size[X], b_size[Y]);
+
+					if (a_side != b_side)
+						return a_side > b_side;
+
+					if (a_size[X] * a_size[Y] != b_size[X] * b_size[Y])
+						return a_size[X] * a_size[Y] > b_size[X] * b_size[Y];
+
+					return a.first < b.first;
+				});
+
+				std::vector<Page> pages;
+				std::vector<Entry> moved;
+
+				for (auto & item : entries) {
+					const Entry & entry = *item.second;
+
+					Vec2u size = entry.bounds.size(), origin;
+					std::size_t page;
+
+					if (!allocate(pages, size + (_padding * 2), page, origin)) {
+						logger()->log(LOG_WARN, "Texture atlas could not be defragmented, keeping the existing pages.");
+
+						return 0;
+					}
+
+					copy(pages[page], origin + _padding, *_pages[entry.page].image, entry.bounds.min(), size);
+					moved.push_back(make_entry(page, origin + _padding, size));
+				}
+
+				for (std::size_t i = 0; i < entries.size(); i += 1)
+					*entries[i].second = moved[i];
+
+				// The new pages are entirely dirty, so their textures can be reused:
+				for (std::size_t i = 0; i < pages.size() && i < _pages.size(); i += 1)
+					pages[i].texture = _pages[i].texture;
+
+				std::size_t released = _pages.size() > pages.size() ? _pages.size() - pages.size() : 0;
+
+				_pages.swap(pages);
+
+				return released;
+			}
+
+			void TextureAtlas::clear_dirty_regions() {
+				for (auto & page : _pages)
+					page.dirty_regions.clear();
+			}
+
+			void TextureAtlas::upload(Ptr<TextureManager> texture_manager) {
+				for (auto & page : _pages) {
+					if (!page.texture) {
+						page.texture = texture_manager->allocate(_texture_parameters, page.image);
+					} else if (!page.dirty_regions.empty()) {
+						auto & binding = texture_manager->bind(page.texture);
+
+						for (auto & region : page.dirty_regions)
+							binding.update(page.image, region);
+					}
+
+					page.dirty_regions.clear();
+				}
+			}
+
+			RealT TextureAtlas::occupancy() const {
+				if (_pages.empty()) return 0;
+
+				std::size_t used_area = 0;
+
+				for (auto & page : _pages)
+					used_area += page.packer.used_area();
+
+				return RealT(used_area) / RealT(_pages.size() * _page_size[X] * _page_size[Y]);
+			}
+
+			void TextureAtlas::clear() {
+				_pages.clear();
+				_entries.clear();
+			}
+
+// MARK: -
+// MARK: Unit Tests
+
+#ifdef ENABLE_TESTING
+			/// An image filled with a single value, so that it can be identified after it has been packed.
+			static Ref<Image> make_filled_image(const Vec2u & size, ByteT value) {
+				Ref<Image> image = new Image(PixelCoordinateT(size[X], size[Y], 1), PixelFormat::RGBA, DataType::BYTE);
+				memset(image->pixel_data(), value, image->pixel_data_length());
+
+				return image;
+			}
+
+			static bool entry_is_filled(const TextureAtlas & atlas, const TextureAtlas::Entry & entry, ByteT value) {
+				Ptr<Image> page = atlas.page_image(entry.page);
+				Vec2u min = entry.bounds.min(), max = entry.bounds.max();
+
+				// Including the extruded padding around the image:
+				for (std::size_t y = min[Y] - 1; y < max[Y] + 1; y += 1) {
+					const ByteT * row = page->pixel_data_at(PixelCoordinateT(min[X] - 1, y, 0));
+
+					for (std::size_t i = 0; i < (max[X] - min[X] + 2) * 4; i += 1) {
+						if (row[i] != value)
+							return false;
+					}
+				}
+
+				return true;
+			}
+
+			UNIT_TEST(TextureAtlas)
+			{
+				testing("Inserting images");
+
+				Ref<TextureAtlas> atlas = new TextureAtlas(Vec2u(128, 128), 4, 1);
+
+				// A 4x3 image where each pixel has a distinct value:
+				Ref<Image> image = new Image(PixelCoordinateT(4, 3, 1), PixelFormat::RGBA, DataType::BYTE);
+				for (std::size_t y = 0; y < 3; y += 1) {
+					for (std::size_t x = 0; x < 4; x += 1)
+						memset(image->pixel_data_at(PixelCoordinateT(x, y, 0)), 1 + y * 4 + x, 4);
+				}
+
+				const TextureAtlas::Entry * entry = atlas->insert(1, *image);
+
+				check(entry != NULL) << "Image was inserted";
+				check(atlas->page_count() == 1) << "One page was allocated";
+				check(entry->bounds.size() == Vec2u(4, 3)) << "Bounds match the image size";
+				check(entry->bounds.min()[X] >= 1 && entry->bounds.min()[Y] >= 1) << "Image is inside its padding";
+
+				Vec2u origin = entry->bounds.min();
+				Ptr<Image> page = atlas->page_image(0);
+
+				check(page->pixel_data_at(PixelCoordinateT(origin[X] + 1, origin[Y] + 2, 0))[0] == 10) << "Pixels were copied";
+				check(page->pixel_data_at(PixelCoordinateT(origin[X] - 1, origin[Y] + 1, 0))[0] == 5) << "Left edge was extruded";
+				check(page->pixel_data_at(PixelCoordinateT(origin[X] + 4, origin[Y] + 1, 0))[0] == 8) << "Right edge was extruded";
+				check(page->pixel_data_at(PixelCoordinateT(origin[X] + 2, origin[Y] + 3, 0))[0] == 11) << "Top edge was extruded";
+				check(page->pixel_data_at(PixelCoordinateT(origin[X] - 1, origin[Y] - 1, 0))[0] == 1) << "Corner was extruded";
+
+				check(entry->uv.min()[X] == RealT(origin[X]) / 128) << "Texture coordinates are normalized";
+				check(entry->uv.max()[Y] == RealT(origin[Y] + 3) / 128) << "Texture coordinates are normalized";
+
+				check(atlas->lookup(1) == entry) << "Image can be found";
+				check(atlas->insert(1, *image) == entry) << "Inserting the same key again returns the existing entry";
+
+				testing("Dirty regions");
+
+				check(atlas->dirty_regions(0).size() == 2) << "New page and image are dirty";
+				check(atlas->dirty_regions(0)[1].size() == Vec2u(6, 5)) << "Dirty region covers the image and its padding";
+
+				atlas->clear_dirty_regions();
+				atlas->insert(2, *image);
+				check(atlas->dirty_regions(0).size() == 1) << "Only the new image is dirty";
+
+				testing("Removing images");
+
+				Vec2u previous = atlas->lookup(2)->bounds.min();
+
+				check(atlas->remove(2)) << "Image was removed";
+				check(atlas->lookup(2) == NULL) << "Removed image can't be found";
+				check(!atlas->remove(2)) << "Image can only be removed once";
+
+				check(atlas->insert(3, *image)->bounds.min() == previous) << "Space of the removed image is reused";
+
+				testing("Packing");
+
+				atlas->clear();
+
+				std::size_t inserted = 0;
+
+				for (std::size_t i = 0; i < 150; i += 1) {
+					Vec2u size(4 + (i * 7) % 29, 4 + (i * 13) % 23);
+
+					if (atlas->insert(i, *make_filled_image(size, 1 + i % 251)))
+						inserted += 1;
+				}
+
+				check(inserted == 150) << "All images were inserted";
+				check(atlas->page_count() <= 4) << "Page count is limited";
+
+				bool filled = true;
+				for (std::size_t i = 0; i < 150; i += 1)
+					filled = filled && entry_is_filled(*atlas, *atlas->lookup(i), 1 + i % 251);
+
+				check(filled) << "Images and their padding don't overlap";
+				check(atlas->occupancy() > 0.7) << "Images are packed densely";
+
+				testing("Defragmentation");
+
+				std::size_t pages = atlas->page_count();
+
+				for (std::size_t i = 0; i < 150; i += 1) {
+					if (i % 3)
+						atlas->remove(i);
+				}
+
+				RealT fragmented = atlas->occupancy();
+				std::size_t released = atlas->defragment();
+
+				check(released > 0 && atlas->page_count() == pages - released) << "Unused pages were released";
+				check(atlas->occupancy() > fragmented) << "Occupancy improved";
+
+				filled = atlas->entry_count() == 50;
+				for (std::size_t i = 0; i < 150; i += 3)
+					filled = filled && entry_is_filled(*atlas, *atlas->lookup(i), 1 + i % 251);
+
+				check(filled) << "Images were moved with their contents";
+				check(atlas->dirty_regions(0).size() == 1 && atlas->dirty_regions(0)[0].size() == Vec2u(128, 128)) << "Repacked pages are entirely dirty";
+
+				testing("Empty and oversized images");
+
+				check(atlas->insert(1000, *make_filled_image(Vec2u(0, 0), 1)) == NULL) << "Empty image was rejected";
+				check(atlas->insert(1001, *make_filled_image(Vec2u(128, 4), 1)) == NULL) << "Image which doesn't fit with its padding was rejected";
+			}
+#endif
+		}
+	}
+}
@@ -0,0 +1,122 @@
+//
+//  Client/Graphics/TextureAtlas.h
+//  This file is part of the "Dream" project, and is released under the MIT license.
+//
+//  Created by agent on 18/10/26.
+//  Copyright (c) 2026 agent. All rights reserved.
+//
+
+#ifndef _DREAM_CLIENT_GRAPHICS_TEXTUREATLAS_H
+#define _DREAM_CLIENT_GRAPHICS_TEXTUREATLAS_H
+
+#include "TextureManager.h"
+#include "../../Imaging/Image.h"
+#include "../../Imaging/MaxRectsPacker.h"
+
+#include <unordered_map>
+#include <vector>
+
+namespace Dream {
+	namespace Client {
+		namespace Graphics {
+			using Dream::Imaging::Image;
+			using Dream::Imaging::MaxRectsPacker;
+			using Dream::Imaging::PixelFormat;
+			using Euclid::Numerics::RealT;
+			using Euclid::Geometry::AlignedBox2;
+
+			/**
+			 Packs many small pixel buffers, such as icons and user interface images, into a few large pages, so that they share textures and can be drawn without binding a texture for each one.
+
+			 Images are packed using maximal rectangles, so that the space of removed images can be reused. Each image is surrounded by padding which is filled by extruding its edges, so filtering near the edge of an image doesn't sample its neighbours. The changes to each page are recorded as a list of dirty regions, so upload() only copies the modified parts of each page to its texture.
+			 */
+			class TextureAtlas : public Object {
+			public:
+				typedef uint64_t KeyT;
+
+				struct Entry {
+					std::size_t page;
+
+					/// The location of the image within the page, in pixels, not including the padding.
+					AlignedBox2u bounds;
+
+					/// The texture coordinates of the image within the page.
+					AlignedBox2 uv;
+				};
+
+			protected:
+				struct Page {
+					Ref<Image> image;
+					MaxRectsPacker packer;
+					Ref<Texture> texture;
+
+					std::vector<AlignedBox2u> dirty_regions;
+
+					Page(const Vec2u & size) : packer(size) {}
+				};
+
+				Vec2u _page_size;
+				std::size_t _maximum_pages, _padding;
+				PixelFormat _pixel_format;
+
+				TextureParameters _texture_parameters;
+
+				std::vector<Page> _pages;
+				std::unordered_map<KeyT, Entry> _entries;
+
+				void mark_dirty(Page & page, const AlignedBox2u & region);
+
+				/// Finds space for an image of the given size, including padding, adding a page if required.
+				bool allocate(std::vector<Page> & pages, const Vec2u & size, std::size_t & page, Vec2u & origin);
+
+				/// Copies a region of the source into the page, and extrudes its edges into the padding around it.
+				void copy(Page & page, const Vec2u & origin, const IPixelBuffer & source, const Vec2u & source_origin, const Vec2u & size);
+
+				Entry make_entry(std::size_t page, const Vec2u & origin, const Vec2u & size) const;
+
+			public:
+				TextureAtlas(const Vec2u & page_size = Vec2u(1024, 1024), std::size_t maximum_pages = 4, std::size_t padding = 1, PixelFormat pixel_format = PixelFormat::RGBA);
+				virtual ~TextureAtlas();
+
+				/// The parameters used for the page textures. Mip-maps are disabled by default, as the smaller levels would blend neighbouring images together.
+				TextureParameters & texture_parameters() { return _texture_parameters; }
+				const TextureParameters & texture_parameters() const { return _texture_parameters; }
+
+				/// Returns the entry for the given key, or NULL if it is not in the atlas.
+				const Entry * lookup(KeyT key) const;
+
+				/// Copies the pixel buffer into the atlas. If the key is already in the atlas, the existing entry is returned unchanged. Returns NULL if the pixel buffer is empty or there is no space for it. The returned pointer is valid until the next insertion.
+				const Entry * insert(KeyT key, const IPixelBuffer & pixel_buffer);
+
+				/// Releases the space used by the image, so it can be reused. Returns false if the key is not in the atlas.
+				bool remove(KeyT key);
+
+				/// Repacks all images into as few pages as possible, largest first, and releases any pages which are no longer needed. Images may move, so entries must be looked up again afterwards. Returns the number of pages released.
+				std::size_t defragment();
+
+				std::size_t page_count() const { return _pages.size(); }
+				Ptr<Image> page_image(std::size_t page) const { return _pages[page].image; }
+
+				/// The texture for the page, once it has been uploaded.
+				Ptr<Texture> page_texture(std::size_t page) const { return _pages[page].texture; }
+
+				/// The regions of the page which have changed since the dirty regions were last cleared.
+				const std::vector<AlignedBox2u> & dirty_regions(std::size_t page) const { return _pages[page].dirty_regions; }
+				void clear_dirty_regions();
+
+				/// Allocates textures for new pages, and copies the dirty regions of the other pages to their textures. Clears the dirty regions.
+				void upload(Ptr<TextureManager> texture_manager);
+
+				std::size_t entry_count() const { return _entries.size(); }
+
+				/// The fraction of all allocated pages which contain images, including their padding.
+				RealT occupancy() const;
+
+				/// Discard all images and pages.
+				void clear();
+			};
+		}
+	}
+}
+
+#endif
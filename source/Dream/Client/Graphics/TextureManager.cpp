@@ -87,6 +87,69 @@ namespace Dream {
 				}
 			}
 
+			GLenum texture_block_format(Imaging::BlockFormat block_format, bool srgb) {
+				using Imaging::BlockFormat;
+
+				if (srgb) {
+					switch (block_format) {
+#if defined(GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT)
+						case BlockFormat::BC1:
+							return GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT;
+#endif
+
+#if defined(GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT)
+						case BlockFormat::BC3:
+							return GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT;
+#endif
+
+#if defined(GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM)
+						case BlockFormat::BC7:
+							return GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM;
+#elif defined(GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM_ARB)
+						case BlockFormat::BC7:
+							return GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM_ARB;
+#endif
+
+						// Loading the blocks as linear data would lose the colour space:
+						default:
+							return GL_INVALID_ENUM;
+					}
+				}
+
+				switch (block_format) {
+#if defined(GL_COMPRESSED_RGBA_S3TC_DXT1_EXT)
+					case BlockFormat::BC1:
+						return GL_COMPRESSED_RGBA_S3TC_DXT1_EXT;
+#endif
+
+#if defined(GL_COMPRESSED_RGBA_S3TC_DXT5_EXT)
+					case BlockFormat::BC3:
+						return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+#endif
+
+#if defined(GL_COMPRESSED_RED_RGTC1)
+					case BlockFormat::BC4:
+						return GL_COMPRESSED_RED_RGTC1;
+#endif
+
+#if defined(GL_COMPRESSED_RG_RGTC2)
+					case BlockFormat::BC5:
+						return GL_COMPRESSED_RG_RGTC2;
+#endif
+
+#if defined(GL_COMPRESSED_RGBA_BPTC_UNORM)
+					case BlockFormat::BC7:
+						return GL_COMPRESSED_RGBA_BPTC_UNORM;
+#elif defined(GL_COMPRESSED_RGBA_BPTC_UNORM_ARB)
+					case BlockFormat::BC7:
+						return GL_COMPRESSED_RGBA_BPTC_UNORM_ARB;
+#endif
+
+					default:
+						return GL_INVALID_ENUM;
+				}
+			}
+
 			const GLenum INVALID_TARGET = 0;
 			const GLuint INVALID_TEXTURE = (GLuint)-1;
 
@@ -302,6 +365,62 @@ namespace Dream {
 				check_graphics_error();
 			}
 
+			void Texture::load_partial_pixel_data(const Vec2u & offset, const Vec2u & size, std::size_t row_length, const ByteT * pixels) {
+				GLenum target = _parameters.get_target();
+
+				if (target != GL_TEXTURE_2D)
+					throw std::runtime_error("Invalid texture target");
+
+#ifndef DREAM_OPENGLES2
+				glPixelStorei(GL_UNPACK_ROW_LENGTH, row_length);
+#else
+				DREAM_ASSERT(row_length == size[WIDTH]);
+#endif
+
+				glTexSubImage2D(target, 0, offset[X], offset[Y], size[WIDTH], size[HEIGHT], _format, _data_type, pixels);
+
+#ifndef DREAM_OPENGLES2
+				glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+#endif
+
+				if (_parameters.generate_mip_maps) {
+					glGenerateMipmap(target);
+				}
+
+				check_graphics_error();
+			}
+
+			void Texture::load_compressed_data(Ptr<CompressedImage> compressed_image) {
+				GLenum internal_format = texture_block_format(compressed_image->block_format(), compressed_image->srgb());
+				GLenum target = _parameters.get_target();
+
+				if (internal_format == GL_INVALID_ENUM)
+					throw std::runtime_error("Unsupported compressed texture format");
+
+				if (target != GL_TEXTURE_2D)
+					throw std::runtime_error("Invalid texture target");
+
+				// The compressed data is passed straight through from the source buffer:
+				for (std::size_t level = 0; level < compressed_image->level_count(); level += 1) {
+					Vec3u size = compressed_image->level_size(level);
+					Ref<IData> data = compressed_image->level_data(level);
+
+					glCompressedTexImage2D(target, level, internal_format, size[WIDTH], size[HEIGHT], 0, data->size(), data->buffer()->begin());
+				}
+
+				// Mip-maps can't be generated for compressed textures, so limit sampling to the levels provided:
+#ifdef GL_TEXTURE_MAX_LEVEL
+				glTexParameteri(target, GL_TEXTURE_MAX_LEVEL, compressed_image->level_count() - 1);
+#endif
+
+				// Update the client-side texture details:
+				_size = compressed_image->size();
+				_format = internal_format;
+				_data_type = GL_INVALID_ENUM;
+
+				check_graphics_error();
+			}
+
 			void TextureManager::Binding::resize(const Vec3u & size, GLenum format, GLenum data_type) {
 				if (size != _texture->size()) {
 					_texture->load_pixel_data(size, NULL, _texture->format(), _texture->data_type());
@@ -321,6 +440,28 @@ namespace Dream {
 				update(pixel_buffer);
 			}
 
+			void TextureManager::Binding::update(Ptr<IPixelBuffer> pixel_buffer, const AlignedBox2u & region) {
+				DREAM_ASSERT(pixel_buffer->size() == _texture->size());
+				DREAM_ASSERT(texture_pixel_format(pixel_buffer->pixel_format()) == _texture->format());
+
+				Vec2u offset = region.min(), size = region.size();
+				std::size_t row_length = pixel_buffer->size()[WIDTH];
+
+#ifdef DREAM_OPENGLES2
+				// Without GL_UNPACK_ROW_LENGTH, only whole rows can be uploaded:
+				offset[X] = 0;
+				size[WIDTH] = row_length;
+#endif
+
+				const ByteT * pixels = pixel_buffer->pixel_data_at(Imaging::PixelCoordinateT(offset[X], offset[Y], 0));
+
+				_texture->load_partial_pixel_data(offset, size, row_length, pixels);
+			}
+
+			void TextureManager::Binding::update_compressed(Ptr<CompressedImage> compressed_image) {
+				_texture->load_compressed_data(compressed_image);
+			}
+
 // MARK: -
 
 			TextureManager::TextureManager() {
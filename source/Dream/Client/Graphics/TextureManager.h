@@ -10,19 +10,27 @@
 #define _DREAM_CLIENT_GRAPHICS_TEXTUREMANAGER_H
 
 #include "../../Imaging/PixelBuffer.h"
+#include "../../Imaging/CompressedImage.h"
 #include "Graphics.h"
 
 #include <Euclid/Numerics/Vector.h>
+#include <Euclid/Geometry/AlignedBox.h>
 
 namespace Dream {
 	namespace Client {
 		namespace Graphics {
 			using Dream::Imaging::IPixelBuffer;
+			using Dream::Imaging::CompressedImage;
+			using Euclid::Numerics::Vec2u;
 			using Euclid::Numerics::Vec3u;
+			using Euclid::Geometry::AlignedBox2u;
 
 			GLenum texture_pixel_format(Imaging::PixelFormat pixel_format);
 			GLenum texture_data_type(Imaging::DataType data_type);
 
+			/// Returns the compressed internal format for the given block format, or GL_INVALID_ENUM if it is not supported by the current headers. If srgb is true, returns the sRGB variant of the format, so that colours are converted to linear when sampled.
+			GLenum texture_block_format(Imaging::BlockFormat block_format, bool srgb = false);
+
 			const char * target_name (GLenum target);
 			const char * format_name (GLenum format);
 
@@ -114,6 +122,12 @@ namespace Dream {
 
 					/// Update the texture data and associated parameters.
 					void update(const TextureParameters & parameters, Ptr<IPixelBuffer> pixel_buffer);
+
+					/// Update a region of a 2D texture from the same region of the pixel buffer, which must be the same size as the texture.
+					void update(Ptr<IPixelBuffer> pixel_buffer, const AlignedBox2u & region);
+
+					/// Upload all levels of a block compressed image directly, without decoding them.
+					void update_compressed(Ptr<CompressedImage> compressed_image);
 				};
 
 			protected:
@@ -157,6 +171,8 @@ namespace Dream {
 				friend class TextureManager::Binding;
 
 				void load_pixel_data(const Vec3u & size, const ByteT * pixels, GLenum format, GLenum data_type);
+				void load_partial_pixel_data(const Vec2u & offset, const Vec2u & size, std::size_t row_length, const ByteT * pixels);
+				void load_compressed_data(Ptr<CompressedImage> compressed_image);
 				void set_parameters(const TextureParameters & parameters) { _parameters = parameters; }
 
 			public:
@@ -26,6 +26,8 @@ namespace Dream {
 				void bind();
 				void unbind();
 
+				friend class GLCommandBackend;
+
 			public:
 				VertexArray();
 				~VertexArray();
@@ -37,9 +39,11 @@ namespace Dream {
 				class Attributes {
 				protected:
 					Binding & _binding;
+					std::ptrdiff_t _offset;
 
 				public:
-					Attributes(Binding & binding) : _binding(binding) {
+					/// The offset in bytes is added to every attribute, e.g. to start drawing from a later vertex in the buffer.
+					Attributes(Binding & binding, std::ptrdiff_t offset = 0) : _binding(binding), _offset(offset) {
 					}
 
 					struct Location {
@@ -91,10 +95,10 @@ namespace Dream {
 						buffer.bind();
 					}
 
-					Attributes attach(BufferHandle<GL_ARRAY_BUFFER> & buffer) {
+					Attributes attach(BufferHandle<GL_ARRAY_BUFFER> & buffer, std::ptrdiff_t offset = 0) {
 						buffer.bind();
 
-						Attributes attributes(*this);
+						Attributes attributes(*this, offset);
 
 						return attributes;
 					}
@@ -110,7 +114,7 @@ namespace Dream {
 
 			template <class T, typename U>
 			void VertexArray::Attributes::associate(GLuint index, U T::* member, bool normalized) {
-				_binding.set_attribute(index, std::tuple_size<typename U::array>::value, GLTypeTraits<typename std::tuple_element<0, typename U::array>::type>::TYPE, normalized, sizeof(T), member_offset(member));
+				_binding.set_attribute(index, std::tuple_size<typename U::array>::value, GLTypeTraits<typename std::tuple_element<0, typename U::array>::type>::TYPE, normalized, sizeof(T), _offset + member_offset(member));
 
 				// We assume that the attributes are enabled by default:
 				_binding.enable(index);
@@ -106,6 +106,9 @@ namespace Dream
 			if (strncmp("DDS ", (const char *)&buffer[0], 4) == 0)
 				return IMAGE_DDS;
 
+			if (buffer[0] == 0xAB && strncmp("KTX", (const char *)&buffer[1], 3) == 0)
+				return IMAGE_KTX;
+
 			if (strncmp("RIFF", (const char *)&buffer[0], 4) == 0)
 				return AUDIO_XWAV;
 
@@ -324,6 +327,28 @@ namespace Dream
 			return _buf;
 		}
 
+// MARK: -
+// MARK: class SliceBuffer
+
+		SliceBuffer::SliceBuffer (Shared<Buffer> buffer, std::size_t offset, std::size_t size) : _buffer(buffer), _offset(offset), _size(size)
+		{
+			DREAM_ASSERT(_offset + _size <= _buffer->size());
+		}
+
+		SliceBuffer::~SliceBuffer ()
+		{
+		}
+
+		std::size_t SliceBuffer::size () const
+		{
+			return _size;
+		}
+
+		const ByteT * SliceBuffer::begin () const
+		{
+			return _buffer->begin() + _offset;
+		}
+
 // MARK: -
 // MARK: class FileBuffer
 
@@ -29,6 +29,7 @@ namespace Dream
 			IMAGE_JPEG = 10,
 			IMAGE_PNG = 11,
 			IMAGE_DDS = 12,
+			IMAGE_KTX = 13,
 			AUDIO_XWAV = 40,
 			AUDIO_BASIC = 41,
 			APPLICATION_OGG = 80
@@ -224,6 +225,26 @@ namespace Dream
 			virtual const ByteT * begin () const;
 		};
 
+		/**
+		 A read-only buffer that provides access to a range of bytes within another buffer.
+
+		 The data is not copied - the slice retains the original buffer and refers directly into it. This is useful for exposing parts of a larger file,
+		 such as individual mip levels of a texture, without duplicating the data.
+		 */
+		class SliceBuffer : public Buffer {
+			Shared<Buffer> _buffer;
+			std::size_t _offset, _size;
+
+		public:
+			/// The range [offset, offset + size) must be within the given buffer.
+			SliceBuffer (Shared<Buffer> buffer, std::size_t offset, std::size_t size);
+
+			virtual ~SliceBuffer ();
+
+			virtual std::size_t size () const;
+			virtual const ByteT * begin () const;
+		};
+
 		/**
 		 A read-only buffer that provides fast access to files on the file-system.
 
@@ -86,6 +86,36 @@ namespace Dream
 			return _buffer->size();
 		}
 
+// MARK: -
+// MARK: SliceData
+
+		SliceData::SliceData (Ptr<IData> data, std::size_t offset, std::size_t size) : _data(data), _offset(offset), _size(size)
+		{
+		}
+
+		SliceData::~SliceData ()
+		{
+		}
+
+		Shared<Buffer> SliceData::buffer () const
+		{
+			if (!_buffer) {
+				_buffer = new SliceBuffer(_data->buffer(), _offset, _size);
+			}
+
+			return _buffer;
+		}
+
+		Shared<std::istream> SliceData::input_stream () const
+		{
+			return new BufferStream(*buffer());
+		}
+
+		std::size_t SliceData::size () const
+		{
+			return _size;
+		}
+
 // MARK: -
 // MARK: Unit Tests
 
@@ -101,6 +131,22 @@ namespace Dream
 
 			check(a->buffer()->size() == strlen(data)) << "Data length is correct";
 		}
+
+		UNIT_TEST(SliceData)
+		{
+			const char * data = "First things first -- but not necessarily in that order.";
+
+			testing("Construction");
+
+			Shared<StaticBuffer> sb = new StaticBuffer(StaticBuffer::for_cstring(data, false));
+			Ref<IData> a = new BufferedData(sb);
+			Ref<IData> b = new SliceData(a, 6, 6);
+
+			check(b->size() == 6) << "Slice length is correct";
+			check(b->buffer()->size() == 6) << "Slice buffer length is correct";
+			check(b->buffer()->begin() == a->buffer()->begin() + 6) << "Slice refers to original data";
+			check(strncmp("things", (const char *)b->buffer()->begin(), 6) == 0) << "Slice data is correct";
+		}
 #endif
 	}
 }
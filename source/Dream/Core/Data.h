@@ -66,6 +66,29 @@ namespace Dream
 
 			virtual std::size_t size () const;
 		};
+
+		/**
+		 A data store which refers to a range of bytes within another data store. The underlying buffer is shared rather than copied.
+		 */
+		class SliceData : public Object, implements IData {
+		protected:
+			Ref<IData> _data;
+			std::size_t _offset, _size;
+
+			mutable Shared<Buffer> _buffer;
+
+		public:
+			SliceData (Ptr<IData> data, std::size_t offset, std::size_t size);
+			virtual ~SliceData ();
+
+			/// The offset of this slice within the original data store.
+			std::size_t offset () const { return _offset; }
+
+			virtual Shared<Buffer> buffer () const;
+			virtual Shared<std::istream> input_stream () const;
+
+			virtual std::size_t size () const;
+		};
 	}
 }
 
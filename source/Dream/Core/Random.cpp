@@ -0,0 +1,373 @@
+//
+//  Core/Random.cpp
+//  This file is part of the "Dream" project, and is released under the MIT license.
+//
+//  Created by agent on 18/10/26.
+//  Copyright (c) 2026 agent. All rights reserved.
+//
+//
+
+#include "Random.h"
+
+#include <atomic>
+
+#ifdef ENABLE_TESTING
+#include "Timer.h"
+
+#include <cmath>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <thread>
+#include <vector>
+#endif
+
+namespace Dream {
+	namespace Core {
+
+// MARK: -
+// MARK: class PCG32
+
+		PCG32::PCG32 (std::uint64_t seed, std::uint64_t stream)
+		{
+			this->seed(seed, stream);
+		}
+
+		void PCG32::seed (std::uint64_t seed, std::uint64_t stream)
+		{
+			// The increment must be odd:
+			_state = 0;
+			_increment = (stream << 1) | 1;
+
+			(*this)();
+			_state += seed;
+			(*this)();
+		}
+
+		void PCG32::advance (std::uint64_t steps)
+		{
+			// Compose the linear congruential step with itself by repeated squaring:
+			std::uint64_t multiplier = 6364136223846793005ULL, increment = _increment;
+			std::uint64_t total_multiplier = 1, total_increment = 0;
+
+			while (steps > 0) {
+				if (steps & 1) {
+					total_multiplier *= multiplier;
+					total_increment = total_increment * multiplier + increment;
+				}
+
+				increment = (multiplier + 1) * increment;
+				multiplier *= multiplier;
+
+				steps >>= 1;
+			}
+
+			_state = total_multiplier * _state + total_increment;
+		}
+
+// MARK: -
+// MARK: class Xoshiro256
+
+		Xoshiro256::Xoshiro256 (std::uint64_t seed)
+		{
+			this->seed(seed);
+		}
+
+		void Xoshiro256::seed (std::uint64_t seed)
+		{
+			// SplitMix64 never produces four zeros in a row, which is the only invalid state:
+			SplitMix64 mix(seed);
+
+			for (std::size_t i = 0; i < 4; i += 1)
+				_state[i] = mix();
+		}
+
+		void Xoshiro256::jump ()
+		{
+			static const std::uint64_t JUMP[] = {0x180EC6D33CFD0ABAULL, 0xD5A61266F0C9392CULL, 0xA9582618E03FC9AAULL, 0x39ABDC4529B1661CULL};
+
+			std::uint64_t state[4] = {0, 0, 0, 0};
+
+			for (std::size_t i = 0; i < 4; i += 1) {
+				for (std::size_t b = 0; b < 64; b += 1) {
+					if (JUMP[i] & (1ULL << b)) {
+						for (std::size_t j = 0; j < 4; j += 1)
+							state[j] ^= _state[j];
+					}
+
+					(*this)();
+				}
+			}
+
+			for (std::size_t j = 0; j < 4; j += 1)
+				_state[j] = state[j];
+		}
+
+// MARK: -
+// MARK: Bulk Generation
+
+		void convert_reals (const std::uint32_t * bits, float * values, std::size_t count, float min, float max)
+		{
+			const float scale = (max - min) * (1.0f / 16777216.0f);
+
+			for (std::size_t i = 0; i < count; i += 1)
+				values[i] = min + (float)(std::int32_t)(bits[i] >> 8) * scale;
+		}
+
+		void convert_integrals (std::uint32_t * values, std::size_t count, std::uint32_t bound)
+		{
+			for (std::size_t i = 0; i < count; i += 1)
+				values[i] = (std::uint32_t)(((std::uint64_t)values[i] * bound) >> 32);
+		}
+
+// MARK: -
+// MARK: Per-thread Streams
+
+		static std::atomic<std::uint64_t> _thread_random_seed(0x853C49E6748FEA9BULL);
+		static std::atomic<std::uint64_t> _thread_random_streams(0);
+
+		namespace {
+			struct ThreadRandom {
+				PCG32 generator;
+
+				ThreadRandom () : generator(_thread_random_seed, _thread_random_streams++) {}
+			};
+		}
+
+		PCG32 & thread_random ()
+		{
+			static thread_local ThreadRandom thread_random;
+
+			return thread_random.generator;
+		}
+
+		void seed_thread_random (std::uint64_t seed)
+		{
+			_thread_random_seed = seed;
+
+			PCG32 & generator = thread_random();
+
+			// The calling thread always gets the first stream, so that single threaded programs are reproducible:
+			_thread_random_streams = 1;
+			generator.seed(seed, 0);
+		}
+
+// MARK: -
+// MARK: Unit Tests
+
+#ifdef ENABLE_TESTING
+		UNIT_TEST(PCG32)
+		{
+			testing("Known Sequence");
+
+			// The reference output of pcg32_srandom_r(&rng, 42, 54):
+			const std::uint32_t EXPECTED[] = {0xA15C02B7, 0x7B47F409, 0xBA1D3330, 0x83D2F293, 0xBFA4784B, 0xCBED606E};
+
+			PCG32 generator(42, 54);
+			bool matches = true;
+
+			for (std::size_t i = 0; i < 6; i += 1)
+				matches = matches && generator() == EXPECTED[i];
+
+			check(matches) << "Generator matches the reference implementation";
+
+			testing("Streams");
+
+			PCG32 a(42, 1), b(42, 1), c(42, 2);
+			std::size_t same = 0, different = 0;
+
+			for (std::size_t i = 0; i < 1000; i += 1) {
+				std::uint32_t x = a(), y = b(), z = c();
+
+				if (x == y) same += 1;
+				if (x != z) different += 1;
+			}
+
+			check(same == 1000) << "The same seed and stream give the same sequence";
+			check(different > 990) << "Different streams give different sequences";
+
+			testing("Advance");
+
+			PCG32 stepped(7, 3), advanced(7, 3);
+
+			for (std::size_t i = 0; i < 12345; i += 1)
+				stepped();
+
+			advanced.advance(12345);
+
+			check(stepped() == advanced()) << "Advancing is equivalent to stepping";
+		}
+
+		UNIT_TEST(Xoshiro256)
+		{
+			testing("Reproducibility");
+
+			Xoshiro256 a(99), b(99), c(100);
+			bool same = true, different = false;
+
+			for (std::size_t i = 0; i < 1000; i += 1) {
+				std::uint64_t x = a(), y = b(), z = c();
+
+				same = same && x == y;
+				different = different || x != z;
+			}
+
+			check(same) << "The same seed gives the same sequence";
+			check(different) << "Different seeds give different sequences";
+
+			testing("Jump");
+
+			Xoshiro256 first(5), second(5), again(5);
+			second.jump();
+			again.jump();
+
+			check(second() == again()) << "Jumping is deterministic";
+			check(first() != second()) << "Jumping gives a different stream";
+		}
+
+		UNIT_TEST(RandomDistributions)
+		{
+			testing("Integral Range");
+
+			PCG32 generator(1234);
+			const std::uint32_t BOUND = 10, SAMPLES = 100000;
+			std::size_t counts[BOUND] = {0};
+			bool in_range = true;
+
+			for (std::size_t i = 0; i < SAMPLES; i += 1) {
+				std::uint32_t value = integral_random(generator, BOUND);
+
+				if (value < BOUND)
+					counts[value] += 1;
+				else
+					in_range = false;
+			}
+
+			check(in_range) << "All integers are within the bound";
+
+			bool uniform = true;
+			for (std::size_t i = 0; i < BOUND; i += 1)
+				uniform = uniform && counts[i] > (SAMPLES / BOUND) * 0.95 && counts[i] < (SAMPLES / BOUND) * 1.05;
+
+			check(uniform) << "Integers are evenly distributed";
+
+			testing("Real Range");
+
+			bool reals_in_range = true;
+			for (std::size_t i = 0; i < SAMPLES; i += 1) {
+				float value = real_random(generator, -2.0f, 3.0f);
+
+				reals_in_range = reals_in_range && value >= -2.0f && value < 3.0f;
+			}
+
+			check(reals_in_range) << "All reals are within [min, max)";
+
+			testing("Bulk Fill");
+
+			PCG32 scalar(77), bulk(77);
+			std::vector<float> reals(1000);
+			fill_real(bulk, reals.data(), reals.size(), -1.0f, 1.0f);
+
+			bool matches_scalar = true;
+			for (std::size_t i = 0; i < reals.size(); i += 1)
+				matches_scalar = matches_scalar && std::abs(reals[i] - real_random(scalar, -1.0f, 1.0f)) < 1e-6;
+
+			check(matches_scalar) << "Bulk fill produces the same reals as single draws";
+
+			Xoshiro256 wide(77);
+			std::vector<std::uint32_t> integrals(1001);
+			fill_integral(wide, integrals.data(), integrals.size(), 6);
+
+			bool integrals_in_range = true;
+			for (auto value : integrals)
+				integrals_in_range = integrals_in_range && value < 6;
+
+			check(integrals_in_range) << "Bulk integers are within the bound";
+		}
+
+		UNIT_TEST(ThreadRandom)
+		{
+			testing("Reproducibility");
+
+			seed_thread_random(2012);
+			float first[3] = {real_random(), real_random(), real_random()};
+
+			seed_thread_random(2012);
+			float second[3] = {real_random(), real_random(), real_random()};
+
+			check(first[0] == second[0] && first[1] == second[1] && first[2] == second[2]) << "Reseeding repeats the sequence";
+
+			testing("Independent Threads");
+
+			std::uint32_t values[2];
+			std::thread other([&]() { values[1] = thread_random()(); });
+			values[0] = thread_random()();
+			other.join();
+
+			seed_thread_random(2012);
+			thread_random()();
+			thread_random()();
+			thread_random()();
+
+			check(values[0] == thread_random()()) << "Other threads don't consume values from this thread's stream";
+			check(values[0] != values[1]) << "Each thread has its own stream";
+		}
+
+		UNIT_TEST(RandomPerformance)
+		{
+			testing("Generators Under Threads");
+
+			const std::size_t THREADS = 8, COUNT = 1000000;
+			std::vector<std::uint32_t> sums(THREADS);
+
+			auto run = [&](std::function<void(std::size_t)> function) {
+				Stopwatch stopwatch;
+				std::vector<std::thread> threads;
+
+				stopwatch.start();
+
+				for (std::size_t t = 0; t < THREADS; t += 1)
+					threads.push_back(std::thread(function, t));
+
+				for (auto & thread : threads)
+					thread.join();
+
+				stopwatch.pause();
+
+				return (THREADS * COUNT) / stopwatch.time() / 1e6;
+			};
+
+			TimeT rand_rate = run([&](std::size_t t) {
+				std::uint32_t sum = 0;
+
+				for (std::size_t i = 0; i < COUNT; i += 1)
+					sum += std::rand();
+
+				sums[t] = sum;
+			});
+
+			TimeT pcg_rate = run([&](std::size_t t) {
+				PCG32 generator(2012, t);
+				std::uint32_t sum = 0;
+
+				for (std::size_t i = 0; i < COUNT; i += 1)
+					sum += generator();
+
+				sums[t] = sum;
+			});
+
+			std::vector<std::vector<float>> values(THREADS, std::vector<float>(COUNT));
+
+			TimeT fill_rate = run([&](std::size_t t) {
+				Xoshiro256 generator(2012 + t);
+
+				fill_real(generator, values[t].data(), COUNT);
+
+				sums[t] = (std::uint32_t)values[t][COUNT / 2];
+			});
+
+			std::cout << "Random numbers with " << THREADS << " threads: rand() " << rand_rate << "M/s, PCG32 " << pcg_rate << "M/s, Xoshiro256 fill_real " << fill_rate << "M/s" << std::endl;
+		}
+#endif
+	}
+}
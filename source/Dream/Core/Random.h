@@ -0,0 +1,225 @@
+//
+//  Core/Random.h
+//  This file is part of the "Dream" project, and is released under the MIT license.
+//
+//  Created by agent on 18/10/26.
+//  Copyright (c) 2026 agent. All rights reserved.
+//
+//
+
+#ifndef _DREAM_CORE_RANDOM_H
+#define _DREAM_CORE_RANDOM_H
+
+#include "Core.h"
+
+#include <cstdint>
+
+namespace Dream {
+	namespace Core {
+		/**
+		 Small, fast and seedable random number generators, for use in place of rand().
+
+		 rand() shares one hidden state between all threads, which is slow under contention and makes results depend on everything else which calls it. These generators are plain values: each system, emitter or task can keep its own, and the same seed always gives the same sequence.
+
+		 All generators satisfy the requirements of a uniform random bit generator, so they can also be used with the distributions in <random>.
+		 */
+
+		// Expands a single 64-bit seed into well mixed values, for seeding the larger generators.
+		class SplitMix64 {
+		protected:
+			std::uint64_t _state;
+
+		public:
+			typedef std::uint64_t result_type;
+
+			static constexpr result_type min () { return 0; }
+			static constexpr result_type max () { return UINT64_MAX; }
+
+			SplitMix64 (std::uint64_t seed) : _state(seed) {}
+
+			result_type operator() () {
+				std::uint64_t z = (_state += 0x9E3779B97F4A7C15ULL);
+
+				z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+				z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+
+				return z ^ (z >> 31);
+			}
+		};
+
+		// PCG32 (XSH-RR) has 64 bits of state and produces 32-bit values. Generators with the same seed but different streams produce independent sequences, which makes it easy to give every emitter its own.
+		class PCG32 {
+		protected:
+			std::uint64_t _state, _increment;
+
+		public:
+			typedef std::uint32_t result_type;
+
+			static constexpr result_type min () { return 0; }
+			static constexpr result_type max () { return UINT32_MAX; }
+
+			PCG32 (std::uint64_t seed = 0x853C49E6748FEA9BULL, std::uint64_t stream = 0xDA3E39CB94B95BDBULL);
+
+			void seed (std::uint64_t seed, std::uint64_t stream = 0xDA3E39CB94B95BDBULL);
+
+			result_type operator() () {
+				std::uint64_t state = _state;
+				_state = state * 6364136223846793005ULL + _increment;
+
+				std::uint32_t shifted = (std::uint32_t)(((state >> 18) ^ state) >> 27);
+				std::uint32_t rotation = (std::uint32_t)(state >> 59);
+
+				return (shifted >> rotation) | (shifted << ((-rotation) & 31));
+			}
+
+			// Move the generator forward by the given number of steps in O(log n) time.
+			void advance (std::uint64_t steps);
+		};
+
+		// xoshiro256** has 256 bits of state and produces 64-bit values. It is the fastest generator here when many values are needed at once, as each call provides two 32-bit values.
+		class Xoshiro256 {
+		protected:
+			std::uint64_t _state[4];
+
+			static std::uint64_t rotate_left (std::uint64_t x, int k) {
+				return (x << k) | (x >> (64 - k));
+			}
+
+		public:
+			typedef std::uint64_t result_type;
+
+			static constexpr result_type min () { return 0; }
+			static constexpr result_type max () { return UINT64_MAX; }
+
+			Xoshiro256 (std::uint64_t seed = 0);
+
+			void seed (std::uint64_t seed);
+
+			result_type operator() () {
+				std::uint64_t result = rotate_left(_state[1] * 5, 7) * 9;
+				std::uint64_t t = _state[1] << 17;
+
+				_state[2] ^= _state[0];
+				_state[3] ^= _state[1];
+				_state[1] ^= _state[2];
+				_state[0] ^= _state[3];
+
+				_state[2] ^= t;
+				_state[3] = rotate_left(_state[3], 45);
+
+				return result;
+			}
+
+			// Equivalent to 2^128 calls. Jumping a copy of a generator N times gives N non-overlapping streams, e.g. one per thread.
+			void jump ();
+		};
+
+		// MARK: -
+
+		// The upper 32 bits of the next value, which are the best bits of every generator here.
+		template <typename GeneratorT>
+		inline std::uint32_t random_bits (GeneratorT & generator) {
+			return (std::uint32_t)(generator() >> (sizeof(typename GeneratorT::result_type) * 8 - 32));
+		}
+
+		// The upper 24 bits as a float in [0, 1).
+		inline float unit_real (std::uint32_t bits) {
+			return (float)(bits >> 8) * (1.0f / 16777216.0f);
+		}
+
+		// A float in [0, 1).
+		template <typename GeneratorT>
+		inline float real_random (GeneratorT & generator) {
+			return unit_real(random_bits(generator));
+		}
+
+		// A real number in [min, max).
+		template <typename GeneratorT, typename NumericT>
+		inline NumericT real_random (GeneratorT & generator, NumericT min, NumericT max) {
+			return min + (NumericT)real_random(generator) * (max - min);
+		}
+
+		// An unbiased integer in [0, bound), using Lemire's multiply and shift with rejection of the few values which would bias the result.
+		template <typename GeneratorT>
+		inline std::uint32_t integral_random (GeneratorT & generator, std::uint32_t bound) {
+			std::uint64_t product = (std::uint64_t)random_bits(generator) * bound;
+
+			if ((std::uint32_t)product < bound) {
+				std::uint32_t threshold = (-bound) % bound;
+
+				while ((std::uint32_t)product < threshold)
+					product = (std::uint64_t)random_bits(generator) * bound;
+			}
+
+			return (std::uint32_t)(product >> 32);
+		}
+
+		// MARK: -
+		// MARK: Bulk Generation
+
+		// Generators are called back to back and the results are converted in a separate pass, which the compiler can vectorize.
+		template <typename GeneratorT>
+		void generate (GeneratorT & generator, std::uint32_t * values, std::size_t count) {
+			std::size_t i = 0;
+
+			if (sizeof(typename GeneratorT::result_type) == 8) {
+				for (; i + 1 < count; i += 2) {
+					std::uint64_t value = generator();
+
+					values[i] = (std::uint32_t)(value >> 32);
+					values[i+1] = (std::uint32_t)value;
+				}
+			}
+
+			for (; i < count; i += 1)
+				values[i] = random_bits(generator);
+		}
+
+		void convert_reals (const std::uint32_t * bits, float * values, std::size_t count, float min, float max);
+		void convert_integrals (std::uint32_t * values, std::size_t count, std::uint32_t bound);
+
+		// Fill with reals in [min, max).
+		template <typename GeneratorT>
+		void fill_real (GeneratorT & generator, float * values, std::size_t count, float min = 0, float max = 1) {
+			const std::size_t BLOCK = 256;
+			std::uint32_t bits[BLOCK];
+
+			for (std::size_t i = 0; i < count; i += BLOCK) {
+				std::size_t size = (count - i) < BLOCK ? (count - i) : BLOCK;
+
+				generate(generator, bits, size);
+				convert_reals(bits, values + i, size, min, max);
+			}
+		}
+
+		// Fill with integers in [0, bound). Unlike integral_random, values are not rejected, so the bias is at most bound / 2^32, which is negligible for the small bounds used for effects.
+		template <typename GeneratorT>
+		void fill_integral (GeneratorT & generator, std::uint32_t * values, std::size_t count, std::uint32_t bound) {
+			generate(generator, values, count);
+			convert_integrals(values, count, bound);
+		}
+
+		// MARK: -
+		// MARK: Per-thread Streams
+
+		// Each thread has its own generator, created on first use from the seed and the order in which threads first used it. This is a direct replacement for rand(), and is reproducible for a single thread. When work is spread across threads, give each task its own stream instead, e.g. PCG32(seed, task).
+		PCG32 & thread_random ();
+
+		// Reseeds the calling thread's generator, and the generators of threads which use thread_random() for the first time after this call.
+		void seed_thread_random (std::uint64_t seed);
+
+		inline float real_random () {
+			return real_random(thread_random());
+		}
+
+		inline float real_random (float min, float max) {
+			return real_random(thread_random(), min, max);
+		}
+
+		inline unsigned integral_random (unsigned bound) {
+			return integral_random(thread_random(), bound);
+		}
+	}
+}
+
+#endif
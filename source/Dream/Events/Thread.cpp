@@ -10,6 +10,7 @@
 #include "Logger.h"
 
 #include <string.h>
+#include <algorithm>
 
 namespace Dream {
 	namespace Events {
@@ -68,6 +69,103 @@ namespace Dream {
 			}
 		}
 
+// MARK: -
+// MARK: class WorkerPool
+
+		WorkerPool::WorkerPool (std::size_t additional_threads) : _function(NULL), _count(0), _active(0), _generation(0), _next(0), _stopping(false)
+		{
+			if (additional_threads == AUTOMATIC)
+				additional_threads = std::max(std::thread::hardware_concurrency(), 1U) - 1;
+
+			for (std::size_t i = 0; i < additional_threads; i += 1)
+				_threads.push_back(std::thread(std::bind(&WorkerPool::run, this)));
+		}
+
+		WorkerPool::~WorkerPool ()
+		{
+			{
+				std::lock_guard<std::mutex> lock(_lock);
+				_stopping = true;
+			}
+
+			_work_available.notify_all();
+
+			for (auto & thread : _threads)
+				thread.join();
+		}
+
+		void WorkerPool::work ()
+		{
+			std::size_t index;
+
+			while ((index = _next++) < _count)
+				(*_function)(index);
+		}
+
+		void WorkerPool::run ()
+		{
+			std::size_t generation = 0;
+
+			while (true) {
+				{
+					std::unique_lock<std::mutex> lock(_lock);
+					_work_available.wait(lock, [&]() { return _stopping || _generation != generation; });
+
+					if (_stopping) return;
+
+					generation = _generation;
+				}
+
+				work();
+
+				{
+					std::lock_guard<std::mutex> lock(_lock);
+					_active -= 1;
+				}
+
+				_work_complete.notify_one();
+			}
+		}
+
+		void WorkerPool::parallel_for (std::size_t count, const FunctionT & function)
+		{
+			if (_threads.empty() || count <= 1) {
+				for (std::size_t i = 0; i < count; i += 1)
+					function(i);
+
+				return;
+			}
+
+			{
+				std::lock_guard<std::mutex> lock(_lock);
+
+				_function = &function;
+				_count = count;
+				_next = 0;
+				_active = _threads.size();
+				_generation += 1;
+			}
+
+			_work_available.notify_all();
+
+			work();
+
+			std::unique_lock<std::mutex> lock(_lock);
+			_work_complete.wait(lock, [&]() { return _active == 0; });
+
+			_function = NULL;
+		}
+
+		void parallel_for (WorkerPool * pool, std::size_t count, const WorkerPool::FunctionT & function)
+		{
+			if (pool) {
+				pool->parallel_for(count, function);
+			} else {
+				for (std::size_t i = 0; i < count; i += 1)
+					function(i);
+			}
+		}
+
 // MARK: -
 // MARK: Unit Tests
 
@@ -169,6 +267,52 @@ namespace Dream {
 			std::cerr << std::flush;
 		}
 
+		UNIT_TEST(WorkerPool) {
+			testing("Parallel loops");
+
+			Ref<WorkerPool> pool = new WorkerPool(3);
+			check(pool->thread_count() == 4) << "Pool includes the calling thread";
+
+			std::vector<std::size_t> values(10000, 0);
+			std::atomic<std::size_t> calls(0);
+
+			for (std::size_t iteration = 0; iteration < 100; iteration += 1) {
+				pool->parallel_for(values.size(), [&](std::size_t index) {
+					values[index] += index;
+					calls += 1;
+				});
+			}
+
+			bool correct = true;
+			for (std::size_t i = 0; i < values.size(); i += 1)
+				correct = correct && values[i] == i * 100;
+
+			check(calls == values.size() * 100) << "Every index was called once per loop";
+			check(correct) << "Every loop completed before the next started";
+
+			testing("Thread counts");
+
+			Ref<WorkerPool> serial = new WorkerPool(0);
+			check(serial->thread_count() == 1) << "A pool with no additional threads only uses the caller";
+
+			std::size_t count = 0;
+			serial->parallel_for(100, [&](std::size_t index) {
+				count += 1;
+			});
+
+			check(count == 100) << "Serial loop completed";
+
+			count = 0;
+			parallel_for(NULL, 100, [&](std::size_t index) {
+				count += 1;
+			});
+
+			check(count == 100) << "Loop without a pool runs on the caller";
+
+			Ref<WorkerPool> automatic = new WorkerPool;
+			check(automatic->thread_count() == std::max(std::thread::hardware_concurrency(), 1U)) << "Automatic pool uses every processor";
+		}
+
 #endif
 	}
 }
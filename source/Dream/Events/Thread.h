@@ -11,6 +11,9 @@
 
 #include "Loop.h"
 
+#include <atomic>
+#include <condition_variable>
+#include <functional>
 #include <thread>
 #include <mutex>
 
@@ -44,6 +47,43 @@ namespace Dream
 			void stop();
 		};
 
+		/// A fixed set of threads which work together on parallel loops. The calling thread also takes part, so a pool with no additional threads runs loops serially.
+		class WorkerPool : public Object {
+		public:
+			typedef std::function<void(std::size_t)> FunctionT;
+
+		protected:
+			std::vector<std::thread> _threads;
+
+			std::mutex _lock;
+			std::condition_variable _work_available, _work_complete;
+
+			const FunctionT * _function;
+			std::size_t _count, _active, _generation;
+			std::atomic<std::size_t> _next;
+			bool _stopping;
+
+			void run ();
+			void work ();
+
+		public:
+			/// Use one less than the number of processors, so that together with the caller every processor is used.
+			static const std::size_t AUTOMATIC = (std::size_t)-1;
+
+			/// Creates the given number of additional threads. With zero, loops run serially on the caller.
+			WorkerPool (std::size_t additional_threads = AUTOMATIC);
+			virtual ~WorkerPool ();
+
+			/// The number of threads which work on each loop, including the caller.
+			std::size_t thread_count () const { return _threads.size() + 1; }
+
+			/// Call the function for every index in [0, count) and wait until all calls are complete. Indices are handed out in increasing order, but may complete in any order.
+			void parallel_for (std::size_t count, const FunctionT & function);
+		};
+
+		/// Call the function for every index in [0, count) using the pool, or serially on the calling thread if there is no pool.
+		void parallel_for (WorkerPool * pool, std::size_t count, const WorkerPool::FunctionT & function);
+
 		/// Stream data from multiple writers to a single reader.
 		template <typename ItemT>
 		class Queue : public Object {
@@ -0,0 +1,675 @@
+//
+//  Imaging/BlockCompression.cpp
+//  This file is part of the "Dream" project, and is released under the MIT license.
+//
+//  Created by agent on 18/10/26.
+//  Copyright (c) 2026 agent. All rights reserved.
+//
+//
+
+#include "BlockCompression.h"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+namespace Dream {
+	namespace Imaging {
+		std::size_t block_format_byte_size(BlockFormat format) {
+			return (unsigned)format & 0xFF;
+		}
+
+		std::size_t block_compressed_length(BlockFormat format, std::size_t width, std::size_t height) {
+			if (width > MAXIMUM_BLOCK_COMPRESSED_DIMENSION || height > MAXIMUM_BLOCK_COMPRESSED_DIMENSION)
+				return 0;
+
+			std::size_t blocks_wide = std::max<std::size_t>(1, (width + BLOCK_DIMENSION - 1) / BLOCK_DIMENSION);
+			std::size_t blocks_high = std::max<std::size_t>(1, (height + BLOCK_DIMENSION - 1) / BLOCK_DIMENSION);
+			std::size_t block_size = block_format_byte_size(format);
+
+			// The dimensions are limited, but the length may still not fit if std::size_t is 32 bits:
+			if (blocks_wide * blocks_high > std::numeric_limits<std::size_t>::max() / block_size)
+				return 0;
+
+			return blocks_wide * blocks_high * block_size;
+		}
+
+// MARK: -
+// MARK: BC1 - BC5
+
+		static void expand_565 (uint16_t color, ByteT * rgb) {
+			unsigned r = (color >> 11) & 0x1F, g = (color >> 5) & 0x3F, b = color & 0x1F;
+
+			rgb[0] = (r << 3) | (r >> 2);
+			rgb[1] = (g << 2) | (g >> 4);
+			rgb[2] = (b << 3) | (b >> 2);
+		}
+
+		/// Decodes the 8 byte colour block shared by BC1 and BC3. BC3 always uses the four colour mode.
+		static void decode_color_block (const ByteT * block, ByteT * rgba, bool allow_punch_through) {
+			uint16_t c0 = block[0] | (block[1] << 8);
+			uint16_t c1 = block[2] | (block[3] << 8);
+
+			ByteT palette[4][4];
+
+			expand_565(c0, palette[0]);
+			expand_565(c1, palette[1]);
+			palette[0][3] = palette[1][3] = palette[2][3] = palette[3][3] = 255;
+
+			if (c0 > c1 || !allow_punch_through) {
+				for (std::size_t i = 0; i < 3; i += 1) {
+					palette[2][i] = (2 * palette[0][i] + palette[1][i]) / 3;
+					palette[3][i] = (palette[0][i] + 2 * palette[1][i]) / 3;
+				}
+			} else {
+				for (std::size_t i = 0; i < 3; i += 1) {
+					palette[2][i] = (palette[0][i] + palette[1][i]) / 2;
+					palette[3][i] = 0;
+				}
+
+				palette[3][3] = 0;
+			}
+
+			uint32_t indices = block[4] | (block[5] << 8) | (block[6] << 16) | ((uint32_t)block[7] << 24);
+
+			for (std::size_t i = 0; i < 16; i += 1) {
+				memcpy(rgba + i * 4, palette[(indices >> (i * 2)) & 0x3], 4);
+			}
+		}
+
+		/// Decodes an 8 byte BC4 channel block, writing the 16 values at the given stride.
+		static void decode_channel_block (const ByteT * block, ByteT * output, std::size_t stride) {
+			unsigned palette[8];
+
+			palette[0] = block[0];
+			palette[1] = block[1];
+
+			if (palette[0] > palette[1]) {
+				for (unsigned i = 2; i < 8; i += 1)
+					palette[i] = ((8 - i) * palette[0] + (i - 1) * palette[1]) / 7;
+			} else {
+				for (unsigned i = 2; i < 6; i += 1)
+					palette[i] = ((6 - i) * palette[0] + (i - 1) * palette[1]) / 5;
+
+				palette[6] = 0;
+				palette[7] = 255;
+			}
+
+			uint64_t indices = 0;
+			for (std::size_t i = 0; i < 6; i += 1)
+				indices |= (uint64_t)block[2 + i] << (i * 8);
+
+			for (std::size_t i = 0; i < 16; i += 1) {
+				output[i * stride] = palette[(indices >> (i * 3)) & 0x7];
+			}
+		}
+
+		void decode_bc1_block(const ByteT * block, ByteT * rgba) {
+			decode_color_block(block, rgba, true);
+		}
+
+		void decode_bc3_block(const ByteT * block, ByteT * rgba) {
+			decode_color_block(block + 8, rgba, false);
+			decode_channel_block(block, rgba + 3, 4);
+		}
+
+		void decode_bc4_block(const ByteT * block, ByteT * rgba) {
+			decode_channel_block(block, rgba, 4);
+
+			for (std::size_t i = 0; i < 16; i += 1) {
+				rgba[i * 4 + 1] = rgba[i * 4 + 2] = rgba[i * 4];
+				rgba[i * 4 + 3] = 255;
+			}
+		}
+
+		void decode_bc5_block(const ByteT * block, ByteT * rgba) {
+			decode_channel_block(block, rgba, 4);
+			decode_channel_block(block + 8, rgba + 1, 4);
+
+			for (std::size_t i = 0; i < 16; i += 1) {
+				rgba[i * 4 + 2] = 0;
+				rgba[i * 4 + 3] = 255;
+			}
+		}
+
+// MARK: -
+// MARK: BC7
+
+		namespace {
+			struct BC7Mode {
+				unsigned subsets, partition_bits, rotation_bits, index_selection_bits;
+				unsigned color_bits, alpha_bits, endpoint_pbits, shared_pbits;
+				unsigned index_bits, secondary_index_bits;
+			};
+
+			const BC7Mode BC7_MODES[8] = {
+				{3, 4, 0, 0, 4, 0, 1, 0, 3, 0},
+				{2, 6, 0, 0, 6, 0, 0, 1, 3, 0},
+				{3, 6, 0, 0, 5, 0, 0, 0, 2, 0},
+				{2, 6, 0, 0, 7, 0, 1, 0, 2, 0},
+				{1, 0, 2, 1, 5, 6, 0, 0, 2, 3},
+				{1, 0, 2, 0, 7, 8, 0, 0, 2, 2},
+				{1, 0, 0, 0, 7, 7, 1, 0, 4, 0},
+				{2, 6, 0, 0, 5, 5, 1, 0, 2, 0},
+			};
+
+			// Bit n is set if pixel n belongs to the second subset.
+			const uint16_t BC7_PARTITIONS_2[64] = {
+				0xCCCC, 0x8888, 0xEEEE, 0xECC8, 0xC880, 0xFEEC, 0xFEC8, 0xEC80,
+				0xC800, 0xFFEC, 0xFE80, 0xE800, 0xFFE8, 0xFF00, 0xFFF0, 0xF000,
+				0xF710, 0x008E, 0x7100, 0x08CE, 0x008C, 0x7310, 0x3100, 0x8CCE,
+				0x088C, 0x3110, 0x6666, 0x366C, 0x17E8, 0x0FF0, 0x718E, 0x399C,
+				0xAAAA, 0xF0F0, 0x5A5A, 0x33CC, 0x3C3C, 0x55AA, 0x9696, 0xA55A,
+				0x73CE, 0x13C8, 0x324C, 0x3BDC, 0x6996, 0xC33C, 0x9966, 0x0660,
+				0x0272, 0x04E4, 0x4E40, 0x2720, 0xC936, 0x936C, 0x39C6, 0x639C,
+				0x9336, 0x9CC6, 0x817E, 0xE718, 0xCCF0, 0x0FCC, 0x7744, 0xEE22,
+			};
+
+			const ByteT BC7_PARTITIONS_3[64][16] = {
+				{0,0,1,1,0,0,1,1,0,2,2,1,2,2,2,2}, {0,0,0,1,0,0,1,1,2,2,1,1,2,2,2,1},
+				{0,0,0,0,2,0,0,1,2,2,1,1,2,2,1,1}, {0,2,2,2,0,0,2,2,0,0,1,1,0,1,1,1},
+				{0,0,0,0,0,0,0,0,1,1,2,2,1,1,2,2}, {0,0,1,1,0,0,1,1,0,0,2,2,0,0,2,2},
+				{0,0,2,2,0,0,2,2,1,1,1,1,1,1,1,1}, {0,0,1,1,0,0,1,1,2,2,1,1,2,2,1,1},
+				{0,0,0,0,0,0,0,0,1,1,1,1,2,2,2,2}, {0,0,0,0,1,1,1,1,1,1,1,1,2,2,2,2},
+				{0,0,0,0,1,1,1,1,2,2,2,2,2,2,2,2}, {0,0,1,2,0,0,1,2,0,0,1,2,0,0,1,2},
+				{0,1,1,2,0,1,1,2,0,1,1,2,0,1,1,2}, {0,1,2,2,0,1,2,2,0,1,2,2,0,1,2,2},
+				{0,0,1,1,0,1,1,2,1,1,2,2,1,2,2,2}, {0,0,1,1,2,0,0,1,2,2,0,0,2,2,2,0},
+				{0,0,0,1,0,0,1,1,0,1,1,2,1,1,2,2}, {0,1,1,1,0,0,1,1,2,0,0,1,2,2,0,0},
+				{0,0,0,0,1,1,2,2,1,1,2,2,1,1,2,2}, {0,0,2,2,0,0,2,2,0,0,2,2,1,1,1,1},
+				{0,1,1,1,0,1,1,1,0,2,2,2,0,2,2,2}, {0,0,0,1,0,0,0,1,2,2,2,1,2,2,2,1},
+				{0,0,0,0,0,0,1,1,0,1,2,2,0,1,2,2}, {0,0,0,0,1,1,0,0,2,2,1,0,2,2,1,0},
+				{0,1,2,2,0,1,2,2,0,0,1,1,0,0,0,0}, {0,0,1,2,0,0,1,2,1,1,2,2,2,2,2,2},
+				{0,1,1,0,1,2,2,1,1,2,2,1,0,1,1,0}, {0,0,0,0,0,1,1,0,1,2,2,1,1,2,2,1},
+				{0,0,2,2,1,1,0,2,1,1,0,2,0,0,2,2}, {0,1,1,0,0,1,1,0,2,0,0,2,2,2,2,2},
+				{0,0,1,1,0,1,2,2,0,1,2,2,0,0,1,1}, {0,0,0,0,2,0,0,0,2,2,1,1,2,2,2,1},
+				{0,0,0,0,0,0,0,2,1,1,2,2,1,2,2,2}, {0,2,2,2,0,0,2,2,0,0,1,2,0,0,1,1},
+				{0,0,1,1,0,0,1,2,0,0,2,2,0,2,2,2}, {0,1,2,0,0,1,2,0,0,1,2,0,0,1,2,0},
+				{0,0,0,0,1,1,1,1,2,2,2,2,0,0,0,0}, {0,1,2,0,1,2,0,1,2,0,1,2,0,1,2,0},
+				{0,1,2,0,2,0,1,2,1,2,0,1,0,1,2,0}, {0,0,1,1,2,2,0,0,1,1,2,2,0,0,1,1},
+				{0,0,1,1,1,1,2,2,2,2,0,0,0,0,1,1}, {0,1,0,1,0,1,0,1,2,2,2,2,2,2,2,2},
+				{0,0,0,0,0,0,0,0,2,1,2,1,2,1,2,1}, {0,0,2,2,1,1,2,2,0,0,2,2,1,1,2,2},
+				{0,0,2,2,0,0,1,1,0,0,2,2,0,0,1,1}, {0,2,2,0,1,2,2,1,0,2,2,0,1,2,2,1},
+				{0,1,0,1,2,2,2,2,2,2,2,2,0,1,0,1}, {0,0,0,0,2,1,2,1,2,1,2,1,2,1,2,1},
+				{0,1,0,1,0,1,0,1,0,1,0,1,2,2,2,2}, {0,2,2,2,0,1,1,1,0,2,2,2,0,1,1,1},
+				{0,0,0,2,1,1,1,2,0,0,0,2,1,1,1,2}, {0,0,0,0,2,1,1,2,2,1,1,2,2,1,1,2},
+				{0,2,2,2,0,1,1,1,0,1,1,1,0,2,2,2}, {0,0,0,2,1,1,1,2,1,1,1,2,0,0,0,2},
+				{0,1,1,0,0,1,1,0,0,1,1,0,2,2,2,2}, {0,0,0,0,0,0,0,0,2,1,1,2,2,1,1,2},
+				{0,1,1,0,0,1,1,0,2,2,2,2,2,2,2,2}, {0,0,2,2,0,0,1,1,0,0,1,1,0,0,2,2},
+				{0,0,2,2,1,1,2,2,1,1,2,2,0,0,2,2}, {0,0,0,0,0,0,0,0,0,0,0,0,2,1,1,2},
+				{0,0,0,2,0,0,0,1,0,0,0,2,0,0,0,1}, {0,2,2,2,1,2,2,2,0,2,2,2,1,2,2,2},
+				{0,1,0,1,2,2,2,2,2,2,2,2,2,2,2,2}, {0,1,1,1,2,0,1,1,2,2,0,1,2,2,2,0},
+			};
+
+			// The anchor pixel of the second subset for two subset partitions.
+			const ByteT BC7_ANCHORS_2[64] = {
+				15,15,15,15,15,15,15,15, 15,15,15,15,15,15,15,15,
+				15, 2, 8, 2, 2, 8, 8,15,  2, 8, 2, 2, 8, 8, 2, 2,
+				15,15, 6, 8, 2, 8,15,15,  2, 8, 2, 2, 2,15,15, 6,
+				 6, 2, 6, 8,15,15, 2, 2, 15,15,15,15,15, 2, 2,15,
+			};
+
+			// The anchor pixels of the second and third subsets for three subset partitions.
+			const ByteT BC7_ANCHORS_3[2][64] = {
+				{
+					 3, 3,15,15, 8, 3,15,15,  8, 8, 6, 6, 6, 5, 3, 3,
+					 3, 3, 8,15, 3, 3, 6,10,  5, 8, 8, 6, 8, 5,15,15,
+					 8,15, 3, 5, 6,10, 8,15, 15, 3,15, 5,15,15,15,15,
+					 3,15, 5, 5, 5, 8, 5,10,  5,10, 8,13,15,12, 3, 3,
+				}, {
+					15, 8, 8, 3,15,15, 3, 8, 15,15,15,15,15,15,15, 8,
+					15, 8,15, 3,15, 8,15, 8,  3,15, 6,10,15,15,10, 8,
+					15, 3,15,10,10, 8, 9,10,  6,15, 8,15, 3, 6, 6, 8,
+					15, 3,15,15,15,15,15,15, 15,15,15,15, 3,15,15, 8,
+				}
+			};
+
+			const unsigned BC7_WEIGHTS_2[4] = {0, 21, 43, 64};
+			const unsigned BC7_WEIGHTS_3[8] = {0, 9, 18, 27, 37, 46, 55, 64};
+			const unsigned BC7_WEIGHTS_4[16] = {0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+
+			/// Reads bits from a block, least significant bit first.
+			struct BitReader {
+				const ByteT * data;
+				unsigned offset;
+
+				BitReader (const ByteT * _data) : data(_data), offset(0) {}
+
+				unsigned read (unsigned count) {
+					unsigned value = 0;
+
+					for (unsigned i = 0; i < count; i += 1, offset += 1) {
+						value |= ((data[offset >> 3] >> (offset & 7)) & 1) << i;
+					}
+
+					return value;
+				}
+			};
+
+			unsigned bc7_subset (unsigned subsets, unsigned partition, unsigned pixel) {
+				if (subsets == 2)
+					return (BC7_PARTITIONS_2[partition] >> pixel) & 1;
+				else if (subsets == 3)
+					return BC7_PARTITIONS_3[partition][pixel];
+				else
+					return 0;
+			}
+
+			unsigned bc7_anchor (unsigned subsets, unsigned partition, unsigned subset) {
+				if (subset == 0)
+					return 0;
+				else if (subsets == 2)
+					return BC7_ANCHORS_2[partition];
+				else
+					return BC7_ANCHORS_3[subset - 1][partition];
+			}
+
+			const unsigned * bc7_weights (unsigned index_bits) {
+				if (index_bits == 2)
+					return BC7_WEIGHTS_2;
+				else if (index_bits == 3)
+					return BC7_WEIGHTS_3;
+				else
+					return BC7_WEIGHTS_4;
+			}
+
+			ByteT bc7_unquantize (unsigned value, unsigned precision) {
+				value <<= (8 - precision);
+
+				return value | (value >> precision);
+			}
+
+			ByteT bc7_interpolate (unsigned e0, unsigned e1, unsigned weight) {
+				return ((64 - weight) * e0 + weight * e1 + 32) >> 6;
+			}
+		}
+
+		void decode_bc7_block(const ByteT * block, ByteT * rgba) {
+			unsigned mode = 0;
+
+			while (mode < 8 && !(block[0] & (1 << mode)))
+				mode += 1;
+
+			// Reserved mode, decodes to transparent black:
+			if (mode == 8) {
+				memset(rgba, 0, 16 * 4);
+				return;
+			}
+
+			const BC7Mode & m = BC7_MODES[mode];
+
+			BitReader bits(block);
+			bits.read(mode + 1);
+
+			unsigned partition = bits.read(m.partition_bits);
+			unsigned rotation = bits.read(m.rotation_bits);
+			unsigned index_selection = bits.read(m.index_selection_bits);
+
+			unsigned endpoint_count = m.subsets * 2;
+			unsigned endpoints[6][4];
+
+			for (unsigned channel = 0; channel < 3; channel += 1)
+				for (unsigned i = 0; i < endpoint_count; i += 1)
+					endpoints[i][channel] = bits.read(m.color_bits);
+
+			for (unsigned i = 0; i < endpoint_count; i += 1)
+				endpoints[i][3] = m.alpha_bits ? bits.read(m.alpha_bits) : 255;
+
+			unsigned color_precision = m.color_bits, alpha_precision = m.alpha_bits;
+
+			if (m.endpoint_pbits || m.shared_pbits) {
+				unsigned pbits[6];
+
+				if (m.endpoint_pbits) {
+					for (unsigned i = 0; i < endpoint_count; i += 1)
+						pbits[i] = bits.read(1);
+				} else {
+					for (unsigned s = 0; s < m.subsets; s += 1)
+						pbits[s * 2] = pbits[s * 2 + 1] = bits.read(1);
+				}
+
+				for (unsigned i = 0; i < endpoint_count; i += 1) {
+					for (unsigned channel = 0; channel < 3; channel += 1)
+						endpoints[i][channel] = (endpoints[i][channel] << 1) | pbits[i];
+
+					if (m.alpha_bits)
+						endpoints[i][3] = (endpoints[i][3] << 1) | pbits[i];
+				}
+
+				color_precision += 1;
+				if (alpha_precision) alpha_precision += 1;
+			}
+
+			for (unsigned i = 0; i < endpoint_count; i += 1) {
+				for (unsigned channel = 0; channel < 3; channel += 1)
+					endpoints[i][channel] = bc7_unquantize(endpoints[i][channel], color_precision);
+
+				if (m.alpha_bits)
+					endpoints[i][3] = bc7_unquantize(endpoints[i][3], alpha_precision);
+			}
+
+			unsigned subsets[16], primary[16], secondary[16];
+
+			for (unsigned i = 0; i < 16; i += 1) {
+				subsets[i] = bc7_subset(m.subsets, partition, i);
+
+				bool anchor = (i == bc7_anchor(m.subsets, partition, subsets[i]));
+				primary[i] = bits.read(anchor ? m.index_bits - 1 : m.index_bits);
+			}
+
+			if (m.secondary_index_bits) {
+				for (unsigned i = 0; i < 16; i += 1)
+					secondary[i] = bits.read(i == 0 ? m.secondary_index_bits - 1 : m.secondary_index_bits);
+			}
+
+			const unsigned * color_indices = primary, * alpha_indices = primary;
+			const unsigned * color_weights = bc7_weights(m.index_bits), * alpha_weights = color_weights;
+
+			if (m.secondary_index_bits) {
+				if (index_selection) {
+					color_indices = secondary;
+					color_weights = bc7_weights(m.secondary_index_bits);
+				} else {
+					alpha_indices = secondary;
+					alpha_weights = bc7_weights(m.secondary_index_bits);
+				}
+			}
+
+			for (unsigned i = 0; i < 16; i += 1) {
+				const unsigned * e0 = endpoints[subsets[i] * 2], * e1 = endpoints[subsets[i] * 2 + 1];
+				ByteT * pixel = rgba + i * 4;
+
+				for (unsigned channel = 0; channel < 3; channel += 1)
+					pixel[channel] = bc7_interpolate(e0[channel], e1[channel], color_weights[color_indices[i]]);
+
+				pixel[3] = bc7_interpolate(e0[3], e1[3], alpha_weights[alpha_indices[i]]);
+
+				if (rotation)
+					std::swap(pixel[3], pixel[rotation - 1]);
+			}
+		}
+
+// MARK: -
+// MARK: Surface Decoding
+
+		void decode_block(BlockFormat format, const ByteT * block, ByteT * rgba) {
+			switch (format) {
+				case BlockFormat::BC1:
+					decode_bc1_block(block, rgba);
+					break;
+				case BlockFormat::BC3:
+					decode_bc3_block(block, rgba);
+					break;
+				case BlockFormat::BC4:
+					decode_bc4_block(block, rgba);
+					break;
+				case BlockFormat::BC5:
+					decode_bc5_block(block, rgba);
+					break;
+				case BlockFormat::BC7:
+					decode_bc7_block(block, rgba);
+					break;
+			}
+		}
+
+		Ref<Image> decode_blocks(BlockFormat format, const ByteT * data, std::size_t width, std::size_t height) {
+			Ref<Image> image = new Image(PixelCoordinateT(width, height, 1), PixelFormat::RGBA, DataType::BYTE);
+
+			std::size_t block_size = block_format_byte_size(format);
+			std::size_t blocks_wide = (width + BLOCK_DIMENSION - 1) / BLOCK_DIMENSION;
+			std::size_t blocks_high = (height + BLOCK_DIMENSION - 1) / BLOCK_DIMENSION;
+
+			ByteT * output = image->pixel_data();
+			ByteT pixels[16 * 4];
+
+			for (std::size_t by = 0; by < blocks_high; by += 1) {
+				for (std::size_t bx = 0; bx < blocks_wide; bx += 1) {
+					decode_block(format, data, pixels);
+					data += block_size;
+
+					// Copy rows of the block, clipping partial blocks at the right and bottom edges:
+					std::size_t x = bx * BLOCK_DIMENSION, y = by * BLOCK_DIMENSION;
+					std::size_t columns = std::min(BLOCK_DIMENSION, width - x), rows = std::min(BLOCK_DIMENSION, height - y);
+
+					for (std::size_t row = 0; row < rows; row += 1) {
+						memcpy(output + ((y + row) * width + x) * 4, pixels + row * BLOCK_DIMENSION * 4, columns * 4);
+					}
+				}
+			}
+
+			return image;
+		}
+
+// MARK: -
+// MARK: Unit Tests
+
+#ifdef ENABLE_TESTING
+		namespace {
+			/// Writes bits into a block, least significant bit first.
+			struct BitWriter {
+				ByteT data[16];
+				unsigned offset;
+
+				BitWriter () : offset(0) {
+					memset(data, 0, sizeof(data));
+				}
+
+				void write (unsigned value, unsigned count) {
+					for (unsigned i = 0; i < count; i += 1, offset += 1) {
+						data[offset >> 3] |= ((value >> i) & 1) << (offset & 7);
+					}
+				}
+			};
+
+			bool check_pixel (const ByteT * pixel, ByteT r, ByteT g, ByteT b, ByteT a) {
+				return pixel[0] == r && pixel[1] == g && pixel[2] == b && pixel[3] == a;
+			}
+		}
+
+		UNIT_TEST(BlockCompressionBC1)
+		{
+			ByteT rgba[16 * 4];
+
+			testing("Four colour mode");
+
+			// Red and blue endpoints, first row uses indices 0, 1, 2, 3:
+			const ByteT opaque[8] = {0x00, 0xF8, 0x1F, 0x00, 0xE4, 0x00, 0x00, 0x00};
+			decode_bc1_block(opaque, rgba);
+
+			check(check_pixel(rgba + 0, 255, 0, 0, 255)) << "First endpoint is decoded";
+			check(check_pixel(rgba + 4, 0, 0, 255, 255)) << "Second endpoint is decoded";
+			check(check_pixel(rgba + 8, 170, 0, 85, 255)) << "First interpolant is decoded";
+			check(check_pixel(rgba + 12, 85, 0, 170, 255)) << "Second interpolant is decoded";
+			check(check_pixel(rgba + 60, 255, 0, 0, 255)) << "Last pixel uses first endpoint";
+
+			testing("Punch through mode");
+
+			const ByteT transparent[8] = {0x1F, 0x00, 0x00, 0xF8, 0xE4, 0x00, 0x00, 0x00};
+			decode_bc1_block(transparent, rgba);
+
+			check(check_pixel(rgba + 8, 127, 0, 127, 255)) << "Midpoint is decoded";
+			check(check_pixel(rgba + 12, 0, 0, 0, 0)) << "Transparent pixel is decoded";
+		}
+
+		UNIT_TEST(BlockCompressionBC3)
+		{
+			ByteT rgba[16 * 4];
+
+			testing("Alpha and colour blocks");
+
+			// Alpha endpoints 255 and 0, all pixels use index 1. Colour endpoints are equal and all pixels use index 3:
+			const ByteT block[16] = {
+				0xFF, 0x00, 0x49, 0x92, 0x24, 0x49, 0x92, 0x24,
+				0x00, 0xF8, 0x00, 0xF8, 0xFF, 0xFF, 0xFF, 0xFF
+			};
+
+			decode_bc3_block(block, rgba);
+
+			bool correct = true;
+			for (std::size_t i = 0; i < 16; i += 1)
+				correct = correct && check_pixel(rgba + i * 4, 255, 0, 0, 0);
+
+			check(correct) << "Colour block always uses four colour mode";
+
+			decode_bc1_block(block + 8, rgba);
+			check(check_pixel(rgba, 0, 0, 0, 0)) << "Same colour block as BC1 is transparent";
+		}
+
+		UNIT_TEST(BlockCompressionBC4BC5)
+		{
+			ByteT rgba[16 * 4];
+
+			testing("Eight value mode");
+
+			// Pixels 0 to 3 use indices 0, 1, 2, 7:
+			const ByteT eight[8] = {200, 100, 0x88, 0x0E, 0x00, 0x00, 0x00, 0x00};
+			decode_bc4_block(eight, rgba);
+
+			check(check_pixel(rgba + 0, 200, 200, 200, 255)) << "First endpoint is decoded";
+			check(check_pixel(rgba + 4, 100, 100, 100, 255)) << "Second endpoint is decoded";
+			check(check_pixel(rgba + 8, 185, 185, 185, 255)) << "First interpolant is decoded";
+			check(check_pixel(rgba + 12, 114, 114, 114, 255)) << "Last interpolant is decoded";
+
+			testing("Six value mode");
+
+			// Pixels 0 to 3 use indices 2, 6, 7, 0:
+			const ByteT six[8] = {50, 150, 0xF2, 0x01, 0x00, 0x00, 0x00, 0x00};
+			decode_bc4_block(six, rgba);
+
+			check(rgba[0] == 70) << "First interpolant is decoded";
+			check(rgba[4] == 0) << "Minimum value is decoded";
+			check(rgba[8] == 255) << "Maximum value is decoded";
+			check(rgba[12] == 50) << "First endpoint is decoded";
+
+			testing("Two channels");
+
+			ByteT two[16];
+			memcpy(two, eight, 8);
+			memcpy(two + 8, six, 8);
+
+			decode_bc5_block(two, rgba);
+
+			check(check_pixel(rgba + 0, 200, 70, 0, 255)) << "Red and green channels are decoded";
+			check(check_pixel(rgba + 12, 114, 50, 0, 255)) << "Red and green channels are decoded";
+		}
+
+		UNIT_TEST(BlockCompressionBC7)
+		{
+			ByteT rgba[16 * 4];
+
+			testing("Partition tables");
+
+			bool consistent = true;
+			for (unsigned partition = 0; partition < 64; partition += 1) {
+				consistent = consistent && bc7_subset(2, partition, 0) == 0 && bc7_subset(3, partition, 0) == 0;
+				consistent = consistent && bc7_subset(2, partition, bc7_anchor(2, partition, 1)) == 1;
+				consistent = consistent && bc7_subset(3, partition, bc7_anchor(3, partition, 1)) == 1;
+				consistent = consistent && bc7_subset(3, partition, bc7_anchor(3, partition, 2)) == 2;
+			}
+
+			check(consistent) << "Anchor pixels belong to their subsets";
+
+			testing("Mode 6");
+
+			{
+				BitWriter writer;
+				writer.write(1 << 6, 7);
+
+				// Red: 255 -> 0, Green: 1 -> 254, Blue: 129 -> 128, Alpha: 255 -> 254
+				writer.write(127, 7); writer.write(0, 7);
+				writer.write(0, 7); writer.write(127, 7);
+				writer.write(64, 7); writer.write(64, 7);
+				writer.write(127, 7); writer.write(127, 7);
+
+				// P-bits:
+				writer.write(1, 1); writer.write(0, 1);
+
+				// Pixel i uses index i:
+				writer.write(0, 3);
+				for (unsigned i = 1; i < 16; i += 1)
+					writer.write(i, 4);
+
+				check(writer.offset == 128) << "Block is complete";
+
+				decode_bc7_block(writer.data, rgba);
+
+				bool correct = true;
+				for (unsigned i = 0; i < 16; i += 1) {
+					unsigned w = BC7_WEIGHTS_4[i];
+
+					correct = correct && check_pixel(rgba + i * 4, bc7_interpolate(255, 0, w), bc7_interpolate(1, 254, w), bc7_interpolate(129, 128, w), bc7_interpolate(255, 254, w));
+				}
+
+				check(correct) << "Pixels are interpolated";
+			}
+
+			testing("Mode 1");
+
+			{
+				BitWriter writer;
+				writer.write(1 << 1, 2);
+
+				// Partition 0 splits the block into two columns of width 2:
+				writer.write(0, 6);
+
+				// Subset 0 is red, subset 1 is blue:
+				writer.write(63, 6); writer.write(63, 6); writer.write(0, 6); writer.write(0, 6);
+				writer.write(0, 6); writer.write(0, 6); writer.write(0, 6); writer.write(0, 6);
+				writer.write(0, 6); writer.write(0, 6); writer.write(63, 6); writer.write(63, 6);
+
+				// Shared p-bits:
+				writer.write(1, 1); writer.write(1, 1);
+
+				for (unsigned i = 0; i < 16; i += 1)
+					writer.write(0, (i == 0 || i == 15) ? 2 : 3);
+
+				check(writer.offset == 128) << "Block is complete";
+
+				decode_bc7_block(writer.data, rgba);
+
+				bool correct = true;
+				for (unsigned i = 0; i < 16; i += 1) {
+					if ((i % 4) < 2)
+						correct = correct && check_pixel(rgba + i * 4, 255, 2, 2, 255);
+					else
+						correct = correct && check_pixel(rgba + i * 4, 2, 2, 255, 255);
+				}
+
+				check(correct) << "Pixels are assigned to subsets";
+			}
+
+			testing("Reserved mode");
+
+			ByteT reserved[16] = {0};
+			decode_bc7_block(reserved, rgba);
+			check(check_pixel(rgba, 0, 0, 0, 0)) << "Reserved mode is transparent black";
+		}
+
+		UNIT_TEST(BlockCompressionSurface)
+		{
+			testing("Partial blocks");
+
+			check(block_compressed_length(BlockFormat::BC1, 1, 1) == 8) << "Single pixel uses a full block";
+			check(block_compressed_length(BlockFormat::BC7, 6, 5) == 64) << "Partial blocks are padded";
+
+			// Four identical red BC1 blocks:
+			ByteT data[32];
+			const ByteT red[8] = {0x00, 0xF8, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00};
+			for (std::size_t i = 0; i < 4; i += 1)
+				memcpy(data + i * 8, red, 8);
+
+			Ref<Image> image = decode_blocks(BlockFormat::BC1, data, 6, 5);
+
+			check(image->size() == PixelCoordinateT(6, 5, 1)) << "Image has correct size";
+			check(check_pixel(image->pixel_data() + (4 * 6 + 5) * 4, 255, 0, 0, 255)) << "Last pixel is decoded";
+
+			testing("Surface length");
+
+			check(block_compressed_length(BlockFormat::BC1, 6, 5) == 4 * 8) << "Partial blocks are padded";
+			check(block_compressed_length(BlockFormat::BC7, 1, 1) == 16) << "Smallest surface is one block";
+			check(block_compressed_length(BlockFormat::BC7, MAXIMUM_BLOCK_COMPRESSED_DIMENSION, MAXIMUM_BLOCK_COMPRESSED_DIMENSION) != 0) << "Largest surface has a length";
+			check(block_compressed_length(BlockFormat::BC7, MAXIMUM_BLOCK_COMPRESSED_DIMENSION + 1, 4) == 0) << "Oversized surface is rejected";
+			check(block_compressed_length(BlockFormat::BC1, std::numeric_limits<std::size_t>::max(), std::numeric_limits<std::size_t>::max()) == 0) << "Length doesn't wrap around";
+		}
+#endif
+	}
+}
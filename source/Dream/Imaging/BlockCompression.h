@@ -0,0 +1,56 @@
+//
+//  Imaging/BlockCompression.h
+//  This file is part of the "Dream" project, and is released under the MIT license.
+//
+//  Created by agent on 18/10/26.
+//  Copyright (c) 2026 agent. All rights reserved.
+//
+//
+
+#ifndef _DREAM_IMAGING_BLOCKCOMPRESSION_H
+#define _DREAM_IMAGING_BLOCKCOMPRESSION_H
+
+#include "Image.h"
+
+namespace Dream {
+	namespace Imaging {
+		/// Block compressed pixel formats. Every format encodes a 4x4 block of pixels into a fixed number of bytes, given by the low byte.
+		enum class BlockFormat : unsigned {
+			/// RGB with optional 1-bit alpha (DXT1).
+			BC1 = 0x0108,
+			/// RGBA with interpolated alpha (DXT5).
+			BC3 = 0x0310,
+			/// Single channel (ATI1, RGTC1).
+			BC4 = 0x0408,
+			/// Two channels (ATI2, RGTC2).
+			BC5 = 0x0510,
+			/// High quality RGBA (BPTC).
+			BC7 = 0x0710,
+		};
+
+		/// The width and height of a compressed block in pixels.
+		const std::size_t BLOCK_DIMENSION = 4;
+
+		/// The largest width or height of a compressed surface. This is well beyond what graphics hardware supports, but small enough that the length of a surface can't overflow.
+		const std::size_t MAXIMUM_BLOCK_COMPRESSED_DIMENSION = 1 << 16;
+
+		std::size_t block_format_byte_size(BlockFormat format);
+
+		/// The number of bytes required to store a surface of the given size. Partial blocks at the edges are padded to a full block. Returns 0 if either dimension is larger than MAXIMUM_BLOCK_COMPRESSED_DIMENSION or the length can't be represented.
+		std::size_t block_compressed_length(BlockFormat format, std::size_t width, std::size_t height);
+
+		/// Decode a single block into 16 RGBA pixels (64 bytes) in row-major order.
+		void decode_block(BlockFormat format, const ByteT * block, ByteT * rgba);
+
+		void decode_bc1_block(const ByteT * block, ByteT * rgba);
+		void decode_bc3_block(const ByteT * block, ByteT * rgba);
+		void decode_bc4_block(const ByteT * block, ByteT * rgba);
+		void decode_bc5_block(const ByteT * block, ByteT * rgba);
+		void decode_bc7_block(const ByteT * block, ByteT * rgba);
+
+		/// Decode a complete surface into an RGBA byte image. The data must be at least block_compressed_length() bytes.
+		Ref<Image> decode_blocks(BlockFormat format, const ByteT * data, std::size_t width, std::size_t height);
+	}
+}
+
+#endif
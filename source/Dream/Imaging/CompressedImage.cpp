@@ -0,0 +1,77 @@
+//
+//  Imaging/CompressedImage.cpp
+//  This file is part of the "Dream" project, and is released under the MIT license.
+//
+//  Created by agent on 18/10/26.
+//  Copyright (c) 2026 agent. All rights reserved.
+//
+//
+
+#include "CompressedImage.h"
+
+namespace Dream {
+	namespace Imaging {
+		void CompressedImage::Loader::register_loader_types (ILoader * loader)
+		{
+			loader->set_loader_for_extension(this, "dds");
+			loader->set_loader_for_extension(this, "ktx");
+		}
+
+		Ref<Object> CompressedImage::Loader::load_from_data(const Ptr<IData> data, const ILoader * loader)
+		{
+			return CompressedImage::load_from_data(data);
+		}
+
+		CompressedImage::CompressedImage (BlockFormat format, const PixelCoordinateT & size, bool srgb) : _format(format), _size(size), _srgb(srgb)
+		{
+		}
+
+		CompressedImage::~CompressedImage ()
+		{
+		}
+
+		std::size_t CompressedImage::maximum_level_count (const PixelCoordinateT & size)
+		{
+			std::size_t largest = std::max(size[WIDTH], size[HEIGHT]), count = 1;
+
+			while (largest > 1) {
+				largest >>= 1;
+				count += 1;
+			}
+
+			return count;
+		}
+
+		PixelCoordinateT CompressedImage::level_size (std::size_t level) const
+		{
+			PixelCoordinateT size = _size;
+
+			// Shifting by the width of the type or more is undefined, and every dimension is 1 by then anyway:
+			for (std::size_t i = 0; i < 3; i += 1)
+				size[i] = (level < 32) ? std::max<std::size_t>(1, size[i] >> level) : 1;
+
+			return size;
+		}
+
+		Ref<IData> CompressedImage::level_data (std::size_t level) const
+		{
+			return _levels.at(level);
+		}
+
+		void CompressedImage::add_level (Ptr<IData> data)
+		{
+			PixelCoordinateT size = level_size(_levels.size());
+
+			DREAM_ASSERT(data->size() >= block_compressed_length(_format, size[WIDTH], size[HEIGHT]));
+
+			_levels.push_back(data);
+		}
+
+		Ref<Image> CompressedImage::decode (std::size_t level) const
+		{
+			PixelCoordinateT size = level_size(level);
+
+			return decode_blocks(_format, level_data(level)->buffer()->begin(), size[WIDTH], size[HEIGHT]);
+		}
+	}
+}
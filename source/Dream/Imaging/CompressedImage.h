@@ -0,0 +1,74 @@
+//
+//  Imaging/CompressedImage.h
+//  This file is part of the "Dream" project, and is released under the MIT license.
+//
+//  Created by agent on 18/10/26.
+//  Copyright (c) 2026 agent. All rights reserved.
+//
+//
+
+#ifndef _DREAM_IMAGING_COMPRESSEDIMAGE_H
+#define _DREAM_IMAGING_COMPRESSEDIMAGE_H
+
+#include "Image.h"
+#include "BlockCompression.h"
+
+#include <vector>
+
+namespace Dream {
+	namespace Imaging {
+		/**
+		 A block compressed image with an optional chain of mip levels, typically loaded from a DDS or KTX container.
+
+		 Each level refers directly to a range of the original data, so loading a compressed image does not copy any pixel data. When the data comes from a LocalFileData, the levels are slices of the memory mapped file and can be handed straight to the GPU.
+		 */
+		class CompressedImage : public Object {
+		public:
+			class Loader : public Object, implements ILoadable {
+			public:
+				virtual void register_loader_types (ILoader * loader);
+				virtual Ref<Object> load_from_data (const Ptr<IData> data, const ILoader * loader);
+			};
+
+		protected:
+			BlockFormat _format;
+			PixelCoordinateT _size;
+			bool _srgb;
+
+			std::vector<Ref<IData>> _levels;
+
+		public:
+			/// If srgb is true, the blocks decode to colours in the sRGB colour space, which must be converted to linear when sampled.
+			CompressedImage (BlockFormat format, const PixelCoordinateT & size, bool srgb = false);
+			virtual ~CompressedImage ();
+
+			BlockFormat block_format () const { return _format; }
+			bool srgb () const { return _srgb; }
+
+			/// The number of levels in a complete mip chain for the given size, down to 1x1.
+			static std::size_t maximum_level_count (const PixelCoordinateT & size);
+
+			/// The size of the top level.
+			const PixelCoordinateT & size () const { return _size; }
+
+			std::size_t level_count () const { return _levels.size(); }
+
+			/// The size of the given mip level, each level is half the size of the previous one.
+			PixelCoordinateT level_size (std::size_t level) const;
+
+			/// The compressed data for the given mip level.
+			Ref<IData> level_data (std::size_t level) const;
+
+			/// Append the next mip level. The data must be at least block_compressed_length() bytes for the level size.
+			void add_level (Ptr<IData> data);
+
+			/// Decode the given level into an RGBA image on the CPU.
+			Ref<Image> decode (std::size_t level = 0) const;
+
+			/// Load a DDS or KTX container. Returns NULL if the container or its format is not supported.
+			static Ref<CompressedImage> load_from_data (const Ptr<IData> data);
+		};
+	}
+}
+
+#endif
@@ -0,0 +1,505 @@
+//
+//  Imaging/CompressedImageLoader.cpp
+//  This file is part of the "Dream" project, and is released under the MIT license.
+//
+//  Created by agent on 18/10/26.
+//  Copyright (c) 2026 agent. All rights reserved.
+//
+//
+
+#include "CompressedImage.h"
+#include "../Core/Data.h"
+#include "../Events/Logger.h"
+
+#include <cstring>
+
+namespace Dream {
+	namespace Imaging {
+		using namespace Events::Logging;
+
+		/// Whether the dimensions from an image header are small enough to be loaded.
+		static bool valid_dimensions (uint32_t width, uint32_t height)
+		{
+			return width > 0 && width <= MAXIMUM_BLOCK_COMPRESSED_DIMENSION && height <= MAXIMUM_BLOCK_COMPRESSED_DIMENSION;
+		}
+
+		/// Appends the next level of the image as a slice of the original data. Returns the length of the level, or 0 if the data is truncated.
+		static std::size_t add_next_level (Ref<CompressedImage> image, const Ptr<IData> data, std::size_t offset)
+		{
+			PixelCoordinateT size = image->level_size(image->level_count());
+			std::size_t length = block_compressed_length(image->block_format(), size[WIDTH], size[HEIGHT]), available = data->buffer()->size();
+
+			if (length == 0) {
+				logger()->log(LOG_WARN, LogBuffer() << "Compressed image level " << image->level_count() << " has an invalid size");
+				return 0;
+			}
+
+			if (offset > available || length > available - offset) {
+				logger()->log(LOG_WARN, LogBuffer() << "Compressed image truncated at level " << image->level_count());
+				return 0;
+			}
+
+			image->add_level(new SliceData(data, offset, length));
+
+			return length;
+		}
+
+// MARK: -
+// MARK: DDS Loader Code
+
+		enum DDSConstants {
+			DDS_HEADER_SIZE = 128,
+			DDS_HEADER_DX10_SIZE = 20,
+
+			DDSD_MIPMAPCOUNT = 0x20000,
+			DDPF_FOURCC = 0x4,
+		};
+
+		static uint32_t dds_four_cc (const char * code)
+		{
+			return code[0] | (code[1] << 8) | (code[2] << 16) | (code[3] << 24);
+		}
+
+		static bool dds_block_format (uint32_t four_cc, BlockFormat & format)
+		{
+			if (four_cc == dds_four_cc("DXT1"))
+				format = BlockFormat::BC1;
+			else if (four_cc == dds_four_cc("DXT5"))
+				format = BlockFormat::BC3;
+			else if (four_cc == dds_four_cc("ATI1") || four_cc == dds_four_cc("BC4U"))
+				format = BlockFormat::BC4;
+			else if (four_cc == dds_four_cc("ATI2") || four_cc == dds_four_cc("BC5U"))
+				format = BlockFormat::BC5;
+			else
+				return false;
+
+			return true;
+		}
+
+		static bool dxgi_block_format (uint32_t dxgi_format, BlockFormat & format, bool & srgb)
+		{
+			srgb = (dxgi_format == 72 || dxgi_format == 78 || dxgi_format == 99);
+
+			switch (dxgi_format) {
+				case 71: // DXGI_FORMAT_BC1_UNORM
+				case 72: // DXGI_FORMAT_BC1_UNORM_SRGB
+					format = BlockFormat::BC1;
+					return true;
+				case 77: // DXGI_FORMAT_BC3_UNORM
+				case 78: // DXGI_FORMAT_BC3_UNORM_SRGB
+					format = BlockFormat::BC3;
+					return true;
+				case 80: // DXGI_FORMAT_BC4_UNORM
+					format = BlockFormat::BC4;
+					return true;
+				case 83: // DXGI_FORMAT_BC5_UNORM
+					format = BlockFormat::BC5;
+					return true;
+				case 98: // DXGI_FORMAT_BC7_UNORM
+				case 99: // DXGI_FORMAT_BC7_UNORM_SRGB
+					format = BlockFormat::BC7;
+					return true;
+				default:
+					return false;
+			}
+		}
+
+		static Ref<CompressedImage> load_dds_image (const Ptr<IData> data)
+		{
+			Shared<Buffer> buffer = data->buffer();
+
+			if (buffer->size() < DDS_HEADER_SIZE) {
+				logger()->log(LOG_ERROR, "Could not load DDS image: Header is truncated.");
+				return NULL;
+			}
+
+			uint32_t flags, height, width, mip_map_count, pixel_flags, four_cc;
+
+			buffer->read(8, flags, library_endian());
+			buffer->read(12, height, library_endian());
+			buffer->read(16, width, library_endian());
+			buffer->read(28, mip_map_count, library_endian());
+			buffer->read(80, pixel_flags, library_endian());
+			buffer->read(84, four_cc, library_endian());
+
+			if (!(flags & DDSD_MIPMAPCOUNT) || mip_map_count == 0)
+				mip_map_count = 1;
+
+			if (height == 0 || !valid_dimensions(width, height)) {
+				logger()->log(LOG_ERROR, "Could not load DDS image: Invalid dimensions.");
+				return NULL;
+			}
+
+			if (mip_map_count > CompressedImage::maximum_level_count(PixelCoordinateT(width, height, 1))) {
+				logger()->log(LOG_ERROR, LogBuffer() << "Could not load DDS image: " << mip_map_count << " mip levels is more than the image size allows.");
+				return NULL;
+			}
+
+			BlockFormat format;
+			bool srgb = false;
+			std::size_t offset = DDS_HEADER_SIZE;
+
+			if (!(pixel_flags & DDPF_FOURCC)) {
+				logger()->log(LOG_ERROR, "Could not load DDS image: Uncompressed formats are not supported.");
+				return NULL;
+			}
+
+			if (four_cc == dds_four_cc("DX10")) {
+				uint32_t dxgi_format = 0;
+
+				if (buffer->size() < DDS_HEADER_SIZE + DDS_HEADER_DX10_SIZE) {
+					logger()->log(LOG_ERROR, "Could not load DDS image: Extended header is truncated.");
+					return NULL;
+				}
+
+				buffer->read(DDS_HEADER_SIZE, dxgi_format, library_endian());
+
+				if (!dxgi_block_format(dxgi_format, format, srgb)) {
+					logger()->log(LOG_ERROR, LogBuffer() << "Could not load DDS image: Unsupported DXGI format " << dxgi_format);
+					return NULL;
+				}
+
+				offset += DDS_HEADER_DX10_SIZE;
+			} else if (!dds_block_format(four_cc, format)) {
+				logger()->log(LOG_ERROR, "Could not load DDS image: Unsupported compression format.");
+				return NULL;
+			}
+
+			Ref<CompressedImage> image = new CompressedImage(format, PixelCoordinateT(width, height, 1), srgb);
+
+			for (std::size_t level = 0; level < mip_map_count; level += 1) {
+				std::size_t length = add_next_level(image, data, offset);
+
+				if (length == 0) break;
+
+				offset += length;
+			}
+
+			if (image->level_count() == 0)
+				return NULL;
+
+			return image;
+		}
+
+// MARK: -
+// MARK: KTX Loader Code
+
+		enum KTXConstants {
+			KTX_HEADER_SIZE = 64,
+			KTX_ENDIANNESS = 0x04030201,
+			KTX_ENDIANNESS_SWAPPED = 0x01020304,
+
+			KTX_COMPRESSED_RGB_S3TC_DXT1 = 0x83F0,
+			KTX_COMPRESSED_RGBA_S3TC_DXT1 = 0x83F1,
+			KTX_COMPRESSED_RGBA_S3TC_DXT5 = 0x83F3,
+			KTX_COMPRESSED_SRGB_S3TC_DXT1 = 0x8C4C,
+			KTX_COMPRESSED_SRGB_ALPHA_S3TC_DXT1 = 0x8C4D,
+			KTX_COMPRESSED_SRGB_ALPHA_S3TC_DXT5 = 0x8C4F,
+			KTX_COMPRESSED_RED_RGTC1 = 0x8DBB,
+			KTX_COMPRESSED_RG_RGTC2 = 0x8DBD,
+			KTX_COMPRESSED_RGBA_BPTC_UNORM = 0x8E8C,
+			KTX_COMPRESSED_SRGB_ALPHA_BPTC_UNORM = 0x8E8D,
+		};
+
+		static const ByteT KTX_IDENTIFIER[12] = {0xAB, 0x4B, 0x54, 0x58, 0x20, 0x31, 0x31, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A};
+
+		static bool ktx_block_format (uint32_t internal_format, BlockFormat & format, bool & srgb)
+		{
+			srgb = (internal_format == KTX_COMPRESSED_SRGB_S3TC_DXT1 || internal_format == KTX_COMPRESSED_SRGB_ALPHA_S3TC_DXT1 || internal_format == KTX_COMPRESSED_SRGB_ALPHA_S3TC_DXT5 || internal_format == KTX_COMPRESSED_SRGB_ALPHA_BPTC_UNORM);
+
+			switch (internal_format) {
+				case KTX_COMPRESSED_RGB_S3TC_DXT1:
+				case KTX_COMPRESSED_RGBA_S3TC_DXT1:
+				case KTX_COMPRESSED_SRGB_S3TC_DXT1:
+				case KTX_COMPRESSED_SRGB_ALPHA_S3TC_DXT1:
+					format = BlockFormat::BC1;
+					return true;
+				case KTX_COMPRESSED_RGBA_S3TC_DXT5:
+				case KTX_COMPRESSED_SRGB_ALPHA_S3TC_DXT5:
+					format = BlockFormat::BC3;
+					return true;
+				case KTX_COMPRESSED_RED_RGTC1:
+					format = BlockFormat::BC4;
+					return true;
+				case KTX_COMPRESSED_RG_RGTC2:
+					format = BlockFormat::BC5;
+					return true;
+				case KTX_COMPRESSED_RGBA_BPTC_UNORM:
+				case KTX_COMPRESSED_SRGB_ALPHA_BPTC_UNORM:
+					format = BlockFormat::BC7;
+					return true;
+				default:
+					return false;
+			}
+		}
+
+		static Ref<CompressedImage> load_ktx_image (const Ptr<IData> data)
+		{
+			Shared<Buffer> buffer = data->buffer();
+
+			if (buffer->size() < KTX_HEADER_SIZE || memcmp(buffer->begin(), KTX_IDENTIFIER, sizeof(KTX_IDENTIFIER)) != 0) {
+				logger()->log(LOG_ERROR, "Could not load KTX image: Invalid header.");
+				return NULL;
+			}
+
+			uint32_t endianness;
+			buffer->read(12, endianness);
+
+			if (endianness != KTX_ENDIANNESS && endianness != KTX_ENDIANNESS_SWAPPED) {
+				logger()->log(LOG_ERROR, "Could not load KTX image: Invalid endianness.");
+				return NULL;
+			}
+
+			// The file is written in the byte order of the machine that created it:
+			Endian file_endian = (endianness == KTX_ENDIANNESS) ? host_endian() : (host_endian() == LITTLE ? BIG : LITTLE);
+
+			uint32_t internal_format, width, height, array_elements, faces, level_count, key_value_bytes;
+
+			buffer->read(28, internal_format, file_endian);
+			buffer->read(36, width, file_endian);
+			buffer->read(40, height, file_endian);
+			buffer->read(48, array_elements, file_endian);
+			buffer->read(52, faces, file_endian);
+			buffer->read(56, level_count, file_endian);
+			buffer->read(60, key_value_bytes, file_endian);
+
+			BlockFormat format;
+			bool srgb;
+
+			if (!ktx_block_format(internal_format, format, srgb)) {
+				logger()->log(LOG_ERROR, LogBuffer() << "Could not load KTX image: Unsupported internal format " << internal_format);
+				return NULL;
+			}
+
+			if (faces != 1) {
+				logger()->log(LOG_ERROR, "Could not load KTX image: Cube maps are not supported.");
+				return NULL;
+			}
+
+			if (array_elements != 0) {
+				logger()->log(LOG_ERROR, "Could not load KTX image: Texture arrays are not supported.");
+				return NULL;
+			}
+
+			if (!valid_dimensions(width, height)) {
+				logger()->log(LOG_ERROR, "Could not load KTX image: Invalid dimensions.");
+				return NULL;
+			}
+
+			PixelCoordinateT size(width, std::max<uint32_t>(height, 1), 1);
+
+			if (level_count == 0)
+				level_count = 1;
+
+			if (level_count > CompressedImage::maximum_level_count(size)) {
+				logger()->log(LOG_ERROR, LogBuffer() << "Could not load KTX image: " << level_count << " mip levels is more than the image size allows.");
+				return NULL;
+			}
+
+			Ref<CompressedImage> image = new CompressedImage(format, size, srgb);
+			std::size_t offset = KTX_HEADER_SIZE + key_value_bytes;
+
+			// Each level is prefixed by its size, and padded to a multiple of four bytes:
+			for (std::size_t level = 0; level < level_count; level += 1) {
+				uint32_t image_size;
+
+				if (offset > buffer->size() || sizeof(image_size) > buffer->size() - offset)
+					break;
+
+				buffer->read(offset, image_size, file_endian);
+				offset += sizeof(image_size);
+
+				// The size is checked before it is rounded up, so that the padding can't wrap around:
+				if (image_size > buffer->size() - offset) {
+					logger()->log(LOG_WARN, LogBuffer() << "Compressed image truncated at level " << image->level_count());
+					break;
+				}
+
+				if (add_next_level(image, data, offset) == 0)
+					break;
+
+				offset += (std::size_t(image_size) + 3) & ~std::size_t(3);
+			}
+
+			if (image->level_count() == 0)
+				return NULL;
+
+			return image;
+		}
+
+// MARK: -
+// MARK: Loader Multiplexer
+
+		Ref<CompressedImage> CompressedImage::load_from_data (const Ptr<IData> data)
+		{
+			switch (data->buffer()->mimetype()) {
+				case IMAGE_DDS:
+					return load_dds_image(data);
+				case IMAGE_KTX:
+					return load_ktx_image(data);
+				default:
+					logger()->log(LOG_ERROR, "Could not load compressed image: Unsupported container format.");
+					return NULL;
+			}
+		}
+
+// MARK: -
+// MARK: Unit Tests
+
+#ifdef ENABLE_TESTING
+		static void write_little (Shared<DynamicBuffer> buffer, std::size_t offset, uint32_t value)
+		{
+			for (std::size_t i = 0; i < 4; i += 1)
+				buffer->begin()[offset + i] = (value >> (i * 8)) & 0xFF;
+		}
+
+		UNIT_TEST(CompressedImageDDS)
+		{
+			testing("Loading mip levels");
+
+			Shared<DynamicBuffer> buffer = new DynamicBuffer(128 + 56);
+			memset(buffer->begin(), 0, buffer->size());
+
+			memcpy(buffer->begin(), "DDS ", 4);
+			write_little(buffer, 4, 124);
+			write_little(buffer, 8, DDSD_MIPMAPCOUNT);
+			write_little(buffer, 12, 8);
+			write_little(buffer, 16, 8);
+			write_little(buffer, 28, 4);
+			write_little(buffer, 80, DDPF_FOURCC);
+			write_little(buffer, 84, dds_four_cc("DXT1"));
+
+			// 8x8, 4x4, 2x2 and 1x1 levels, all red:
+			for (std::size_t offset = 128; offset < buffer->size(); offset += 8)
+				write_little(buffer, offset, 0xF800);
+
+			Ref<IData> data = new BufferedData(buffer);
+			Ref<CompressedImage> image = CompressedImage::load_from_data(data);
+
+			check(image) << "Image was loaded";
+			check(image->block_format() == BlockFormat::BC1) << "Block format is correct";
+			check(image->level_count() == 4) << "All mip levels were loaded";
+			check(image->level_size(3) == PixelCoordinateT(1, 1, 1)) << "Smallest level is one pixel";
+			check(image->level_data(0)->size() == 32) << "Top level contains four blocks";
+			check(image->level_data(1)->buffer()->begin() == buffer->begin() + 128 + 32) << "Mip level refers to original data";
+
+			Ref<Image> decoded = image->decode(1);
+			check(decoded->size() == PixelCoordinateT(4, 4, 1)) << "Decoded level has correct size";
+			check(decoded->pixel_data()[0] == 255 && decoded->pixel_data()[1] == 0) << "Decoded level is red";
+
+			testing("Truncated data");
+
+			Shared<StaticBuffer> truncated = new StaticBuffer(buffer->begin(), 128 + 36);
+			Ref<IData> truncated_data = new BufferedData(truncated);
+			image = CompressedImage::load_from_data(truncated_data);
+
+			check(image->level_count() == 1) << "Only complete levels were loaded";
+
+			testing("Malformed headers");
+
+			write_little(buffer, 28, 40);
+			check(!CompressedImage::load_from_data(data)) << "More mip levels than the size allows is rejected";
+
+			write_little(buffer, 28, 4);
+			write_little(buffer, 16, 0);
+			check(!CompressedImage::load_from_data(data)) << "Empty image is rejected";
+
+			write_little(buffer, 16, 0x80000000);
+			write_little(buffer, 12, 0x80000000);
+			write_little(buffer, 28, 1);
+			check(!CompressedImage::load_from_data(data)) << "Oversized image is rejected";
+
+			write_little(buffer, 12, 8);
+			write_little(buffer, 16, 8);
+			write_little(buffer, 28, 4);
+
+			testing("Colour space");
+
+			Shared<DynamicBuffer> extended = new DynamicBuffer(128 + 20 + 32);
+			memset(extended->begin(), 0, extended->size());
+			memcpy(extended->begin(), buffer->begin(), 128);
+
+			write_little(extended, 16, 8);
+			write_little(extended, 28, 1);
+			write_little(extended, 84, dds_four_cc("DX10"));
+			write_little(extended, 128, 72);
+
+			Ref<IData> extended_data = new BufferedData(extended);
+			image = CompressedImage::load_from_data(extended_data);
+			check(image && image->srgb() && image->block_format() == BlockFormat::BC1) << "sRGB format is preserved";
+
+			write_little(extended, 128, 71);
+			image = CompressedImage::load_from_data(extended_data);
+			check(image && !image->srgb()) << "Linear format is not sRGB";
+		}
+
+		UNIT_TEST(CompressedImageKTX)
+		{
+			testing("Loading mip levels");
+
+			// Header, 8 bytes of key/value data, then two levels each with a size prefix:
+			Shared<DynamicBuffer> buffer = new DynamicBuffer(64 + 8 + 12 + 12);
+			memset(buffer->begin(), 0, buffer->size());
+
+			memcpy(buffer->begin(), KTX_IDENTIFIER, sizeof(KTX_IDENTIFIER));
+			write_little(buffer, 12, KTX_ENDIANNESS);
+			write_little(buffer, 28, KTX_COMPRESSED_RED_RGTC1);
+			write_little(buffer, 36, 4);
+			write_little(buffer, 40, 4);
+			write_little(buffer, 52, 1);
+			write_little(buffer, 56, 2);
+			write_little(buffer, 60, 8);
+
+			write_little(buffer, 72, 8);
+			buffer->begin()[76] = 100;
+			buffer->begin()[77] = 100;
+			write_little(buffer, 84, 8);
+			buffer->begin()[88] = 200;
+			buffer->begin()[89] = 200;
+
+			check(buffer->mimetype() == IMAGE_KTX) << "Mimetype is detected";
+
+			Ref<IData> data = new BufferedData(buffer);
+			Ref<CompressedImage> image = CompressedImage::load_from_data(data);
+
+			check(image) << "Image was loaded";
+			check(image->block_format() == BlockFormat::BC4) << "Block format is correct";
+			check(image->level_count() == 2) << "All mip levels were loaded";
+			check(image->level_data(1)->buffer()->begin() == buffer->begin() + 88) << "Mip level refers to original data";
+			check(image->decode(0)->pixel_data()[0] == 100) << "First level is decoded";
+			check(image->decode(1)->pixel_data()[0] == 200) << "Second level is decoded";
+			check(!image->srgb()) << "Linear format is not sRGB";
+
+			testing("Colour space");
+
+			write_little(buffer, 28, KTX_COMPRESSED_SRGB_ALPHA_S3TC_DXT1);
+			image = CompressedImage::load_from_data(data);
+			check(image && image->srgb() && image->block_format() == BlockFormat::BC1) << "sRGB format is preserved";
+
+			write_little(buffer, 28, KTX_COMPRESSED_RED_RGTC1);
+
+			testing("Malformed headers");
+
+			write_little(buffer, 56, 10);
+			check(!CompressedImage::load_from_data(data)) << "More mip levels than the size allows is rejected";
+			write_little(buffer, 56, 2);
+
+			write_little(buffer, 48, 3);
+			check(!CompressedImage::load_from_data(data)) << "Texture arrays are rejected";
+			write_little(buffer, 48, 0);
+
+			write_little(buffer, 36, 0x80000000);
+			check(!CompressedImage::load_from_data(data)) << "Oversized image is rejected";
+			write_little(buffer, 36, 4);
+
+			write_little(buffer, 84, 0xFFFFFFFF);
+			image = CompressedImage::load_from_data(data);
+			check(image && image->level_count() == 1) << "Level size which would wrap around when padded is rejected";
+			write_little(buffer, 84, 8);
+
+			write_little(buffer, 12, 0x12345678);
+			check(!CompressedImage::load_from_data(data)) << "Invalid endianness is rejected";
+		}
+#endif
+	}
+}
@@ -8,6 +8,7 @@
 //
 
 #include "Image.h"
+#include "CompressedImage.h"
 #include "../Core/Data.h"
 #include "../Core/Timer.h"
 #include "../Events/Logger.h"
@@ -284,8 +285,16 @@ namespace Dream {
 			case IMAGE_PNG:
 				loaded_image = load_png_image(data);
 				break;
-			//case Data::IMAGE_DDS:
-			//	loaded_image = load_ddsimage(data);
+			case IMAGE_DDS:
+			case IMAGE_KTX: {
+				// Compressed images are decoded, use CompressedImage directly to keep the data compressed:
+				Ref<CompressedImage> compressed_image = CompressedImage::load_from_data(data);
+
+				if (compressed_image)
+					loaded_image = compressed_image->decode();
+
+				break;
+			}
 			default:
 				logger()->log(LOG_ERROR, "Could not load image: Unsupported image format.");
 			}
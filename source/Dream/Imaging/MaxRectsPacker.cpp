@@ -0,0 +1,247 @@
+//
+//  Imaging/MaxRectsPacker.cpp
+//  This file is part of the "Dream" project, and is released under the MIT license.
+//
+//  Created by agent on 18/10/26.
+//  Copyright (c) 2026 agent. All rights reserved.
+//
+//
+
+#include "MaxRectsPacker.h"
+
+#include <algorithm>
+#include <limits>
+
+namespace Dream {
+	namespace Imaging {
+		bool MaxRectsPacker::Rectangle::contains (const Rectangle & other) const
+		{
+			return x <= other.x && y <= other.y && x + width >= other.x + other.width && y + height >= other.y + other.height;
+		}
+
+		bool MaxRectsPacker::Rectangle::intersects (const Rectangle & other) const
+		{
+			return x < other.x + other.width && other.x < x + width && y < other.y + other.height && other.y < y + height;
+		}
+
+		MaxRectsPacker::MaxRectsPacker (const Vec2u & size) : _size(size)
+		{
+			reset();
+		}
+
+		void MaxRectsPacker::reset ()
+		{
+			_free.clear();
+			_free.push_back(Rectangle{0, 0, _size[X], _size[Y]});
+
+			_used_area = 0;
+		}
+
+		void MaxRectsPacker::split (const Rectangle & allocated)
+		{
+			std::size_t count = _free.size();
+
+			for (std::size_t i = 0; i < count;) {
+				Rectangle free = _free[i];
+
+				if (!free.intersects(allocated)) {
+					i += 1;
+					continue;
+				}
+
+				_free.erase(_free.begin() + i);
+				count -= 1;
+
+				// The parts of the free rectangle to the left, right, below and above the allocation:
+				if (allocated.x > free.x)
+					_free.push_back(Rectangle{free.x, free.y, allocated.x - free.x, free.height});
+
+				if (allocated.x + allocated.width < free.x + free.width)
+					_free.push_back(Rectangle{allocated.x + allocated.width, free.y, free.x + free.width - (allocated.x + allocated.width), free.height});
+
+				if (allocated.y > free.y)
+					_free.push_back(Rectangle{free.x, free.y, free.width, allocated.y - free.y});
+
+				if (allocated.y + allocated.height < free.y + free.height)
+					_free.push_back(Rectangle{free.x, allocated.y + allocated.height, free.width, free.y + free.height - (allocated.y + allocated.height)});
+			}
+		}
+
+		void MaxRectsPacker::prune ()
+		{
+			bool merged = true;
+
+			while (merged) {
+				merged = false;
+
+				for (std::size_t i = 0; i < _free.size() && !merged; i += 1) {
+					for (std::size_t j = i + 1; j < _free.size(); j += 1) {
+						Rectangle & a = _free[i], & b = _free[j];
+
+						if (a.x == b.x && a.width == b.width && (a.y + a.height == b.y || b.y + b.height == a.y)) {
+							a.y = std::min(a.y, b.y);
+							a.height += b.height;
+						} else if (a.y == b.y && a.height == b.height && (a.x + a.width == b.x || b.x + b.width == a.x)) {
+							a.x = std::min(a.x, b.x);
+							a.width += b.width;
+						} else {
+							continue;
+						}
+
+						_free.erase(_free.begin() + j);
+						merged = true;
+
+						break;
+					}
+				}
+			}
+
+			for (std::size_t i = 0; i < _free.size(); i += 1) {
+				for (std::size_t j = i + 1; j < _free.size();) {
+					if (_free[i].contains(_free[j])) {
+						_free.erase(_free.begin() + j);
+					} else if (_free[j].contains(_free[i])) {
+						_free.erase(_free.begin() + i);
+						j = i + 1;
+					} else {
+						j += 1;
+					}
+				}
+			}
+		}
+
+		bool MaxRectsPacker::allocate (const Vec2u & size, Vec2u & origin)
+		{
+			if (size[X] == 0 || size[Y] == 0) {
+				origin = ZERO;
+				return true;
+			}
+
+			std::size_t best_index = _free.size();
+			std::size_t best_short = std::numeric_limits<std::size_t>::max(), best_long = std::numeric_limits<std::size_t>::max();
+
+			for (std::size_t i = 0; i < _free.size(); i += 1) {
+				const Rectangle & free = _free[i];
+
+				if (free.width < size[X] || free.height < size[Y])
+					continue;
+
+				// Prefer the free rectangle which leaves the smallest leftover on its shorter side:
+				std::size_t leftover_x = free.width - size[X], leftover_y = free.height - size[Y];
+				std::size_t leftover_short = std::min(leftover_x, leftover_y), leftover_long = std::max(leftover_x, leftover_y);
+
+				if (leftover_short < best_short || (leftover_short == best_short && leftover_long < best_long)) {
+					best_index = i;
+					best_short = leftover_short;
+					best_long = leftover_long;
+				}
+			}
+
+			if (best_index == _free.size())
+				return false;
+
+			Rectangle allocated = {_free[best_index].x, _free[best_index].y, size[X], size[Y]};
+
+			split(allocated);
+			prune();
+
+			origin[X] = allocated.x;
+			origin[Y] = allocated.y;
+
+			_used_area += size[X] * size[Y];
+
+			return true;
+		}
+
+		void MaxRectsPacker::release (const Vec2u & origin, const Vec2u & size)
+		{
+			if (size[X] == 0 || size[Y] == 0)
+				return;
+
+			DREAM_ASSERT(origin[X] + size[X] <= _size[X] && origin[Y] + size[Y] <= _size[Y]);
+
+			_free.push_back(Rectangle{origin[X], origin[Y], size[X], size[Y]});
+			prune();
+
+			_used_area -= size[X] * size[Y];
+		}
+
+// MARK: -
+// MARK: Unit Tests
+
+#ifdef ENABLE_TESTING
+		UNIT_TEST(MaxRectsPacker)
+		{
+			testing("Allocation");
+
+			MaxRectsPacker packer(Vec2u(64, 64));
+			std::vector<Vec2u> origins, sizes;
+
+			// Pack a sequence of varying rectangles until the area is full:
+			for (std::size_t i = 0; ; i += 1) {
+				Vec2u size(3 + (i * 7) % 11, 2 + (i * 5) % 9), origin;
+
+				if (!packer.allocate(size, origin))
+					break;
+
+				origins.push_back(origin);
+				sizes.push_back(size);
+			}
+
+			check(origins.size() > 20) << "Many rectangles were allocated";
+
+			bool inside = true, overlapping = false;
+
+			for (std::size_t i = 0; i < origins.size(); i += 1) {
+				inside = inside && (origins[i][X] + sizes[i][X] <= 64) && (origins[i][Y] + sizes[i][Y] <= 64);
+
+				for (std::size_t j = i + 1; j < origins.size(); j += 1) {
+					bool separate_x = origins[i][X] + sizes[i][X] <= origins[j][X] || origins[j][X] + sizes[j][X] <= origins[i][X];
+					bool separate_y = origins[i][Y] + sizes[i][Y] <= origins[j][Y] || origins[j][Y] + sizes[j][Y] <= origins[i][Y];
+
+					overlapping = overlapping || !(separate_x || separate_y);
+				}
+			}
+
+			check(inside) << "All rectangles are inside the area";
+			check(!overlapping) << "No rectangles overlap";
+			check(packer.occupancy() > 0.7) << "Rectangles are packed densely";
+
+			testing("Release");
+
+			std::size_t area = packer.used_area();
+
+			for (std::size_t i = 0; i < origins.size(); i += 2) {
+				packer.release(origins[i], sizes[i]);
+				area -= sizes[i][X] * sizes[i][Y];
+			}
+
+			check(packer.used_area() == area) << "Used area is tracked";
+
+			bool reallocated = true;
+			for (std::size_t i = 0; i < origins.size(); i += 2) {
+				Vec2u origin;
+				reallocated = reallocated && packer.allocate(sizes[i], origin);
+			}
+
+			check(reallocated) << "Released space can be allocated again";
+
+			testing("Merging");
+
+			packer.reset();
+
+			Vec2u quadrants[4], origin;
+			for (std::size_t i = 0; i < 4; i += 1)
+				packer.allocate(Vec2u(32, 32), quadrants[i]);
+
+			check(!packer.allocate(Vec2u(1, 1), origin)) << "The area is full";
+
+			for (std::size_t i = 0; i < 4; i += 1)
+				packer.release(quadrants[i], Vec2u(32, 32));
+
+			check(packer.free_rectangles() == 1) << "Adjacent free rectangles are merged";
+			check(packer.allocate(Vec2u(64, 64), origin) && origin == Vec2u(0, 0)) << "Full area is available after releasing everything";
+		}
+#endif
+	}
+}
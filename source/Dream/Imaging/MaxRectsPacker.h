@@ -0,0 +1,72 @@
+//
+//  Imaging/MaxRectsPacker.h
+//  This file is part of the "Dream" project, and is released under the MIT license.
+//
+//  Created by agent on 18/10/26.
+//  Copyright (c) 2026 agent. All rights reserved.
+//
+//
+
+#ifndef _DREAM_IMAGING_MAXRECTSPACKER_H
+#define _DREAM_IMAGING_MAXRECTSPACKER_H
+
+#include "../Framework.h"
+
+#include <Euclid/Numerics/Vector.h>
+#include <vector>
+
+namespace Dream {
+	namespace Imaging {
+		using namespace Euclid::Numerics;
+
+		/**
+		 Packs rectangles into a fixed size area using the maximal rectangles best short side fit heuristic.
+
+		 The free space is tracked as a list of possibly overlapping rectangles, each of which is as large as possible. This packs more densely than a skyline, and unlike a skyline, individual rectangles can be released. Released space is merged with adjacent free rectangles where they line up exactly, so after many releases the free space may be fragmented, and repacking is required to recover it.
+		 */
+		class MaxRectsPacker {
+		protected:
+			struct Rectangle {
+				std::size_t x, y, width, height;
+
+				bool contains (const Rectangle & other) const;
+				bool intersects (const Rectangle & other) const;
+			};
+
+			Vec2u _size;
+			std::vector<Rectangle> _free;
+			std::size_t _used_area;
+
+			/// Removes the allocated rectangle from the free list, replacing each free rectangle it intersects with the maximal rectangles which remain.
+			void split (const Rectangle & allocated);
+
+			/// Merges free rectangles which share a whole edge, then removes those contained by another.
+			void prune ();
+
+		public:
+			MaxRectsPacker (const Vec2u & size);
+
+			/// Discard all allocations.
+			void reset ();
+
+			/// Allocate a rectangle of the given size, returning its origin. Returns false if there is not enough space.
+			bool allocate (const Vec2u & size, Vec2u & origin);
+
+			/// Return a previously allocated rectangle to the free space.
+			void release (const Vec2u & origin, const Vec2u & size);
+
+			const Vec2u & size () const { return _size; }
+
+			/// The number of free rectangles, which grows as the free space becomes fragmented.
+			std::size_t free_rectangles () const { return _free.size(); }
+
+			/// The total area of all allocated rectangles.
+			std::size_t used_area () const { return _used_area; }
+
+			/// The fraction of the area which has been allocated, between 0 and 1.
+			RealT occupancy () const { return RealT(_used_area) / RealT(_size[X] * _size[Y]); }
+		};
+	}
+}
+
+#endif
@@ -0,0 +1,173 @@
+//
+//  Imaging/SkylinePacker.cpp
+//  This file is part of the "Dream" project, and is released under the MIT license.
+//
+//  Created by agent on 18/10/26.
+//  Copyright (c) 2026 agent. All rights reserved.
+//
+//
+
+#include "SkylinePacker.h"
+
+#include <algorithm>
+#include <limits>
+
+namespace Dream {
+	namespace Imaging {
+		SkylinePacker::SkylinePacker (const Vec2u & size) : _size(size)
+		{
+			reset();
+		}
+
+		void SkylinePacker::reset ()
+		{
+			_skyline.clear();
+			_skyline.push_back(Segment{0, 0, _size[X]});
+
+			_used_area = 0;
+		}
+
+		bool SkylinePacker::fits (std::size_t index, const Vec2u & size, std::size_t & y) const
+		{
+			std::size_t x = _skyline[index].x;
+
+			if (x + size[X] > _size[X])
+				return false;
+
+			y = _skyline[index].y;
+
+			// The rectangle rests on the highest segment it spans:
+			for (std::size_t covered = 0; covered < size[X]; index += 1) {
+				y = std::max(y, _skyline[index].y);
+
+				if (y + size[Y] > _size[Y])
+					return false;
+
+				covered += _skyline[index].width;
+			}
+
+			return true;
+		}
+
+		bool SkylinePacker::allocate (const Vec2u & size, Vec2u & origin)
+		{
+			if (size[X] == 0 || size[Y] == 0) {
+				origin = ZERO;
+				return true;
+			}
+
+			std::size_t best_index = _skyline.size(), best_top = std::numeric_limits<std::size_t>::max(), best_width = 0;
+
+			for (std::size_t i = 0; i < _skyline.size(); i += 1) {
+				std::size_t y;
+
+				if (fits(i, size, y)) {
+					// Prefer the lowest position, then the narrowest segment to reduce wasted space:
+					if (y + size[Y] < best_top || (y + size[Y] == best_top && _skyline[i].width < best_width)) {
+						best_index = i;
+						best_top = y + size[Y];
+						best_width = _skyline[i].width;
+					}
+				}
+			}
+
+			if (best_index == _skyline.size())
+				return false;
+
+			origin[X] = _skyline[best_index].x;
+			origin[Y] = best_top - size[Y];
+
+			// Insert the new segment and remove the parts of the skyline it covers:
+			_skyline.insert(_skyline.begin() + best_index, Segment{origin[X], best_top, size[X]});
+
+			std::size_t right = origin[X] + size[X];
+
+			for (std::size_t i = best_index + 1; i < _skyline.size();) {
+				Segment & segment = _skyline[i];
+
+				if (segment.x >= right)
+					break;
+
+				if (segment.x + segment.width <= right) {
+					_skyline.erase(_skyline.begin() + i);
+				} else {
+					segment.width -= right - segment.x;
+					segment.x = right;
+					break;
+				}
+			}
+
+			// Merge adjacent segments at the same height:
+			for (std::size_t i = 0; i + 1 < _skyline.size();) {
+				if (_skyline[i].y == _skyline[i+1].y) {
+					_skyline[i].width += _skyline[i+1].width;
+					_skyline.erase(_skyline.begin() + i + 1);
+				} else {
+					i += 1;
+				}
+			}
+
+			_used_area += size[X] * size[Y];
+
+			return true;
+		}
+
+// MARK: -
+// MARK: Unit Tests
+
+#ifdef ENABLE_TESTING
+		UNIT_TEST(SkylinePacker)
+		{
+			testing("Allocation");
+
+			SkylinePacker packer(Vec2u(64, 64));
+			std::vector<Vec2u> origins, sizes;
+
+			// Pack a sequence of varying rectangles until the area is full:
+			for (std::size_t i = 0; ; i += 1) {
+				Vec2u size(3 + (i * 7) % 11, 2 + (i * 5) % 9), origin;
+
+				if (!packer.allocate(size, origin))
+					break;
+
+				origins.push_back(origin);
+				sizes.push_back(size);
+			}
+
+			check(origins.size() > 20) << "Many rectangles were allocated";
+
+			bool inside = true, overlapping = false;
+
+			for (std::size_t i = 0; i < origins.size(); i += 1) {
+				inside = inside && (origins[i][X] + sizes[i][X] <= 64) && (origins[i][Y] + sizes[i][Y] <= 64);
+
+				for (std::size_t j = i + 1; j < origins.size(); j += 1) {
+					bool separate_x = origins[i][X] + sizes[i][X] <= origins[j][X] || origins[j][X] + sizes[j][X] <= origins[i][X];
+					bool separate_y = origins[i][Y] + sizes[i][Y] <= origins[j][Y] || origins[j][Y] + sizes[j][Y] <= origins[i][Y];
+
+					overlapping = overlapping || !(separate_x || separate_y);
+				}
+			}
+
+			check(inside) << "All rectangles are inside the area";
+			check(!overlapping) << "No rectangles overlap";
+
+			testing("Occupancy");
+
+			std::size_t area = 0;
+			for (auto size : sizes)
+				area += size[X] * size[Y];
+
+			check(packer.used_area() == area) << "Used area is tracked";
+			check(packer.occupancy() > 0.6) << "Rectangles are packed densely";
+
+			Vec2u origin;
+			check(!packer.allocate(Vec2u(65, 1), origin)) << "Oversized rectangle is rejected";
+
+			packer.reset();
+			check(packer.used_area() == 0) << "Reset discards allocations";
+			check(packer.allocate(Vec2u(64, 64), origin) && origin == Vec2u(0, 0)) << "Full area is available after reset";
+		}
+#endif
+	}
+}
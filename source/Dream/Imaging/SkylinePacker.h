@@ -0,0 +1,60 @@
+//
+//  Imaging/SkylinePacker.h
+//  This file is part of the "Dream" project, and is released under the MIT license.
+//
+//  Created by agent on 18/10/26.
+//  Copyright (c) 2026 agent. All rights reserved.
+//
+//
+
+#ifndef _DREAM_IMAGING_SKYLINEPACKER_H
+#define _DREAM_IMAGING_SKYLINEPACKER_H
+
+#include "../Framework.h"
+
+#include <Euclid/Numerics/Vector.h>
+#include <vector>
+
+namespace Dream {
+	namespace Imaging {
+		using namespace Euclid::Numerics;
+
+		/**
+		 Packs rectangles into a fixed size area using the skyline bottom-left heuristic.
+
+		 The skyline tracks the top edge of the allocated area as a list of horizontal segments, so allocation is O(segments) and needs no per-rectangle storage. Individual rectangles can't be freed, but the whole area can be reset.
+		 */
+		class SkylinePacker {
+		protected:
+			struct Segment {
+				std::size_t x, y, width;
+			};
+
+			Vec2u _size;
+			std::vector<Segment> _skyline;
+			std::size_t _used_area;
+
+			/// Returns true if a rectangle fits on top of the skyline starting at the given segment, and the y position it would be placed at.
+			bool fits (std::size_t index, const Vec2u & size, std::size_t & y) const;
+
+		public:
+			SkylinePacker (const Vec2u & size);
+
+			/// Discard all allocations.
+			void reset ();
+
+			/// Allocate a rectangle of the given size, returning its origin. Returns false if there is not enough space.
+			bool allocate (const Vec2u & size, Vec2u & origin);
+
+			const Vec2u & size () const { return _size; }
+
+			/// The total area of all allocated rectangles.
+			std::size_t used_area () const { return _used_area; }
+
+			/// The fraction of the area which has been allocated, between 0 and 1.
+			RealT occupancy () const { return RealT(_used_area) / RealT(_size[X] * _size[Y]); }
+		};
+	}
+}
+
+#endif
@@ -0,0 +1,389 @@
+//
+//  Imaging/TiledImage.cpp
+//  This file is part of the "Dream" project, and is released under the MIT license.
+//
+//  Created by agent on 18/10/26.
+//  Copyright (c) 2026 agent. All rights reserved.
+//
+//
+
+#include "TiledImage.h"
+#include "../Core/Data.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace Dream {
+	namespace Imaging {
+// MARK: -
+// MARK: class RawTileSource
+
+		RawTileSource::RawTileSource (Ptr<IData> data, const PixelCoordinateT & size, std::size_t bytes_per_pixel, std::size_t offset) : _data(data), _size(size), _bytes_per_pixel(bytes_per_pixel), _offset(offset)
+		{
+		}
+
+		RawTileSource::~RawTileSource ()
+		{
+		}
+
+		bool RawTileSource::load_tile (const PixelCoordinateT & origin, IMutablePixelBuffer & tile) const
+		{
+			DREAM_ASSERT(tile.bytes_per_pixel() == _bytes_per_pixel);
+
+			Shared<Buffer> buffer = _data->buffer();
+
+			if (!buffer) return false;
+
+			PixelCoordinateT size = tile.size();
+			std::size_t row_length = size[X] * _bytes_per_pixel;
+
+			for (std::size_t y = 0; y < size[Y]; y += 1) {
+				std::size_t offset = _offset + ((origin[Y] + y) * _size[X] + origin[X]) * _bytes_per_pixel;
+
+				if (offset + row_length > buffer->size())
+					return false;
+
+				memcpy(tile.pixel_data() + y * row_length, buffer->begin() + offset, row_length);
+			}
+
+			return true;
+		}
+
+// MARK: -
+// MARK: class TiledImage
+
+		TiledImage::TiledImage (const PixelCoordinateT & size, PixelFormat format, DataType data_type, std::size_t tile_size) : _tile_size(tile_size)
+		{
+			DREAM_ASSERT(size[Z] == 1);
+
+			_size = size;
+			_format = format;
+			_data_type = data_type;
+
+			_tile_count[X] = (size[X] + tile_size - 1) / tile_size;
+			_tile_count[Y] = (size[Y] + tile_size - 1) / tile_size;
+			_tile_count[Z] = 1;
+
+			_tiles.resize(_tile_count[X] * _tile_count[Y]);
+		}
+
+		TiledImage::TiledImage (const TiledImage & other) : Object(), ImageBase(other), _tile_size(other._tile_size), _tile_count(other._tile_count), _tiles(other._tiles), _source(other._source)
+		{
+		}
+
+		TiledImage::~TiledImage ()
+		{
+		}
+
+		PixelCoordinateT TiledImage::tile_origin (std::size_t x, std::size_t y) const
+		{
+			return PixelCoordinateT(x * _tile_size, y * _tile_size, 0);
+		}
+
+		PixelCoordinateT TiledImage::tile_extent (std::size_t x, std::size_t y) const
+		{
+			PixelCoordinateT origin = tile_origin(x, y);
+
+			// Tiles at the right and bottom edges are clipped to the size of the image:
+			return PixelCoordinateT(std::min(_tile_size, _size[X] - origin[X]), std::min(_tile_size, _size[Y] - origin[Y]), 1);
+		}
+
+		const Image * TiledImage::tile_for_reading (std::size_t x, std::size_t y) const
+		{
+			TileEntry & entry = _tiles[tile_index(x, y)];
+
+			if (!entry.image && _source) {
+				Ref<Image> image = new Image(tile_extent(x, y), _format, _data_type);
+
+				if (_source->load_tile(tile_origin(x, y), *image)) {
+					entry.image = image;
+					entry.modified = false;
+				}
+			}
+
+			return entry.image.get();
+		}
+
+		Image * TiledImage::tile_for_writing (std::size_t x, std::size_t y)
+		{
+			tile_for_reading(x, y);
+
+			TileEntry & entry = _tiles[tile_index(x, y)];
+
+			if (!entry.image) {
+				entry.image = new Image(tile_extent(x, y), _format, _data_type);
+				entry.image->clear();
+			} else if (entry.image->reference_count() > 1) {
+				// The tile is shared with another image, so make a private copy:
+				Ref<Image> copy = new Image(entry.image->size(), _format, _data_type);
+				memcpy(copy->pixel_data(), entry.image->pixel_data(), copy->pixel_data_length());
+
+				entry.image = copy;
+			}
+
+			entry.modified = true;
+			_flattened = NULL;
+
+			return entry.image.get();
+		}
+
+		template <typename CallbackT>
+		void TiledImage::each_tile (const PixelCoordinateT & origin, const PixelCoordinateT & size, CallbackT callback) const
+		{
+			if (size[X] == 0 || size[Y] == 0) return;
+
+			DREAM_ASSERT((origin + size).less_than_or_equal(_size));
+
+			std::size_t first_x = origin[X] / _tile_size, last_x = (origin[X] + size[X] - 1) / _tile_size;
+			std::size_t first_y = origin[Y] / _tile_size, last_y = (origin[Y] + size[Y] - 1) / _tile_size;
+
+			for (std::size_t y = first_y; y <= last_y; y += 1) {
+				for (std::size_t x = first_x; x <= last_x; x += 1) {
+					PixelCoordinateT tile_min = tile_origin(x, y), tile_max = tile_min + tile_extent(x, y);
+					PixelCoordinateT region_min, region_max;
+
+					for (std::size_t i = 0; i < 2; i += 1) {
+						region_min[i] = std::max(origin[i], tile_min[i]);
+						region_max[i] = std::min(origin[i] + size[i], tile_max[i]);
+					}
+
+					region_min[Z] = 0;
+					region_max[Z] = 1;
+
+					callback(x, y, region_min, region_max - region_min);
+				}
+			}
+		}
+
+		void TiledImage::read_region (const PixelCoordinateT & from, const PixelCoordinateT & size, IMutablePixelBuffer & output, const PixelCoordinateT & to) const
+		{
+			DREAM_ASSERT(output.bytes_per_pixel() == bytes_per_pixel());
+			DREAM_ASSERT((to + size).less_than_or_equal(output.size()));
+
+			const std::size_t pixel_size = bytes_per_pixel();
+
+			each_tile(from, size, [&](std::size_t x, std::size_t y, const PixelCoordinateT & origin, const PixelCoordinateT & extent) {
+				const Image * tile = tile_for_reading(x, y);
+				PixelCoordinateT tile_min = tile_origin(x, y);
+
+				for (std::size_t row = 0; row < extent[Y]; row += 1) {
+					PixelCoordinateT at(origin[X], origin[Y] + row, 0);
+					ByteT * destination = output.pixel_data_at(at - from + to);
+
+					if (tile)
+						memcpy(destination, tile->pixel_data() + tile->pixel_offset(at - tile_min), extent[X] * pixel_size);
+					else
+						memset(destination, 0, extent[X] * pixel_size);
+				}
+			});
+		}
+
+		void TiledImage::write_region (const IPixelBuffer & input, const PixelCoordinateT & from, const PixelCoordinateT & size, const PixelCoordinateT & to)
+		{
+			DREAM_ASSERT(input.bytes_per_pixel() == bytes_per_pixel());
+			DREAM_ASSERT((from + size).less_than_or_equal(input.size()));
+
+			const std::size_t pixel_size = bytes_per_pixel();
+
+			each_tile(to, size, [&](std::size_t x, std::size_t y, const PixelCoordinateT & origin, const PixelCoordinateT & extent) {
+				Image * tile = tile_for_writing(x, y);
+				PixelCoordinateT tile_min = tile_origin(x, y);
+
+				for (std::size_t row = 0; row < extent[Y]; row += 1) {
+					PixelCoordinateT at(origin[X], origin[Y] + row, 0);
+
+					memcpy(tile->pixel_data_at(at - tile_min), input.pixel_data_at(at - to + from), extent[X] * pixel_size);
+				}
+			});
+		}
+
+		void TiledImage::fill_region (const PixelCoordinateT & origin, const PixelCoordinateT & size, PixelT pixel)
+		{
+			const std::size_t pixel_size = bytes_per_pixel();
+
+			each_tile(origin, size, [&](std::size_t x, std::size_t y, const PixelCoordinateT & region_origin, const PixelCoordinateT & extent) {
+				Image * tile = tile_for_writing(x, y);
+				PixelCoordinateT tile_min = tile_origin(x, y);
+
+				for (std::size_t row = 0; row < extent[Y]; row += 1) {
+					ByteT * destination = tile->pixel_data_at(PixelCoordinateT(region_origin[X], region_origin[Y] + row, 0) - tile_min);
+
+					for (std::size_t column = 0; column < extent[X]; column += 1)
+						memcpy(destination + column * pixel_size, &pixel, pixel_size);
+				}
+			});
+		}
+
+		PixelT TiledImage::read_pixel (const PixelCoordinateT & at) const
+		{
+			PixelT pixel = 0;
+			const Image * tile = tile_for_reading(at[X] / _tile_size, at[Y] / _tile_size);
+
+			if (tile) {
+				PixelCoordinateT tile_min = tile_origin(at[X] / _tile_size, at[Y] / _tile_size);
+				memcpy(&pixel, tile->pixel_data() + tile->pixel_offset(at - tile_min), bytes_per_pixel());
+			}
+
+			return pixel;
+		}
+
+		void TiledImage::write_pixel (const PixelCoordinateT & at, PixelT pixel)
+		{
+			Image * tile = tile_for_writing(at[X] / _tile_size, at[Y] / _tile_size);
+			PixelCoordinateT tile_min = tile_origin(at[X] / _tile_size, at[Y] / _tile_size);
+
+			memcpy(tile->pixel_data_at(at - tile_min), &pixel, bytes_per_pixel());
+		}
+
+		std::size_t TiledImage::evict_unmodified_tiles ()
+		{
+			std::size_t count = 0;
+
+			if (!_source) return count;
+
+			for (auto & entry : _tiles) {
+				if (entry.image && !entry.modified) {
+					entry.image = NULL;
+					count += 1;
+				}
+			}
+
+			return count;
+		}
+
+		void TiledImage::clear ()
+		{
+			for (auto & entry : _tiles) {
+				entry.image = NULL;
+				entry.modified = false;
+			}
+
+			_flattened = NULL;
+		}
+
+		std::size_t TiledImage::allocated_tile_count () const
+		{
+			std::size_t count = 0;
+
+			for (auto & entry : _tiles)
+				if (entry.image) count += 1;
+
+			return count;
+		}
+
+		std::size_t TiledImage::shared_tile_count () const
+		{
+			std::size_t count = 0;
+
+			for (auto & entry : _tiles)
+				if (entry.image && entry.image->reference_count() > 1) count += 1;
+
+			return count;
+		}
+
+		std::size_t TiledImage::allocated_bytes () const
+		{
+			std::size_t total = 0;
+
+			for (auto & entry : _tiles)
+				if (entry.image) total += entry.image->pixel_data_length();
+
+			return total;
+		}
+
+		const ByteT * TiledImage::pixel_data () const
+		{
+			if (!_flattened) {
+				_flattened = new Image(_size, _format, _data_type);
+				read_region(ZERO, _size, *_flattened);
+			}
+
+			return _flattened->pixel_data();
+		}
+
+// MARK: -
+// MARK: Unit Tests
+
+#ifdef ENABLE_TESTING
+		UNIT_TEST(TiledImage)
+		{
+			testing("Sparse allocation");
+
+			// 64MB if it was allocated up front:
+			Ref<TiledImage> image = new TiledImage(PixelCoordinateT(4096, 4096, 1), PixelFormat::RGBA, DataType::BYTE);
+
+			check(image->tile_count() == PixelCoordinateT(16, 16, 1)) << "Image is divided into tiles";
+			check(image->allocated_bytes() == 0) << "No tiles are allocated initially";
+			check(image->read_pixel(PixelCoordinateT(1000, 1000, 0)) == 0) << "Unallocated tiles read as zero";
+			check(image->allocated_tile_count() == 0) << "Reading does not allocate tiles";
+
+			// Fill a region which overlaps four tiles:
+			image->fill_region(PixelCoordinateT(250, 250, 0), PixelCoordinateT(10, 10, 1), 0xFF0000FF);
+
+			check(image->allocated_tile_count() == 4) << "Only overlapping tiles are allocated";
+			check(image->allocated_bytes() == 4 * 256 * 256 * 4) << "Memory use is proportional to tiles";
+			check(image->read_pixel(PixelCoordinateT(255, 255, 0)) == 0xFF0000FF) << "Pixel was written";
+			check(image->read_pixel(PixelCoordinateT(256, 259, 0)) == 0xFF0000FF) << "Pixel was written";
+			check(image->read_pixel(PixelCoordinateT(260, 260, 0)) == 0) << "Pixel outside region was not written";
+
+			testing("Region copies");
+
+			Ref<Image> region = new Image(PixelCoordinateT(20, 20, 1), PixelFormat::RGBA, DataType::BYTE);
+			image->read_region(PixelCoordinateT(245, 245, 0), PixelCoordinateT(20, 20, 1), *region);
+
+			check(region->read_pixel(PixelCoordinateT(5, 5, 0)) == 0xFF0000FF) << "Region was read across tiles";
+			check(region->read_pixel(PixelCoordinateT(4, 4, 0)) == 0) << "Region was read across tiles";
+
+			image->write_region(*region, PixelCoordinateT(0, 0, 0), PixelCoordinateT(20, 20, 1), PixelCoordinateT(4000, 10, 0));
+
+			check(image->allocated_tile_count() == 5) << "Writing a region allocates one additional tile";
+			check(image->read_pixel(PixelCoordinateT(4005, 15, 0)) == 0xFF0000FF) << "Region was written";
+
+			testing("Copy on write");
+
+			Ref<TiledImage> copy = new TiledImage(*image);
+
+			check(copy->shared_tile_count() == 5) << "All tiles are shared";
+
+			copy->write_pixel(PixelCoordinateT(255, 255, 0), 0x00FF00FF);
+
+			check(copy->read_pixel(PixelCoordinateT(255, 255, 0)) == 0x00FF00FF) << "Copy was modified";
+			check(image->read_pixel(PixelCoordinateT(255, 255, 0)) == 0xFF0000FF) << "Original was not modified";
+			check(copy->shared_tile_count() == 4) << "Modified tile is no longer shared";
+		}
+
+		UNIT_TEST(TiledImageSource)
+		{
+			testing("Paging tiles from source");
+
+			// A 600x300 luminance image where each pixel is (x + y) & 0xFF:
+			Shared<DynamicBuffer> buffer = new DynamicBuffer(600 * 300);
+			for (std::size_t y = 0; y < 300; y += 1)
+				for (std::size_t x = 0; x < 600; x += 1)
+					buffer->begin()[y * 600 + x] = (x + y) & 0xFF;
+
+			PixelCoordinateT size(600, 300, 1);
+			Ref<TiledImage> image = new TiledImage(size, PixelFormat::L, DataType::BYTE);
+			image->set_source(new RawTileSource(new BufferedData(buffer), size, 1));
+
+			check(image->read_pixel(PixelCoordinateT(550, 290, 0)) == ((550 + 290) & 0xFF)) << "Edge tile was paged in";
+			check(image->allocated_tile_count() == 1) << "Only one tile was paged in";
+			check(image->allocated_bytes() == (600 - 512) * (300 - 256)) << "Edge tile is clipped to the image size";
+
+			image->write_pixel(PixelCoordinateT(10, 10, 0), 0);
+
+			check(image->allocated_tile_count() == 2) << "Written tile was paged in";
+			check(image->read_pixel(PixelCoordinateT(11, 10, 0)) == 21) << "Surrounding pixels were paged in";
+
+			check(image->evict_unmodified_tiles() == 1) << "Unmodified tile was evicted";
+			check(image->read_pixel(PixelCoordinateT(10, 10, 0)) == 0) << "Modified tile was kept";
+
+			testing("Flattening");
+
+			const ByteT * pixels = image->pixel_data();
+			check(pixels[599] == ((599) & 0xFF)) << "Flattened image contains paged tiles";
+			check(pixels[10 * 600 + 10] == 0) << "Flattened image contains modified tiles";
+		}
+#endif
+	}
+}
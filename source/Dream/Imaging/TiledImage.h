@@ -0,0 +1,138 @@
+//
+//  Imaging/TiledImage.h
+//  This file is part of the "Dream" project, and is released under the MIT license.
+//
+//  Created by agent on 18/10/26.
+//  Copyright (c) 2026 agent. All rights reserved.
+//
+//
+
+#ifndef _DREAM_IMAGING_TILEDIMAGE_H
+#define _DREAM_IMAGING_TILEDIMAGE_H
+
+#include "Image.h"
+
+#include <vector>
+
+namespace Dream {
+	namespace Imaging {
+		/// Provides pixel data for tiles which have not been loaded yet.
+		class ITileSource : implements IObject {
+		public:
+			/// Fill the tile with pixel data, where origin is the position of the tile within the full image. Returns false if no data is available, in which case the tile is left zeroed.
+			virtual bool load_tile (const PixelCoordinateT & origin, IMutablePixelBuffer & tile) const abstract;
+		};
+
+		/**
+		 Reads tiles from raw, row-major pixel data, such as a memory mapped file.
+
+		 Only the rows overlapping a tile are read, so when used with LocalFileData only the pages of the file that are actually required are loaded from disk.
+		 */
+		class RawTileSource : public Object, implements ITileSource {
+		protected:
+			Ref<IData> _data;
+			PixelCoordinateT _size;
+			std::size_t _bytes_per_pixel, _offset;
+
+		public:
+			/// The data contains an image of the given size, starting at offset bytes.
+			RawTileSource (Ptr<IData> data, const PixelCoordinateT & size, std::size_t bytes_per_pixel, std::size_t offset = 0);
+			virtual ~RawTileSource ();
+
+			virtual bool load_tile (const PixelCoordinateT & origin, IMutablePixelBuffer & tile) const;
+		};
+
+		/**
+		 A 2D image stored as fixed size tiles, which are only allocated when they are written to or paged in from a tile source.
+
+		 Tiles are reference counted and shared between copies of an image. A shared tile is copied before it is modified, so copying a large image is cheap and only the tiles which change use additional memory. Region operations only touch the tiles they overlap.
+
+		 Because the image is not contiguous, pixel_data() has to assemble a full copy of the image, and should be avoided for large images.
+		 */
+		class TiledImage : public Object, public ImageBase, implements IPixelBuffer {
+		public:
+			static const std::size_t DEFAULT_TILE_SIZE = 256;
+
+		protected:
+			struct TileEntry {
+				Ref<Image> image;
+
+				/// Whether the tile has been modified since it was paged in. Unmodified tiles can be evicted.
+				bool modified;
+
+				TileEntry () : modified(false) {}
+			};
+
+			std::size_t _tile_size;
+			PixelCoordinateT _tile_count;
+
+			mutable std::vector<TileEntry> _tiles;
+			Ref<ITileSource> _source;
+
+			mutable Ref<Image> _flattened;
+
+			std::size_t tile_index (std::size_t x, std::size_t y) const { return x + y * _tile_count[X]; }
+
+			PixelCoordinateT tile_origin (std::size_t x, std::size_t y) const;
+			PixelCoordinateT tile_extent (std::size_t x, std::size_t y) const;
+
+			/// Returns the tile for reading, paging it in if required. Returns NULL for tiles which have no data.
+			const Image * tile_for_reading (std::size_t x, std::size_t y) const;
+
+			/// Returns the tile for writing, allocating or copying it if required.
+			Image * tile_for_writing (std::size_t x, std::size_t y);
+
+			/// Calls the callback for every tile overlapping the given region, with the region clipped to the tile in image coordinates.
+			template <typename CallbackT>
+			void each_tile (const PixelCoordinateT & origin, const PixelCoordinateT & size, CallbackT callback) const;
+
+		public:
+			TiledImage (const PixelCoordinateT & size, PixelFormat format, DataType data_type, std::size_t tile_size = DEFAULT_TILE_SIZE);
+
+			/// Shares all tiles with the other image. Tiles are copied when they are first modified.
+			TiledImage (const TiledImage & other);
+
+			virtual ~TiledImage ();
+
+			/// Tiles which have not been allocated are paged in from the given source when they are first accessed.
+			void set_source (Ptr<ITileSource> source) { _source = source; }
+
+			std::size_t tile_size () const { return _tile_size; }
+			const PixelCoordinateT & tile_count () const { return _tile_count; }
+
+			bool is_tile_allocated (std::size_t x, std::size_t y) const { return _tiles[tile_index(x, y)].image; }
+
+			/// Copy a region of this image into the output buffer.
+			void read_region (const PixelCoordinateT & from, const PixelCoordinateT & size, IMutablePixelBuffer & output, const PixelCoordinateT & to = ZERO) const;
+
+			/// Copy a region of the input buffer into this image.
+			void write_region (const IPixelBuffer & input, const PixelCoordinateT & from, const PixelCoordinateT & size, const PixelCoordinateT & to);
+
+			/// Set every pixel in the region to the given value.
+			void fill_region (const PixelCoordinateT & origin, const PixelCoordinateT & size, PixelT pixel);
+
+			PixelT read_pixel (const PixelCoordinateT & at) const;
+			void write_pixel (const PixelCoordinateT & at, PixelT pixel);
+
+			/// Release all tiles which can be paged in again from the source. Returns the number of tiles released.
+			std::size_t evict_unmodified_tiles ();
+
+			/// Release all tiles, the image becomes zeroed (or reverts to the source).
+			void clear ();
+
+			/// The number of tiles currently held by this image, including those shared with other images.
+			std::size_t allocated_tile_count () const;
+
+			/// The number of tiles which are shared with another image.
+			std::size_t shared_tile_count () const;
+
+			/// The number of bytes of pixel data held by this image, including shared tiles.
+			std::size_t allocated_bytes () const;
+
+			/// Assembles a contiguous copy of the image. The copy is cached until the image is next modified.
+			virtual const ByteT * pixel_data () const;
+		};
+	}
+}
+
+#endif
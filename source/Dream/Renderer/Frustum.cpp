@@ -0,0 +1,407 @@
+//
+//  Renderer/Frustum.cpp
+//  This file is part of the "Dream" project, and is released under the MIT license.
+//
+//  Created by agent on 18/10/26.
+//  Copyright (c) 2026 agent. All rights reserved.
+//
+
+#include "Frustum.h"
+
+#include <algorithm>
+#include <cmath>
+
+#ifdef ENABLE_TESTING
+#include "../Core/Random.h"
+#include "../Core/Timer.h"
+#include "../Events/Logger.h"
+#include "../Simulation/BoundingVolumeHierarchy.h"
+#include "../Simulation/LooseTree.h"
+
+#include <vector>
+#endif
+
+namespace Dream
+{
+	namespace Renderer
+	{
+		Frustum::Frustum()
+		{
+			// Every point is inside a plane with no normal:
+			for (std::size_t i = 0; i < PLANES; i += 1)
+				set_plane(i, 0, 0, 0, 0);
+		}
+
+		Frustum::Frustum(const Mat44 & display_matrix)
+		{
+			// The matrix is stored in column major order:
+			const RealT * m = display_matrix.data();
+
+			// A point is inside the clip volume if -w <= x, y, z <= w, so each plane is the last row of the matrix plus or minus one of the others:
+			for (std::size_t i = 0; i < 3; i += 1) {
+				set_plane(i * 2, m[3] + m[i], m[7] + m[4 + i], m[11] + m[8 + i], -(m[15] + m[12 + i]));
+				set_plane(i * 2 + 1, m[3] - m[i], m[7] - m[4 + i], m[11] - m[8 + i], -(m[15] - m[12 + i]));
+			}
+		}
+
+		void Frustum::set_plane(std::size_t index, RealT x, RealT y, RealT z, RealT distance)
+		{
+			RealT length = std::sqrt(x*x + y*y + z*z);
+
+			// Normalized planes give the actual distance to a point, which is needed for testing spheres:
+			if (length > 0) {
+				x /= length;
+				y /= length;
+				z /= length;
+				distance /= length;
+			}
+
+			_x[index] = x;
+			_y[index] = y;
+			_z[index] = z;
+			_distance[index] = distance;
+
+			_absolute_x[index] = std::abs(x);
+			_absolute_y[index] = std::abs(y);
+			_absolute_z[index] = std::abs(z);
+		}
+
+		bool Frustum::contains(const Vec3 & point) const
+		{
+			for (std::size_t i = 0; i < PLANES; i += 1) {
+				if (_x[i] * point[X] + _y[i] * point[Y] + _z[i] * point[Z] < _distance[i])
+					return false;
+			}
+
+			return true;
+		}
+
+		bool Frustum::intersects(const AlignedBox<3> & box) const
+		{
+			return classify(box, ALL) >= 0;
+		}
+
+		bool Frustum::intersects(const Vec3 & center, RealT radius) const
+		{
+			for (std::size_t i = 0; i < PLANES; i += 1) {
+				if (_x[i] * center[X] + _y[i] * center[Y] + _z[i] * center[Z] - _distance[i] < -radius)
+					return false;
+			}
+
+			return true;
+		}
+
+		long Frustum::classify(const AlignedBox<3> & box, unsigned long mask) const
+		{
+			Vec3 center = box.center(), extent = box.size() / 2;
+
+			for (std::size_t i = 0; i < PLANES; i += 1) {
+				if ((mask & (1UL << i)) == 0) continue;
+
+				// The distance from the plane to the center, and the furthest any corner can be from the center along the normal:
+				RealT distance = _x[i] * center[X] + _y[i] * center[Y] + _z[i] * center[Z] - _distance[i];
+				RealT radius = _absolute_x[i] * extent[X] + _absolute_y[i] * extent[Y] + _absolute_z[i] * extent[Z];
+
+				if (distance + radius < 0)
+					return -1;
+
+				if (distance - radius >= 0)
+					mask &= ~(1UL << i);
+			}
+
+			return mask;
+		}
+
+		std::size_t Frustum::cull_spheres(const RealT * x, const RealT * y, const RealT * z, const RealT * radius, std::size_t count, std::uint8_t * visible) const
+		{
+			std::size_t total = 0;
+
+			for (std::size_t i = 0; i < count; i += 1) {
+				std::uint8_t inside = 1;
+
+				for (std::size_t j = 0; j < PLANES; j += 1)
+					inside &= (_x[j] * x[i] + _y[j] * y[i] + _z[j] * z[i] - _distance[j] + radius[i]) >= 0;
+
+				visible[i] = inside;
+				total += inside;
+			}
+
+			return total;
+		}
+
+		std::size_t Frustum::cull_boxes(const RealT * x, const RealT * y, const RealT * z, const RealT * extent_x, const RealT * extent_y, const RealT * extent_z, std::size_t count, std::uint8_t * visible) const
+		{
+			std::size_t total = 0;
+
+			for (std::size_t i = 0; i < count; i += 1) {
+				std::uint8_t inside = 1;
+
+				for (std::size_t j = 0; j < PLANES; j += 1) {
+					RealT distance = _x[j] * x[i] + _y[j] * y[i] + _z[j] * z[i] - _distance[j];
+					RealT radius = _absolute_x[j] * extent_x[i] + _absolute_y[j] * extent_y[i] + _absolute_z[j] * extent_z[i];
+
+					inside &= (distance + radius) >= 0;
+				}
+
+				visible[i] = inside;
+				total += inside;
+			}
+
+			return total;
+		}
+
+		std::size_t Frustum::cull_boxes(const AlignedBox<3> * boxes, std::size_t count, std::uint8_t * visible) const
+		{
+			const std::size_t BLOCK = 64;
+			RealT x[BLOCK], y[BLOCK], z[BLOCK], extent_x[BLOCK], extent_y[BLOCK], extent_z[BLOCK];
+
+			std::size_t total = 0;
+
+			for (std::size_t offset = 0; offset < count; offset += BLOCK) {
+				std::size_t size = std::min(BLOCK, count - offset);
+
+				for (std::size_t i = 0; i < size; i += 1) {
+					const AlignedBox<3> & box = boxes[offset + i];
+
+					x[i] = (box.min()[X] + box.max()[X]) / 2;
+					y[i] = (box.min()[Y] + box.max()[Y]) / 2;
+					z[i] = (box.min()[Z] + box.max()[Z]) / 2;
+
+					extent_x[i] = (box.max()[X] - box.min()[X]) / 2;
+					extent_y[i] = (box.max()[Y] - box.min()[Y]) / 2;
+					extent_z[i] = (box.max()[Z] - box.min()[Z]) / 2;
+				}
+
+				total += cull_boxes(x, y, z, extent_x, extent_y, extent_z, size, visible + offset);
+			}
+
+			return total;
+		}
+
+// MARK: -
+// MARK: Unit Tests
+
+#ifdef ENABLE_TESTING
+		using namespace Events::Logging;
+		using namespace Core;
+
+		// A perspective projection looking down the negative z axis, in column major order:
+		static Mat44 test_perspective(RealT field_of_view, RealT aspect_ratio, RealT near, RealT far)
+		{
+			Mat44 m = ZERO;
+			RealT f = 1.0 / std::tan(field_of_view / 2);
+
+			m.data()[0] = f / aspect_ratio;
+			m.data()[5] = f;
+			m.data()[10] = (far + near) / (near - far);
+			m.data()[11] = -1;
+			m.data()[14] = (2 * far * near) / (near - far);
+
+			return m;
+		}
+
+		static Mat44 test_translation(const Vec3 & offset)
+		{
+			Mat44 m = IDENTITY;
+
+			m.data()[12] = offset[X];
+			m.data()[13] = offset[Y];
+			m.data()[14] = offset[Z];
+
+			return m;
+		}
+
+		// How far inside the clip volume the point is, as a fraction of w. Negative if it is outside:
+		static RealT clip_margin(const Mat44 & matrix, const Vec3 & point)
+		{
+			const RealT * m = matrix.data();
+			RealT clip[4];
+
+			for (std::size_t i = 0; i < 4; i += 1)
+				clip[i] = m[i] * point[X] + m[4 + i] * point[Y] + m[8 + i] * point[Z] + m[12 + i];
+
+			RealT margin = clip[3];
+
+			for (std::size_t i = 0; i < 3; i += 1)
+				margin = std::min(margin, clip[3] - std::abs(clip[i]));
+
+			return margin / std::abs(clip[3]);
+		}
+
+		// A box is outside if all of its corners are outside the same plane:
+		static bool box_outside(const Frustum & frustum, const AlignedBox<3> & box)
+		{
+			for (std::size_t i = 0; i < Frustum::PLANES; i += 1) {
+				bool all_outside = true;
+
+				for (std::size_t corner = 0; corner < 8; corner += 1) {
+					Vec3 point((corner & 1) ? box.max()[X] : box.min()[X], (corner & 2) ? box.max()[Y] : box.min()[Y], (corner & 4) ? box.max()[Z] : box.min()[Z]);
+
+					if (frustum.normal(i)[X] * point[X] + frustum.normal(i)[Y] * point[Y] + frustum.normal(i)[Z] * point[Z] >= frustum.distance(i))
+						all_outside = false;
+				}
+
+				if (all_outside)
+					return true;
+			}
+
+			return false;
+		}
+
+		static AlignedBox<3> random_box(PCG32 & generator, RealT extent, RealT size)
+		{
+			Vec3 center(real_random(generator, -extent, extent), real_random(generator, -extent, extent), real_random(generator, -extent, extent));
+			Vec3 half_size(real_random(generator, 0.1f, size), real_random(generator, 0.1f, size), real_random(generator, 0.1f, size));
+
+			return AlignedBox<3>(center - half_size, center + half_size);
+		}
+
+		// Counts how many boxes a spatial tree asks the frustum to classify:
+		struct CountingFrustum {
+			const Frustum & frustum;
+			mutable std::size_t tests;
+
+			long classify(const AlignedBox<3> & box, unsigned long mask) const {
+				tests += 1;
+
+				return frustum.classify(box, mask);
+			}
+		};
+
+		UNIT_TEST(Frustum)
+		{
+			testing("Extraction");
+
+			// A camera at (0, 0, 50) looking down the negative z axis:
+			Mat44 display_matrix = test_perspective(M_PI / 2, 4.0 / 3.0, 1, 200) * test_translation(Vec3(0, 0, -50));
+			Frustum frustum(display_matrix);
+
+			check(frustum.contains(Vec3(0, 0, 0))) << "The point in front of the camera is visible";
+			check(!frustum.contains(Vec3(0, 0, 60))) << "The point behind the camera is not visible";
+			check(!frustum.contains(Vec3(0, 0, -160))) << "The point beyond the far plane is not visible";
+
+			PCG32 generator(2012);
+			bool matches_clip_space = true;
+
+			for (std::size_t i = 0; i < 10000; i += 1) {
+				Vec3 point(real_random(generator, -200.0f, 200.0f), real_random(generator, -200.0f, 200.0f), real_random(generator, -200.0f, 100.0f));
+				RealT margin = clip_margin(display_matrix, point);
+
+				// Points very close to a plane may go either way due to rounding:
+				if (std::abs(margin) < 1e-3) continue;
+
+				matches_clip_space = matches_clip_space && frustum.contains(point) == (margin > 0);
+			}
+
+			check(matches_clip_space) << "Points inside the frustum are inside the clip volume";
+
+			Frustum everything;
+			check(everything.contains(Vec3(1e6, -1e6, 1e6)) && everything.intersects(Vec3(0, 0, 0), 0)) << "The default frustum contains everything";
+
+			testing("Boxes and Spheres");
+
+			const std::size_t COUNT = 100000;
+			std::vector<AlignedBox<3>> boxes;
+			std::vector<RealT> x(COUNT), y(COUNT), z(COUNT), radius(COUNT);
+
+			for (std::size_t i = 0; i < COUNT; i += 1) {
+				boxes.push_back(random_box(generator, 250, 20));
+
+				x[i] = real_random(generator, -250.0f, 250.0f);
+				y[i] = real_random(generator, -250.0f, 250.0f);
+				z[i] = real_random(generator, -250.0f, 250.0f);
+				radius[i] = real_random(generator, 0.1f, 20.0f);
+			}
+
+			std::vector<std::uint8_t> visible_boxes(COUNT), visible_spheres(COUNT);
+			std::size_t box_count = frustum.cull_boxes(boxes.data(), COUNT, visible_boxes.data());
+			std::size_t sphere_count = frustum.cull_spheres(x.data(), y.data(), z.data(), radius.data(), COUNT, visible_spheres.data());
+
+			bool boxes_match = true, spheres_match = true;
+			std::size_t expected_boxes = 0, expected_spheres = 0;
+
+			for (std::size_t i = 0; i < COUNT; i += 1) {
+				bool box_visible = !box_outside(frustum, boxes[i]);
+				boxes_match = boxes_match && visible_boxes[i] == box_visible && frustum.intersects(boxes[i]) == box_visible;
+				expected_boxes += box_visible;
+
+				bool sphere_visible = true;
+				for (std::size_t j = 0; j < Frustum::PLANES; j += 1) {
+					Vec3 normal = frustum.normal(j);
+					sphere_visible = sphere_visible && normal[X] * x[i] + normal[Y] * y[i] + normal[Z] * z[i] - frustum.distance(j) >= -radius[i];
+				}
+
+				spheres_match = spheres_match && visible_spheres[i] == sphere_visible && frustum.intersects(Vec3(x[i], y[i], z[i]), radius[i]) == sphere_visible;
+				expected_spheres += sphere_visible;
+			}
+
+			check(box_count > 0 && box_count < COUNT) << "Some boxes are visible";
+			check(boxes_match && box_count == expected_boxes) << "Box tests match brute force";
+			check(spheres_match && sphere_count == expected_spheres) << "Sphere tests match brute force";
+
+			testing("Batches");
+
+			const std::size_t ITERATIONS = 20;
+			Stopwatch single_stopwatch, batch_stopwatch;
+			std::size_t single_total = 0, batch_total = 0;
+
+			single_stopwatch.start();
+			for (std::size_t j = 0; j < ITERATIONS; j += 1) {
+				for (std::size_t i = 0; i < COUNT; i += 1)
+					single_total += frustum.intersects(boxes[i]);
+			}
+			single_stopwatch.pause();
+
+			batch_stopwatch.start();
+			for (std::size_t j = 0; j < ITERATIONS; j += 1)
+				batch_total += frustum.cull_boxes(boxes.data(), COUNT, visible_boxes.data());
+			batch_stopwatch.pause();
+
+			logger()->log(LOG_INFO, LogBuffer() << "Frustum culling: " << (COUNT * ITERATIONS) / single_stopwatch.time() / 1e6 << "M boxes/s one at a time, " << (COUNT * ITERATIONS) / batch_stopwatch.time() / 1e6 << "M boxes/s in batches");
+
+			check(single_total == batch_total) << "Batches give the same results";
+
+			testing("Spatial Trees");
+
+			// The tree tests each node, and objects in nodes which are entirely inside the frustum are accepted without testing:
+			Geometry::LooseTree<Geometry::Octants, unsigned> tree(Vec3(-256, -256, -256), Vec3(512, 512, 512), 6, 16);
+			Geometry::BoundingVolumeHierarchy<Geometry::Octants, unsigned> hierarchy;
+
+			for (unsigned i = 0; i < COUNT; i += 1) {
+				tree.insert(i, boxes[i]);
+				hierarchy.insert(i, boxes[i]);
+			}
+
+			hierarchy.build();
+
+			CountingFrustum counting_tree = {frustum, 0}, counting_hierarchy = {frustum, 0};
+			std::vector<bool> found_in_tree(COUNT), found_in_hierarchy(COUNT);
+			std::size_t tree_visible = 0, hierarchy_visible = 0;
+
+			tree.visit_objects_in_volume(counting_tree, Frustum::ALL, [&](unsigned index, const AlignedBox<3> &) {
+				found_in_tree[index] = true;
+				tree_visible += 1;
+
+				return true;
+			});
+
+			hierarchy.visit_objects_in_volume(counting_hierarchy, Frustum::ALL, [&](unsigned index, const AlignedBox<3> &) {
+				found_in_hierarchy[index] = true;
+				hierarchy_visible += 1;
+
+				return true;
+			});
+
+			bool trees_match = true;
+
+			for (std::size_t i = 0; i < COUNT; i += 1)
+				trees_match = trees_match && found_in_tree[i] == (bool)visible_boxes[i] && found_in_hierarchy[i] == (bool)visible_boxes[i];
+
+			logger()->log(LOG_INFO, LogBuffer() << "Frustum culling " << COUNT << " objects: loose tree " << counting_tree.tests << " tests, hierarchy " << counting_hierarchy.tests << " tests");
+
+			check(trees_match && tree_visible == box_count && hierarchy_visible == box_count) << "Spatial trees find the same objects as brute force";
+			check(counting_tree.tests < COUNT && counting_hierarchy.tests < COUNT) << "Spatial trees test fewer boxes than brute force";
+		}
+#endif
+	}
+}
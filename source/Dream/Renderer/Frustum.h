@@ -0,0 +1,78 @@
+//
+//  Renderer/Frustum.h
+//  This file is part of the "Dream" project, and is released under the MIT license.
+//
+//  Created by agent on 18/10/26.
+//  Copyright (c) 2026 agent. All rights reserved.
+//
+
+#ifndef _DREAM_RENDERER_FRUSTUM_H
+#define _DREAM_RENDERER_FRUSTUM_H
+
+#include "Renderer.h"
+
+#include <Euclid/Numerics/Matrix.h>
+#include <Euclid/Geometry/AlignedBox.h>
+
+#include <cstdint>
+
+namespace Dream
+{
+	namespace Renderer
+	{
+		using Euclid::Numerics::Mat44;
+		using Euclid::Numerics::Vec3;
+		using Euclid::Geometry::AlignedBox;
+
+		/**
+		 The planes of a view frustum, for rejecting objects which can't be visible before they are drawn.
+
+		 The planes are extracted from the combined projection and view matrix, so any projection and camera can be used. Each plane has a normalized, inward facing normal, and a point p is inside the plane if dot(normal, p) >= distance. The planes are in the order left, right, bottom, top, near and far.
+
+		 Boxes and spheres are only rejected if they are entirely outside at least one plane. This is conservative: objects just outside the corners of the frustum are reported as visible.
+		 */
+		class Frustum {
+		public:
+			static const std::size_t PLANES = 6;
+
+			/// The mask with a bit set for every plane.
+			static const unsigned long ALL = (1UL << PLANES) - 1;
+
+		protected:
+			// The planes are stored by component, so that batches can be tested against all planes with simple loops which the compiler can vectorize:
+			RealT _x[PLANES], _y[PLANES], _z[PLANES], _distance[PLANES];
+			RealT _absolute_x[PLANES], _absolute_y[PLANES], _absolute_z[PLANES];
+
+			void set_plane(std::size_t index, RealT x, RealT y, RealT z, RealT distance);
+
+		public:
+			/// A frustum which contains everything.
+			Frustum();
+
+			/// The frustum of the given projection * view matrix, following the OpenGL clip space conventions.
+			Frustum(const Mat44 & display_matrix);
+
+			Vec3 normal(std::size_t index) const { return Vec3(_x[index], _y[index], _z[index]); }
+			RealT distance(std::size_t index) const { return _distance[index]; }
+
+			bool contains(const Vec3 & point) const;
+
+			bool intersects(const AlignedBox<3> & box) const;
+			bool intersects(const Vec3 & center, RealT radius) const;
+
+			/// Returns -1 if the box is outside any of the planes in the mask, otherwise the planes in the mask which pass through the box. Everything inside the box is also inside the other planes, so spatial trees pass the result on to the children of a node, and stop testing once it is zero.
+			long classify(const AlignedBox<3> & box, unsigned long mask = ALL) const;
+
+			/// Tests spheres stored by component. Sets visible[i] to 1 or 0, and returns the number which are visible.
+			std::size_t cull_spheres(const RealT * x, const RealT * y, const RealT * z, const RealT * radius, std::size_t count, std::uint8_t * visible) const;
+
+			/// Tests boxes given by their centers and half sizes, stored by component. Sets visible[i] to 1 or 0, and returns the number which are visible.
+			std::size_t cull_boxes(const RealT * x, const RealT * y, const RealT * z, const RealT * extent_x, const RealT * extent_y, const RealT * extent_z, std::size_t count, std::uint8_t * visible) const;
+
+			/// Tests boxes in blocks, converting each block to components first.
+			std::size_t cull_boxes(const AlignedBox<3> * boxes, std::size_t count, std::uint8_t * visible) const;
+		};
+	}
+}
+
+#endif
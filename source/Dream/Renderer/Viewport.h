@@ -11,6 +11,7 @@
 
 #include "Projection.h"
 #include "Camera.h"
+#include "Frustum.h"
 
 #include <Euclid/Geometry/Eye.h>
 
@@ -33,6 +34,11 @@ namespace Dream
 				return projection_matrix() * view_matrix();
 			}
 
+			/// The visible region in world space, for culling objects before they are drawn.
+			Frustum frustum() const {
+				return Frustum(display_matrix());
+			}
+
 			Eye<> convert_to_object_space(const Vec2 & point);
 		};
 
@@ -10,6 +10,15 @@
 #include "AlignedTree.h"
 #include "../Assertion.h"
 
+#ifdef ENABLE_TESTING
+#include "../Core/Timer.h"
+#include "../Events/Logger.h"
+
+#include <algorithm>
+#include <iterator>
+#include <random>
+#endif
+
 namespace Dream {
 	namespace Geometry {
 		using namespace Euclid::Numerics::Constants;
@@ -143,5 +152,181 @@ namespace Dream {
 
 			return BottomLeftNear;
 		}
+
+// MARK: -
+// MARK: Unit Tests
+
+#ifdef ENABLE_TESTING
+		using namespace Events::Logging;
+		using namespace Core;
+
+		struct TestTreeObject {
+			unsigned index;
+			AlignedBox<2> box;
+
+			AlignedBox<2> bounding_box () const { return box; }
+
+			bool operator< (const TestTreeObject & other) const { return index < other.index; }
+			bool operator== (const TestTreeObject & other) const { return index == other.index; }
+		};
+
+		typedef AlignedTree<Quadrants, TestTreeObject> TestAlignedTreeT;
+
+		static AlignedBox<2> random_box (std::minstd_rand & random, RealT extent, RealT size) {
+			std::uniform_real_distribution<RealT> position(0, extent - size), scale(0.1, size);
+			Vec2 origin(position(random), position(random));
+
+			return AlignedBox<2>(origin, origin + Vec2(scale(random), scale(random)));
+		}
+
+		static void populate (TestAlignedTreeT & tree, std::vector<TestTreeObject> & objects, std::size_t count, RealT extent, std::minstd_rand & random) {
+			for (unsigned i = 0; i < count; i += 1) {
+				TestTreeObject object = {i, random_box(random, extent, 4)};
+
+				objects.push_back(object);
+				tree.insert(object);
+			}
+		}
+
+		UNIT_TEST(AlignedTreeQueries)
+		{
+			testing("Visiting objects");
+
+			std::minstd_rand random(11);
+			TestAlignedTreeT tree(Vec2(0, 0), Vec2(1024, 1024));
+
+			std::vector<TestTreeObject> objects;
+			populate(tree, objects, 5000, 1024, random);
+
+			std::vector<TestTreeObject> buffer;
+			bool correct = true;
+
+			for (unsigned i = 0; i < 50; i += 1) {
+				AlignedBox<2> rect = random_box(random, 1024, 100);
+
+				TestAlignedTreeT::ObjectSetT selection = tree.top()->objects_in_rect(rect);
+
+				buffer.clear();
+				tree.copy_objects_in_rect(rect, std::back_inserter(buffer));
+				std::sort(buffer.begin(), buffer.end());
+
+				correct = correct && buffer.size() == selection.size() && std::equal(buffer.begin(), buffer.end(), selection.begin());
+			}
+
+			check(correct) << "Visitor results match the existing query";
+
+			std::size_t visited = 0;
+			bool finished = tree.visit_objects_in_rect(AlignedBox<2>(Vec2(0, 0), Vec2(1024, 1024)), [&](const TestTreeObject &) {
+				visited += 1;
+				return visited < 10;
+			});
+
+			check(!finished && visited == 10) << "Query stops early when the callback returns false";
+
+			testing("Objects along a line");
+
+			LineSegment<2> line(Vec2(10, 20), Vec2(900, 700));
+
+			std::vector<unsigned> along, expected;
+			tree.visit_objects_along_line(line, [&](const TestTreeObject & object) {
+				along.push_back(object.index);
+				return true;
+			});
+
+			for (auto & object : objects) {
+				if (object.box.intersects_with(line, true))
+					expected.push_back(object.index);
+			}
+
+			std::sort(along.begin(), along.end());
+			check(along == expected) << "Line query matches brute force";
+
+			testing("Batched queries");
+
+			std::vector<AlignedBox<2>> rects;
+			for (unsigned i = 0; i < 100; i += 1)
+				rects.push_back(random_box(random, 1024, 50));
+
+			std::vector<std::vector<unsigned>> batched(rects.size());
+			tree.visit_objects_in_rects(rects, [&](std::size_t index, const TestTreeObject & object) {
+				batched[index].push_back(object.index);
+				return true;
+			});
+
+			correct = true;
+			for (std::size_t i = 0; i < rects.size(); i += 1) {
+				std::vector<unsigned> single;
+				tree.visit_objects_in_rect(rects[i], [&](const TestTreeObject & object) {
+					single.push_back(object.index);
+					return true;
+				});
+
+				std::sort(single.begin(), single.end());
+				std::sort(batched[i].begin(), batched[i].end());
+
+				correct = correct && single == batched[i];
+			}
+
+			check(correct) << "Batched results match individual queries";
+		}
+
+		UNIT_TEST(AlignedTreeQueryPerformance)
+		{
+			testing("Query allocations and time");
+
+			const std::size_t COUNT = 100000, QUERIES = 1000;
+
+			std::minstd_rand random(5);
+			TestAlignedTreeT tree(Vec2(0, 0), Vec2(4096, 4096));
+
+			std::vector<TestTreeObject> objects;
+			populate(tree, objects, COUNT, 4096, random);
+
+			std::vector<AlignedBox<2>> rects;
+			for (std::size_t i = 0; i < QUERIES; i += 1)
+				rects.push_back(random_box(random, 4096, 128));
+
+			Stopwatch set_stopwatch, visitor_stopwatch, batch_stopwatch;
+			std::size_t set_results = 0, visitor_results = 0, batch_results = 0;
+
+			set_stopwatch.start();
+			for (auto & rect : rects) {
+				// Every result is a new set node, and the sets from each child are merged again:
+				set_results += tree.top()->objects_in_rect(rect).size();
+			}
+			set_stopwatch.pause();
+
+			std::vector<TestTreeObject> buffer;
+			std::size_t reallocations = 0;
+
+			visitor_stopwatch.start();
+			for (auto & rect : rects) {
+				std::size_t capacity = buffer.capacity();
+
+				buffer.clear();
+				tree.copy_objects_in_rect(rect, std::back_inserter(buffer));
+				visitor_results += buffer.size();
+
+				if (buffer.capacity() != capacity)
+					reallocations += 1;
+			}
+			visitor_stopwatch.pause();
+
+			batch_stopwatch.start();
+			tree.visit_objects_in_rects(rects, [&](std::size_t, const TestTreeObject &) {
+				batch_results += 1;
+				return true;
+			});
+			batch_stopwatch.pause();
+
+			logger()->log(LOG_INFO, LogBuffer() << "Set query: " << set_stopwatch.time() / QUERIES * 1e6 << "us per query, at least " << set_results << " allocations.");
+			logger()->log(LOG_INFO, LogBuffer() << "Visitor query: " << visitor_stopwatch.time() / QUERIES * 1e6 << "us per query, " << reallocations << " buffer allocations.");
+			logger()->log(LOG_INFO, LogBuffer() << "Batched query: " << batch_stopwatch.time() / QUERIES * 1e6 << "us per query, " << rects.size() << " rectangles in one traversal.");
+
+			check(visitor_results == set_results) << "Visitor finds the same objects";
+			check(batch_results == set_results) << "Batched query finds the same objects";
+			check(reallocations < 20) << "Buffer is reused between queries";
+		}
+#endif
 	}
 }
@@ -17,6 +17,8 @@
 #include <Euclid/Numerics/Vector.h>
 #include <Euclid/Geometry/AlignedBox.h>
 
+#include "../Assertion.h"
+
 namespace Dream {
 	namespace Geometry {
 		using namespace Euclid::Geometry::Constants;
@@ -371,12 +373,99 @@ namespace Dream {
 
 					return selection;
 				}
+
+				// Call callback(object) for each object which intersects the given rectangle, without allocating. The search stops early if the callback returns false, in which case false is returned.
+				template <typename FunctionT>
+				bool visit_objects_in_rect (const SpaceT & rect, FunctionT & callback) {
+					for (auto & object : _objects) {
+						if (TraitsT::calculate_bounding_box(object).intersects_with(rect)) {
+							if (!callback(object))
+								return false;
+						}
+					}
+
+					for (unsigned i = 0; i < TraitsT::Q; i += 1) {
+						if (child(i) == NULL) continue;
+
+						if (child(i)->bounding_box().intersects_with(rect)) {
+							if (!child(i)->visit_objects_in_rect(rect, callback))
+								return false;
+						}
+					}
+
+					return true;
+				}
+
+				// Call callback(object) for each object which intersects the given line segment, including objects in this partition.
+				template <typename FunctionT>
+				bool visit_objects_along_line (const LineSegment<TraitsT::D> & l, FunctionT & callback) {
+					for (auto & object : _objects) {
+						if (TraitsT::calculate_bounding_box(object).intersects_with(l, true)) {
+							if (!callback(object))
+								return false;
+						}
+					}
+
+					for (unsigned i = 0; i < TraitsT::Q; i += 1) {
+						if (child(i) == NULL) continue;
+
+						if (child(i)->bounding_box().intersects_with(l, true)) {
+							if (!child(i)->visit_objects_along_line(l, callback))
+								return false;
+						}
+					}
+
+					return true;
+				}
+
+				// Call callback(index, object) for each pair of rectangle and intersecting object. The indices of the rectangles which intersect this partition are active[begin...], and the indices for each child are appended to active and removed again, so the buffer can be reused between queries.
+				template <typename FunctionT>
+				bool visit_objects_in_rects (const SpaceT * rects, std::vector<std::size_t> & active, std::size_t begin, FunctionT & callback) {
+					std::size_t end = active.size();
+
+					for (auto & object : _objects) {
+						SpaceT b = TraitsT::calculate_bounding_box(object);
+
+						for (std::size_t i = begin; i < end; i += 1) {
+							if (b.intersects_with(rects[active[i]])) {
+								if (!callback(active[i], object))
+									return false;
+							}
+						}
+					}
+
+					for (unsigned i = 0; i < TraitsT::Q; i += 1) {
+						if (child(i) == NULL) continue;
+
+						SpaceT b = child(i)->bounding_box();
+						std::size_t child_begin = active.size();
+
+						for (std::size_t j = begin; j < end; j += 1) {
+							if (b.intersects_with(rects[active[j]]))
+								active.push_back(active[j]);
+						}
+
+						if (active.size() != child_begin) {
+							bool finished = child(i)->visit_objects_in_rects(rects, active, child_begin, callback);
+
+							active.resize(child_begin);
+
+							if (!finished)
+								return false;
+						}
+					}
+
+					return true;
+				}
 			};
 
 		protected:
 			SpaceT _bounds;
 			Partition *_top;
 
+			// Reused by batched queries to avoid allocating per query.
+			std::vector<std::size_t> _active_rects;
+
 			void expand (const unsigned & dir) {
 				if (dir && LEFT) {
 					if (dir && TOP) {
@@ -461,6 +550,46 @@ namespace Dream {
 			Partition* partition_for_rect (const SpaceT &rect) {
 				return _top->partition_for_rect(rect);
 			}
+
+			// Call callback(object) for each object which intersects the given rectangle. Unlike Partition::objects_in_rect, no memory is allocated. The callback should return false to stop the search early.
+			template <typename FunctionT>
+			bool visit_objects_in_rect (const SpaceT & rect, FunctionT callback) {
+				return _top->visit_objects_in_rect(rect, callback);
+			}
+
+			// Copy each object which intersects the given rectangle to the output iterator, e.g. std::back_inserter into a buffer which is reused between queries.
+			template <typename OutputIteratorT>
+			OutputIteratorT copy_objects_in_rect (const SpaceT & rect, OutputIteratorT output) {
+				visit_objects_in_rect(rect, [&](const ObjectT & object) {
+					*output++ = object;
+					return true;
+				});
+
+				return output;
+			}
+
+			// Call callback(object) for each object which intersects the given line segment.
+			template <typename FunctionT>
+			bool visit_objects_along_line (const LineSegment<TraitsT::D> & l, FunctionT callback) {
+				return _top->visit_objects_along_line(l, callback);
+			}
+
+			// Call callback(index, object) for each object which intersects rects[index], visiting each partition once for the entire batch.
+			template <typename FunctionT>
+			bool visit_objects_in_rects (const std::vector<SpaceT> & rects, FunctionT callback) {
+				_active_rects.clear();
+
+				SpaceT b = _top->bounding_box();
+				for (std::size_t i = 0; i < rects.size(); i += 1) {
+					if (b.intersects_with(rects[i]))
+						_active_rects.push_back(i);
+				}
+
+				if (_active_rects.empty())
+					return true;
+
+				return _top->visit_objects_in_rects(rects.data(), _active_rects, 0, callback);
+			}
 		};
 	}
 }
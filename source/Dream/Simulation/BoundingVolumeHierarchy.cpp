@@ -0,0 +1,252 @@
+//
+//  Simulation/BoundingVolumeHierarchy.cpp
+//  This file is part of the "Dream" project, and is released under the MIT license.
+//
+//  Created by agent on 18/10/26.
+//  Copyright (c) 2026 agent. All rights reserved.
+//
+//
+
+#include "BoundingVolumeHierarchy.h"
+
+#ifdef ENABLE_TESTING
+#include "../Core/Timer.h"
+#include "../Events/Logger.h"
+
+#include <random>
+#endif
+
+namespace Dream {
+	namespace Geometry {
+
+// MARK: -
+// MARK: Unit Tests
+
+#ifdef ENABLE_TESTING
+		using namespace Events::Logging;
+		using namespace Core;
+
+		typedef BoundingVolumeHierarchy<Octants, unsigned> TestHierarchyT;
+
+		static AlignedBox<3> random_box (std::minstd_rand & random, const Vec3 & center, RealT extent, RealT size) {
+			std::uniform_real_distribution<RealT> position(-extent, extent), scale(0.1, size);
+			Vec3 origin = center + Vec3(position(random), position(random), position(random));
+
+			return AlignedBox<3>(origin, origin + Vec3(scale(random), scale(random), scale(random)));
+		}
+
+		static bool boxes_overlap (const AlignedBox<3> & a, const AlignedBox<3> & b) {
+			for (std::size_t i = 0; i < 3; i += 1) {
+				if (a.max()[i] < b.min()[i] || a.min()[i] > b.max()[i])
+					return false;
+			}
+
+			return true;
+		}
+
+		// The distance along the ray where it enters the box, or a negative value if it misses.
+		static RealT ray_entry (const AlignedBox<3> & box, const Vec3 & origin, const Vec3 & direction, RealT far) {
+			RealT near = 0;
+
+			for (std::size_t i = 0; i < 3; i += 1) {
+				RealT t1 = (box.min()[i] - origin[i]) / direction[i], t2 = (box.max()[i] - origin[i]) / direction[i];
+
+				if (t1 > t2) std::swap(t1, t2);
+
+				near = std::max(near, t1);
+				far = std::min(far, t2);
+
+				if (near > far) return -1;
+			}
+
+			return near;
+		}
+
+		static bool matches_brute_force (const TestHierarchyT & hierarchy, const std::vector<AlignedBox<3>> & boxes, const AlignedBox<3> & query) {
+			std::vector<bool> found(boxes.size());
+			bool correct = true;
+
+			hierarchy.visit_objects_in_box(query, [&](unsigned index, const AlignedBox<3> &) {
+				correct = correct && !found[index];
+				found[index] = true;
+				return true;
+			});
+
+			for (std::size_t i = 0; i < boxes.size(); i += 1)
+				correct = correct && found[i] == boxes_overlap(boxes[i], query);
+
+			return correct;
+		}
+
+		UNIT_TEST(BoundingVolumeHierarchy)
+		{
+			testing("Construction");
+
+			std::minstd_rand random(3);
+			std::vector<AlignedBox<3>> boxes;
+
+			// A mixture of uniform and tightly clustered objects:
+			for (unsigned i = 0; i < 3000; i += 1)
+				boxes.push_back(random_box(random, Vec3(0, 0, 0), 500, 10));
+
+			for (unsigned i = 0; i < 3000; i += 1)
+				boxes.push_back(random_box(random, Vec3(200, -100, 50), 5, 1));
+
+			TestHierarchyT hierarchy, parallel_hierarchy;
+
+			for (unsigned i = 0; i < boxes.size(); i += 1) {
+				hierarchy.insert(i, boxes[i]);
+				parallel_hierarchy.insert(i, boxes[i]);
+			}
+
+			Ref<Events::WorkerPool> pool = new Events::WorkerPool(3);
+
+			hierarchy.build();
+			parallel_hierarchy.build(pool.get());
+
+			check(hierarchy.size() == boxes.size()) << "All objects were added";
+			check(hierarchy.nodes().size() > 1) << "Hierarchy was subdivided";
+			check(parallel_hierarchy.nodes().size() == hierarchy.nodes().size()) << "Parallel build produces the same hierarchy";
+
+			bool same_nodes = true;
+			for (std::size_t i = 0; i < hierarchy.nodes().size(); i += 1) {
+				const TestHierarchyT::Node & a = hierarchy.nodes()[i], & b = parallel_hierarchy.nodes()[i];
+				same_nodes = same_nodes && a.offset == b.offset && a.count == b.count;
+			}
+
+			check(same_nodes) << "Parallel build stores the nodes in the same order";
+			check(hierarchy.object(123) == 123) << "Objects can be found by index";
+
+			bool correct = true;
+			for (unsigned i = 0; i < 50; i += 1) {
+				AlignedBox<3> query = random_box(random, Vec3(0, 0, 0), 500, 100);
+
+				correct = correct && matches_brute_force(hierarchy, boxes, query) && matches_brute_force(parallel_hierarchy, boxes, query);
+			}
+
+			check(correct) << "Box queries match brute force";
+
+			testing("Rays and segments");
+
+			std::uniform_real_distribution<RealT> direction(-1, 1);
+
+			correct = true;
+			for (unsigned i = 0; i < 50; i += 1) {
+				Vec3 origin(direction(random) * 600, direction(random) * 600, direction(random) * 600);
+				Vec3 towards = Vec3(200, -100, 50) + Vec3(direction(random), direction(random), direction(random)) * 100 - origin;
+
+				RealT expected_distance = 2;
+				unsigned expected = boxes.size();
+
+				for (unsigned j = 0; j < boxes.size(); j += 1) {
+					RealT entry = ray_entry(boxes[j], origin, towards, expected_distance);
+
+					if (entry >= 0 && entry < expected_distance) {
+						expected_distance = entry;
+						expected = j;
+					}
+				}
+
+				RealT distance = 2;
+				unsigned hit = boxes.size();
+
+				hierarchy.nearest_along_ray(origin, towards, distance, [&](unsigned index, RealT & far) {
+					RealT entry = ray_entry(boxes[index], origin, towards, far);
+
+					if (entry >= 0 && entry < far) {
+						far = entry;
+						return true;
+					}
+
+					return false;
+				}, hit);
+
+				correct = correct && hit == expected && (hit == boxes.size() || distance == expected_distance);
+
+				// All boxes along the segment from the origin to the target:
+				LineSegment<3> segment(origin, origin + towards);
+				std::size_t along = 0, expected_along = 0;
+
+				hierarchy.visit_objects_along_line(segment, [&](unsigned index, const AlignedBox<3> &, RealT) {
+					along += 1;
+					return true;
+				});
+
+				for (auto & box : boxes) {
+					if (ray_entry(box, origin, towards, 1) >= 0)
+						expected_along += 1;
+				}
+
+				correct = correct && along == expected_along;
+			}
+
+			check(correct) << "Ray and segment queries match brute force";
+
+			testing("Refitting");
+
+			std::uniform_real_distribution<RealT> offset(-20, 20);
+			for (unsigned i = 0; i < boxes.size(); i += 1) {
+				Vec3 delta(offset(random), offset(random), offset(random));
+				boxes[i] = AlignedBox<3>(boxes[i].min() + delta, boxes[i].max() + delta);
+
+				hierarchy.update(i, boxes[i]);
+			}
+
+			hierarchy.refit();
+
+			correct = true;
+			for (unsigned i = 0; i < 50; i += 1)
+				correct = correct && matches_brute_force(hierarchy, boxes, random_box(random, Vec3(0, 0, 0), 500, 100));
+
+			check(correct) << "Box queries match brute force after refitting";
+		}
+
+		UNIT_TEST(BoundingVolumeHierarchyPerformance)
+		{
+			testing("Build and query");
+
+			const unsigned COUNT = 100000;
+
+			std::minstd_rand random(9);
+			TestHierarchyT hierarchy;
+
+			for (unsigned i = 0; i < COUNT; i += 1)
+				hierarchy.insert(i, random_box(random, Vec3(0, 0, 0), 1000, 5));
+
+			Stopwatch build_stopwatch, parallel_stopwatch, refit_stopwatch, ray_stopwatch;
+
+			build_stopwatch.start();
+			hierarchy.build();
+			build_stopwatch.pause();
+
+			parallel_stopwatch.start();
+			Ref<Events::WorkerPool> pool = new Events::WorkerPool;
+			hierarchy.build(pool.get());
+			parallel_stopwatch.pause();
+
+			refit_stopwatch.start();
+			hierarchy.refit();
+			refit_stopwatch.pause();
+
+			std::uniform_real_distribution<RealT> direction(-1, 1);
+			std::size_t hits = 0;
+
+			ray_stopwatch.start();
+			for (unsigned i = 0; i < 1000; i += 1) {
+				Vec3 origin(0, 0, 0), towards(direction(random), direction(random), direction(random));
+				RealT distance = 2000;
+				unsigned hit;
+
+				if (hierarchy.nearest_along_ray(origin, towards, distance, [&](unsigned, RealT &) { return true; }, hit))
+					hits += 1;
+			}
+			ray_stopwatch.pause();
+
+			logger()->log(LOG_INFO, LogBuffer() << "Hierarchy build: " << build_stopwatch.time() * 1e3 << "ms, parallel build: " << parallel_stopwatch.time() * 1e3 << "ms, refit: " << refit_stopwatch.time() * 1e3 << "ms.");
+			logger()->log(LOG_INFO, LogBuffer() << "Ray query: " << ray_stopwatch.time() / 1000 * 1e6 << "us per ray.");
+
+			check(hits > 0) << "Rays hit objects";
+		}
+#endif
+	}
+}
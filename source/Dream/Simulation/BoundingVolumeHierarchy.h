@@ -0,0 +1,620 @@
+//
+//  Simulation/BoundingVolumeHierarchy.h
+//  This file is part of the "Dream" project, and is released under the MIT license.
+//
+//  Created by agent on 18/10/26.
+//  Copyright (c) 2026 agent. All rights reserved.
+//
+//
+
+#ifndef _DREAM_BOUNDING_VOLUME_HIERARCHY_H
+#define _DREAM_BOUNDING_VOLUME_HIERARCHY_H
+
+#include "AlignedTree.h"
+#include "../Events/Thread.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+namespace Dream {
+	namespace Geometry {
+		/**
+		 A bounding volume hierarchy of axis-aligned boxes, BoundingVolumeHierarchy<Quadrants> or BoundingVolumeHierarchy<Octants>, for ray, segment, box and frustum queries.
+
+		 The hierarchy is built top-down using a binned surface area heuristic, which adapts to clustered data, and the top levels can be built in parallel. Nodes are stored in depth first order, so the first child of a node always follows it, and objects are reordered so that each leaf refers to a contiguous range. When objects move, their boxes can be updated and the hierarchy refitted in linear time without changing its structure. It should be rebuilt if the objects have moved a long way.
+		 */
+		template <typename _TraitsT, typename ObjectT>
+		class BoundingVolumeHierarchy {
+		public:
+			typedef _TraitsT TraitsT;
+			typedef typename TraitsT::VecT VecT;
+			typedef typename TraitsT::SpaceT SpaceT;
+
+			typedef std::uint32_t IndexT;
+
+			struct Node {
+				SpaceT bounding_box;
+
+				/// For leaves, the index of the first primitive, otherwise the index of the second child.
+				IndexT offset;
+
+				/// The number of primitives in a leaf, or zero for interior nodes.
+				IndexT count;
+
+				bool is_leaf () const { return count != 0; }
+			};
+
+			struct Primitive {
+				SpaceT bounding_box;
+				ObjectT object;
+
+				/// The index returned when the object was inserted.
+				IndexT index;
+			};
+
+		protected:
+			enum {
+				BINS = 16,
+				/// Traversal uses a fixed size stack, so deep subtrees are split at the median to bound the depth.
+				MAXIMUM_DEPTH = 64,
+				MEDIAN_DEPTH = 32,
+				MINIMUM_PARALLEL_PRIMITIVES = 1024
+			};
+
+			/// Marks a node of the top levels whose subtree is built separately, in which case the offset is the index of the subtree.
+			static const IndexT DEFERRED = (IndexT)-1;
+
+			/// A range of objects below the top levels, which is built on a worker thread into its own array of nodes.
+			struct Subtree {
+				std::size_t begin, end, depth;
+				std::vector<Node> nodes;
+			};
+
+			std::vector<Node> _nodes;
+			std::vector<Primitive> _primitives;
+
+			/// The current location of each primitive in _primitives, by insertion index.
+			std::vector<IndexT> _positions;
+
+			std::size_t _maximum_leaf_size;
+
+			static RealT dot (const VecT & a, const VecT & b) {
+				RealT result = 0;
+
+				for (std::size_t i = 0; i < TraitsT::D; i += 1)
+					result += a[i] * b[i];
+
+				return result;
+			}
+
+			/// Half the surface area of a box in 3 dimensions, or half the perimeter in 2 dimensions.
+			static RealT surface_area (const SpaceT & box) {
+				VecT size = box.max() - box.min();
+
+				if (TraitsT::D == 2)
+					return size[0] + size[1];
+
+				RealT area = 0;
+				for (std::size_t i = 0; i < TraitsT::D; i += 1) {
+					for (std::size_t j = i + 1; j < TraitsT::D; j += 1)
+						area += size[i] * size[j];
+				}
+
+				return area;
+			}
+
+			static SpaceT empty_box () {
+				return SpaceT(VecT(std::numeric_limits<RealT>::max()), VecT(-std::numeric_limits<RealT>::max()));
+			}
+
+			static void grow (SpaceT & box, const SpaceT & other) {
+				for (std::size_t i = 0; i < TraitsT::D; i += 1) {
+					box.min()[i] = std::min(box.min()[i], other.min()[i]);
+					box.max()[i] = std::max(box.max()[i], other.max()[i]);
+				}
+			}
+
+			static bool overlaps (const SpaceT & a, const SpaceT & b) {
+				for (std::size_t i = 0; i < TraitsT::D; i += 1) {
+					if (a.max()[i] < b.min()[i] || a.min()[i] > b.max()[i])
+						return false;
+				}
+
+				return true;
+			}
+
+			static RealT centroid (const SpaceT & box, std::size_t axis) {
+				return (box.min()[axis] + box.max()[axis]) * 0.5;
+			}
+
+			/// Clips the ray interval [near, far] to the box using the slab test.
+			static bool clip_ray (const SpaceT & box, const VecT & origin, const VecT & inverse_direction, RealT & near, RealT & far) {
+				for (std::size_t i = 0; i < TraitsT::D; i += 1) {
+					RealT t1 = (box.min()[i] - origin[i]) * inverse_direction[i];
+					RealT t2 = (box.max()[i] - origin[i]) * inverse_direction[i];
+
+					if (t1 > t2) std::swap(t1, t2);
+
+					if (t1 > near) near = t1;
+					if (t2 < far) far = t2;
+
+					if (near > far)
+						return false;
+				}
+
+				return true;
+			}
+
+			struct Split {
+				std::size_t axis;
+				RealT position;
+				RealT cost;
+			};
+
+			/// Finds the best split of the primitives in [begin, end) using binned centroids. Returns false if all centroids are the same.
+			bool find_split (std::vector<IndexT> & order, std::size_t begin, std::size_t end, const SpaceT & centroids, Split & best) const {
+				struct Bin {
+					SpaceT bounding_box;
+					std::size_t count;
+				};
+
+				bool found = false;
+				best.cost = std::numeric_limits<RealT>::max();
+
+				for (std::size_t axis = 0; axis < TraitsT::D; axis += 1) {
+					RealT min = centroids.min()[axis], extent = centroids.max()[axis] - min;
+
+					if (extent <= 0) continue;
+
+					Bin bins[BINS];
+					for (auto & bin : bins) {
+						bin.bounding_box = empty_box();
+						bin.count = 0;
+					}
+
+					RealT scale = BINS / extent;
+
+					for (std::size_t i = begin; i < end; i += 1) {
+						const SpaceT & box = _primitives[order[i]].bounding_box;
+						std::size_t b = std::min<std::size_t>(BINS - 1, (centroid(box, axis) - min) * scale);
+
+						grow(bins[b].bounding_box, box);
+						bins[b].count += 1;
+					}
+
+					// Sweep from the left to find the cost of the primitives before each boundary:
+					RealT left_costs[BINS];
+					std::size_t left_counts[BINS];
+
+					SpaceT left = empty_box();
+					std::size_t left_count = 0;
+
+					for (std::size_t b = 1; b < BINS; b += 1) {
+						grow(left, bins[b - 1].bounding_box);
+						left_count += bins[b - 1].count;
+
+						left_costs[b] = left_count ? surface_area(left) * left_count : 0;
+						left_counts[b] = left_count;
+					}
+
+					// Then sweep from the right, and consider splitting at each boundary b, between bin b - 1 and bin b:
+					SpaceT right = empty_box();
+					std::size_t right_count = 0;
+
+					for (std::size_t b = BINS - 1; b > 0; b -= 1) {
+						grow(right, bins[b].bounding_box);
+						right_count += bins[b].count;
+
+						if (left_counts[b] == 0 || right_count == 0)
+							continue;
+
+						RealT cost = left_costs[b] + surface_area(right) * right_count;
+
+						if (cost < best.cost) {
+							best.axis = axis;
+							best.position = min + b / scale;
+							best.cost = cost;
+							found = true;
+						}
+					}
+				}
+
+				return found;
+			}
+
+			/// Builds the node for the objects in [begin, end) and its children. If subtrees is given, the children below the given number of levels are deferred, so they can be built in parallel.
+			void build_node (std::vector<Node> & nodes, std::vector<IndexT> & order, std::size_t begin, std::size_t end, std::size_t depth, std::size_t parallel_depth, std::vector<Subtree> * subtrees) {
+				IndexT index = (IndexT)nodes.size();
+				nodes.push_back(Node());
+
+				SpaceT bounding_box = empty_box(), centroids = empty_box();
+
+				for (std::size_t i = begin; i < end; i += 1) {
+					const SpaceT & box = _primitives[order[i]].bounding_box;
+					grow(bounding_box, box);
+
+					VecT center;
+					for (std::size_t j = 0; j < TraitsT::D; j += 1)
+						center[j] = centroid(box, j);
+
+					grow(centroids, SpaceT(center, center));
+				}
+
+				nodes[index].bounding_box = bounding_box;
+
+				std::size_t count = end - begin, middle = begin + count / 2;
+				Split split;
+
+				if (depth < MEDIAN_DEPTH && find_split(order, begin, end, centroids, split)) {
+					// Relative to the area of this node, a leaf costs one test per primitive, while a split costs one traversal step plus the tests in each child weighted by its area:
+					RealT area = surface_area(bounding_box);
+
+					if (count <= _maximum_leaf_size && area + split.cost >= area * count) {
+						nodes[index].offset = (IndexT)begin;
+						nodes[index].count = (IndexT)count;
+
+						return;
+					}
+
+					middle = std::partition(order.begin() + begin, order.begin() + end, [&](IndexT i) {
+						return centroid(_primitives[i].bounding_box, split.axis) < split.position;
+					}) - order.begin();
+
+					// Rounding can put every centroid on one side of the boundary:
+					if (middle == begin || middle == end)
+						middle = begin + count / 2;
+				} else if (count <= _maximum_leaf_size) {
+					nodes[index].offset = (IndexT)begin;
+					nodes[index].count = (IndexT)count;
+
+					return;
+				} else {
+					// All centroids are the same, or the tree is too deep, so split at the median along the longest axis:
+					std::size_t axis = 0;
+					for (std::size_t i = 1; i < TraitsT::D; i += 1) {
+						if (bounding_box.max()[i] - bounding_box.min()[i] > bounding_box.max()[axis] - bounding_box.min()[axis])
+							axis = i;
+					}
+
+					std::nth_element(order.begin() + begin, order.begin() + middle, order.begin() + end, [&](IndexT a, IndexT b) {
+						return centroid(_primitives[a].bounding_box, axis) < centroid(_primitives[b].bounding_box, axis);
+					});
+				}
+
+				nodes[index].count = 0;
+
+				if (subtrees && count >= MINIMUM_PARALLEL_PRIMITIVES) {
+					build_child(nodes, order, begin, middle, depth + 1, parallel_depth - 1, subtrees);
+					nodes[index].offset = (IndexT)nodes.size();
+					build_child(nodes, order, middle, end, depth + 1, parallel_depth - 1, subtrees);
+				} else {
+					build_node(nodes, order, begin, middle, depth + 1, 0, NULL);
+					nodes[index].offset = (IndexT)nodes.size();
+					build_node(nodes, order, middle, end, depth + 1, 0, NULL);
+				}
+			}
+
+			/// Splits the child further if it is within the top levels, otherwise adds a placeholder for it and defers building it.
+			void build_child (std::vector<Node> & nodes, std::vector<IndexT> & order, std::size_t begin, std::size_t end, std::size_t depth, std::size_t parallel_depth, std::vector<Subtree> * subtrees) {
+				if (parallel_depth > 0) {
+					build_node(nodes, order, begin, end, depth, parallel_depth, subtrees);
+				} else {
+					Node node;
+					node.offset = (IndexT)subtrees->size();
+					node.count = DEFERRED;
+
+					nodes.push_back(node);
+					subtrees->push_back(Subtree{begin, end, depth, std::vector<Node>()});
+				}
+			}
+
+			/// Appends a node of the top levels and its children in depth first order, replacing each placeholder with its subtree.
+			void stitch_node (const std::vector<Node> & top, IndexT index, const std::vector<Subtree> & subtrees) {
+				const Node & node = top[index];
+
+				if (node.count == DEFERRED) {
+					append_nodes(_nodes, subtrees[node.offset].nodes);
+					return;
+				}
+
+				IndexT position = (IndexT)_nodes.size();
+				_nodes.push_back(node);
+
+				if (node.is_leaf()) return;
+
+				stitch_node(top, index + 1, subtrees);
+				_nodes[position].offset = (IndexT)_nodes.size();
+				stitch_node(top, node.offset, subtrees);
+			}
+
+			static void append_nodes (std::vector<Node> & nodes, const std::vector<Node> & subtree) {
+				IndexT base = (IndexT)nodes.size();
+
+				for (auto node : subtree) {
+					if (!node.is_leaf())
+						node.offset += base;
+
+					nodes.push_back(node);
+				}
+			}
+
+			/// Visits the primitives of each leaf intersected by the ray in [near, far], nearest first. The callback may reduce far to prune the search, and returns false to stop.
+			template <typename FunctionT>
+			bool traverse_ray (const VecT & origin, const VecT & direction, RealT near, RealT & far, FunctionT & callback) const {
+				if (_nodes.empty()) return true;
+
+				VecT inverse_direction;
+				for (std::size_t i = 0; i < TraitsT::D; i += 1)
+					inverse_direction[i] = RealT(1) / direction[i];
+
+				IndexT stack[MAXIMUM_DEPTH];
+				std::size_t top = 0;
+
+				stack[top++] = 0;
+
+				while (top) {
+					IndexT index = stack[--top];
+					const Node & node = _nodes[index];
+
+					RealT node_near = near, node_far = far;
+					if (!clip_ray(node.bounding_box, origin, inverse_direction, node_near, node_far))
+						continue;
+
+					if (node.is_leaf()) {
+						for (IndexT i = node.offset; i < node.offset + node.count; i += 1) {
+							RealT primitive_near = near, primitive_far = far;
+							const Primitive & primitive = _primitives[i];
+
+							if (clip_ray(primitive.bounding_box, origin, inverse_direction, primitive_near, primitive_far)) {
+								if (!callback(primitive, primitive_near, far))
+									return false;
+							}
+						}
+					} else {
+						IndexT first = index + 1, second = node.offset;
+
+						// Push the farther child first, so the nearer child is visited first:
+						RealT first_near = near, first_far = far, second_near = near, second_far = far;
+						bool first_hit = clip_ray(_nodes[first].bounding_box, origin, inverse_direction, first_near, first_far);
+						bool second_hit = clip_ray(_nodes[second].bounding_box, origin, inverse_direction, second_near, second_far);
+
+						if (first_hit && second_hit) {
+							if (first_near <= second_near) {
+								stack[top++] = second;
+								stack[top++] = first;
+							} else {
+								stack[top++] = first;
+								stack[top++] = second;
+							}
+						} else if (first_hit) {
+							stack[top++] = first;
+						} else if (second_hit) {
+							stack[top++] = second;
+						}
+					}
+				}
+
+				return true;
+			}
+
+		public:
+			BoundingVolumeHierarchy (std::size_t maximum_leaf_size = 4) : _maximum_leaf_size(maximum_leaf_size)
+			{
+			}
+
+			/// Add an object using the bounding box provided by the traits. The hierarchy must be rebuilt before it can be queried.
+			IndexT insert (ObjectT object) {
+				return insert(object, TraitsT::calculate_bounding_box(object));
+			}
+
+			/// Add an object with the given bounding box, and return its index. The hierarchy must be rebuilt before it can be queried.
+			IndexT insert (ObjectT object, const SpaceT & bounding_box) {
+				IndexT index = (IndexT)_positions.size();
+
+				_positions.push_back((IndexT)_primitives.size());
+				_primitives.push_back(Primitive{bounding_box, object, index});
+
+				return index;
+			}
+
+			/// Builds the hierarchy from all inserted objects. If a pool is given, the top levels are split on the calling thread, and the subtrees below them are built in parallel.
+			void build (Events::WorkerPool * pool = NULL) {
+				_nodes.clear();
+
+				if (_primitives.empty()) return;
+
+				std::vector<IndexT> order(_primitives.size());
+				for (std::size_t i = 0; i < order.size(); i += 1)
+					order[i] = (IndexT)i;
+
+				// Split the top levels until there is at least one subtree per thread:
+				std::size_t parallel_depth = 0;
+				while (pool && (std::size_t(1) << parallel_depth) < pool->thread_count())
+					parallel_depth += 1;
+
+				_nodes.reserve(2 * (_primitives.size() / std::max<std::size_t>(1, _maximum_leaf_size / 2)));
+
+				if (parallel_depth > 0) {
+					std::vector<Node> top;
+					std::vector<Subtree> subtrees;
+
+					build_node(top, order, 0, order.size(), 0, parallel_depth, &subtrees);
+
+					// Each subtree refers to a separate range of the order:
+					pool->parallel_for(subtrees.size(), [&](std::size_t i) {
+						Subtree & subtree = subtrees[i];
+						build_node(subtree.nodes, order, subtree.begin, subtree.end, subtree.depth, 0, NULL);
+					});
+
+					stitch_node(top, 0, subtrees);
+				} else {
+					build_node(_nodes, order, 0, order.size(), 0, 0, NULL);
+				}
+
+				// Store the primitives in leaf order:
+				std::vector<Primitive> primitives;
+				primitives.reserve(_primitives.size());
+
+				for (std::size_t i = 0; i < order.size(); i += 1) {
+					primitives.push_back(_primitives[order[i]]);
+					_positions[primitives.back().index] = (IndexT)i;
+				}
+
+				_primitives.swap(primitives);
+			}
+
+			/// Changes the bounding box of an object. The hierarchy must be refitted or rebuilt before it is queried again.
+			void update (IndexT index, const SpaceT & bounding_box) {
+				_primitives[_positions[index]].bounding_box = bounding_box;
+			}
+
+			/// Recomputes the bounds of every node from the current object bounds, without changing the structure.
+			void refit () {
+				// Children are always stored after their parent:
+				for (std::size_t i = _nodes.size(); i-- > 0;) {
+					Node & node = _nodes[i];
+					SpaceT bounding_box = empty_box();
+
+					if (node.is_leaf()) {
+						for (IndexT j = node.offset; j < node.offset + node.count; j += 1)
+							grow(bounding_box, _primitives[j].bounding_box);
+					} else {
+						grow(bounding_box, _nodes[i + 1].bounding_box);
+						grow(bounding_box, _nodes[node.offset].bounding_box);
+					}
+
+					node.bounding_box = bounding_box;
+				}
+			}
+
+			void clear () {
+				_nodes.clear();
+				_primitives.clear();
+				_positions.clear();
+			}
+
+			const ObjectT & object (IndexT index) const { return _primitives[_positions[index]].object; }
+			const SpaceT & bounding_box (IndexT index) const { return _primitives[_positions[index]].bounding_box; }
+
+			std::size_t size () const { return _primitives.size(); }
+			const std::vector<Node> & nodes () const { return _nodes; }
+
+			/// Calls callback(object, bounding_box) for each object which intersects the given box. The search stops early if the callback returns false.
+			template <typename FunctionT>
+			bool visit_objects_in_box (const SpaceT & box, FunctionT callback) const {
+				if (_nodes.empty()) return true;
+
+				IndexT stack[MAXIMUM_DEPTH];
+				std::size_t top = 0;
+
+				stack[top++] = 0;
+
+				while (top) {
+					IndexT index = stack[--top];
+					const Node & node = _nodes[index];
+
+					if (!overlaps(node.bounding_box, box))
+						continue;
+
+					if (node.is_leaf()) {
+						for (IndexT i = node.offset; i < node.offset + node.count; i += 1) {
+							if (overlaps(_primitives[i].bounding_box, box)) {
+								if (!callback(_primitives[i].object, _primitives[i].bounding_box))
+									return false;
+							}
+						}
+					} else {
+						stack[top++] = node.offset;
+						stack[top++] = index + 1;
+					}
+				}
+
+				return true;
+			}
+
+			/// Calls callback(object, bounding_box, distance) for each object whose bounding box is hit by the ray within the given distance, approximately nearest first. The distance is measured in multiples of the direction.
+			template <typename FunctionT>
+			bool visit_objects_along_ray (const VecT & origin, const VecT & direction, RealT distance, FunctionT callback) const {
+				auto visitor = [&](const Primitive & primitive, RealT near, RealT &) {
+					return callback(primitive.object, primitive.bounding_box, near);
+				};
+
+				return traverse_ray(origin, direction, 0, distance, visitor);
+			}
+
+			/// Calls callback(object, bounding_box, distance) for each object whose bounding box intersects the line segment.
+			template <typename FunctionT>
+			bool visit_objects_along_line (const LineSegment<TraitsT::D> & line, FunctionT callback) const {
+				return visit_objects_along_ray(line.start(), line.offset(), 1, callback);
+			}
+
+			/**
+			 Finds the nearest object hit by the ray, e.g. for picking. The intersect(object, distance) function should perform an exact test, and if the object is hit closer than distance, update distance and return true. Subtrees further away than the closest hit so far are skipped.
+
+			 Returns true if an object was hit, in which case hit and distance are updated.
+			 */
+			template <typename IntersectT>
+			bool nearest_along_ray (const VecT & origin, const VecT & direction, RealT & distance, IntersectT intersect, ObjectT & hit) const {
+				bool found = false;
+
+				auto visitor = [&](const Primitive & primitive, RealT, RealT & far) {
+					if (intersect(primitive.object, far)) {
+						hit = primitive.object;
+						found = true;
+					}
+
+					return true;
+				};
+
+				traverse_ray(origin, direction, 0, distance, visitor);
+
+				return found;
+			}
+
+			/// Calls callback(object, bounding_box) for each object which intersects the volume. The volume must provide classify(box, mask), which returns -1 if the box is outside, and otherwise the part of the mask which still needs to be tested for anything inside the box, e.g. the planes of a Renderer::Frustum which pass through it.
+			template <typename VolumeT, typename FunctionT>
+			bool visit_objects_in_volume (const VolumeT & volume, unsigned long mask, FunctionT callback) const {
+				if (_nodes.empty()) return true;
+
+				// Parts of the volume which entirely contain a node are not tested again for its children:
+				IndexT stack[MAXIMUM_DEPTH];
+				unsigned long masks[MAXIMUM_DEPTH];
+				std::size_t top = 0;
+
+				stack[top] = 0;
+				masks[top++] = mask;
+
+				while (top) {
+					top -= 1;
+
+					IndexT index = stack[top];
+					const Node & node = _nodes[index];
+
+					long node_mask = masks[top] ? volume.classify(node.bounding_box, masks[top]) : 0;
+					if (node_mask < 0) continue;
+
+					if (node.is_leaf()) {
+						for (IndexT i = node.offset; i < node.offset + node.count; i += 1) {
+							if (node_mask == 0 || volume.classify(_primitives[i].bounding_box, node_mask) >= 0) {
+								if (!callback(_primitives[i].object, _primitives[i].bounding_box))
+									return false;
+							}
+						}
+					} else {
+						stack[top] = node.offset;
+						masks[top++] = node_mask;
+
+						stack[top] = index + 1;
+						masks[top++] = node_mask;
+					}
+				}
+
+				return true;
+			}
+		};
+	}
+}
+
+#endif
@@ -9,6 +9,19 @@
 
 #include "HeightMap.h"
 
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#ifdef ENABLE_TESTING
+#include "../Core/Timer.h"
+#include "../Events/Logger.h"
+#include "../Imaging/Image.h"
+
+#include <numeric>
+#include <random>
+#endif
+
 namespace Dream {
 	namespace Simulation {
 		HeightMap::HeightMap () {
@@ -17,31 +30,37 @@ namespace Dream {
 		HeightMap::~HeightMap () {
 		}
 
-		/*
-		void HeightMap::to_mesh (Mesh & mesh, Vec2u size, Vec3 scale, RealT offset) {
-		    std::size_t base = mesh.vertices().size();
-
-		    // Add points in the mesh
-		    for (std::size_t y = 0; y < size[HEIGHT]; ++y) {
-		        for (std::size_t x = 0; x < size[WIDTH]; ++x) {
-		            //std::cout << "(" << x << "," << y << ") = " << height(Vec2(x,y)) << std::endl;
-		            Vec3 v(x * scale[X], y * scale[Y], height(Vec2(x,y)) * scale[Z] + offset);
-		            mesh.addVertex(v);
-		        }
-		    }
+		void HeightMap::heights (const Vec2 * points, std::size_t count, RealT * output) {
+			Vec2 scale(1, 1), offset(0, 0);
+			HeightMap * source = resolve(scale, offset);
 
-		    // Add triangles using points
-		    std::size_t w = size[WIDTH];
-		    for (std::size_t y = 0; (y+1) < size[HEIGHT]; ++y) {
-		        for (std::size_t x = 0; (x+1) < size[WIDTH]; ++x) {
-		            std::size_t m = base + x + y*w;
+			source->sample(points, count, scale, offset, output);
+		}
 
-		            mesh.addTriangleSurface(m, m+w+1, m+w);
-		            mesh.addTriangleSurface(m, m+1, m+w+1);
-		        }
-		    }
+		void HeightMap::heights (const Vec2 & origin, const Vec2 & step, const Vec2u & size, RealT * output) {
+			Vec2 scale(1, 1), offset(0, 0);
+			HeightMap * source = resolve(scale, offset);
+
+			source->sample_grid(origin * scale + offset, step * scale, size, output);
+		}
+
+		HeightMap * HeightMap::resolve (Vec2 &, Vec2 &) {
+			return this;
+		}
+
+		void HeightMap::sample (const Vec2 * points, std::size_t count, const Vec2 & scale, const Vec2 & offset, RealT * output) {
+			for (std::size_t i = 0; i < count; i += 1)
+				output[i] = height(points[i] * scale + offset);
+		}
+
+		void HeightMap::sample_grid (const Vec2 & origin, const Vec2 & step, const Vec2u & size, RealT * output) {
+			for (std::size_t y = 0; y < size[Y]; y += 1) {
+				for (std::size_t x = 0; x < size[X]; x += 1)
+					*output++ = height(origin + step * Vec2(x, y));
+			}
 		}
 
+		/*
 		// Bivalent - 0 = black, 1 = white
 		void HeightMap::to_image (REF(IMutablePixelBuffer) image) {
 		    //std::size_t byteOffset = sizeof(pixel_t) - image->bytesPerPixel();
@@ -64,17 +83,65 @@ namespace Dream {
 		ImageHeightMap::~ImageHeightMap () {
 		}
 
+		// Reads pixels directly from the image data, without a virtual call per pixel.
+		struct ImagePixelReader {
+			const ByteT * data;
+			std::size_t width, height, bytes_per_pixel;
+			RealT scale;
+
+			ImagePixelReader (const IPixelBuffer * image) : data(image->pixel_data()), width(image->size()[X]), height(image->size()[Y]), bytes_per_pixel(image->bytes_per_pixel()) {
+				// The fourth byte (typically alpha) does not contribute to the height:
+				PixelT max = image->max_pixel_size();
+				((ByteT *)&max)[3] = 0;
+
+				scale = RealT(1) / RealT(max);
+			}
+
+			static std::size_t clamp (RealT value, std::size_t size) {
+				if (value <= 0) return 0;
+
+				std::size_t index = (std::size_t)value;
+				return index < size ? index : size - 1;
+			}
+
+			RealT read (std::size_t x, std::size_t y) const {
+				const ByteT * pixel_data = data + (x + y * width) * bytes_per_pixel;
+
+				if (bytes_per_pixel == 1)
+					return *pixel_data * scale;
+
+				PixelT pixel = 0;
+				memcpy(&pixel, pixel_data, bytes_per_pixel);
+				((ByteT *)&pixel)[3] = 0;
+
+				return RealT(pixel) * scale;
+			}
+
+			RealT read (const Vec2 & at) const {
+				return read(clamp(at[X], width), clamp(at[Y], height));
+			}
+		};
+
 		RealT ImageHeightMap::height (const Vec2 &at) {
-			//std::size_t byteOffset = sizeof(pixel_t) - _image->bytesPerPixel();
-			PixelT max = _image->max_pixel_size();
-			PixelT pixel = _image->read_pixel(Vec3u(at[X], at[Y], 0));
+			return ImagePixelReader(_image.get()).read(at);
+		}
+
+		void ImageHeightMap::sample (const Vec2 * points, std::size_t count, const Vec2 & scale, const Vec2 & offset, RealT * output) {
+			ImagePixelReader reader(_image.get());
+
+			for (std::size_t i = 0; i < count; i += 1)
+				output[i] = reader.read(points[i] * scale + offset);
+		}
 
-			ByteT * pixel_data = (ByteT *)&pixel;
-			pixel_data[3] = 0;
-			ByteT * max_data = (ByteT *)&max;
-			max_data[3] = 0;
+		void ImageHeightMap::sample_grid (const Vec2 & origin, const Vec2 & step, const Vec2u & size, RealT * output) {
+			ImagePixelReader reader(_image.get());
 
-			return RealT(pixel) / RealT(max);
+			for (std::size_t y = 0; y < size[Y]; y += 1) {
+				std::size_t row = reader.clamp(origin[Y] + step[Y] * y, reader.height);
+
+				for (std::size_t x = 0; x < size[X]; x += 1)
+					*output++ = reader.read(reader.clamp(origin[X] + step[X] * x, reader.width), row);
+			}
 		}
 
 		BilinearHeightMap::BilinearHeightMap (HeightMap *input) : _input(input) {
@@ -102,14 +169,117 @@ namespace Dream {
 			}
 
 			Vec2 f = at.fraction();
-			//std::cout << "Frac: " << f << std::endl;
-			RealT a = linear_interpolate(f[X], s[0], s[1]);
-			RealT b = linear_interpolate(f[X], s[2], s[3]);
+			RealT a = linear_interpolate(f[X], s[0], s[2]);
+			RealT b = linear_interpolate(f[X], s[1], s[3]);
 			RealT c = linear_interpolate(f[Y], a, b);
 
 			return c;
 		}
 
+		// Interpolates between corner samples stored in separate arrays, written so that the compiler can vectorize it.
+		static void bilinear_filter (std::size_t count, const RealT * s0, const RealT * s1, const RealT * s2, const RealT * s3, const RealT * fx, const RealT * fy, RealT * output) {
+			for (std::size_t i = 0; i < count; i += 1) {
+				RealT a = s0[i] + (s2[i] - s0[i]) * fx[i];
+				RealT b = s1[i] + (s3[i] - s1[i]) * fx[i];
+
+				output[i] = a + (b - a) * fy[i];
+			}
+		}
+
+		void BilinearHeightMap::sample (const Vec2 * points, std::size_t count, const Vec2 & scale, const Vec2 & offset, RealT * output) {
+			_corners.resize(count * 4);
+			_samples.resize(count * 4);
+			_fractions.resize(count * 2);
+
+			Vec2 * corners = _corners.data();
+			RealT * fx = _fractions.data(), * fy = fx + count;
+
+			for (std::size_t i = 0; i < count; i += 1) {
+				Vec2 at = points[i] * scale + offset - 0.5;
+				Vec2 t = at.truncate();
+
+				corners[i] = t;
+				corners[i + count] = Vec2(t[X], t[Y] + 1);
+				corners[i + count * 2] = Vec2(t[X] + 1, t[Y]);
+				corners[i + count * 3] = Vec2(t[X] + 1, t[Y] + 1);
+
+				fx[i] = at[X] - t[X];
+				fy[i] = at[Y] - t[Y];
+			}
+
+			// All corners are sampled in one batch, which is transformed once by the input chain:
+			_input->heights(corners, count * 4, _samples.data());
+
+			const RealT * samples = _samples.data();
+			bilinear_filter(count, samples, samples + count, samples + count * 2, samples + count * 3, fx, fy, output);
+		}
+
+		void BilinearHeightMap::sample_grid (const Vec2 & origin, const Vec2 & step, const Vec2u & size, RealT * output) {
+			std::size_t width = size[X], height = size[Y];
+			if (width == 0 || height == 0) return;
+
+			// The lattice cell and fraction of each column and each row:
+			_columns.resize(width + height);
+			_fractions.resize(width + height);
+
+			int * columns = _columns.data(), * rows = columns + width;
+			RealT * fx = _fractions.data(), * fy = fx + width;
+
+			for (std::size_t x = 0; x < width; x += 1) {
+				RealT at = origin[X] + step[X] * x - 0.5, t = std::trunc(at);
+				columns[x] = (int)t;
+				fx[x] = at - t;
+			}
+
+			for (std::size_t y = 0; y < height; y += 1) {
+				RealT at = origin[Y] + step[Y] * y - 0.5, t = std::trunc(at);
+				rows[y] = (int)t;
+				fy[y] = at - t;
+			}
+
+			auto column_range = std::minmax_element(columns, columns + width);
+			auto row_range = std::minmax_element(rows, rows + height);
+
+			int left = *column_range.first, bottom = *row_range.first;
+			std::size_t lattice_width = *column_range.second - left + 2, lattice_height = *row_range.second - bottom + 2;
+
+			if (lattice_width * lattice_height > width * height * 4) {
+				// The grid is sparse compared to the input, so sample the corners of each point instead:
+				std::vector<Vec2> points;
+				points.reserve(width * height);
+
+				for (std::size_t y = 0; y < height; y += 1) {
+					for (std::size_t x = 0; x < width; x += 1)
+						points.push_back(origin + step * Vec2(x, y));
+				}
+
+				sample(points.data(), points.size(), Vec2(1, 1), Vec2(0, 0), output);
+
+				return;
+			}
+
+			// Every lattice point under the grid is sampled from the input exactly once:
+			_samples.resize(lattice_width * lattice_height);
+			_input->heights(Vec2(left, bottom), Vec2(1, 1), Vec2u(lattice_width, lattice_height), _samples.data());
+
+			for (std::size_t x = 0; x < width; x += 1)
+				columns[x] -= left;
+
+			for (std::size_t y = 0; y < height; y += 1) {
+				const RealT * row0 = _samples.data() + (rows[y] - bottom) * lattice_width, * row1 = row0 + lattice_width;
+				RealT * row_output = output + y * width;
+
+				for (std::size_t x = 0; x < width; x += 1) {
+					int c = columns[x];
+
+					RealT a = row0[c] + (row0[c + 1] - row0[c]) * fx[x];
+					RealT b = row1[c] + (row1[c + 1] - row1[c]) * fx[x];
+
+					row_output[x] = a + (b - a) * fy[y];
+				}
+			}
+		}
+
 		ScaleHeightMap::ScaleHeightMap (HeightMap *input, Vec2 scale) : _input(input), _scale(scale) {
 		}
 
@@ -121,6 +291,13 @@ namespace Dream {
 			return _input->height(at * _scale);
 		}
 
+		HeightMap * ScaleHeightMap::resolve (Vec2 & scale, Vec2 & offset) {
+			scale *= _scale;
+			offset *= _scale;
+
+			return _input->resolve(scale, offset);
+		}
+
 		OffsetHeightMap::OffsetHeightMap (HeightMap *input, Vec2 offset) : _input(input), _offset(offset) {
 		}
 
@@ -130,5 +307,165 @@ namespace Dream {
 		RealT OffsetHeightMap::height (const Vec2 &at) {
 			return _input->height(at + _offset);
 		}
+
+		HeightMap * OffsetHeightMap::resolve (Vec2 & scale, Vec2 & offset) {
+			offset += _offset;
+
+			return _input->resolve(scale, offset);
+		}
+
+// MARK: -
+// MARK: Unit Tests
+
+#ifdef ENABLE_TESTING
+		using namespace Events::Logging;
+		using namespace Core;
+
+		static Ref<Image> random_height_image (std::size_t size, unsigned seed) {
+			Ref<Image> image = new Image(Vec3u(size, size, 1), PixelFormat::R, DataType::BYTE);
+			std::minstd_rand random(seed);
+
+			ByteT * data = image->pixel_data();
+			for (std::size_t i = 0; i < size * size; i += 1)
+				data[i] = random() % 256;
+
+			return image;
+		}
+
+		static RealT maximum_difference (const std::vector<RealT> & a, const std::vector<RealT> & b) {
+			RealT difference = 0;
+
+			for (std::size_t i = 0; i < a.size(); i += 1)
+				difference = std::max(difference, std::abs(a[i] - b[i]));
+
+			return difference;
+		}
+
+		UNIT_TEST(HeightMap)
+		{
+			testing("Bilinear filtering");
+
+			Ref<Image> gradient = new Image(Vec3u(4, 4, 1), PixelFormat::R, DataType::BYTE);
+			for (std::size_t y = 0; y < 4; y += 1) {
+				for (std::size_t x = 0; x < 4; x += 1)
+					gradient->pixel_data()[x + y * 4] = x * 50 + y * 10;
+			}
+
+			ImageHeightMap gradient_image(gradient);
+			BilinearHeightMap gradient_filter(&gradient_image);
+
+			check(std::abs(gradient_filter.height(Vec2(1.5, 2.5)) - RealT(70) / 255) < 1e-5) << "Pixel centers have the pixel value";
+			check(std::abs(gradient_filter.height(Vec2(1.75, 2.5)) - RealT(82.5) / 255) < 1e-5) << "Horizontal fraction interpolates along the x axis";
+			check(std::abs(gradient_filter.height(Vec2(1.5, 2.75)) - RealT(72.5) / 255) < 1e-5) << "Vertical fraction interpolates along the y axis";
+
+			testing("Batched sampling");
+
+			Ref<Image> image = random_height_image(64, 1);
+			ImageHeightMap image_height_map(image);
+			OffsetHeightMap inner_offset(&image_height_map, Vec2(3.25, 1.75));
+			BilinearHeightMap bilinear(&inner_offset);
+			ScaleHeightMap scale(&bilinear, Vec2(0.37, 0.41));
+			OffsetHeightMap terrain(&scale, Vec2(5.13, 7.29));
+
+			Vec2 scale_factor(1, 1), offset(0, 0);
+			check(terrain.resolve(scale_factor, offset) == &bilinear) << "Scale and offset maps are folded into the filter";
+
+			std::minstd_rand random(2);
+			std::vector<Vec2> points;
+			for (std::size_t i = 0; i < 1000; i += 1)
+				points.push_back(Vec2((random() % 10000) / 100.0f, (random() % 10000) / 100.0f));
+
+			std::vector<RealT> expected, batched(points.size());
+			for (auto & point : points)
+				expected.push_back(terrain.height(point));
+
+			terrain.heights(points.data(), points.size(), batched.data());
+			check(maximum_difference(expected, batched) < 1e-4) << "Batched points match individual samples";
+
+			std::vector<RealT> image_expected, image_batched(points.size());
+			for (auto & point : points)
+				image_expected.push_back(inner_offset.height(point));
+
+			inner_offset.heights(points.data(), points.size(), image_batched.data());
+			check(maximum_difference(image_expected, image_batched) < 1e-6) << "Batched image points match individual samples";
+
+			testing("Grid sampling");
+
+			Vec2 origin(1.13, 2.31), step(0.93, 1.07);
+			Vec2u size(40, 30);
+
+			std::vector<RealT> grid_expected, grid_batched(size.product());
+			for (std::size_t y = 0; y < size[Y]; y += 1) {
+				for (std::size_t x = 0; x < size[X]; x += 1)
+					grid_expected.push_back(terrain.height(origin + step * Vec2(x, y)));
+			}
+
+			terrain.heights(origin, step, size, grid_batched.data());
+			check(maximum_difference(grid_expected, grid_batched) < 1e-4) << "Grid matches individual samples";
+
+			// A sparse grid which covers much more of the input than it samples:
+			std::vector<RealT> sparse_expected, sparse_batched(16);
+			for (std::size_t y = 0; y < 4; y += 1) {
+				for (std::size_t x = 0; x < 4; x += 1)
+					sparse_expected.push_back(terrain.height(origin + Vec2(40.3, 50.7) * Vec2(x, y)));
+			}
+
+			terrain.heights(origin, Vec2(40.3, 50.7), Vec2u(4, 4), sparse_batched.data());
+			check(maximum_difference(sparse_expected, sparse_batched) < 1e-4) << "Sparse grid matches individual samples";
+		}
+
+		UNIT_TEST(HeightMapPerformance)
+		{
+			testing("Sampling a 256x256 terrain patch");
+
+			Ref<Image> image = random_height_image(512, 3);
+			ImageHeightMap image_height_map(image);
+			BilinearHeightMap bilinear(&image_height_map);
+			ScaleHeightMap scale(&bilinear, Vec2(0.5, 0.5));
+			OffsetHeightMap terrain(&scale, Vec2(100.25, 50.75));
+
+			const std::size_t SIZE = 256, PASSES = 10;
+			std::vector<RealT> heights(SIZE * SIZE);
+
+			Stopwatch point_stopwatch, grid_stopwatch, batch_stopwatch;
+
+			point_stopwatch.start();
+			for (std::size_t pass = 0; pass < PASSES; pass += 1) {
+				for (std::size_t y = 0; y < SIZE; y += 1) {
+					for (std::size_t x = 0; x < SIZE; x += 1)
+						heights[x + y * SIZE] = terrain.height(Vec2(x, y));
+				}
+			}
+			point_stopwatch.pause();
+
+			RealT point_sum = std::accumulate(heights.begin(), heights.end(), RealT(0));
+
+			grid_stopwatch.start();
+			for (std::size_t pass = 0; pass < PASSES; pass += 1)
+				terrain.heights(Vec2(0, 0), Vec2(1, 1), Vec2u(SIZE, SIZE), heights.data());
+			grid_stopwatch.pause();
+
+			RealT grid_sum = std::accumulate(heights.begin(), heights.end(), RealT(0));
+
+			// Ground clamping scattered units:
+			std::minstd_rand random(4);
+			std::vector<Vec2> points;
+			for (std::size_t i = 0; i < SIZE * SIZE; i += 1)
+				points.push_back(Vec2((random() % 51200) / 100.0f, (random() % 51200) / 100.0f));
+
+			batch_stopwatch.start();
+			for (std::size_t pass = 0; pass < PASSES; pass += 1)
+				terrain.heights(points.data(), points.size(), heights.data());
+			batch_stopwatch.pause();
+
+			RealT samples = SIZE * SIZE * PASSES;
+
+			logger()->log(LOG_INFO, LogBuffer() << "Per point: " << samples / point_stopwatch.time() / 1e6 << "M samples/s");
+			logger()->log(LOG_INFO, LogBuffer() << "Grid: " << samples / grid_stopwatch.time() / 1e6 << "M samples/s");
+			logger()->log(LOG_INFO, LogBuffer() << "Scattered points: " << samples / batch_stopwatch.time() / 1e6 << "M samples/s");
+
+			check(std::abs(point_sum - grid_sum) < point_sum * 1e-4) << "Grid sampling gives the same terrain";
+		}
+#endif
 	}
 }
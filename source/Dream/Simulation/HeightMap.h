@@ -16,6 +16,8 @@
 #include <Euclid/Numerics/Vector.h>
 #include <Euclid/Numerics/Interpolate.h>
 
+#include <vector>
+
 namespace Dream {
 	namespace Simulation {
 		using namespace Euclid::Numerics;
@@ -28,14 +30,31 @@ namespace Dream {
 
 			virtual RealT height (const Vec2 &at) abstract;
 
+			// Sample many points at once, which avoids a chain of virtual calls per point. Scale and offset maps are folded into a single transform, so only the map which produces the heights visits the points.
+			void heights (const Vec2 * points, std::size_t count, RealT * output);
+
+			// Sample a regular grid, one row after another, where sample (x, y) is at origin + step * (x, y).
+			void heights (const Vec2 & origin, const Vec2 & step, const Vec2u & size, RealT * output);
+
+			// Returns the map which produces the heights, updating the transform (at * scale + offset) which maps positions in this map to positions in the returned map.
+			virtual HeightMap * resolve (Vec2 & scale, Vec2 & offset);
+
 			/* Bivalent - 0 = black, 1 = white */
 			//void to_image(REF(IMutablePixelBuffer) image);
-			//void to_mesh(Mesh & mesh, Vec2u size, Vec3 scale, RealT offset);
+
+		protected:
+			// The default implementations call height for each transformed point.
+			virtual void sample (const Vec2 * points, std::size_t count, const Vec2 & scale, const Vec2 & offset, RealT * output);
+			virtual void sample_grid (const Vec2 & origin, const Vec2 & step, const Vec2u & size, RealT * output);
 		};
 
 		class ImageHeightMap : public HeightMap {
 		protected:
 			Ref<IPixelBuffer> _image;
+
+			virtual void sample (const Vec2 * points, std::size_t count, const Vec2 & scale, const Vec2 & offset, RealT * output);
+			virtual void sample_grid (const Vec2 & origin, const Vec2 & step, const Vec2u & size, RealT * output);
+
 		public:
 			ImageHeightMap (Ref<IPixelBuffer> image);
 			virtual ~ImageHeightMap();
@@ -47,6 +66,14 @@ namespace Dream {
 		protected:
 			HeightMap * _input;
 
+			// Scratch space for batched sampling. The corner samples are stored one corner after another, so that filtering works on contiguous arrays.
+			std::vector<Vec2> _corners;
+			std::vector<RealT> _samples, _fractions;
+			std::vector<int> _columns;
+
+			virtual void sample (const Vec2 * points, std::size_t count, const Vec2 & scale, const Vec2 & offset, RealT * output);
+			virtual void sample_grid (const Vec2 & origin, const Vec2 & step, const Vec2u & size, RealT * output);
+
 		public:
 			BilinearHeightMap (HeightMap *input);
 			virtual ~BilinearHeightMap();
@@ -64,6 +91,7 @@ namespace Dream {
 			virtual ~ScaleHeightMap();
 
 			virtual RealT height (const Vec2 &at);
+			virtual HeightMap * resolve (Vec2 & scale, Vec2 & offset);
 		};
 
 		class OffsetHeightMap : public HeightMap {
@@ -76,6 +104,7 @@ namespace Dream {
 			virtual ~OffsetHeightMap();
 
 			virtual RealT height (const Vec2 &at);
+			virtual HeightMap * resolve (Vec2 & scale, Vec2 & offset);
 		};
 	}
 }
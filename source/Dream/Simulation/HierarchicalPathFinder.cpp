@@ -0,0 +1,716 @@
+//
+//  Simulation/HierarchicalPathFinder.cpp
+//  This file is part of the "Dream" project, and is released under the MIT license.
+//
+//  Created by agent on 18/10/26.
+//  Copyright (c) 2026 agent. All rights reserved.
+//
+//
+
+#include "HierarchicalPathFinder.h"
+#include "../Assertion.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+#ifdef ENABLE_TESTING
+#include "TestGridSearch.h"
+#include "../Core/Timer.h"
+#include "../Events/Logger.h"
+
+#include <random>
+#endif
+
+namespace Dream {
+	namespace Simulation {
+		// Entrances shorter than this have a single node in the middle, longer entrances have a node at each end.
+		const int MAXIMUM_ENTRANCE_WIDTH = 6;
+
+		// The path finder interface for the abstract graph, which also contains a temporary node for the start and goal of the current query.
+		struct HierarchicalPathFinder::AbstractSearch {
+			typedef std::pair<NodeIndexT, float> LinkT;
+
+			HierarchicalPathFinder * graph;
+
+			NodeIndexT start, goal;
+			Vec2i start_position, goal_position;
+
+			// The entrances reachable from the start, and the entrances from which the goal can be reached, within their clusters:
+			std::vector<LinkT> start_links, goal_links;
+
+			// The cost of the edge being added, as PathFinder::add_step asks for it separately.
+			float edge_cost;
+
+			const Vec2i & position (NodeIndexT node) const {
+				if (node == start) return start_position;
+				if (node == goal) return goal_position;
+
+				return graph->_nodes[node].position;
+			}
+
+			void notify_cost (const NodeIndexT &, float, float) {
+			}
+
+			template <typename NodeT, typename PathFinderT>
+			void add_steps_from (const NodeT * node, PathFinderT & path_finder) {
+				if (node->step == start) {
+					for (auto & link : start_links) {
+						edge_cost = link.second;
+						path_finder.add_step(link.first, node);
+					}
+
+					return;
+				}
+
+				for (auto & edge : graph->_nodes[node->step].edges) {
+					edge_cost = edge.cost;
+					path_finder.add_step(edge.target, node);
+				}
+
+				for (auto & link : goal_links) {
+					if (link.first == node->step) {
+						edge_cost = link.second;
+						path_finder.add_step(goal, node);
+					}
+				}
+			}
+
+			float estimate_path_cost (const NodeIndexT & from, const NodeIndexT & to) const {
+				return octile_distance(position(from), position(to));
+			}
+
+			float exact_path_cost (const NodeIndexT &, const NodeIndexT &) const {
+				return edge_cost;
+			}
+
+			template <typename PathFinderT>
+			bool is_goal_state (PathFinderT &, const NodeIndexT & from, const NodeIndexT & to) const {
+				return from == to;
+			}
+		};
+
+		HierarchicalPathFinder::HierarchicalPathFinder (int width, int height, int cluster_size) : _width(width), _height(height), _cluster_size(cluster_size), _blocked(width * height, false)
+		{
+			DREAM_ASSERT(cluster_size > 1);
+
+			_clusters_wide = (width + cluster_size - 1) / cluster_size;
+			_clusters_high = (height + cluster_size - 1) / cluster_size;
+
+			std::size_t count = _clusters_wide * _clusters_high;
+
+			_cluster_nodes.resize(count);
+			_dirty.assign(count, true);
+			_border_nodes[0].resize(count);
+			_border_nodes[1].resize(count);
+
+			_search.reset(new AbstractSearch);
+			_search->graph = this;
+		}
+
+		HierarchicalPathFinder::~HierarchicalPathFinder ()
+		{
+		}
+
+		void HierarchicalPathFinder::cluster_bounds (std::size_t cluster, Vec2i & origin, Vec2i & size) const
+		{
+			origin = Vec2i((cluster % _clusters_wide) * _cluster_size, (cluster / _clusters_wide) * _cluster_size);
+			size = Vec2i(std::min(_cluster_size, _width - origin[0]), std::min(_cluster_size, _height - origin[1]));
+		}
+
+		bool HierarchicalPathFinder::can_move (int x, int y, int dx, int dy) const
+		{
+			if (!passable(x + dx, y + dy))
+				return false;
+
+			return dx == 0 || dy == 0 || (passable(x + dx, y) && passable(x, y + dy));
+		}
+
+		void HierarchicalPathFinder::set_blocked (int x, int y, bool blocked)
+		{
+			if (_blocked[x + y * _width] == blocked) return;
+
+			_blocked[x + y * _width] = blocked;
+			_dirty[cluster_for(Vec2i(x, y))] = true;
+		}
+
+		void HierarchicalPathFinder::cluster_distances (std::size_t cluster, const Vec2i & from, std::vector<float> & distances)
+		{
+			typedef std::pair<float, int> EntryT;
+
+			Vec2i origin, size;
+			cluster_bounds(cluster, origin, size);
+
+			// Distances are final once the cell is removed from the queue, until then the best known cost is kept in _tentative so that each cell is only queued when its cost improves:
+			distances.assign(size[0] * size[1], -1);
+			_tentative.assign(size[0] * size[1], -1);
+
+			std::vector<EntryT> & queue = _queue;
+			queue.clear();
+
+			int first = (from[0] - origin[0]) + (from[1] - origin[1]) * size[0];
+			queue.push_back(EntryT(0, first));
+			_tentative[first] = 0;
+
+			while (!queue.empty()) {
+				std::pop_heap(queue.begin(), queue.end(), std::greater<EntryT>());
+				EntryT entry = queue.back();
+				queue.pop_back();
+
+				if (distances[entry.second] >= 0) continue;
+				distances[entry.second] = entry.first;
+
+				int lx = entry.second % size[0], ly = entry.second / size[0];
+
+				for (int dy = -1; dy <= 1; dy += 1) {
+					for (int dx = -1; dx <= 1; dx += 1) {
+						int nx = lx + dx, ny = ly + dy;
+
+						if ((dx == 0 && dy == 0) || nx < 0 || ny < 0 || nx >= size[0] || ny >= size[1]) continue;
+
+						int next = nx + ny * size[0];
+						float cost = entry.first + ((dx && dy) ? DIAGONAL_COST : 1.0f);
+
+						if ((_tentative[next] >= 0 && _tentative[next] <= cost) || !can_move(origin[0] + lx, origin[1] + ly, dx, dy)) continue;
+
+						_tentative[next] = cost;
+						queue.push_back(EntryT(cost, next));
+						std::push_heap(queue.begin(), queue.end(), std::greater<EntryT>());
+					}
+				}
+			}
+		}
+
+		NodeIndexT HierarchicalPathFinder::add_node (const Vec2i & position)
+		{
+			NodeIndexT index;
+			AbstractNode node(position, cluster_for(position));
+
+			if (_free_nodes.size()) {
+				index = _free_nodes.back();
+				_free_nodes.pop_back();
+
+				_nodes[index] = node;
+			} else {
+				index = (NodeIndexT)_nodes.size();
+				_nodes.push_back(node);
+			}
+
+			_cluster_nodes[node.cluster].push_back(index);
+
+			return index;
+		}
+
+		void HierarchicalPathFinder::remove_border_nodes (std::size_t cluster, std::size_t side)
+		{
+			for (auto index : _border_nodes[side][cluster]) {
+				std::vector<NodeIndexT> & nodes = _cluster_nodes[_nodes[index].cluster];
+				nodes.erase(std::find(nodes.begin(), nodes.end(), index));
+
+				_nodes[index].edges.clear();
+				_free_nodes.push_back(index);
+			}
+
+			_border_nodes[side][cluster].clear();
+		}
+
+		void HierarchicalPathFinder::find_entrances (std::size_t cluster, std::size_t side)
+		{
+			Vec2i origin, size;
+			cluster_bounds(cluster, origin, size);
+
+			// Side 0 is the border with the cluster to the right, side 1 the border with the cluster above:
+			int dx = side == 0, dy = side == 1;
+
+			if ((side == 0 && origin[0] + size[0] >= _width) || (side == 1 && origin[1] + size[1] >= _height))
+				return;
+
+			Vec2i first = side == 0 ? Vec2i(origin[0] + size[0] - 1, origin[1]) : Vec2i(origin[0], origin[1] + size[1] - 1);
+			int length = size[side == 0 ? 1 : 0];
+
+			std::vector<NodeIndexT> & border_nodes = _border_nodes[side][cluster];
+
+			auto add_entrance = [&](int offset) {
+				Vec2i inside(first[0] + dy * offset, first[1] + dx * offset);
+				Vec2i outside(inside[0] + dx, inside[1] + dy);
+
+				NodeIndexT a = add_node(inside), b = add_node(outside);
+
+				_nodes[a].edges.push_back(Edge{b, 1, true});
+				_nodes[b].edges.push_back(Edge{a, 1, true});
+
+				border_nodes.push_back(a);
+				border_nodes.push_back(b);
+			};
+
+			int begin = -1;
+			for (int offset = 0; offset <= length; offset += 1) {
+				bool open = false;
+
+				if (offset < length) {
+					int x = first[0] + dy * offset, y = first[1] + dx * offset;
+					open = passable(x, y) && passable(x + dx, y + dy);
+				}
+
+				if (open && begin < 0) {
+					begin = offset;
+				} else if (!open && begin >= 0) {
+					int end = offset - 1;
+
+					if (end - begin + 1 < MAXIMUM_ENTRANCE_WIDTH) {
+						add_entrance((begin + end) / 2);
+					} else {
+						add_entrance(begin);
+						add_entrance(end);
+					}
+
+					begin = -1;
+				}
+			}
+		}
+
+		void HierarchicalPathFinder::connect_cluster (std::size_t cluster)
+		{
+			Vec2i origin, size;
+			cluster_bounds(cluster, origin, size);
+
+			const std::vector<NodeIndexT> & nodes = _cluster_nodes[cluster];
+
+			for (auto index : nodes) {
+				std::vector<Edge> & edges = _nodes[index].edges;
+				edges.erase(std::remove_if(edges.begin(), edges.end(), [](const Edge & edge) { return !edge.inter; }), edges.end());
+			}
+
+			// Costs are symmetric, so each search only needs to find the entrances after it:
+			for (std::size_t i = 0; i + 1 < nodes.size(); i += 1) {
+				cluster_distances(cluster, _nodes[nodes[i]].position, _distances);
+
+				for (std::size_t j = i + 1; j < nodes.size(); j += 1) {
+					const Vec2i & position = _nodes[nodes[j]].position;
+					float distance = _distances[(position[0] - origin[0]) + (position[1] - origin[1]) * size[0]];
+
+					if (distance >= 0) {
+						_nodes[nodes[i]].edges.push_back(Edge{nodes[j], distance, false});
+						_nodes[nodes[j]].edges.push_back(Edge{nodes[i], distance, false});
+					}
+				}
+			}
+		}
+
+		std::size_t HierarchicalPathFinder::update ()
+		{
+			std::vector<bool> reconnect(_cluster_nodes.size(), false);
+			std::vector<std::pair<std::size_t, std::size_t>> borders;
+
+			for (int cy = 0; cy < _clusters_high; cy += 1) {
+				for (int cx = 0; cx < _clusters_wide; cx += 1) {
+					std::size_t cluster = cluster_index(cx, cy);
+
+					if (!_dirty[cluster]) continue;
+
+					// All four borders of the cluster are recomputed, which changes the entrances of the neighbouring clusters:
+					borders.push_back(std::make_pair(cluster, 0));
+					borders.push_back(std::make_pair(cluster, 1));
+					reconnect[cluster] = true;
+
+					if (cx > 0) {
+						borders.push_back(std::make_pair(cluster_index(cx - 1, cy), 0));
+						reconnect[cluster_index(cx - 1, cy)] = true;
+					}
+
+					if (cy > 0) {
+						borders.push_back(std::make_pair(cluster_index(cx, cy - 1), 1));
+						reconnect[cluster_index(cx, cy - 1)] = true;
+					}
+
+					if (cx + 1 < _clusters_wide)
+						reconnect[cluster_index(cx + 1, cy)] = true;
+
+					if (cy + 1 < _clusters_high)
+						reconnect[cluster_index(cx, cy + 1)] = true;
+
+					_dirty[cluster] = false;
+				}
+			}
+
+			std::sort(borders.begin(), borders.end());
+			borders.erase(std::unique(borders.begin(), borders.end()), borders.end());
+
+			for (auto & border : borders)
+				remove_border_nodes(border.first, border.second);
+
+			for (auto & border : borders)
+				find_entrances(border.first, border.second);
+
+			std::size_t count = 0;
+			for (std::size_t cluster = 0; cluster < reconnect.size(); cluster += 1) {
+				if (reconnect[cluster]) {
+					connect_cluster(cluster);
+					count += 1;
+				}
+			}
+
+			return count;
+		}
+
+		std::size_t HierarchicalPathFinder::edge_count () const
+		{
+			std::size_t count = 0;
+
+			for (auto & nodes : _cluster_nodes) {
+				for (auto index : nodes)
+					count += _nodes[index].edges.size();
+			}
+
+			return count;
+		}
+
+		bool HierarchicalPathFinder::find_abstract_path (const Vec2i & start, const Vec2i & goal, PathT & waypoints)
+		{
+			if (!passable(start[0], start[1]) || !passable(goal[0], goal[1]))
+				return false;
+
+			if (std::find(_dirty.begin(), _dirty.end(), true) != _dirty.end())
+				update();
+
+			AbstractSearch & search = *_search;
+
+			search.start = (NodeIndexT)_nodes.size();
+			search.goal = search.start + 1;
+			search.start_position = start;
+			search.goal_position = goal;
+
+			search.start_links.clear();
+			search.goal_links.clear();
+
+			// Connect the start and goal to the entrances of their clusters:
+			Vec2i origin, size;
+			std::size_t start_cluster = cluster_for(start), goal_cluster = cluster_for(goal);
+
+			cluster_bounds(start_cluster, origin, size);
+			cluster_distances(start_cluster, start, _start_distances);
+
+			for (auto index : _cluster_nodes[start_cluster]) {
+				const Vec2i & position = _nodes[index].position;
+				float distance = _start_distances[(position[0] - origin[0]) + (position[1] - origin[1]) * size[0]];
+
+				if (distance >= 0)
+					search.start_links.push_back(AbstractSearch::LinkT(index, distance));
+			}
+
+			if (start_cluster == goal_cluster) {
+				float distance = _start_distances[(goal[0] - origin[0]) + (goal[1] - origin[1]) * size[0]];
+
+				if (distance >= 0)
+					search.start_links.push_back(AbstractSearch::LinkT(search.goal, distance));
+			}
+
+			cluster_bounds(goal_cluster, origin, size);
+			cluster_distances(goal_cluster, goal, _goal_distances);
+
+			for (auto index : _cluster_nodes[goal_cluster]) {
+				const Vec2i & position = _nodes[index].position;
+				float distance = _goal_distances[(position[0] - origin[0]) + (position[1] - origin[1]) * size[0]];
+
+				if (distance >= 0)
+					search.goal_links.push_back(AbstractSearch::LinkT(index, distance));
+			}
+
+			if (!_path_finder)
+				_path_finder.reset(new AbstractPathFinderT(search.start, search.goal, &search));
+			else
+				_path_finder->reset(search.start, search.goal);
+
+			_path_finder->find_path(1 << 30);
+
+			AbstractPathFinderT::PathT path = _path_finder->construct_current_path();
+
+			if (path.empty() || path.back() != search.goal)
+				return false;
+
+			waypoints.clear();
+			for (auto node : path)
+				waypoints.push_back(search.position(node));
+
+			return true;
+		}
+
+		bool HierarchicalPathFinder::refine (const PathT & waypoints, std::size_t index, PathT & path)
+		{
+			const Vec2i & from = waypoints[index], & to = waypoints[index + 1];
+
+			if (from == to) return true;
+
+			std::size_t cluster = cluster_for(from);
+
+			if (cluster != cluster_for(to)) {
+				// Entrances are adjacent cells on either side of a border:
+				if (!can_move(from[0], from[1], to[0] - from[0], to[1] - from[1]))
+					return false;
+
+				path.push_back(to);
+				return true;
+			}
+
+			Vec2i origin, size;
+			cluster_bounds(cluster, origin, size);
+
+			// Follow the distances from the destination downhill:
+			cluster_distances(cluster, to, _distances);
+
+			Vec2i current = from;
+			float distance = _distances[(current[0] - origin[0]) + (current[1] - origin[1]) * size[0]];
+
+			if (distance < 0)
+				return false;
+
+			while (current != to) {
+				Vec2i best = current;
+				float best_distance = distance;
+
+				for (int dy = -1; dy <= 1; dy += 1) {
+					for (int dx = -1; dx <= 1; dx += 1) {
+						int lx = current[0] + dx - origin[0], ly = current[1] + dy - origin[1];
+
+						if ((dx == 0 && dy == 0) || lx < 0 || ly < 0 || lx >= size[0] || ly >= size[1]) continue;
+
+						if (!can_move(current[0], current[1], dx, dy)) continue;
+
+						float next = _distances[lx + ly * size[0]];
+
+						if (next >= 0 && next < best_distance) {
+							best = Vec2i(current[0] + dx, current[1] + dy);
+							best_distance = next;
+						}
+					}
+				}
+
+				DREAM_ASSERT(best != current);
+
+				current = best;
+				distance = best_distance;
+
+				path.push_back(current);
+			}
+
+			return true;
+		}
+
+		bool HierarchicalPathFinder::find_path (const Vec2i & start, const Vec2i & goal, PathT & path)
+		{
+			PathT waypoints;
+
+			if (!find_abstract_path(start, goal, waypoints))
+				return false;
+
+			path.clear();
+			path.push_back(start);
+
+			for (std::size_t i = 0; i + 1 < waypoints.size(); i += 1) {
+				if (!refine(waypoints, i, path))
+					return false;
+			}
+
+			return true;
+		}
+
+// MARK: -
+// MARK: Unit Tests
+
+#ifdef ENABLE_TESTING
+		using namespace Events::Logging;
+		using namespace Core;
+
+		typedef PathFinder<TestGridSearch<HierarchicalPathFinder>, Vec2i, float, GridStepIndex<Vec2i>> TestHierarchicalPathFinderT;
+
+		static void add_random_walls (HierarchicalPathFinder & grid, std::size_t count, std::minstd_rand & random) {
+			for (std::size_t i = 0; i < count; i += 1) {
+				int x = random() % grid.width(), y = random() % grid.height(), length = 5 + random() % 40;
+				bool horizontal = random() % 2;
+
+				for (int j = 0; j < length; j += 1) {
+					if (horizontal && x + j < grid.width())
+						grid.set_blocked(x + j, y, true);
+					else if (!horizontal && y + j < grid.height())
+						grid.set_blocked(x, y + j, true);
+				}
+			}
+		}
+
+		UNIT_TEST(HierarchicalPathFinder)
+		{
+			testing("Refined paths");
+
+			std::minstd_rand random(31);
+			HierarchicalPathFinder grid(200, 150, 16);
+			add_random_walls(grid, 150, random);
+
+			check(grid.update() == grid.cluster_count()) << "All clusters were computed initially";
+			check(grid.node_count() > 0 && grid.edge_count() > 0) << "Abstract graph was built";
+
+			TestGridSearch<HierarchicalPathFinder> search = {&grid};
+			TestHierarchicalPathFinderT a_star(Vec2i(0, 0), Vec2i(0, 0), &search, GridStepIndex<Vec2i>(200, 150));
+
+			std::size_t found = 0, queries = 0;
+			bool valid = true, complete = true, near_optimal = true;
+			float total_cost = 0, total_optimal = 0;
+
+			while (queries < 100) {
+				Vec2i from(random() % 200, random() % 150), to(random() % 200, random() % 150);
+				if (!grid.passable(from[0], from[1]) || !grid.passable(to[0], to[1])) continue;
+
+				queries += 1;
+
+				a_star.reset(from, to);
+				a_star.find_path(1 << 30);
+				HierarchicalPathFinder::PathT expected = a_star.construct_current_path();
+
+				HierarchicalPathFinder::PathT path;
+				bool result = grid.find_path(from, to, path);
+
+				complete = complete && result == !expected.empty();
+				if (!result) continue;
+
+				found += 1;
+
+				float cost = test_grid_path_cost(grid, path), optimal = test_grid_path_cost(grid, expected);
+				valid = valid && cost >= 0 && path.front() == from && path.back() == to;
+				near_optimal = near_optimal && cost <= optimal * 1.5 + 2;
+
+				total_cost += cost;
+				total_optimal += optimal;
+			}
+
+			check(found > 50) << "Most paths were found";
+			check(complete) << "A path is found whenever one exists";
+			check(valid) << "Refined paths are connected and avoid obstacles";
+			check(near_optimal) << "Refined paths are close to optimal";
+
+			logger()->log(LOG_INFO, LogBuffer() << "Hierarchical paths are " << (total_cost / total_optimal - 1) * 100 << "% longer than optimal on average.");
+
+			testing("Lazy refinement");
+
+			HierarchicalPathFinder::PathT waypoints, lazy, complete_path;
+			Vec2i from, to;
+
+			// Find a long path which crosses several clusters:
+			do {
+				from = Vec2i(random() % 50, random() % 50);
+				to = Vec2i(150 + random() % 50, 100 + random() % 50);
+			} while (!grid.find_abstract_path(from, to, waypoints));
+
+			check(waypoints.size() > 2) << "Abstract path crosses several clusters";
+
+			lazy.push_back(from);
+			for (std::size_t i = 0; i + 1 < waypoints.size(); i += 1)
+				grid.refine(waypoints, i, lazy);
+
+			grid.find_path(from, to, complete_path);
+			check(lazy == complete_path) << "Refining each segment gives the complete path";
+
+			testing("Incremental updates");
+
+			// Wall off a column in one cluster:
+			for (int y = 32; y < 48; y += 1)
+				grid.set_blocked(40, y, true);
+
+			std::size_t updated = grid.update();
+			check(updated > 0 && updated <= 5) << "Only the changed cluster and its neighbours were updated";
+
+			// A second grid built from scratch with the same cells should have the same graph:
+			HierarchicalPathFinder rebuilt(200, 150, 16);
+			for (int y = 0; y < 150; y += 1) {
+				for (int x = 0; x < 200; x += 1)
+					rebuilt.set_blocked(x, y, !grid.passable(x, y));
+			}
+			rebuilt.update();
+
+			check(rebuilt.node_count() == grid.node_count()) << "Updated graph has the same entrances";
+			check(rebuilt.edge_count() == grid.edge_count()) << "Updated graph has the same edges";
+
+			valid = true;
+			for (unsigned i = 0; i < 50; i += 1) {
+				Vec2i from(random() % 200, random() % 150), to(random() % 200, random() % 150);
+				HierarchicalPathFinder::PathT path;
+
+				if (grid.find_path(from, to, path))
+					valid = valid && test_grid_path_cost(grid, path) >= 0;
+			}
+
+			check(valid) << "Paths avoid the new obstacles";
+		}
+
+		UNIT_TEST(HierarchicalPathFinderPerformance)
+		{
+			testing("Query latency by path length");
+
+			const int SIZE = 1024;
+
+			std::minstd_rand random(37);
+			HierarchicalPathFinder grid(SIZE, SIZE, 32);
+			add_random_walls(grid, 2000, random);
+
+			Stopwatch build_stopwatch;
+			build_stopwatch.start();
+			grid.update();
+			build_stopwatch.pause();
+
+			logger()->log(LOG_INFO, LogBuffer() << "Abstract graph: " << grid.node_count() << " nodes, " << grid.edge_count() << " edges, built in " << build_stopwatch.time() * 1e3 << "ms.");
+
+			TestGridSearch<HierarchicalPathFinder> search = {&grid};
+			TestHierarchicalPathFinderT a_star(Vec2i(0, 0), Vec2i(0, 0), &search, GridStepIndex<Vec2i>(SIZE, SIZE));
+
+			const int distances[] = {64, 256, 768};
+
+			for (int distance : distances) {
+				Stopwatch abstract_stopwatch, refine_stopwatch, a_star_stopwatch;
+				std::size_t queries = 0;
+
+				while (queries < 5) {
+					// The goal is between half and the full distance away:
+					Vec2i from(random() % (SIZE - distance), random() % (SIZE - distance / 2));
+					Vec2i to(from[0] + distance / 2 + random() % (distance / 2), from[1] + random() % (distance / 2));
+
+					if (!grid.passable(from[0], from[1]) || !grid.passable(to[0], to[1])) continue;
+
+					HierarchicalPathFinder::PathT waypoints, path;
+
+					abstract_stopwatch.start();
+					bool found = grid.find_abstract_path(from, to, waypoints);
+					abstract_stopwatch.pause();
+
+					if (!found) continue;
+
+					refine_stopwatch.start();
+					path.push_back(from);
+					for (std::size_t i = 0; i + 1 < waypoints.size(); i += 1)
+						grid.refine(waypoints, i, path);
+					refine_stopwatch.pause();
+
+					a_star_stopwatch.start();
+					a_star.reset(from, to);
+					a_star.find_path(1 << 30);
+					a_star_stopwatch.pause();
+
+					queries += 1;
+				}
+
+				logger()->log(LOG_INFO, LogBuffer() << "Distance up to " << distance << ": abstract search " << abstract_stopwatch.time() / queries * 1e3 << "ms, refinement " << refine_stopwatch.time() / queries * 1e3 << "ms, A* " << a_star_stopwatch.time() / queries * 1e3 << "ms per query.");
+			}
+
+			testing("Updating a cluster");
+
+			Stopwatch update_stopwatch;
+			update_stopwatch.start();
+			for (int x = 500; x < 520; x += 1)
+				grid.set_blocked(x, 500, true);
+			std::size_t updated = grid.update();
+			update_stopwatch.pause();
+
+			logger()->log(LOG_INFO, LogBuffer() << "Updated " << updated << " clusters in " << update_stopwatch.time() * 1e3 << "ms.");
+
+			check(updated < grid.cluster_count() / 10) << "Only nearby clusters were updated";
+		}
+#endif
+	}
+}
@@ -0,0 +1,129 @@
+//
+//  Simulation/HierarchicalPathFinder.h
+//  This file is part of the "Dream" project, and is released under the MIT license.
+//
+//  Created by agent on 18/10/26.
+//  Copyright (c) 2026 agent. All rights reserved.
+//
+//
+
+#ifndef _DREAM_SIMULATION_HIERARCHICALPATHFINDER_H
+#define _DREAM_SIMULATION_HIERARCHICALPATHFINDER_H
+
+#include "PathFinder.h"
+
+#include <Euclid/Numerics/Vector.h>
+
+#include <memory>
+#include <vector>
+
+namespace Dream {
+	namespace Simulation {
+		using Euclid::Numerics::Vec2i;
+
+		/**
+		 Hierarchical path finding (HPA*) for large 8-connected grids, using the same movement rules as JumpPointSearch.
+
+		 The grid is divided into square clusters. Wherever two clusters share an open border, entrance nodes are placed on each side, and the cost between every pair of entrances within a cluster is precomputed. A query connects the start and goal to the entrances of their clusters and searches this much smaller abstract graph, which gives a list of waypoints. Each segment between waypoints lies within one cluster, or crosses a border, and can be refined into cells when it is needed.
+
+		 When the grid changes, the affected clusters are marked dirty, and update() recomputes only the entrances and costs of those clusters and their neighbours.
+		 */
+		class HierarchicalPathFinder {
+		public:
+			typedef std::vector<Vec2i> PathT;
+
+			struct Edge {
+				NodeIndexT target;
+				float cost;
+
+				// Whether this edge crosses a cluster border, rather than connecting entrances within a cluster.
+				bool inter;
+			};
+
+			struct AbstractNode {
+				Vec2i position;
+				std::size_t cluster;
+				std::vector<Edge> edges;
+
+				AbstractNode (const Vec2i & position_, std::size_t cluster_) : position(position_), cluster(cluster_) {}
+			};
+
+		protected:
+			struct AbstractSearch;
+			typedef PathFinder<AbstractSearch, NodeIndexT, float> AbstractPathFinderT;
+
+			int _width, _height, _cluster_size;
+			int _clusters_wide, _clusters_high;
+
+			std::vector<bool> _blocked;
+
+			std::vector<AbstractNode> _nodes;
+			std::vector<NodeIndexT> _free_nodes;
+
+			// The entrance nodes in each cluster.
+			std::vector<std::vector<NodeIndexT>> _cluster_nodes;
+			std::vector<bool> _dirty;
+
+			// The entrance nodes on the right and top border of each cluster, on both sides.
+			std::vector<std::vector<NodeIndexT>> _border_nodes[2];
+
+			// Scratch space for searches within a cluster.
+			std::vector<float> _distances;
+			std::vector<float> _start_distances, _goal_distances;
+			std::vector<float> _tentative;
+			std::vector<std::pair<float, int>> _queue;
+
+			std::unique_ptr<AbstractSearch> _search;
+			std::unique_ptr<AbstractPathFinderT> _path_finder;
+
+			std::size_t cluster_index (int cx, int cy) const { return cx + cy * _clusters_wide; }
+			void cluster_bounds (std::size_t cluster, Vec2i & origin, Vec2i & size) const;
+
+			bool can_move (int x, int y, int dx, int dy) const;
+
+			// Computes the cost from the given cell to every cell in the cluster, moving only within the cluster. Unreachable cells are negative.
+			void cluster_distances (std::size_t cluster, const Vec2i & from, std::vector<float> & distances);
+
+			NodeIndexT add_node (const Vec2i & position);
+			void remove_border_nodes (std::size_t cluster, std::size_t side);
+			void find_entrances (std::size_t cluster, std::size_t side);
+			void connect_cluster (std::size_t cluster);
+
+		public:
+			HierarchicalPathFinder (int width, int height, int cluster_size = 16);
+			virtual ~HierarchicalPathFinder ();
+
+			int width () const { return _width; }
+			int height () const { return _height; }
+
+			bool passable (int x, int y) const {
+				return x >= 0 && y >= 0 && x < _width && y < _height && !_blocked[x + y * _width];
+			}
+
+			std::size_t cluster_for (const Vec2i & position) const {
+				return cluster_index(position[0] / _cluster_size, position[1] / _cluster_size);
+			}
+
+			// Changes the grid and marks the cluster as dirty. The next query calls update() if it was not done explicitly.
+			void set_blocked (int x, int y, bool blocked);
+
+			// Recompute the abstract graph for dirty clusters. Returns the number of clusters whose entrances and costs were recomputed.
+			std::size_t update ();
+
+			std::size_t cluster_count () const { return _cluster_nodes.size(); }
+			std::size_t node_count () const { return _nodes.size() - _free_nodes.size(); }
+			std::size_t edge_count () const;
+
+			// Search the abstract graph. The waypoints include the start and goal, and consecutive waypoints are either in the same cluster or adjacent across a border.
+			bool find_abstract_path (const Vec2i & start, const Vec2i & goal, PathT & waypoints);
+
+			// Append the cells after waypoints[index] up to and including waypoints[index + 1] to the path.
+			bool refine (const PathT & waypoints, std::size_t index, PathT & path);
+
+			// Find the abstract path and refine it completely.
+			bool find_path (const Vec2i & start, const Vec2i & goal, PathT & path);
+		};
+	}
+}
+
+#endif
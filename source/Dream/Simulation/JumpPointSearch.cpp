@@ -0,0 +1,437 @@
+//
+//  Simulation/JumpPointSearch.cpp
+//  This file is part of the "Dream" project, and is released under the MIT license.
+//
+//  Created by agent on 18/10/26.
+//  Copyright (c) 2026 agent. All rights reserved.
+//
+//
+
+#include "JumpPointSearch.h"
+#include "../Assertion.h"
+
+#include <cmath>
+#include <cstdlib>
+#include <limits>
+
+#ifdef ENABLE_TESTING
+#include "TestGridSearch.h"
+#include "../Core/Timer.h"
+#include "../Events/Logger.h"
+
+#include <random>
+#endif
+
+namespace Dream {
+	namespace Simulation {
+		static int sign (int value) {
+			return (value > 0) - (value < 0);
+		}
+
+		// The eight directions are stored in row order, skipping the centre.
+		static std::size_t direction_index (int dx, int dy) {
+			std::size_t index = (dy + 1) * 3 + (dx + 1);
+
+			return index > 4 ? index - 1 : index;
+		}
+
+		JumpPointSearch::JumpPointSearch (int width, int height) : _width(width), _height(height), _blocked(width * height, false)
+		{
+		}
+
+		void JumpPointSearch::set_blocked (int x, int y, bool blocked)
+		{
+			_blocked[x + y * _width] = blocked;
+			_jump_distances.clear();
+		}
+
+		bool JumpPointSearch::can_move (int x, int y, int dx, int dy) const
+		{
+			if (!passable(x + dx, y + dy))
+				return false;
+
+			return dx == 0 || dy == 0 || (passable(x + dx, y) && passable(x, y + dy));
+		}
+
+		bool JumpPointSearch::has_forced_neighbour (int x, int y, int dx, int dy) const
+		{
+			if (dx) {
+				return (passable(x, y - 1) && !passable(x - dx, y - 1)) || (passable(x, y + 1) && !passable(x - dx, y + 1));
+			} else {
+				return (passable(x - 1, y) && !passable(x - 1, y - dy)) || (passable(x + 1, y) && !passable(x + 1, y - dy));
+			}
+		}
+
+		bool JumpPointSearch::jump (const Vec2i & from, int dx, int dy, const Vec2i & goal, Vec2i & result) const
+		{
+			int x = from[0], y = from[1];
+
+			while (can_move(x, y, dx, dy)) {
+				x += dx;
+				y += dy;
+
+				if (x == goal[0] && y == goal[1]) {
+					result = goal;
+					return true;
+				}
+
+				Vec2i unused;
+				if (dx && dy) {
+					// A diagonal jump stops where either straight jump finds something:
+					if (jump(Vec2i(x, y), dx, 0, goal, unused) || jump(Vec2i(x, y), 0, dy, goal, unused)) {
+						result = Vec2i(x, y);
+						return true;
+					}
+				} else if (has_forced_neighbour(x, y, dx, dy)) {
+					result = Vec2i(x, y);
+					return true;
+				}
+			}
+
+			return false;
+		}
+
+		std::int16_t JumpPointSearch::jump_distance (int x, int y, int dx, int dy) const
+		{
+			return _jump_distances[(x + y * _width) * 8 + direction_index(dx, dy)];
+		}
+
+		void JumpPointSearch::build_jump_table ()
+		{
+			DREAM_ASSERT(_width < std::numeric_limits<std::int16_t>::max() && _height < std::numeric_limits<std::int16_t>::max());
+
+			_jump_distances.assign(_width * _height * 8, 0);
+
+			// Straight directions must be computed first, as diagonal jumps depend on them:
+			const int directions[8][2] = {{1, 0}, {-1, 0}, {0, 1}, {0, -1}, {1, 1}, {-1, 1}, {1, -1}, {-1, -1}};
+
+			for (auto & direction : directions) {
+				int dx = direction[0], dy = direction[1];
+				std::size_t index = direction_index(dx, dy);
+
+				// Visit cells so that the next cell in the direction has already been computed:
+				for (int j = 0; j < _height; j += 1) {
+					int y = dy > 0 ? _height - 1 - j : j;
+
+					for (int i = 0; i < _width; i += 1) {
+						int x = dx > 0 ? _width - 1 - i : i;
+						std::int16_t distance = 0;
+
+						if (can_move(x, y, dx, dy)) {
+							int nx = x + dx, ny = y + dy;
+							bool jump_point;
+
+							if (dx && dy)
+								jump_point = jump_distance(nx, ny, dx, 0) > 0 || jump_distance(nx, ny, 0, dy) > 0;
+							else
+								jump_point = has_forced_neighbour(nx, ny, dx, dy);
+
+							if (jump_point) {
+								distance = 1;
+							} else {
+								std::int16_t next = jump_distance(nx, ny, dx, dy);
+								distance = next > 0 ? next + 1 : next - 1;
+							}
+						}
+
+						_jump_distances[(x + y * _width) * 8 + index] = distance;
+					}
+				}
+			}
+		}
+
+		void JumpPointSearch::jump_with_table (const Vec2i & from, int dx, int dy, const Vec2i & goal)
+		{
+			int distance = jump_distance(from[0], from[1], dx, dy);
+			int reach = std::abs(distance);
+
+			int gx = goal[0] - from[0], gy = goal[1] - from[1];
+
+			if (dx && dy) {
+				// The cells on the diagonal which share a row or column with the goal may lead straight to it:
+				if (sign(gx) == dx && sign(gy) == dy) {
+					int targets[2] = {std::abs(gx), std::abs(gy)};
+
+					for (std::size_t i = 0; i < 2; i += 1) {
+						if (targets[i] <= reach && targets[i] != distance && (i == 0 || targets[1] != targets[0]))
+							_successors.push_back(Vec2i(from[0] + dx * targets[i], from[1] + dy * targets[i]));
+					}
+				}
+			} else {
+				// The goal is ahead on the same line:
+				int ahead = dx ? gx * dx : gy * dy;
+
+				if ((dx ? gy : gx) == 0 && ahead > 0 && ahead <= reach) {
+					_successors.push_back(goal);
+					return;
+				}
+			}
+
+			if (distance > 0)
+				_successors.push_back(Vec2i(from[0] + dx * distance, from[1] + dy * distance));
+		}
+
+		void JumpPointSearch::find_successors (const Vec2i & step, const Vec2i * parent, const Vec2i & goal)
+		{
+			int x = step[0], y = step[1];
+			int directions[8][2];
+			std::size_t count = 0;
+
+			if (parent) {
+				// Prune the neighbours which can be reached at least as cheaply without passing through this step:
+				int dx = sign(x - (*parent)[0]), dy = sign(y - (*parent)[1]);
+
+				if (dx && dy) {
+					directions[count][0] = 0; directions[count++][1] = dy;
+					directions[count][0] = dx; directions[count++][1] = 0;
+					directions[count][0] = dx; directions[count++][1] = dy;
+				} else if (dx) {
+					directions[count][0] = dx; directions[count++][1] = 0;
+					directions[count][0] = dx; directions[count++][1] = 1;
+					directions[count][0] = dx; directions[count++][1] = -1;
+					directions[count][0] = 0; directions[count++][1] = 1;
+					directions[count][0] = 0; directions[count++][1] = -1;
+				} else {
+					directions[count][0] = 0; directions[count++][1] = dy;
+					directions[count][0] = 1; directions[count++][1] = dy;
+					directions[count][0] = -1; directions[count++][1] = dy;
+					directions[count][0] = 1; directions[count++][1] = 0;
+					directions[count][0] = -1; directions[count++][1] = 0;
+				}
+			} else {
+				for (int dy = -1; dy <= 1; dy += 1) {
+					for (int dx = -1; dx <= 1; dx += 1) {
+						if (dx || dy) {
+							directions[count][0] = dx;
+							directions[count++][1] = dy;
+						}
+					}
+				}
+			}
+
+			_successors.clear();
+
+			for (std::size_t i = 0; i < count; i += 1) {
+				int dx = directions[i][0], dy = directions[i][1];
+
+				if (has_jump_table()) {
+					jump_with_table(step, dx, dy, goal);
+				} else {
+					Vec2i result;
+
+					if (jump(step, dx, dy, goal, result))
+						_successors.push_back(result);
+				}
+			}
+		}
+
+		JumpPointSearch::PathFinderT JumpPointSearch::path_finder (const Vec2i & start, const Vec2i & goal)
+		{
+			return PathFinderT(start, goal, this, GridStepIndex<Vec2i>(_width, _height));
+		}
+
+		JumpPointSearch::PathT JumpPointSearch::expand_path (const PathT & jump_points)
+		{
+			PathT path;
+
+			for (std::size_t i = 0; i < jump_points.size(); i += 1) {
+				if (i == 0) {
+					path.push_back(jump_points[i]);
+					continue;
+				}
+
+				Vec2i step = jump_points[i - 1];
+				int dx = sign(jump_points[i][0] - step[0]), dy = sign(jump_points[i][1] - step[1]);
+
+				while (step != jump_points[i]) {
+					step = Vec2i(step[0] + dx, step[1] + dy);
+					path.push_back(step);
+				}
+			}
+
+			return path;
+		}
+
+		float JumpPointSearch::estimate_path_cost (const Vec2i & from, const Vec2i & to) const
+		{
+			return octile_distance(from, to);
+		}
+
+// MARK: -
+// MARK: Unit Tests
+
+#ifdef ENABLE_TESTING
+		using namespace Events::Logging;
+		using namespace Core;
+
+		typedef PathFinder<TestGridSearch<JumpPointSearch>, Vec2i, float, GridStepIndex<Vec2i>> TestGridPathFinderT;
+
+		static JumpPointSearch random_grid (int width, int height, unsigned density, std::minstd_rand & random) {
+			JumpPointSearch grid(width, height);
+
+			for (int y = 0; y < height; y += 1) {
+				for (int x = 0; x < width; x += 1) {
+					if ((random() % 100) < density)
+						grid.set_blocked(x, y, true);
+				}
+			}
+
+			return grid;
+		}
+
+		UNIT_TEST(JumpPointSearch)
+		{
+			testing("Optimality");
+
+			std::minstd_rand random(17);
+			std::size_t queries = 0, found = 0;
+			bool optimal = true, valid = true, tables_match = true;
+
+			for (unsigned density = 0; density <= 40; density += 10) {
+				JumpPointSearch grid = random_grid(48, 48, density, random);
+				JumpPointSearch table_grid = grid;
+				table_grid.build_jump_table();
+
+				TestGridSearch<JumpPointSearch> search = {&grid};
+				TestGridPathFinderT a_star(Vec2i(0, 0), Vec2i(0, 0), &search, GridStepIndex<Vec2i>(48, 48));
+
+				JumpPointSearch::PathFinderT jps = grid.path_finder(Vec2i(0, 0), Vec2i(0, 0));
+				JumpPointSearch::PathFinderT jps_plus = table_grid.path_finder(Vec2i(0, 0), Vec2i(0, 0));
+
+				for (unsigned i = 0; i < 40; i += 1) {
+					Vec2i from(random() % 48, random() % 48), to(random() % 48, random() % 48);
+					if (!grid.passable(from[0], from[1]) || !grid.passable(to[0], to[1])) continue;
+
+					queries += 1;
+
+					a_star.reset(from, to);
+					a_star.find_path(1 << 30);
+					JumpPointSearch::PathT expected = a_star.construct_current_path();
+
+					jps.reset(from, to);
+					jps.find_path(1 << 30);
+					JumpPointSearch::PathT path = JumpPointSearch::expand_path(jps.construct_current_path());
+
+					jps_plus.reset(from, to);
+					jps_plus.find_path(1 << 30);
+					JumpPointSearch::PathT table_path = JumpPointSearch::expand_path(jps_plus.construct_current_path());
+
+					if (expected.empty()) {
+						valid = valid && path.empty() && table_path.empty();
+						continue;
+					}
+
+					found += 1;
+
+					float cost = test_grid_path_cost(grid, path), table_cost = test_grid_path_cost(grid, table_path), expected_cost = test_grid_path_cost(grid, expected);
+
+					valid = valid && cost >= 0 && table_cost >= 0 && path.front() == from && path.back() == to && table_path.front() == from && table_path.back() == to;
+					optimal = optimal && std::abs(cost - expected_cost) < 0.001 * (1 + expected_cost);
+					tables_match = tables_match && std::abs(table_cost - expected_cost) < 0.001 * (1 + expected_cost);
+				}
+			}
+
+			check(found > queries / 2) << "Most paths were found";
+			check(valid) << "Expanded paths are connected and avoid obstacles";
+			check(optimal) << "Jump point search finds paths as short as A*";
+			check(tables_match) << "Jump point search with a jump table finds paths as short as A*";
+
+			testing("Iteration budget");
+
+			JumpPointSearch grid = random_grid(64, 64, 20, random);
+			grid.set_blocked(0, 0, false);
+			grid.set_blocked(63, 63, false);
+
+			JumpPointSearch::PathFinderT complete = grid.path_finder(Vec2i(0, 0), Vec2i(63, 63)), incremental = grid.path_finder(Vec2i(0, 0), Vec2i(63, 63));
+			complete.find_path(1 << 30);
+
+			std::size_t frames = 1;
+			while (!incremental.find_path(2))
+				frames += 1;
+
+			check(frames > 1) << "Search was spread across several calls";
+			check(incremental.construct_current_path() == complete.construct_current_path()) << "Incremental search finds the same path";
+		}
+
+		UNIT_TEST(JumpPointSearchPerformance)
+		{
+			testing("Searching a 1024x1024 grid");
+
+			// A mostly open map with scattered walls:
+			std::minstd_rand random(23);
+			JumpPointSearch grid(1024, 1024);
+
+			for (unsigned i = 0; i < 400; i += 1) {
+				int x = random() % 1024, y = random() % 1024, length = 10 + random() % 60;
+				bool horizontal = random() % 2;
+
+				for (int j = 0; j < length; j += 1) {
+					if (horizontal && x + j < 1024)
+						grid.set_blocked(x + j, y, true);
+					else if (!horizontal && y + j < 1024)
+						grid.set_blocked(x, y + j, true);
+				}
+			}
+
+			std::vector<std::pair<Vec2i, Vec2i>> queries;
+			while (queries.size() < 10) {
+				Vec2i from(random() % 1024, random() % 1024), to(random() % 1024, random() % 1024);
+
+				if (grid.passable(from[0], from[1]) && grid.passable(to[0], to[1]))
+					queries.push_back(std::make_pair(from, to));
+			}
+
+			TestGridSearch<JumpPointSearch> search = {&grid};
+			TestGridPathFinderT a_star(Vec2i(0, 0), Vec2i(0, 0), &search, GridStepIndex<Vec2i>(1024, 1024));
+			JumpPointSearch::PathFinderT jps = grid.path_finder(Vec2i(0, 0), Vec2i(0, 0));
+
+			Stopwatch a_star_stopwatch, jps_stopwatch, table_stopwatch, jps_plus_stopwatch;
+			std::size_t a_star_expanded = 0, jps_expanded = 0, jps_plus_expanded = 0;
+			bool same_cost = true;
+
+			std::vector<float> costs;
+
+			a_star_stopwatch.start();
+			for (auto & query : queries) {
+				a_star.reset(query.first, query.second);
+				a_star.find_path(1 << 30);
+
+				a_star_expanded += a_star.closed_count();
+				costs.push_back(test_grid_path_cost(grid, a_star.construct_current_path()));
+			}
+			a_star_stopwatch.pause();
+
+			jps_stopwatch.start();
+			for (std::size_t i = 0; i < queries.size(); i += 1) {
+				jps.reset(queries[i].first, queries[i].second);
+				jps.find_path(1 << 30);
+
+				jps_expanded += jps.closed_count();
+				same_cost = same_cost && std::abs(test_grid_path_cost(grid, JumpPointSearch::expand_path(jps.construct_current_path())) - costs[i]) < 0.01 * (1 + costs[i]);
+			}
+			jps_stopwatch.pause();
+
+			table_stopwatch.start();
+			grid.build_jump_table();
+			table_stopwatch.pause();
+
+			jps_plus_stopwatch.start();
+			for (std::size_t i = 0; i < queries.size(); i += 1) {
+				jps.reset(queries[i].first, queries[i].second);
+				jps.find_path(1 << 30);
+
+				jps_plus_expanded += jps.closed_count();
+				same_cost = same_cost && std::abs(test_grid_path_cost(grid, JumpPointSearch::expand_path(jps.construct_current_path())) - costs[i]) < 0.01 * (1 + costs[i]);
+			}
+			jps_plus_stopwatch.pause();
+
+			logger()->log(LOG_INFO, LogBuffer() << "A*: " << a_star_stopwatch.time() / queries.size() * 1e3 << "ms per query, " << a_star_expanded / queries.size() << " nodes expanded.");
+			logger()->log(LOG_INFO, LogBuffer() << "JPS: " << jps_stopwatch.time() / queries.size() * 1e3 << "ms per query, " << jps_expanded / queries.size() << " nodes expanded.");
+			logger()->log(LOG_INFO, LogBuffer() << "JPS+: " << jps_plus_stopwatch.time() / queries.size() * 1e3 << "ms per query, " << jps_plus_expanded / queries.size() << " nodes expanded, table built in " << table_stopwatch.time() * 1e3 << "ms.");
+
+			check(same_cost) << "All searches find paths of the same cost";
+			check(jps_expanded < a_star_expanded) << "Jump point search expands fewer nodes";
+		}
+#endif
+	}
+}
@@ -0,0 +1,108 @@
+//
+//  Simulation/JumpPointSearch.h
+//  This file is part of the "Dream" project, and is released under the MIT license.
+//
+//  Created by agent on 18/10/26.
+//  Copyright (c) 2026 agent. All rights reserved.
+//
+//
+
+#ifndef _DREAM_SIMULATION_JUMPPOINTSEARCH_H
+#define _DREAM_SIMULATION_JUMPPOINTSEARCH_H
+
+#include "PathFinder.h"
+
+#include <Euclid/Numerics/Vector.h>
+
+#include <cstdint>
+#include <vector>
+
+namespace Dream {
+	namespace Simulation {
+		using Euclid::Numerics::Vec2i;
+
+		/**
+		 A path finder interface for uniform cost, 8-connected grids, using jump point search.
+
+		 Rather than adding every neighbour of a cell, the search jumps in straight lines over cells which cannot be part of a shorter path, and only adds the cells where the path may need to turn. Diagonal moves are only allowed when both adjacent cells are passable, so paths never cut corners. The resulting paths are optimal, but only contain the jump points, which can be filled in using expand_path.
+
+		 Optionally, the jump distance from every cell in every direction can be precomputed (JPS+), so each jump is a table lookup. The table must be rebuilt after the grid is changed.
+		 */
+		class JumpPointSearch {
+		public:
+			typedef PathFinder<JumpPointSearch, Vec2i, float, GridStepIndex<Vec2i>> PathFinderT;
+			typedef PathFinderT::PathT PathT;
+
+		protected:
+			int _width, _height;
+			std::vector<bool> _blocked;
+
+			// For each cell and direction, the distance to the next jump point, or the negated number of steps which can be taken before reaching an obstacle.
+			std::vector<std::int16_t> _jump_distances;
+
+			std::vector<Vec2i> _successors;
+
+			bool can_move (int x, int y, int dx, int dy) const;
+
+			// Whether a straight move onto the given cell has a neighbour which can only be reached optimally through it.
+			bool has_forced_neighbour (int x, int y, int dx, int dy) const;
+
+			bool jump (const Vec2i & from, int dx, int dy, const Vec2i & goal, Vec2i & result) const;
+			void jump_with_table (const Vec2i & from, int dx, int dy, const Vec2i & goal);
+
+			std::int16_t jump_distance (int x, int y, int dx, int dy) const;
+
+			void find_successors (const Vec2i & step, const Vec2i * parent, const Vec2i & goal);
+
+		public:
+			JumpPointSearch (int width, int height);
+
+			int width () const { return _width; }
+			int height () const { return _height; }
+
+			bool passable (int x, int y) const {
+				return x >= 0 && y >= 0 && x < _width && y < _height && !_blocked[x + y * _width];
+			}
+
+			// Changing the grid discards the jump table.
+			void set_blocked (int x, int y, bool blocked);
+
+			// Precompute jump distances in linear time, after which searches use table lookups.
+			void build_jump_table ();
+			bool has_jump_table () const { return !_jump_distances.empty(); }
+
+			// Create a path finder with a dense step index for this grid.
+			PathFinderT path_finder (const Vec2i & start, const Vec2i & goal);
+
+			// Fill in the cells between consecutive jump points.
+			static PathT expand_path (const PathT & jump_points);
+
+			// MARK: Path finder interface
+
+			void notify_cost (const Vec2i &, float, float) {
+			}
+
+			template <typename NodeT, typename PathFinderT>
+			void add_steps_from (const NodeT * node, PathFinderT & path_finder) {
+				find_successors(node->step, node->parent ? &node->parent->step : NULL, path_finder.goal());
+
+				for (auto & successor : _successors)
+					path_finder.add_step(successor, node);
+			}
+
+			// Jump points are always connected by straight or diagonal lines, so the octile distance is exact.
+			float estimate_path_cost (const Vec2i & from, const Vec2i & to) const;
+
+			float exact_path_cost (const Vec2i & from, const Vec2i & to) const {
+				return estimate_path_cost(from, to);
+			}
+
+			template <typename PathFinderT>
+			bool is_goal_state (PathFinderT &, const Vec2i & from, const Vec2i & to) const {
+				return from == to;
+			}
+		};
+	}
+}
+
+#endif
@@ -0,0 +1,196 @@
+//
+//  Simulation/LooseTree.cpp
+//  This file is part of the "Dream" project, and is released under the MIT license.
+//
+//  Created by agent on 18/10/26.
+//  Copyright (c) 2026 agent. All rights reserved.
+//
+//
+
+#include "LooseTree.h"
+
+#ifdef ENABLE_TESTING
+#include "../Core/Timer.h"
+#include "../Events/Logger.h"
+
+#include <algorithm>
+#include <random>
+#endif
+
+namespace Dream {
+	namespace Geometry {
+
+// MARK: -
+// MARK: Unit Tests
+
+#ifdef ENABLE_TESTING
+		using namespace Events::Logging;
+		using namespace Core;
+
+		typedef LooseTree<Quadrants, unsigned> TestLooseTreeT;
+
+		static AlignedBox<2> random_box (std::minstd_rand & random, RealT extent, RealT size) {
+			std::uniform_real_distribution<RealT> position(0, extent), scale(0.1, size);
+			Vec2 origin(position(random), position(random));
+
+			return AlignedBox<2>(origin, origin + Vec2(scale(random), scale(random)));
+		}
+
+		static bool boxes_intersect (const AlignedBox<2> & a, const AlignedBox<2> & b) {
+			return a.min()[X] <= b.max()[X] && a.max()[X] >= b.min()[X] && a.min()[Y] <= b.max()[Y] && a.max()[Y] >= b.min()[Y];
+		}
+
+		static bool matches_brute_force (const TestLooseTreeT & tree, const std::vector<AlignedBox<2>> & boxes, const std::vector<bool> & present, const AlignedBox<2> & query) {
+			std::vector<unsigned> selection, expected;
+			tree.objects_in_rect(query, selection);
+
+			for (unsigned i = 0; i < boxes.size(); i += 1) {
+				if (present[i] && boxes_intersect(boxes[i], query))
+					expected.push_back(i);
+			}
+
+			std::sort(selection.begin(), selection.end());
+
+			return selection == expected;
+		}
+
+		UNIT_TEST(LooseTree)
+		{
+			testing("Insertion and queries");
+
+			std::minstd_rand random(42);
+			TestLooseTreeT tree(Vec2(0, 0), Vec2(1024, 1024), 6);
+
+			std::vector<AlignedBox<2>> boxes;
+			std::vector<TestLooseTreeT::HandleT> handles;
+			std::vector<bool> present;
+
+			for (unsigned i = 0; i < 2000; i += 1) {
+				boxes.push_back(random_box(random, 1000, 8));
+				handles.push_back(tree.insert(i, boxes.back()));
+				present.push_back(true);
+			}
+
+			check(tree.size() == 2000) << "All objects were inserted";
+			check(tree.node_count() > 1) << "Tree was subdivided";
+			check(tree.object(handles[10]) == 10) << "Objects can be found by handle";
+
+			bool correct = true;
+			for (unsigned i = 0; i < 50; i += 1)
+				correct = correct && matches_brute_force(tree, boxes, present, random_box(random, 1000, 100));
+
+			check(correct) << "Query results match brute force";
+
+			std::size_t visited = 0;
+			tree.objects_in_rect(AlignedBox<2>(Vec2(0, 0), Vec2(1024, 1024)), [&](unsigned, const AlignedBox<2> &) {
+				visited += 1;
+				return visited < 5;
+			});
+
+			check(visited == 5) << "Query stops early when the callback returns false";
+
+			testing("Moving objects");
+
+			std::size_t in_place = 0;
+			for (unsigned step = 0; step < 10; step += 1) {
+				for (unsigned i = 0; i < boxes.size(); i += 1) {
+					Vec2 offset(RealT(random() % 3) - 1, RealT(random() % 3) - 1);
+					boxes[i] = AlignedBox<2>(boxes[i].min() + offset, boxes[i].max() + offset);
+
+					if (tree.update(handles[i], boxes[i]))
+						in_place += 1;
+				}
+			}
+
+			check(in_place > (boxes.size() * 10 * 9) / 10) << "Most small movements are updated in place";
+			check(tree.size() == 2000) << "Moving objects does not change the count";
+
+			correct = true;
+			for (unsigned i = 0; i < 50; i += 1)
+				correct = correct && matches_brute_force(tree, boxes, present, random_box(random, 1000, 100));
+
+			check(correct) << "Query results match brute force after moving";
+
+			// Move everything into one corner:
+			for (unsigned i = 0; i < boxes.size(); i += 1) {
+				boxes[i] = random_box(random, 100, 4);
+				tree.update(handles[i], boxes[i]);
+			}
+
+			correct = true;
+			for (unsigned i = 0; i < 50; i += 1)
+				correct = correct && matches_brute_force(tree, boxes, present, random_box(random, 100, 20));
+
+			check(correct) << "Query results match brute force after clustering";
+
+			testing("Erasing and coalescing");
+
+			for (unsigned i = 0; i < boxes.size(); i += 2) {
+				tree.erase(handles[i]);
+				present[i] = false;
+			}
+
+			check(tree.size() == 1000) << "Objects were erased";
+
+			correct = true;
+			for (unsigned i = 0; i < 50; i += 1)
+				correct = correct && matches_brute_force(tree, boxes, present, random_box(random, 100, 20));
+
+			check(correct) << "Query results match brute force after erasing";
+
+			for (unsigned i = 1; i < boxes.size(); i += 2)
+				tree.erase(handles[i]);
+
+			check(tree.size() == 0) << "All objects were erased";
+			check(tree.node_count() == 1) << "Empty nodes were coalesced";
+
+			TestLooseTreeT::HandleT handle = tree.insert(7, AlignedBox<2>(Vec2(2000, 2000), Vec2(2010, 2010)));
+			check(tree.object(handle) == 7) << "Objects outside the bounds are kept at the root";
+			check(tree.node_for(handle).level == 0) << "Objects outside the bounds are kept at the root";
+		}
+
+		UNIT_TEST(LooseTreeUpdatePerformance)
+		{
+			testing("Moving entities");
+
+			const unsigned COUNT = 10000, STEPS = 10;
+
+			std::minstd_rand random(7);
+			TestLooseTreeT tree(Vec2(0, 0), Vec2(4096, 4096), 8);
+
+			std::vector<AlignedBox<2>> boxes;
+			std::vector<TestLooseTreeT::HandleT> handles;
+
+			for (unsigned i = 0; i < COUNT; i += 1) {
+				boxes.push_back(random_box(random, 4000, 8));
+				handles.push_back(tree.insert(i, boxes.back()));
+			}
+
+			std::vector<Vec2> velocities;
+			std::uniform_real_distribution<RealT> speed(-2, 2);
+			for (unsigned i = 0; i < COUNT; i += 1)
+				velocities.push_back(Vec2(speed(random), speed(random)));
+
+			std::size_t in_place = 0;
+			Stopwatch stopwatch;
+
+			stopwatch.start();
+			for (unsigned step = 0; step < STEPS; step += 1) {
+				for (unsigned i = 0; i < COUNT; i += 1) {
+					boxes[i] = AlignedBox<2>(boxes[i].min() + velocities[i], boxes[i].max() + velocities[i]);
+
+					if (tree.update(handles[i], boxes[i]))
+						in_place += 1;
+				}
+			}
+			stopwatch.pause();
+
+			TimeT per_update = stopwatch.time() / (COUNT * STEPS);
+			logger()->log(LOG_INFO, LogBuffer() << "Loose tree update: " << per_update * 1e9 << "ns per object, " << (in_place * 100) / (COUNT * STEPS) << "% updated in place.");
+
+			check(in_place > (COUNT * STEPS) / 2) << "Most updates do not change the structure of the tree";
+			check(tree.size() == COUNT) << "All objects are still in the tree";
+		}
+#endif
+	}
+}
@@ -0,0 +1,455 @@
+//
+//  Simulation/LooseTree.h
+//  This file is part of the "Dream" project, and is released under the MIT license.
+//
+//  Created by agent on 18/10/26.
+//  Copyright (c) 2026 agent. All rights reserved.
+//
+//
+
+#ifndef _DREAM_LOOSE_TREE_H
+#define _DREAM_LOOSE_TREE_H
+
+#include "AlignedTree.h"
+#include "../Assertion.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace Dream {
+	namespace Geometry {
+		/**
+		 A loose quad-tree or oct-tree, LooseTree<Quadrants> or LooseTree<Octants> respectively, designed for large numbers of moving objects.
+
+		 Each node covers an aligned cell, but accepts any object which fits within its loose bounds, which are the cell expanded by half its size on every side. An object is stored in the deepest existing node whose loose bounds contain it, so an object which moves a small distance relative to its size usually stays in the same node, and can be updated in constant time.
+
+		 Nodes are stored in a contiguous array. The children of a node are allocated together as one block, so only the index of the first child is stored. Objects are stored by value along with their bounding box in a contiguous array per node, and are referred to using stable handles. Leaf nodes are split when they contain more than the split threshold, and subtrees are coalesced back into their parent when they contain less than half of it.
+		 */
+		template <typename _TraitsT, typename ObjectT>
+		class LooseTree {
+		public:
+			typedef _TraitsT TraitsT;
+			typedef typename TraitsT::VecT VecT;
+			typedef typename TraitsT::SpaceT SpaceT;
+
+			typedef std::uint32_t HandleT;
+			typedef std::uint32_t IndexT;
+
+			static const IndexT NONE = (IndexT)-1;
+
+			struct Entry {
+				SpaceT bounding_box;
+				ObjectT object;
+				HandleT handle;
+			};
+
+			struct Node {
+				/// The minimum corner of the cell covered by this node.
+				VecT origin;
+
+				IndexT parent, children;
+				unsigned level;
+
+				/// The number of objects in this node and all of its children.
+				std::size_t count;
+
+				std::vector<Entry> entries;
+
+				bool is_leaf () const { return children == NONE; }
+			};
+
+		protected:
+			struct Item {
+				IndexT node, slot;
+			};
+
+			std::vector<Node> _nodes;
+			std::vector<IndexT> _free_blocks;
+
+			std::vector<Item> _items;
+			std::vector<HandleT> _free_handles;
+
+			/// The size of a cell at each level of the tree.
+			std::vector<VecT> _cell_sizes;
+			std::size_t _split_threshold;
+
+			static bool contains (const VecT & min, const VecT & max, const SpaceT & box) {
+				for (std::size_t i = 0; i < TraitsT::D; i += 1) {
+					if (box.min()[i] < min[i] || box.max()[i] > max[i])
+						return false;
+				}
+
+				return true;
+			}
+
+			static bool intersects (const VecT & min, const VecT & max, const SpaceT & box) {
+				for (std::size_t i = 0; i < TraitsT::D; i += 1) {
+					if (box.max()[i] < min[i] || box.min()[i] > max[i])
+						return false;
+				}
+
+				return true;
+			}
+
+			void loose_bounds (const Node & node, VecT & min, VecT & max) const {
+				const VecT & size = _cell_sizes[node.level];
+
+				min = node.origin - (size / 2);
+				max = node.origin + size + (size / 2);
+			}
+
+			/// The root accepts all objects, including those outside the bounds of the tree.
+			bool fits (IndexT index, const SpaceT & box) const {
+				if (index == 0) return true;
+
+				VecT min, max;
+				loose_bounds(_nodes[index], min, max);
+
+				return contains(min, max, box);
+			}
+
+			/// Descends from the given node to the deepest existing node which can contain the box.
+			IndexT find_node (IndexT index, const SpaceT & box) const {
+				VecT center = box.center();
+
+				while (!_nodes[index].is_leaf()) {
+					const Node & node = _nodes[index];
+					IndexT child = node.children + TraitsT::index_for_partition(center, node.origin + (_cell_sizes[node.level] / 2));
+
+					if (!fits(child, box))
+						break;
+
+					index = child;
+				}
+
+				return index;
+			}
+
+			void add_entry (IndexT index, const Entry & entry) {
+				Node & node = _nodes[index];
+
+				_items[entry.handle].node = index;
+				_items[entry.handle].slot = (IndexT)node.entries.size();
+
+				node.entries.push_back(entry);
+			}
+
+			/// Removes an entry by moving the last entry of the node into its slot.
+			Entry remove_entry (IndexT index, IndexT slot) {
+				Node & node = _nodes[index];
+				Entry entry = node.entries[slot];
+
+				if (slot + 1 != node.entries.size()) {
+					node.entries[slot] = node.entries.back();
+					_items[node.entries[slot].handle].slot = slot;
+				}
+
+				node.entries.pop_back();
+
+				return entry;
+			}
+
+			void adjust_count (IndexT index, long delta) {
+				for (; index != NONE; index = _nodes[index].parent)
+					_nodes[index].count += delta;
+			}
+
+			IndexT allocate_children (IndexT parent) {
+				IndexT first;
+
+				if (_free_blocks.size()) {
+					first = _free_blocks.back();
+					_free_blocks.pop_back();
+				} else {
+					first = (IndexT)_nodes.size();
+					_nodes.resize(_nodes.size() + TraitsT::Q);
+				}
+
+				const VecT & size = _cell_sizes[_nodes[parent].level];
+
+				for (IndexT i = 0; i < TraitsT::Q; i += 1) {
+					Node & child = _nodes[first + i];
+
+					child.origin = _nodes[parent].origin + (TraitsT::normal_origin_for_partition_index(i) * size);
+					child.parent = parent;
+					child.children = NONE;
+					child.level = _nodes[parent].level + 1;
+					child.count = 0;
+					child.entries.clear();
+				}
+
+				_nodes[parent].children = first;
+
+				return first;
+			}
+
+			// Moves objects which fit into the children of a leaf node.
+			void split (IndexT index) {
+				allocate_children(index);
+
+				std::vector<Entry> & entries = _nodes[index].entries;
+
+				for (IndexT slot = 0; slot < entries.size();) {
+					IndexT child = find_node(index, entries[slot].bounding_box);
+
+					if (child != index) {
+						Entry entry = remove_entry(index, slot);
+						add_entry(child, entry);
+						_nodes[child].count += 1;
+					} else {
+						slot += 1;
+					}
+				}
+			}
+
+			// Moves all objects from the children of a node into the node and releases the children.
+			void collapse (IndexT index) {
+				IndexT first = _nodes[index].children;
+
+				for (IndexT i = 0; i < TraitsT::Q; i += 1) {
+					Node & child = _nodes[first + i];
+
+					if (!child.is_leaf())
+						collapse(first + i);
+
+					for (auto & entry : child.entries)
+						add_entry(index, entry);
+
+					child.entries.clear();
+				}
+
+				_free_blocks.push_back(first);
+				_nodes[index].children = NONE;
+			}
+
+			/// Coalesces the highest ancestor whose subtree has become sparse.
+			void coalesce (IndexT index) {
+				IndexT sparse = NONE;
+
+				for (; index != NONE; index = _nodes[index].parent) {
+					if (!_nodes[index].is_leaf() && _nodes[index].count <= _split_threshold / 2)
+						sparse = index;
+				}
+
+				if (sparse != NONE)
+					collapse(sparse);
+			}
+
+			void place (const Entry & entry) {
+				IndexT index = find_node(0, entry.bounding_box);
+
+				add_entry(index, entry);
+				adjust_count(index, 1);
+
+				Node & node = _nodes[index];
+				if (node.is_leaf() && node.entries.size() > _split_threshold && node.level + 1 < _cell_sizes.size())
+					split(index);
+			}
+
+			template <typename FunctionT>
+			bool visit (IndexT index, const SpaceT & box, FunctionT & callback) const {
+				const Node & node = _nodes[index];
+
+				if (node.count == 0) return true;
+
+				if (index != 0) {
+					VecT min, max;
+					loose_bounds(node, min, max);
+
+					if (!intersects(min, max, box))
+						return true;
+				}
+
+				for (auto & entry : node.entries) {
+					if (intersects(entry.bounding_box.min(), entry.bounding_box.max(), box)) {
+						if (!callback(entry.object, entry.bounding_box))
+							return false;
+					}
+				}
+
+				if (!node.is_leaf()) {
+					for (IndexT i = 0; i < TraitsT::Q; i += 1) {
+						if (!visit(node.children + i, box, callback))
+							return false;
+					}
+				}
+
+				return true;
+			}
+
+			template <typename VolumeT, typename FunctionT>
+			bool visit_volume (IndexT index, const VolumeT & volume, unsigned long mask, FunctionT & callback) const {
+				const Node & node = _nodes[index];
+
+				if (node.count == 0) return true;
+
+				// Once a node is entirely inside the volume, so are all of its objects and children:
+				if (index != 0 && mask != 0) {
+					VecT min, max;
+					loose_bounds(node, min, max);
+
+					long result = volume.classify(SpaceT(min, max), mask);
+					if (result < 0) return true;
+
+					mask = result;
+				}
+
+				for (auto & entry : node.entries) {
+					if (mask == 0 || volume.classify(entry.bounding_box, mask) >= 0) {
+						if (!callback(entry.object, entry.bounding_box))
+							return false;
+					}
+				}
+
+				if (!node.is_leaf()) {
+					for (IndexT i = 0; i < TraitsT::Q; i += 1) {
+						if (!visit_volume(node.children + i, volume, mask, callback))
+							return false;
+					}
+				}
+
+				return true;
+			}
+
+		public:
+			/// The maximum depth limits how far the space is subdivided, the root is at depth zero.
+			LooseTree (const VecT & origin, const VecT & size, unsigned maximum_depth = 8, std::size_t split_threshold = 16) : _split_threshold(split_threshold)
+			{
+				DREAM_ASSERT(split_threshold > 1);
+
+				VecT cell_size = size;
+				for (unsigned level = 0; level <= maximum_depth; level += 1) {
+					_cell_sizes.push_back(cell_size);
+					cell_size /= 2;
+				}
+
+				_nodes.resize(1);
+				_nodes[0].origin = origin;
+				_nodes[0].parent = NONE;
+				_nodes[0].children = NONE;
+				_nodes[0].level = 0;
+				_nodes[0].count = 0;
+			}
+
+			/// Insert an object using the bounding box provided by the traits.
+			HandleT insert (ObjectT object) {
+				return insert(object, TraitsT::calculate_bounding_box(object));
+			}
+
+			/// Insert an object with the given bounding box. The returned handle remains valid until the object is erased.
+			HandleT insert (ObjectT object, const SpaceT & bounding_box) {
+				HandleT handle;
+
+				if (_free_handles.size()) {
+					handle = _free_handles.back();
+					_free_handles.pop_back();
+				} else {
+					handle = (HandleT)_items.size();
+					_items.push_back(Item());
+				}
+
+				place(Entry{bounding_box, object, handle});
+
+				return handle;
+			}
+
+			/// Update the bounding box of an object. Returns true if the object stayed within the loose bounds of its node, which requires no changes to the structure of the tree.
+			bool update (HandleT handle, const SpaceT & bounding_box) {
+				Item & item = _items[handle];
+
+				if (fits(item.node, bounding_box)) {
+					_nodes[item.node].entries[item.slot].bounding_box = bounding_box;
+
+					return true;
+				}
+
+				IndexT index = item.node;
+				Entry entry = remove_entry(index, item.slot);
+				adjust_count(index, -1);
+
+				entry.bounding_box = bounding_box;
+				place(entry);
+
+				coalesce(index);
+
+				return false;
+			}
+
+			void erase (HandleT handle) {
+				Item & item = _items[handle];
+				IndexT index = item.node;
+
+				remove_entry(index, item.slot);
+				adjust_count(index, -1);
+
+				item.node = NONE;
+				_free_handles.push_back(handle);
+
+				coalesce(index);
+			}
+
+			const ObjectT & object (HandleT handle) const {
+				const Item & item = _items[handle];
+
+				return _nodes[item.node].entries[item.slot].object;
+			}
+
+			const SpaceT & bounding_box (HandleT handle) const {
+				const Item & item = _items[handle];
+
+				return _nodes[item.node].entries[item.slot].bounding_box;
+			}
+
+			/// The node which currently contains the given object.
+			const Node & node_for (HandleT handle) const {
+				return _nodes[_items[handle].node];
+			}
+
+			/// The total number of objects in the tree.
+			std::size_t size () const { return _nodes[0].count; }
+
+			/// The number of nodes in use, including the root.
+			std::size_t node_count () const { return _nodes.size() - (_free_blocks.size() * TraitsT::Q); }
+
+			const Node & top () const { return _nodes[0]; }
+
+			/// Calls callback(object, bounding_box) for every object whose bounding box intersects the given box. The search stops early if the callback returns false.
+			template <typename FunctionT>
+			void objects_in_rect (const SpaceT & box, FunctionT callback) const {
+				visit(0, box, callback);
+			}
+
+			/**
+			 Calls callback(object, bounding_box) for every object whose bounding box intersects the volume, e.g. a view frustum. The search stops early if the callback returns false.
+
+			 The volume must provide classify(box, mask), which returns -1 if the box is outside, and otherwise the part of the mask which still needs to be tested for anything inside the box. Subtrees outside the volume are skipped, and the objects of subtrees which are entirely inside are accepted without testing them.
+			 */
+			template <typename VolumeT, typename FunctionT>
+			bool visit_objects_in_volume (const VolumeT & volume, unsigned long mask, FunctionT callback) const {
+				return visit_volume(0, volume, mask, callback);
+			}
+
+			/// Appends every object whose bounding box intersects the given box to the selection.
+			void objects_in_rect (const SpaceT & box, std::vector<ObjectT> & selection) const {
+				objects_in_rect(box, [&](const ObjectT & object, const SpaceT &) {
+					selection.push_back(object);
+					return true;
+				});
+			}
+
+			/// Removes all objects and nodes.
+			void clear () {
+				_nodes.resize(1);
+				_nodes[0].children = NONE;
+				_nodes[0].count = 0;
+				_nodes[0].entries.clear();
+
+				_free_blocks.clear();
+				_items.clear();
+				_free_handles.clear();
+			}
+		};
+	}
+}
+
+#endif
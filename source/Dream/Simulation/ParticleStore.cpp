@@ -0,0 +1,513 @@
+//
+//  Simulation/ParticleStore.cpp
+//  This file is part of the "Dream" project, and is released under the MIT license.
+//
+//  Created by agent on 18/10/26.
+//  Copyright (c) 2026 agent. All rights reserved.
+//
+//
+
+#include "ParticleStore.h"
+#include "../Events/Thread.h"
+
+#include <algorithm>
+#include <cmath>
+
+#ifdef ENABLE_TESTING
+#include "../Core/Timer.h"
+#include "../Events/Logger.h"
+
+#include <random>
+#endif
+
+namespace Dream {
+	namespace Simulation {
+		ParticleStore::ParticleStore () : _size(0)
+		{
+		}
+
+		void ParticleStore::reserve (std::size_t capacity)
+		{
+			for (auto & values : _attributes)
+				values.reserve(capacity);
+		}
+
+		void ParticleStore::clear ()
+		{
+			for (auto & values : _attributes)
+				values.clear();
+
+			_size = 0;
+		}
+
+		std::size_t ParticleStore::add (const Vec3 & position, const Vec3 & velocity, RealT life)
+		{
+			const RealT defaults[ATTRIBUTE_COUNT] = {
+				position[X], position[Y], position[Z],
+				velocity[X], velocity[Y], velocity[Z],
+				1, 1, 1, 1,
+				0, life,
+				0, 1, 0,
+				-1, 0, 0,
+				0, 0, 1, 1
+			};
+
+			for (std::size_t i = 0; i < ATTRIBUTE_COUNT; i += 1)
+				_attributes[i].push_back(defaults[i]);
+
+			return _size++;
+		}
+
+		Vec3 ParticleStore::position (std::size_t index) const
+		{
+			return Vec3(_attributes[POSITION_X][index], _attributes[POSITION_Y][index], _attributes[POSITION_Z][index]);
+		}
+
+		Vec3 ParticleStore::velocity (std::size_t index) const
+		{
+			return Vec3(_attributes[VELOCITY_X][index], _attributes[VELOCITY_Y][index], _attributes[VELOCITY_Z][index]);
+		}
+
+		void ParticleStore::set_color (std::size_t index, const Vec3 & color)
+		{
+			_attributes[COLOR_R][index] = color[0];
+			_attributes[COLOR_G][index] = color[1];
+			_attributes[COLOR_B][index] = color[2];
+		}
+
+		void ParticleStore::set_orientation (std::size_t index, const Vec3 & up, const Vec3 & forward, RealT rotation)
+		{
+			// Rotating a vector perpendicular to the forward axis by 90 degrees gives the cross product:
+			Vec3 side = cross_product(forward, up);
+			Vec3 rotated_up = up, rotated_side = side;
+
+			if (rotation != 0) {
+				RealT c = std::cos(rotation), s = std::sin(rotation);
+
+				rotated_up = up * c + side * s;
+				rotated_side = side * c - up * s;
+			}
+
+			for (std::size_t i = 0; i < 3; i += 1) {
+				_attributes[UP_X + i][index] = rotated_up[i];
+				_attributes[SIDE_X + i][index] = rotated_side[i];
+			}
+		}
+
+		void ParticleStore::set_mapping (std::size_t index, const Vec2u & count, const Vec2u & cell)
+		{
+			Vec2 size = Vec2(1, 1) / count;
+
+			_attributes[MAPPING_U0][index] = size[X] * cell[X];
+			_attributes[MAPPING_V0][index] = size[Y] * cell[Y];
+			_attributes[MAPPING_U1][index] = size[X] * (cell[X] + 1);
+			_attributes[MAPPING_V1][index] = size[Y] * (cell[Y] + 1);
+		}
+
+		void ParticleStore::integrate (std::size_t begin, std::size_t end, RealT dt, const Vec3 & force)
+		{
+			RealT * age = attribute(AGE);
+
+			for (std::size_t i = begin; i < end; i += 1)
+				age[i] += dt;
+
+			for (std::size_t axis = 0; axis < 3; axis += 1) {
+				RealT * position = attribute(Attribute(POSITION_X + axis)), * velocity = attribute(Attribute(VELOCITY_X + axis));
+				RealT acceleration = force[axis] * dt, displacement = force[axis] * dt * dt * 0.5;
+
+				for (std::size_t i = begin; i < end; i += 1) {
+					position[i] += velocity[i] * dt + displacement;
+					velocity[i] += acceleration;
+				}
+			}
+		}
+
+		void ParticleStore::integrate (RealT dt, const Vec3 & force)
+		{
+			integrate(0, _size, dt, force);
+		}
+
+		void ParticleStore::fade (std::size_t begin, std::size_t end, RealT timeout, RealT ramp)
+		{
+			const RealT * age = attribute(AGE), * life = attribute(LIFE);
+			RealT * alpha = attribute(ALPHA);
+
+			RealT inverse_timeout = timeout > 0 ? 1 / timeout : 0, inverse_ramp = ramp > 0 ? 1 / ramp : 0;
+
+			for (std::size_t i = begin; i < end; i += 1) {
+				RealT remaining = life[i] - age[i];
+
+				// Without a timeout, particles stay opaque until they expire.
+				RealT value = timeout > 0 ? std::min(remaining * inverse_timeout, RealT(1)) : (remaining > 0 ? 1 : 0);
+
+				if (ramp > 0)
+					value = std::min(value, age[i] * inverse_ramp);
+
+				alpha[i] = std::max(value, RealT(0));
+			}
+		}
+
+		void ParticleStore::fade (RealT timeout, RealT ramp)
+		{
+			fade(0, _size, timeout, ramp);
+		}
+
+		std::size_t ParticleStore::expire ()
+		{
+			const RealT * age = attribute(AGE), * life = attribute(LIFE);
+
+			_alive.resize(_size);
+
+			std::size_t alive = 0;
+			for (std::size_t i = 0; i < _size; i += 1) {
+				_alive[i] = age[i] < life[i];
+				alive += _alive[i];
+			}
+
+			if (alive == _size)
+				return 0;
+
+			// Compact each attribute separately, so each pass reads and writes a single array:
+			for (auto & values : _attributes) {
+				std::size_t next = 0;
+
+				for (std::size_t i = 0; i < _size; i += 1) {
+					values[next] = values[i];
+					next += _alive[i];
+				}
+
+				values.resize(alive);
+			}
+
+			std::size_t removed = _size - alive;
+			_size = alive;
+
+			return removed;
+		}
+
+		void ParticleStore::expand_quads (std::size_t begin, std::size_t end, ParticleVertex * vertices) const
+		{
+			for (std::size_t i = begin; i < end; i += 1) {
+				Vec3 position = this->position(i);
+				Vec3 up(_attributes[UP_X][i], _attributes[UP_Y][i], _attributes[UP_Z][i]);
+				Vec3 side(_attributes[SIDE_X][i], _attributes[SIDE_Y][i], _attributes[SIDE_Z][i]);
+				Vec4 color(_attributes[COLOR_R][i], _attributes[COLOR_G][i], _attributes[COLOR_B][i], _attributes[ALPHA][i]);
+
+				RealT u0 = _attributes[MAPPING_U0][i], v0 = _attributes[MAPPING_V0][i], u1 = _attributes[MAPPING_U1][i], v1 = _attributes[MAPPING_V1][i];
+
+				ParticleVertex * quad = vertices + (i - begin) * 4;
+
+				quad[0].position = position; quad[0].offset = up; quad[0].mapping = Vec2(u0, v0); quad[0].color = color;
+				quad[1].position = position; quad[1].offset = side; quad[1].mapping = Vec2(u1, v0); quad[1].color = color;
+				quad[2].position = position; quad[2].offset = -up; quad[2].mapping = Vec2(u1, v1); quad[2].color = color;
+				quad[3].position = position; quad[3].offset = -side; quad[3].mapping = Vec2(u0, v1); quad[3].color = color;
+			}
+		}
+
+		void ParticleStore::expand_quads (ParticleVertex * vertices) const
+		{
+			expand_quads(0, _size, vertices);
+		}
+
+		void ParticleStore::update (RealT dt, const Vec3 & force, RealT timeout, RealT ramp, Events::WorkerPool * pool, ParticleVertex * vertices)
+		{
+			std::size_t chunks = (_size + CHUNK_SIZE - 1) / CHUNK_SIZE;
+
+			_alive.resize(_size);
+			_chunk_offsets.resize(chunks + 1);
+
+			auto for_each_chunk = [&](const std::function<void(std::size_t)> & function) {
+				Events::parallel_for(pool, chunks, function);
+			};
+
+			// Update each chunk and count its survivors:
+			for_each_chunk([&](std::size_t chunk) {
+				std::size_t begin = chunk * CHUNK_SIZE, end = std::min(begin + CHUNK_SIZE, _size);
+
+				integrate(begin, end, dt, force);
+				fade(begin, end, timeout, ramp);
+
+				const RealT * age = attribute(AGE), * life = attribute(LIFE);
+				std::size_t alive = 0;
+
+				for (std::size_t i = begin; i < end; i += 1) {
+					_alive[i] = age[i] < life[i];
+					alive += _alive[i];
+				}
+
+				_chunk_offsets[chunk + 1] = alive;
+			});
+
+			// The prefix sum gives each chunk a disjoint range of the output:
+			_chunk_offsets[0] = 0;
+			for (std::size_t chunk = 0; chunk < chunks; chunk += 1)
+				_chunk_offsets[chunk + 1] += _chunk_offsets[chunk];
+
+			std::size_t alive = _chunk_offsets[chunks];
+
+			// Chunks can't be compacted in place, as a chunk's output may overlap the input of the chunk before it:
+			if (alive != _size) {
+				for (auto & values : _compacted)
+					values.resize(alive);
+
+				for_each_chunk([&](std::size_t chunk) {
+					std::size_t begin = chunk * CHUNK_SIZE, end = std::min(begin + CHUNK_SIZE, _size);
+					std::size_t offset = _chunk_offsets[chunk], count = _chunk_offsets[chunk + 1] - offset;
+
+					for (std::size_t attribute = 0; attribute < ATTRIBUTE_COUNT; attribute += 1) {
+						const RealT * source = _attributes[attribute].data();
+						RealT * destination = _compacted[attribute].data() + offset;
+
+						if (count == end - begin) {
+							std::copy(source + begin, source + end, destination);
+						} else {
+							std::size_t next = 0;
+
+							for (std::size_t i = begin; i < end; i += 1) {
+								if (_alive[i]) destination[next++] = source[i];
+							}
+						}
+					}
+				});
+
+				for (std::size_t attribute = 0; attribute < ATTRIBUTE_COUNT; attribute += 1)
+					_attributes[attribute].swap(_compacted[attribute]);
+
+				_size = alive;
+			}
+
+			if (vertices) {
+				for_each_chunk([&](std::size_t chunk) {
+					std::size_t begin = _chunk_offsets[chunk], end = _chunk_offsets[chunk + 1];
+
+					expand_quads(begin, end, vertices + begin * 4);
+				});
+			}
+		}
+
+// MARK: -
+// MARK: Unit Tests
+
+#ifdef ENABLE_TESTING
+		using namespace Events::Logging;
+		using namespace Core;
+
+		UNIT_TEST(ParticleStore)
+		{
+			testing("Integration");
+
+			ParticleStore store;
+			store.add(Vec3(0, 0, 0), Vec3(1, 2, 0), 1.0);
+			store.add(Vec3(10, 0, 0), Vec3(0, 0, 0), 3.0);
+
+			Vec3 gravity(0, 0, -10);
+			for (std::size_t i = 0; i < 4; i += 1)
+				store.integrate(0.25, gravity);
+
+			// Constant acceleration is integrated exactly: p = p0 + v0 t + a t^2 / 2
+			check((store.position(0) - Vec3(1, 2, -5)).length() < 1e-4) << "Position follows the force";
+			check((store.velocity(0) - Vec3(1, 2, -10)).length() < 1e-4) << "Velocity follows the force";
+
+			testing("Fading");
+
+			store.fade(0.5, 0.1);
+			check(std::abs(store.attribute(ParticleStore::ALPHA)[0]) < 1e-5) << "Expired particle is transparent";
+			check(std::abs(store.attribute(ParticleStore::ALPHA)[1] - 1) < 1e-5) << "Young particle is opaque";
+
+			store.integrate(1.75);
+			store.fade(0.5);
+			check(std::abs(store.attribute(ParticleStore::ALPHA)[1] - 0.5) < 1e-5) << "Particle fades during the timeout";
+
+			store.fade(0);
+			check(store.attribute(ParticleStore::ALPHA)[0] == 0 && store.attribute(ParticleStore::ALPHA)[1] == 1) << "Particles are cut off without a timeout";
+
+			testing("Expiring");
+
+			ParticleStore particles;
+			for (std::size_t i = 0; i < 10; i += 1)
+				particles.add(Vec3(i, 0, 0), Vec3(0, 0, 0), (i % 3) + 0.5);
+
+			particles.integrate(1.0);
+			check(particles.expire() == 4) << "Particles past their life were removed";
+			check(particles.size() == 6) << "Remaining particles are kept";
+
+			bool ordered = true;
+			for (std::size_t i = 0; i < particles.size(); i += 1)
+				ordered = ordered && particles.attribute(ParticleStore::LIFE)[i] > 1 && (i == 0 || particles.position(i)[X] > particles.position(i-1)[X]);
+
+			check(ordered) << "Remaining particles keep their order";
+
+			testing("Quads");
+
+			particles.set_color(0, Vec3(1, 0.5, 0.25));
+			particles.set_mapping(0, Vec2u(4, 2), Vec2u(1, 1));
+
+			std::vector<ParticleVertex> vertices(particles.size() * 4);
+			particles.expand_quads(vertices.data());
+
+			check(vertices[0].position == particles.position(0) && vertices[3].position == particles.position(0)) << "Quad is centered on the particle";
+			check(vertices[0].offset == -vertices[2].offset && vertices[1].offset == -vertices[3].offset) << "Corners are opposite";
+			check(vertices[0].mapping == Vec2(0.25, 0.5) && vertices[2].mapping == Vec2(0.5, 1)) << "Mapping selects the cell";
+			check(vertices[1].color == Vec4(1, 0.5, 0.25, 1)) << "Color includes alpha";
+			check(vertices[4].position == particles.position(1)) << "Next quad belongs to the next particle";
+		}
+
+		UNIT_TEST(ParticleStoreParallelUpdate)
+		{
+			testing("Deterministic parallel updates");
+
+			std::minstd_rand random(5);
+			ParticleStore initial;
+
+			for (std::size_t i = 0; i < 50000; i += 1) {
+				std::size_t index = initial.add(Vec3(random() % 100, 0, 0), Vec3(random() % 100 / 10.0, random() % 100 / 10.0, 1), random() % 1000 / 1000.0);
+				initial.set_color(index, Vec3(random() % 100 / 100.0, 0.5, 1));
+			}
+
+			ParticleStore serial = initial, parallel = initial, pair = initial;
+			Ref<Events::WorkerPool> pool = new Events::WorkerPool(3), pool_of_two = new Events::WorkerPool(1);
+
+			std::vector<ParticleVertex> serial_vertices(initial.size() * 4), parallel_vertices(initial.size() * 4), pair_vertices(initial.size() * 4);
+			bool identical = true;
+
+			for (std::size_t frame = 0; frame < 20; frame += 1) {
+				serial.update(0.03, Vec3(0, 0, -9.8), 0.2, 0.05, NULL, serial_vertices.data());
+				parallel.update(0.03, Vec3(0, 0, -9.8), 0.2, 0.05, pool.get(), parallel_vertices.data());
+				pair.update(0.03, Vec3(0, 0, -9.8), 0.2, 0.05, pool_of_two.get(), pair_vertices.data());
+
+				identical = identical && serial.size() == parallel.size() && serial.size() == pair.size();
+
+				for (std::size_t attribute = 0; identical && attribute < ParticleStore::ATTRIBUTE_COUNT; attribute += 1) {
+					std::size_t bytes = serial.size() * sizeof(RealT);
+					ParticleStore::Attribute name = ParticleStore::Attribute(attribute);
+
+					identical = memcmp(serial.attribute(name), parallel.attribute(name), bytes) == 0 && memcmp(serial.attribute(name), pair.attribute(name), bytes) == 0;
+				}
+
+				std::size_t vertex_bytes = serial.size() * 4 * sizeof(ParticleVertex);
+				identical = identical && memcmp(serial_vertices.data(), parallel_vertices.data(), vertex_bytes) == 0 && memcmp(serial_vertices.data(), pair_vertices.data(), vertex_bytes) == 0;
+			}
+
+			check(serial.size() > 0 && serial.size() < initial.size()) << "Some particles expired";
+			check(identical) << "Particles and vertices are byte for byte identical for any number of threads";
+
+			// The bulk operations give the same particles:
+			ParticleStore separate = initial;
+			for (std::size_t frame = 0; frame < 20; frame += 1) {
+				separate.integrate(0.03, Vec3(0, 0, -9.8));
+				separate.fade(0.2, 0.05);
+				separate.expire();
+			}
+
+			bool same = separate.size() == serial.size();
+			for (std::size_t i = 0; same && i < serial.size(); i += 1)
+				same = (separate.position(i) - serial.position(i)).length() < 1e-4;
+
+			check(same) << "Parallel update matches the separate operations";
+		}
+
+		// The array of structures layout used by ParticleRenderer, for comparison.
+		struct TestParticle {
+			ParticleVertex vertices[4];
+
+			Vec3 velocity, position, color;
+			RealT life, age;
+
+			bool update_time (RealT dt, const Vec3 & force) {
+				age += dt;
+
+				if (age < life) {
+					position += (velocity * dt) + (force * dt * dt * 0.5);
+
+					for (std::size_t i = 0; i < 4; i += 1)
+						vertices[i].position = position;
+
+					velocity += force * dt;
+
+					return true;
+				}
+
+				return false;
+			}
+		};
+
+		UNIT_TEST(ParticleStorePerformance)
+		{
+			testing("Updating 1M particles");
+
+			const std::size_t COUNT = 1000000, FRAMES = 10;
+			const RealT DT = 1.0 / 60.0;
+			Vec3 force(0, 0, -9.8);
+
+			std::minstd_rand random(1);
+
+			ParticleStore store;
+			store.reserve(COUNT);
+
+			std::vector<TestParticle> particles(COUNT);
+
+			for (std::size_t i = 0; i < COUNT; i += 1) {
+				Vec3 velocity(random() % 100 / 10.0, random() % 100 / 10.0, random() % 100 / 10.0);
+				RealT life = 1 + random() % 1000 / 100.0;
+
+				store.add(Vec3(0, 0, 0), velocity, life);
+
+				TestParticle & particle = particles[i];
+				particle.position = Vec3(0, 0, 0);
+				particle.velocity = velocity;
+				particle.life = life;
+				particle.age = 0;
+			}
+
+			ParticleStore parallel_store = store;
+			Ref<Events::WorkerPool> pool = new Events::WorkerPool;
+
+			Stopwatch store_stopwatch, expand_stopwatch, parallel_stopwatch, particles_stopwatch;
+			std::vector<ParticleVertex> vertices(COUNT * 4);
+
+			for (std::size_t frame = 0; frame < FRAMES; frame += 1) {
+				store_stopwatch.start();
+				store.integrate(DT, force);
+				store.fade(0.5);
+				store.expire();
+				store_stopwatch.pause();
+
+				expand_stopwatch.start();
+				store.expand_quads(vertices.data());
+				expand_stopwatch.pause();
+
+				parallel_stopwatch.start();
+				parallel_store.update(DT, force, 0.5, 0, pool.get(), vertices.data());
+				parallel_stopwatch.pause();
+
+				// The previous update loop, which also writes the vertices of every particle:
+				particles_stopwatch.start();
+				std::size_t i = 0;
+				while (i < particles.size()) {
+					TestParticle & particle = particles[i];
+
+					if (particle.update_time(DT, force)) {
+						for (std::size_t j = 0; j < 4; j += 1)
+							particle.vertices[j].color = (particle.color << 0.0) + Vec4(0, 0, 0, std::min(RealT(1), (particle.life - particle.age) * 2));
+
+						memcpy(&vertices[i * 4], particle.vertices, sizeof(particle.vertices));
+						i += 1;
+					} else {
+						particles[i] = particles.back();
+						particles.pop_back();
+					}
+				}
+				particles_stopwatch.pause();
+			}
+
+			RealT updates = COUNT * FRAMES;
+
+			logger()->log(LOG_INFO, LogBuffer() << "Structure of arrays: " << updates / store_stopwatch.time() / 1e6 << "M updates/s, expanding quads " << updates / expand_stopwatch.time() / 1e6 << "M particles/s");
+			logger()->log(LOG_INFO, LogBuffer() << "Parallel update with " << pool->thread_count() << " threads: " << updates / parallel_stopwatch.time() / 1e6 << "M particles/s including quads");
+			logger()->log(LOG_INFO, LogBuffer() << "Array of structures: " << updates / particles_stopwatch.time() / 1e6 << "M updates/s including vertices");
+
+			check(store.size() == particles.size() && parallel_store.size() == particles.size()) << "All updates expire the same particles";
+		}
+#endif
+	}
+}
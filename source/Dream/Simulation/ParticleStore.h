@@ -0,0 +1,119 @@
+//
+//  Simulation/ParticleStore.h
+//  This file is part of the "Dream" project, and is released under the MIT license.
+//
+//  Created by agent on 18/10/26.
+//  Copyright (c) 2026 agent. All rights reserved.
+//
+//
+
+#ifndef _DREAM_SIMULATION_PARTICLESTORE_H
+#define _DREAM_SIMULATION_PARTICLESTORE_H
+
+#include "../Framework.h"
+
+#include <Euclid/Numerics/Vector.h>
+
+#include <vector>
+
+namespace Dream {
+	namespace Events {
+		class WorkerPool;
+	}
+
+	namespace Simulation {
+		using namespace Euclid::Numerics;
+
+		// The vertex layout used by ParticleRenderer, four per particle.
+		struct ParticleVertex {
+			Vec3 position;
+			Vec3 offset;
+			Vec2 mapping;
+			Vec4 color;
+		};
+
+		/**
+		 Particle storage as a structure of arrays, where each attribute of every particle is stored in its own contiguous array.
+
+		 The common cases of integrating under a constant force, fading out and expiring are applied to all particles with simple loops over these arrays, which the compiler can vectorize. Particles are only expanded into vertex quads when they are uploaded for drawing.
+		 */
+		class ParticleStore {
+		public:
+			enum Attribute {
+				POSITION_X, POSITION_Y, POSITION_Z,
+				VELOCITY_X, VELOCITY_Y, VELOCITY_Z,
+				COLOR_R, COLOR_G, COLOR_B, ALPHA,
+				AGE, LIFE,
+
+				// The offsets of the quad's corners from its center are up, side, -up and -side:
+				UP_X, UP_Y, UP_Z,
+				SIDE_X, SIDE_Y, SIDE_Z,
+
+				// The texture coordinates of the bottom left and top right corners:
+				MAPPING_U0, MAPPING_V0, MAPPING_U1, MAPPING_V1,
+
+				ATTRIBUTE_COUNT
+			};
+
+			// Parallel updates work on chunks of this many particles. The chunks don't depend on the number of threads, so neither do the results.
+			static const std::size_t CHUNK_SIZE = 4096;
+
+		protected:
+			std::vector<RealT> _attributes[ATTRIBUTE_COUNT];
+			std::size_t _size;
+
+			std::vector<unsigned char> _alive;
+
+			// The surviving particles are written here by parallel updates, then swapped with the attributes.
+			std::vector<RealT> _compacted[ATTRIBUTE_COUNT];
+			std::vector<std::size_t> _chunk_offsets;
+
+			void integrate (std::size_t begin, std::size_t end, RealT dt, const Vec3 & force);
+			void fade (std::size_t begin, std::size_t end, RealT timeout, RealT ramp);
+			void expand_quads (std::size_t begin, std::size_t end, ParticleVertex * vertices) const;
+
+		public:
+			ParticleStore ();
+
+			std::size_t size () const { return _size; }
+
+			void reserve (std::size_t capacity);
+			void clear ();
+
+			// Adds a particle with white color, full alpha, and a unit quad facing along the z axis. Returns the index of the particle.
+			std::size_t add (const Vec3 & position, const Vec3 & velocity, RealT life);
+
+			// Direct access to an attribute of all particles, for updates which are not covered below.
+			RealT * attribute (Attribute attribute) { return _attributes[attribute].data(); }
+			const RealT * attribute (Attribute attribute) const { return _attributes[attribute].data(); }
+
+			Vec3 position (std::size_t index) const;
+			Vec3 velocity (std::size_t index) const;
+
+			void set_color (std::size_t index, const Vec3 & color);
+
+			// The quad is centered on the particle, perpendicular to the forward direction, and rotated around it by the given angle in radians.
+			void set_orientation (std::size_t index, const Vec3 & up, const Vec3 & forward, RealT rotation = 0);
+
+			// Select one cell from a texture divided into count cells.
+			void set_mapping (std::size_t index, const Vec2u & count, const Vec2u & cell);
+
+			// Age all particles and move them under a constant force.
+			void integrate (RealT dt, const Vec3 & force = ZERO);
+
+			// Fade out particles during the last timeout seconds of their life, and optionally fade them in during the first ramp seconds. A timeout of zero keeps particles opaque until they expire.
+			void fade (RealT timeout, RealT ramp = 0);
+
+			// Remove particles which have reached the end of their life, preserving the order of the rest. Returns the number of particles removed.
+			std::size_t expire ();
+
+			// Write four vertices per particle.
+			void expand_quads (ParticleVertex * vertices) const;
+
+			// Integrate, fade and expire all particles in chunks spread across the pool, and if vertices are given, write the quads of the surviving particles. Surviving particles keep their order, and the results are identical for any number of threads.
+			void update (RealT dt, const Vec3 & force, RealT timeout, RealT ramp = 0, Events::WorkerPool * pool = NULL, ParticleVertex * vertices = NULL);
+		};
+	}
+}
+
+#endif
@@ -9,5 +9,190 @@
 
 #include "PathFinder.h"
 
+#ifdef ENABLE_TESTING
+#include "TestGridSearch.h"
+#include "../Core/Timer.h"
+#include "../Events/Logger.h"
+
+#include <cmath>
+#include <queue>
+#include <random>
+#endif
+
 namespace Dream {
+	namespace Simulation {
+
+// MARK: -
+// MARK: Unit Tests
+
+#ifdef ENABLE_TESTING
+		using namespace Events::Logging;
+		using namespace Core;
+
+		struct TestGridHash {
+			std::size_t operator() (const Vec2i & step) const {
+				return (std::size_t)step[0] * 73856093 ^ (std::size_t)step[1] * 19349663;
+			}
+		};
+
+		// A grid with randomly blocked cells.
+		struct TestGrid {
+			int width, height;
+			std::vector<bool> blocked;
+
+			TestGrid (int _width, int _height, unsigned density, unsigned seed) : width(_width), height(_height), blocked(_width * _height) {
+				std::minstd_rand random(seed);
+
+				for (std::size_t i = 0; i < blocked.size(); i += 1)
+					blocked[i] = (random() % 100) < density;
+			}
+
+			bool passable (int x, int y) const {
+				return x >= 0 && y >= 0 && x < width && y < height && !blocked[x + y * width];
+			}
+
+			// The exact cost of the shortest path using Dijkstra's algorithm, or -1 if there is no path.
+			float shortest_path_cost (const Vec2i & from, const Vec2i & to) const {
+				typedef std::pair<float, int> EntryT;
+
+				std::vector<float> costs(width * height, -1);
+				std::priority_queue<EntryT, std::vector<EntryT>, std::greater<EntryT>> queue;
+
+				queue.push(EntryT(0, from[0] + from[1] * width));
+
+				while (!queue.empty()) {
+					EntryT entry = queue.top();
+					queue.pop();
+
+					if (costs[entry.second] >= 0) continue;
+					costs[entry.second] = entry.first;
+
+					Vec2i step(entry.second % width, entry.second / width);
+					if (step == to) return entry.first;
+
+					for_each_test_grid_step(*this, step, [&](const Vec2i & next) {
+						queue.push(EntryT(entry.first + test_grid_step_cost(step, next), next[0] + next[1] * width));
+					});
+				}
+
+				return -1;
+			}
+
+			Vec2i random_open_step (std::minstd_rand & random) {
+				Vec2i step(random() % width, random() % height);
+				blocked[step[0] + step[1] * width] = false;
+
+				return step;
+			}
+		};
+
+		typedef PathFinder<TestGridSearch<TestGrid>, Vec2i, float, HashedStepIndex<Vec2i, TestGridHash>> TestHashedPathFinderT;
+		typedef PathFinder<TestGridSearch<TestGrid>, Vec2i, float, GridStepIndex<Vec2i>> TestGridPathFinderT;
+
+		UNIT_TEST(PathFinder)
+		{
+			testing("Shortest paths");
+
+			TestGrid grid(64, 64, 25, 1);
+			TestGridSearch<TestGrid> search = {&grid};
+			std::minstd_rand random(2);
+
+			TestGridPathFinderT reused(Vec2i(0, 0), Vec2i(0, 0), &search, GridStepIndex<Vec2i>(64, 64));
+
+			bool optimal = true, valid = true, consistent = true;
+			std::size_t found = 0;
+
+			for (unsigned i = 0; i < 50; i += 1) {
+				Vec2i from = grid.random_open_step(random), to = grid.random_open_step(random);
+				float expected = grid.shortest_path_cost(from, to);
+
+				TestHashedPathFinderT path_finder(from, to, &search);
+				path_finder.find_path(1 << 30);
+
+				std::vector<Vec2i> path = path_finder.construct_current_path();
+
+				if (expected < 0) {
+					optimal = optimal && path.empty();
+					continue;
+				}
+
+				found += 1;
+
+				float cost = test_grid_path_cost(grid, path);
+				valid = valid && path.front() == from && path.back() == to && cost >= 0;
+				optimal = optimal && std::abs(cost - expected) < 0.01;
+
+				// A reused path finder with a dense index finds a path of the same cost:
+				reused.reset(from, to);
+				reused.find_path(1 << 30);
+
+				consistent = consistent && std::abs(test_grid_path_cost(grid, reused.construct_current_path()) - expected) < 0.01;
+			}
+
+			check(found > 20) << "Most paths were found";
+			check(valid) << "Paths are connected and avoid obstacles";
+			check(optimal) << "Paths have the same cost as Dijkstra's algorithm";
+			check(consistent) << "Reused path finder finds the same paths";
+
+			testing("Iteration budget");
+
+			Vec2i from(0, 0), to(63, 63);
+			grid.blocked[0] = grid.blocked[63 + 63 * 64] = false;
+
+			TestHashedPathFinderT complete(from, to, &search), incremental(from, to, &search);
+			complete.find_path(1 << 30);
+
+			std::size_t frames = 1;
+			while (!incremental.find_path(20))
+				frames += 1;
+
+			check(frames > 1) << "Search was spread across several calls";
+			check(incremental.construct_current_path() == complete.construct_current_path()) << "Incremental search finds the same path";
+		}
+
+		UNIT_TEST(PathFinderPerformance)
+		{
+			testing("Searching a 1024x1024 grid");
+
+			TestGrid grid(1024, 1024, 20, 3);
+			TestGridSearch<TestGrid> search = {&grid};
+			std::minstd_rand random(4);
+
+			std::vector<std::pair<Vec2i, Vec2i>> queries;
+			for (unsigned i = 0; i < 10; i += 1) {
+				Vec2i from = grid.random_open_step(random), to = grid.random_open_step(random);
+				queries.push_back(std::make_pair(from, to));
+			}
+
+			Stopwatch hashed_stopwatch, grid_stopwatch;
+			std::size_t hashed_length = 0, grid_length = 0, expanded = 0;
+
+			hashed_stopwatch.start();
+			for (auto & query : queries) {
+				TestHashedPathFinderT path_finder(query.first, query.second, &search);
+				path_finder.find_path(1 << 30);
+
+				hashed_length += path_finder.construct_current_path().size();
+				expanded += path_finder.closed_count();
+			}
+			hashed_stopwatch.pause();
+
+			TestGridPathFinderT path_finder(Vec2i(0, 0), Vec2i(0, 0), &search, GridStepIndex<Vec2i>(1024, 1024));
+
+			grid_stopwatch.start();
+			for (auto & query : queries) {
+				path_finder.reset(query.first, query.second);
+				path_finder.find_path(1 << 30);
+
+				grid_length += path_finder.construct_current_path().size();
+			}
+			grid_stopwatch.pause();
+
+			logger()->log(LOG_INFO, LogBuffer() << "Hashed index: " << hashed_stopwatch.time() / queries.size() * 1e3 << "ms per query, " << expanded / queries.size() << " nodes expanded per query.");
+			logger()->log(LOG_INFO, LogBuffer() << "Grid index, reused: " << grid_stopwatch.time() / queries.size() * 1e3 << "ms per query.");
+
+			check(hashed_length == grid_length) << "Both indexes find paths of the same length";
+		}
+#endif
+	}
 }
@@ -10,11 +10,13 @@
 #ifndef _DREAM_SIMULATION_PATHFINDER_H
 #define _DREAM_SIMULATION_PATHFINDER_H
 
-#include <queue>
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <memory>
+#include <unordered_map>
 #include <vector>
-#include <set>
-#include <map>
-#include <iostream>
 
 namespace Dream {
 	namespace Simulation {
@@ -38,111 +40,255 @@ namespace Dream {
 		    };
 		*/
 
-		template <typename _InterfaceT, typename _StepT, typename _CostT = float>
+		typedef std::uint32_t NodeIndexT;
+		const NodeIndexT NO_NODE = (NodeIndexT)-1;
+
+		// The cost of a diagonal move on a uniform cost grid, where a straight move costs one.
+		const float DIAGONAL_COST = 1.41421356f;
+
+		// The octile distance between two cells of a uniform cost, 8-connected grid, which is the exact cost of the shortest path when there are no obstacles.
+		template <typename StepT>
+		float octile_distance (const StepT & from, const StepT & to) {
+			int dx = std::abs(from[0] - to[0]), dy = std::abs(from[1] - to[1]);
+
+			return std::max(dx, dy) + (DIAGONAL_COST - 1) * std::min(dx, dy);
+		}
+
+		// Maps steps to search nodes using a hash table, which keeps its buckets between searches.
+		template <typename StepT, typename HashT = std::hash<StepT>>
+		class HashedStepIndex {
+		protected:
+			std::unordered_map<StepT, NodeIndexT, HashT> _nodes;
+
+		public:
+			void clear () {
+				_nodes.clear();
+			}
+
+			// Returns the node for the given step, which is NO_NODE if the step has not been visited.
+			NodeIndexT & lookup (const StepT & step) {
+				auto result = _nodes.insert(std::make_pair(step, NO_NODE));
+
+				return result.first->second;
+			}
+		};
+
+		// Maps grid coordinates to search nodes using a dense array. Entries are tagged with the search which wrote them, so clearing the index between searches is constant time.
+		template <typename StepT>
+		class GridStepIndex {
+		protected:
+			struct Entry {
+				std::uint32_t search;
+				NodeIndexT node;
+			};
+
+			std::size_t _width, _height;
+			std::vector<Entry> _entries;
+			std::uint32_t _search;
+
+		public:
+			GridStepIndex (std::size_t width, std::size_t height) : _width(width), _height(height), _entries(width * height, Entry{0, NO_NODE}), _search(1) {
+			}
+
+			std::size_t width () const { return _width; }
+			std::size_t height () const { return _height; }
+
+			void clear () {
+				_search += 1;
+
+				if (_search == 0) {
+					std::fill(_entries.begin(), _entries.end(), Entry{0, NO_NODE});
+					_search = 1;
+				}
+			}
+
+			NodeIndexT & lookup (const StepT & step) {
+				Entry & entry = _entries[step[0] + step[1] * _width];
+
+				if (entry.search != _search) {
+					entry.search = _search;
+					entry.node = NO_NODE;
+				}
+
+				return entry.node;
+			}
+		};
+
+		template <typename _InterfaceT, typename _StepT, typename _CostT = float, typename _StepIndexT = HashedStepIndex<_StepT>>
 		class PathFinder {
 		public:
 			typedef _InterfaceT InterfaceT;
 			typedef _StepT StepT;
 			typedef _CostT CostT;
-			typedef std::set<StepT> StepsT;
+			typedef _StepIndexT StepIndexT;
 			typedef std::vector<StepT> PathT;
 
 			struct Node {
 				bool closed;
 
-				const StepT step;
-				const CostT cost_from_start;
-				const CostT cost_to_goal;
+				StepT step;
+				CostT cost_from_start;
+				CostT cost_to_goal;
 				const Node * parent;
 
-				Node (const StepT& _step, const CostT& _cost_from_start, const CostT& _cost_to_goal, const Node* _parent = NULL) : step(_step), cost_from_start(_cost_from_start), cost_to_goal(_cost_to_goal), parent(_parent), closed(false) {
-					//std::cout << "Total Cost (" << step << "): " << total() << std::endl;
-				}
+				// The position of this node in the open heap, or NO_NODE if it is not open.
+				NodeIndexT heap_index;
 
 				CostT total () const {
 					return cost_from_start+cost_to_goal;
 				}
 
+				// Prefer the node with the lowest total cost, and break ties towards the node closest to the goal, which avoids exploring equivalent paths.
 				bool operator< (const Node &other) const {
-					return total() < other.total();
-				}
+					CostT a = total(), b = other.total();
 
-				bool operator<= (const Node &other) const {
-					return total() <= other.total();
+					return a < b || (a == b && cost_to_goal < other.cost_to_goal);
 				}
-
-				bool operator> (const Node &other) const {
-					return total() > other.total();
-				}
-
-				bool operator>= (const Node &other) const {
-					return total() >= other.total();
-				}
-
-				struct greater : public std::binary_function<Node*, Node*, bool>{
-					bool operator()(const Node* a, const Node* b) const { return *a > *b; }
-				};
 			};
 
 			typedef std::vector<Node *> OpenT;
-			typedef std::set<const Node *> ClosedT;
 
 		protected:
-			void open_push(Node * node) {
-				_open.push_back(node);
-				std::push_heap(_open.begin(), _open.end(), typename Node::greater());
-			}
+			enum { CHUNK_SHIFT = 10, CHUNK_SIZE = 1 << CHUNK_SHIFT };
 
-			void open_pop() {
-				std::pop_heap(_open.begin(), _open.end(), typename Node::greater());
-				_open.pop_back();
-			}
+			// Nodes are allocated from chunks which are kept between searches, so pointers remain valid while searching and a reset search does not allocate.
+			std::vector<std::unique_ptr<Node[]>> _chunks;
+			NodeIndexT _node_count;
 
-			typedef std::map<StepT, Node*> TouchedT;
-			typedef std::pair<typename TouchedT::iterator, bool> TouchedResultT;
-			TouchedT _touched;
+			StepIndexT _index;
 
+			// An indexed binary min-heap, each node knows its position so its cost can be decreased in place.
 			OpenT _open;
-			ClosedT _closed;
+			std::size_t _closed_count;
 
-			const StepT _start_location;
-			const StepT _end_location;
+			StepT _start_location;
+			StepT _end_location;
 
 			InterfaceT* _interface;
 
-			/* Recursively create the path */
-			void construct_forward_path (const Node* node, PathT& path) const {
-				if (node->parent != NULL)
-					construct_forward_path(node->parent, path);
+			Node * node_at (NodeIndexT index) {
+				return &_chunks[index >> CHUNK_SHIFT][index & (CHUNK_SIZE - 1)];
+			}
+
+			NodeIndexT allocate_node () {
+				if ((_node_count >> CHUNK_SHIFT) == _chunks.size())
+					_chunks.push_back(std::unique_ptr<Node[]>(new Node[CHUNK_SIZE]));
 
-				path.push_back(node->step);
+				return _node_count++;
 			}
 
-		public:
-			PathFinder (const StepT& start_location, const StepT& end_location, InterfaceT* interface) : _start_location(start_location), _end_location(end_location), _interface(interface) {
-				CostT estimate_to_goal = _interface->estimate_path_cost(start_location, end_location);
+			void heap_place (Node * node, std::size_t position) {
+				_open[position] = node;
+				node->heap_index = (NodeIndexT)position;
+			}
+
+			void sift_up (std::size_t position) {
+				Node * node = _open[position];
+
+				while (position > 0) {
+					std::size_t parent = (position - 1) / 2;
 
-				open_push (new Node(start_location, 0, estimate_to_goal));
+					if (!(*node < *_open[parent]))
+						break;
+
+					heap_place(_open[parent], position);
+					position = parent;
+				}
+
+				heap_place(node, position);
 			}
 
-			~PathFinder () {
-				//std::cout << __PRETTY_FUNCTION__ << std::endl;
-				while (!_open.empty()) {
-					delete _open.front();
-					open_pop();
+			void sift_down (std::size_t position) {
+				Node * node = _open[position];
+				std::size_t count = _open.size();
+
+				while (true) {
+					std::size_t child = position * 2 + 1;
+
+					if (child >= count)
+						break;
+
+					if (child + 1 < count && *_open[child + 1] < *_open[child])
+						child += 1;
+
+					if (!(*_open[child] < *node))
+						break;
+
+					heap_place(_open[child], position);
+					position = child;
 				}
 
-				for (auto closed_node : _closed) {
-					delete closed_node;
+				heap_place(node, position);
+			}
+
+			void open_push(Node * node) {
+				_open.push_back(node);
+				sift_up(_open.size() - 1);
+			}
+
+			void open_pop() {
+				Node * node = _open.front();
+				node->heap_index = NO_NODE;
+
+				Node * last = _open.back();
+				_open.pop_back();
+
+				if (!_open.empty()) {
+					heap_place(last, 0);
+					sift_down(0);
 				}
 			}
 
-			const OpenT open () const {
+			/* Create the path by following the parents back to the start */
+			void construct_forward_path (const Node* node, PathT& path) const {
+				std::size_t begin = path.size();
+
+				for (; node != NULL; node = node->parent)
+					path.push_back(node->step);
+
+				std::reverse(path.begin() + begin, path.end());
+			}
+
+		public:
+			PathFinder (const StepT& start_location, const StepT& end_location, InterfaceT* interface, const StepIndexT & index = StepIndexT()) : _node_count(0), _index(index), _closed_count(0), _interface(interface) {
+				reset(start_location, end_location);
+			}
+
+			// Start a new search, reusing the memory from the previous search.
+			void reset (const StepT& start_location, const StepT& end_location) {
+				_node_count = 0;
+				_index.clear();
+				_open.clear();
+				_closed_count = 0;
+
+				_start_location = start_location;
+				_end_location = end_location;
+
+				NodeIndexT index = allocate_node();
+				Node * node = node_at(index);
+
+				node->closed = false;
+				node->step = start_location;
+				node->cost_from_start = 0;
+				node->cost_to_goal = _interface->estimate_path_cost(start_location, end_location);
+				node->parent = NULL;
+
+				_index.lookup(start_location) = index;
+				open_push(node);
+			}
+
+			const OpenT & open () const {
 				return _open;
 			}
 
-			const ClosedT closed () const {
-				return _closed;
+			// The number of nodes which have been expanded.
+			std::size_t closed_count () const {
+				return _closed_count;
+			}
+
+			// The number of nodes which have been visited.
+			std::size_t node_count () const {
+				return _node_count;
 			}
 
 			const Node * top () const {
@@ -157,66 +303,66 @@ namespace Dream {
 				return _end_location;
 			}
 
+			InterfaceT * interface () {
+				return _interface;
+			}
+
 			void add_step (const StepT & step, const Node * top) {
-				CostT estimate_to_goal = _interface->estimate_path_cost(step, _end_location);
 				CostT step_cost = _interface->exact_path_cost(top->step, step);
 				CostT cost_from_start = top->cost_from_start + step_cost;
 
-				/* Is this step in the priority queue already? */
-				bool insert_node = false;
-				Node* next_node = new Node(step, cost_from_start, estimate_to_goal, top);
+				NodeIndexT & index = _index.lookup(step);
+				Node * node;
 
-				typename TouchedT::iterator touched_iter = _touched.find(step);
-				if (touched_iter != _touched.end()) {
+				if (index != NO_NODE) {
 					/*	If we have already been to the node, only
-					insert it if it costs less to get here this way */
-					Node* current_next = (*touched_iter).second;
-					if (*current_next > *next_node) {
-						current_next->closed = true;
-						insert_node = true;
+					update it if it costs less to get here this way */
+					node = node_at(index);
+
+					if (node->cost_from_start <= cost_from_start)
+						return;
+
+					node->cost_from_start = cost_from_start;
+					node->parent = top;
+
+					if (node->heap_index != NO_NODE) {
+						sift_up(node->heap_index);
+					} else {
+						// With an inconsistent estimate, a closed node can be reached more cheaply and must be expanded again:
+						node->closed = false;
+						open_push(node);
 					}
 				} else {
-					insert_node = true;
-				}
+					index = allocate_node();
+					node = node_at(index);
 
-				if (insert_node) {
-					_interface->notify_cost(step, cost_from_start, estimate_to_goal);
-					open_push(next_node);
-					_touched[step] = next_node;
-				} else {
-					delete next_node;
+					node->closed = false;
+					node->step = step;
+					node->cost_from_start = cost_from_start;
+					node->cost_to_goal = _interface->estimate_path_cost(step, _end_location);
+					node->parent = top;
+
+					open_push(node);
 				}
+
+				_interface->notify_cost(step, cost_from_start, node->cost_to_goal);
 			}
 
 			bool find_path (int iterations) {
 				while (!_open.empty() && iterations--) {
-					const Node * top = this->top();
-
-					if (top->closed) {
-						/*	We cannot remove a value from the open list,
-						    so we mark it as closed and skip it here.
-						    This is only done if a faster way to the same
-						    node is found. */
-						open_pop();
-					} else {
-						if (_interface->is_goal_state(*this, top->step, _end_location)) {
-							/* We have reached the goal and no longer need to do any searching */
-							return true;
-						}
-
-						/* We are going to process this node, so remove it from the open list */
-						open_pop();
-						_interface->add_steps_from(top, *this);
+					Node * top = this->top();
 
-						//std::set<StepT> next_steps = _interface->steps_from(top);
-
-						//for (iterate_each (next_steps, next_step)) {
-						//	add_step(*next_step, top);
-						//}
+					if (_interface->is_goal_state(*this, top->step, _end_location)) {
+						/* We have reached the goal and no longer need to do any searching */
+						return true;
 					}
 
-					/* Once we have processed the node, place it on the closed list */
-					_closed.insert(top);
+					/* We are going to process this node, so remove it from the open list */
+					open_pop();
+					top->closed = true;
+					_closed_count += 1;
+
+					_interface->add_steps_from(top, *this);
 				}
 
 				return _open.empty();
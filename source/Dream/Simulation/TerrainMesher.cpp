@@ -0,0 +1,377 @@
+//
+//  Simulation/TerrainMesher.cpp
+//  This file is part of the "Dream" project, and is released under the MIT license.
+//
+//  Created by agent on 18/10/26.
+//  Copyright (c) 2026 agent. All rights reserved.
+//
+//
+
+#include "TerrainMesher.h"
+#include "../Assertion.h"
+#include "../Events/Thread.h"
+
+#include <algorithm>
+#include <cmath>
+
+#ifdef ENABLE_TESTING
+#include "../Core/Timer.h"
+#include "../Events/Logger.h"
+#endif
+
+namespace Dream {
+	namespace Simulation {
+		TerrainMesher::TerrainMesher (HeightMap * height_map, Vec2u chunk_count, std::size_t chunk_size, std::size_t level_count) : _height_map(height_map), _chunk_count(chunk_count), _chunk_size(chunk_size), _level_count(level_count), _scale(1, 1, 1), _skirt_depth(-1), _samples_wide(0)
+		{
+			// The chunk size must be a power of two, and small enough for 16-bit indices:
+			DREAM_ASSERT(chunk_size > 0 && (chunk_size & (chunk_size - 1)) == 0 && chunk_size <= 128);
+			DREAM_ASSERT(level_count > 0 && (chunk_size >> (level_count - 1)) > 0);
+		}
+
+		Vec3 TerrainMesher::normal_at (std::ptrdiff_t x, std::ptrdiff_t y) const
+		{
+			RealT dx = (height_at(x + 1, y) - height_at(x - 1, y)) * _scale[Z] / (2 * _scale[X]);
+			RealT dy = (height_at(x, y + 1) - height_at(x, y - 1)) * _scale[Z] / (2 * _scale[Y]);
+
+			return Vec3(-dx, -dy, 1).normalize();
+		}
+
+		RealT TerrainMesher::level_error (const TerrainChunk & chunk, std::size_t level) const
+		{
+			if (level == 0) return 0;
+
+			std::size_t step = 1 << level, cells = _chunk_size >> level;
+			std::ptrdiff_t ox = chunk.index[X] * _chunk_size, oy = chunk.index[Y] * _chunk_size;
+
+			RealT error = 0;
+
+			for (std::size_t y = 0; y <= _chunk_size; y += 1) {
+				std::size_t cy = std::min(y / step, cells - 1);
+				RealT v = RealT(y - cy * step) / step;
+
+				for (std::size_t x = 0; x <= _chunk_size; x += 1) {
+					std::size_t cx = std::min(x / step, cells - 1);
+					RealT u = RealT(x - cx * step) / step;
+
+					std::ptrdiff_t x0 = ox + cx * step, y0 = oy + cy * step;
+					RealT h00 = height_at(x0, y0), h10 = height_at(x0 + step, y0), h01 = height_at(x0, y0 + step), h11 = height_at(x0 + step, y0 + step);
+
+					// Interpolate within the triangle containing the sample, matching the diagonal used for the indices:
+					RealT interpolated;
+					if (u >= v)
+						interpolated = h00 + u * (h10 - h00) + v * (h11 - h10);
+					else
+						interpolated = h00 + v * (h01 - h00) + u * (h11 - h01);
+
+					error = std::max(error, std::abs(interpolated - height_at(ox + x, oy + y)));
+				}
+			}
+
+			return error * std::abs(_scale[Z]);
+		}
+
+		void TerrainMesher::generate_level (TerrainChunk & chunk, std::size_t level, RealT skirt_depth) const
+		{
+			std::size_t step = 1 << level, cells = _chunk_size >> level, width = cells + 1;
+			std::ptrdiff_t ox = chunk.index[X] * _chunk_size, oy = chunk.index[Y] * _chunk_size;
+			Vec2 extent(_chunk_count[X] * _chunk_size, _chunk_count[Y] * _chunk_size);
+
+			Shared<TerrainMeshT> mesh = new TerrainMeshT;
+			mesh->layout = Euclid::Geometry::TRIANGLES;
+
+			std::vector<TerrainVertex> & vertices = mesh->vertices;
+			std::vector<std::uint16_t> & indices = mesh->indices;
+
+			vertices.reserve(width * width + cells * 4);
+			indices.reserve((cells * cells + cells * 4) * 6);
+
+			for (std::size_t y = 0; y < width; y += 1) {
+				for (std::size_t x = 0; x < width; x += 1) {
+					std::ptrdiff_t sx = ox + x * step, sy = oy + y * step;
+
+					TerrainVertex vertex;
+					vertex.position = Vec3(sx * _scale[X], sy * _scale[Y], height_at(sx, sy) * _scale[Z]);
+					vertex.normal = normal_at(sx, sy);
+					vertex.mapping = Vec2(sx / extent[X], sy / extent[Y]);
+
+					vertices.push_back(vertex);
+				}
+			}
+
+			for (std::size_t y = 0; y < cells; y += 1) {
+				for (std::size_t x = 0; x < cells; x += 1) {
+					std::uint16_t m = x + y * width;
+
+					indices.push_back(m);
+					indices.push_back(m + 1);
+					indices.push_back(m + width + 1);
+
+					indices.push_back(m);
+					indices.push_back(m + width + 1);
+					indices.push_back(m + width);
+				}
+			}
+
+			// The border vertices in counter-clockwise order, so that the skirts face outwards:
+			std::vector<std::uint16_t> ring;
+			ring.reserve(cells * 4);
+
+			for (std::size_t x = 0; x < cells; x += 1)
+				ring.push_back(x);
+
+			for (std::size_t y = 0; y < cells; y += 1)
+				ring.push_back(cells + y * width);
+
+			for (std::size_t x = cells; x > 0; x -= 1)
+				ring.push_back(x + cells * width);
+
+			for (std::size_t y = cells; y > 0; y -= 1)
+				ring.push_back(y * width);
+
+			std::uint16_t base = vertices.size();
+
+			for (auto index : ring) {
+				TerrainVertex vertex = vertices[index];
+				vertex.position[Z] -= skirt_depth;
+
+				vertices.push_back(vertex);
+			}
+
+			for (std::size_t i = 0; i < ring.size(); i += 1) {
+				std::size_t j = (i + 1) % ring.size();
+
+				indices.push_back(ring[i]);
+				indices.push_back(base + i);
+				indices.push_back(ring[j]);
+
+				indices.push_back(ring[j]);
+				indices.push_back(base + i);
+				indices.push_back(base + j);
+			}
+
+			for (auto & vertex : vertices)
+				chunk.bounds.union_with_point(vertex.position);
+
+			chunk.levels[level] = mesh;
+		}
+
+		void TerrainMesher::generate (std::vector<TerrainChunk> & chunks, Events::WorkerPool * pool)
+		{
+			// Sample every height once, including a border of one sample for the normals:
+			_samples_wide = _chunk_count[X] * _chunk_size + 3;
+			std::size_t samples_high = _chunk_count[Y] * _chunk_size + 3;
+
+			_heights.resize(_samples_wide * samples_high);
+			_height_map->heights(Vec2(-1, -1), Vec2(1, 1), Vec2u(_samples_wide, samples_high), _heights.data());
+
+			chunks.resize(_chunk_count[X] * _chunk_count[Y]);
+
+			Events::parallel_for(pool, chunks.size(), [&](std::size_t i) {
+				TerrainChunk & chunk = chunks[i];
+
+				chunk.index = Vec2u(i % _chunk_count[X], i / _chunk_count[X]);
+				chunk.levels.assign(_level_count, Shared<TerrainMeshT>());
+				chunk.errors.resize(_level_count);
+
+				for (std::size_t level = 0; level < _level_count; level += 1)
+					chunk.errors[level] = level_error(chunk, level);
+			});
+
+			RealT skirt_depth = _skirt_depth;
+
+			if (skirt_depth < 0) {
+				skirt_depth = 0;
+
+				for (auto & chunk : chunks)
+					skirt_depth = std::max(skirt_depth, chunk.errors.back());
+
+				// Even when the levels match exactly, a small skirt covers gaps from rounding:
+				skirt_depth = std::max(skirt_depth, std::abs(_scale[Z]) * RealT(0.01));
+			}
+
+			Events::parallel_for(pool, chunks.size(), [&](std::size_t i) {
+				TerrainChunk & chunk = chunks[i];
+
+				Vec3 origin(chunk.index[X] * _chunk_size * _scale[X], chunk.index[Y] * _chunk_size * _scale[Y], height_at(chunk.index[X] * _chunk_size, chunk.index[Y] * _chunk_size) * _scale[Z]);
+				chunk.bounds = AlignedBox<3>(origin, origin);
+
+				for (std::size_t level = 0; level < _level_count; level += 1)
+					generate_level(chunk, level, skirt_depth);
+			});
+		}
+
+		std::size_t TerrainMesher::select_level (const TerrainChunk & chunk, const Vec3 & eye, RealT tolerance)
+		{
+			// The distance from the eye to the nearest point of the chunk:
+			Vec3 nearest;
+			for (std::size_t i = 0; i < 3; i += 1)
+				nearest[i] = std::min(std::max(eye[i], chunk.bounds.min()[i]), chunk.bounds.max()[i]);
+
+			RealT distance = (nearest - eye).length();
+
+			std::size_t level = 0;
+			while (level + 1 < chunk.errors.size() && chunk.errors[level + 1] <= tolerance * distance)
+				level += 1;
+
+			return level;
+		}
+
+// MARK: -
+// MARK: Unit Tests
+
+#ifdef ENABLE_TESTING
+		using namespace Events::Logging;
+		using namespace Core;
+
+		struct TestWaveHeightMap : public HeightMap {
+			RealT slope;
+
+			TestWaveHeightMap (RealT _slope) : slope(_slope) {
+			}
+
+			virtual RealT height (const Vec2 & at) {
+				if (slope != 0)
+					return at[X] * slope - at[Y] * slope * 0.5;
+
+				return std::sin(at[X] * 0.1) * std::cos(at[Y] * 0.13) + std::sin(at[X] * 0.71 + at[Y] * 0.37) * 0.1;
+			}
+		};
+
+		UNIT_TEST(TerrainMesher)
+		{
+			testing("Chunk meshes");
+
+			TestWaveHeightMap waves(0);
+			TerrainMesher mesher(&waves, Vec2u(4, 3), 16, 3);
+			mesher.set_scale(Vec3(2, 2, 10));
+
+			Ref<Events::WorkerPool> pool = new Events::WorkerPool(3);
+
+			std::vector<TerrainChunk> chunks;
+			mesher.generate(chunks, pool.get());
+
+			check(chunks.size() == 12) << "Generated all chunks";
+
+			bool counts = true, indices_valid = true, bounded = true, errors_increase = true;
+
+			for (auto & chunk : chunks) {
+				for (std::size_t level = 0; level < 3; level += 1) {
+					const TerrainMeshT & mesh = *chunk.levels[level].get();
+					std::size_t cells = 16 >> level;
+
+					counts = counts && mesh.vertices.size() == (cells + 1) * (cells + 1) + cells * 4;
+					counts = counts && mesh.indices.size() == (cells * cells + cells * 4) * 6;
+
+					for (auto index : mesh.indices)
+						indices_valid = indices_valid && index < mesh.vertices.size();
+
+					for (auto & vertex : mesh.vertices)
+						bounded = bounded && chunk.bounds.contains_point(vertex.position);
+				}
+
+				errors_increase = errors_increase && chunk.errors[0] == 0 && chunk.errors[1] > 0 && chunk.errors[2] >= chunk.errors[1];
+			}
+
+			check(counts) << "Each level has the expected vertices and indices";
+			check(indices_valid) << "Indices are within the vertices";
+			check(bounded) << "Chunk bounds contain every vertex";
+			check(errors_increase) << "Coarser levels have larger errors";
+
+			testing("Crack free borders");
+
+			// Neighbouring chunks share the positions and normals along their border at full resolution:
+			const TerrainMeshT & left = *chunks[0].levels[0].get(), & right = *chunks[1].levels[0].get();
+			bool shared = true;
+
+			for (std::size_t y = 0; y <= 16; y += 1) {
+				const TerrainVertex & a = left.vertices[16 + y * 17], & b = right.vertices[y * 17];
+				shared = shared && a.position == b.position && a.normal == b.normal;
+			}
+
+			check(shared) << "Border vertices match";
+
+			// The skirts hang below the surface by more than any level's error, so they cover the gaps between levels:
+			RealT largest_error = 0;
+			for (auto & chunk : chunks)
+				largest_error = std::max(largest_error, chunk.errors.back());
+
+			const TerrainMeshT & coarse = *chunks[0].levels[2].get();
+			const TerrainVertex & edge = coarse.vertices[0], & skirt = coarse.vertices[5 * 5];
+
+			check(edge.position[X] == skirt.position[X] && edge.position[Y] == skirt.position[Y]) << "Skirt is below the edge";
+			check(edge.position[Z] - skirt.position[Z] >= largest_error) << "Skirt is deeper than the largest error";
+
+			testing("Normals");
+
+			TestWaveHeightMap plane(0.5);
+			TerrainMesher plane_mesher(&plane, Vec2u(2, 2), 8, 2);
+			plane_mesher.set_scale(Vec3(2, 4, 3));
+
+			std::vector<TerrainChunk> plane_chunks;
+			plane_mesher.generate(plane_chunks);
+
+			// z = 3 * (0.5 * x / 2 - 0.25 * y / 4) in world units:
+			Vec3 expected = Vec3(-0.75, 0.1875, 1).normalize();
+			bool flat = true;
+
+			for (auto & vertex : plane_chunks[3].levels[0].get()->vertices)
+				flat = flat && (vertex.normal - expected).length() < 1e-4;
+
+			check(flat) << "Normals of a plane are constant";
+			check(plane_chunks[3].errors[1] < 1e-3) << "Coarser levels of a plane are exact";
+
+			testing("Level selection");
+
+			const TerrainChunk & chunk = chunks[5];
+			Vec3 center = chunk.bounds.center();
+
+			check(TerrainMesher::select_level(chunk, center, 0.001) == 0) << "Full resolution up close";
+			check(TerrainMesher::select_level(chunk, center + Vec3(0, 0, 1e6), 0.001) == 2) << "Coarsest level far away";
+
+			testing("Parallel generation");
+
+			std::vector<TerrainChunk> serial_chunks;
+			mesher.generate(serial_chunks);
+
+			bool identical = true;
+			for (std::size_t i = 0; i < chunks.size(); i += 1) {
+				for (std::size_t level = 0; level < 3; level += 1) {
+					const TerrainMeshT & a = *chunks[i].levels[level].get(), & b = *serial_chunks[i].levels[level].get();
+
+					identical = identical && a.indices == b.indices && a.vertices.size() == b.vertices.size();
+
+					for (std::size_t j = 0; identical && j < a.vertices.size(); j += 1)
+						identical = a.vertices[j].position == b.vertices[j].position;
+				}
+			}
+
+			check(identical) << "Serial and parallel generation give the same meshes";
+		}
+
+		UNIT_TEST(TerrainMesherPerformance)
+		{
+			testing("Generating a 1024x1024 terrain");
+
+			TestWaveHeightMap waves(0);
+			TerrainMesher mesher(&waves, Vec2u(16, 16), 64, 4);
+
+			Ref<Events::WorkerPool> pool = new Events::WorkerPool;
+
+			std::vector<TerrainChunk> chunks;
+			Stopwatch serial_stopwatch, parallel_stopwatch;
+
+			serial_stopwatch.start();
+			mesher.generate(chunks);
+			serial_stopwatch.pause();
+
+			parallel_stopwatch.start();
+			mesher.generate(chunks, pool.get());
+			parallel_stopwatch.pause();
+
+			logger()->log(LOG_INFO, LogBuffer() << "Serial: " << serial_stopwatch.time() * 1e3 << "ms, parallel: " << parallel_stopwatch.time() * 1e3 << "ms with " << pool->thread_count() << " threads.");
+
+			check(chunks.size() == 256) << "Generated all chunks";
+		}
+#endif
+	}
+}
@@ -0,0 +1,106 @@
+//
+//  Simulation/TerrainMesher.h
+//  This file is part of the "Dream" project, and is released under the MIT license.
+//
+//  Created by agent on 18/10/26.
+//  Copyright (c) 2026 agent. All rights reserved.
+//
+//
+
+#ifndef _DREAM_SIMULATION_TERRAINMESHER_H
+#define _DREAM_SIMULATION_TERRAINMESHER_H
+
+#include "HeightMap.h"
+
+#include <Euclid/Geometry/AlignedBox.h>
+#include <Euclid/Geometry/Mesh.h>
+
+#include <cstdint>
+#include <vector>
+
+namespace Dream {
+	namespace Events {
+		class WorkerPool;
+	}
+
+	namespace Simulation {
+		using Euclid::Geometry::AlignedBox;
+
+		struct TerrainVertex {
+			Vec3 position;
+			Vec3 normal;
+			Vec2 mapping;
+		};
+
+		// Each chunk is small enough to use 16-bit indices.
+		typedef Euclid::Geometry::Mesh<TerrainVertex, std::uint16_t> TerrainMeshT;
+
+		struct TerrainChunk {
+			// The position of the chunk in the grid of chunks.
+			Vec2u index;
+
+			// The bounds of every level, including skirts.
+			AlignedBox<3> bounds;
+
+			// Level 0 has one quad per height sample, and each following level halves the resolution.
+			std::vector<Shared<TerrainMeshT>> levels;
+
+			// The largest vertical distance between each level and the full resolution surface, in world units.
+			std::vector<RealT> errors;
+		};
+
+		/**
+		 Generates chunked terrain meshes from a height map, using geometrical mipmapping.
+
+		 Each chunk covers chunk_size x chunk_size quads and has a mesh for each level of detail. Neighbouring chunks may be drawn at different levels, and the cracks which this would leave along their borders are hidden by skirts, strips of triangles which hang down from every edge of the chunk. Normals are computed from central differences of the full resolution heights, so they match along chunk borders and across levels.
+
+		 The height map is sampled once, in a single batch on the calling thread, as height maps are not thread safe. The chunks are then built from the sampled heights in parallel.
+
+		 Height sample (x, y) becomes the vertex (x * scale[X], y * scale[Y], height * scale[Z]).
+		 */
+		class TerrainMesher {
+		protected:
+			HeightMap * _height_map;
+
+			Vec2u _chunk_count;
+			std::size_t _chunk_size, _level_count;
+
+			Vec3 _scale;
+			RealT _skirt_depth;
+
+			// The sampled heights, with an extra sample around the edge for computing normals.
+			std::vector<RealT> _heights;
+			std::size_t _samples_wide;
+
+			RealT height_at (std::ptrdiff_t x, std::ptrdiff_t y) const {
+				return _heights[(x + 1) + (y + 1) * _samples_wide];
+			}
+
+			Vec3 normal_at (std::ptrdiff_t x, std::ptrdiff_t y) const;
+
+			void generate_level (TerrainChunk & chunk, std::size_t level, RealT skirt_depth) const;
+			RealT level_error (const TerrainChunk & chunk, std::size_t level) const;
+
+		public:
+			TerrainMesher (HeightMap * height_map, Vec2u chunk_count, std::size_t chunk_size = 64, std::size_t level_count = 4);
+
+			void set_scale (const Vec3 & scale) { _scale = scale; }
+			const Vec3 & scale () const { return _scale; }
+
+			// Skirts must be deeper than the largest error of the levels which are drawn next to each other. If negative (the default), the largest error of any level is used.
+			void set_skirt_depth (RealT skirt_depth) { _skirt_depth = skirt_depth; }
+
+			const Vec2u & chunk_count () const { return _chunk_count; }
+			std::size_t chunk_size () const { return _chunk_size; }
+			std::size_t level_count () const { return _level_count; }
+
+			// Sample the height map and generate all chunks, in parallel on the given pool, or serially on the calling thread if there is no pool.
+			void generate (std::vector<TerrainChunk> & chunks, Events::WorkerPool * pool = NULL);
+
+			// Choose the coarsest level whose error, projected to the given distance, is within the tolerance. The tolerance is the allowed error per unit of distance, e.g. the pixel tolerance divided by the focal length in pixels.
+			static std::size_t select_level (const TerrainChunk & chunk, const Vec3 & eye, RealT tolerance);
+		};
+	}
+}
+
+#endif
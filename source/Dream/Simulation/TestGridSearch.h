@@ -0,0 +1,97 @@
+//
+//  Simulation/TestGridSearch.h
+//  This file is part of the "Dream" project, and is released under the MIT license.
+//
+//  Created by agent on 18/10/26.
+//  Copyright (c) 2026 agent. All rights reserved.
+//
+//
+
+#ifndef _DREAM_SIMULATION_TESTGRIDSEARCH_H
+#define _DREAM_SIMULATION_TESTGRIDSEARCH_H
+
+#ifdef ENABLE_TESTING
+
+#include "PathFinder.h"
+
+#include <Euclid/Numerics/Vector.h>
+
+namespace Dream {
+	namespace Simulation {
+		using Euclid::Numerics::Vec2i;
+
+		// The cost of a single move between adjacent cells.
+		inline float test_grid_step_cost (const Vec2i & from, const Vec2i & to) {
+			return (from[0] != to[0] && from[1] != to[1]) ? DIAGONAL_COST : 1.0f;
+		}
+
+		// Calls the function with each neighbour of the step which can be moved to on an 8-connected grid, where diagonal moves may not cut corners. The grid only needs to provide passable(x, y).
+		template <typename GridT, typename FunctionT>
+		void for_each_test_grid_step (const GridT & grid, const Vec2i & step, FunctionT function) {
+			for (int dy = -1; dy <= 1; dy += 1) {
+				for (int dx = -1; dx <= 1; dx += 1) {
+					if (dx == 0 && dy == 0) continue;
+
+					if (!grid.passable(step[0] + dx, step[1] + dy)) continue;
+
+					if (dx && dy && !(grid.passable(step[0] + dx, step[1]) && grid.passable(step[0], step[1] + dy))) continue;
+
+					function(Vec2i(step[0] + dx, step[1] + dy));
+				}
+			}
+		}
+
+		// Plain A* over any grid, which the optimized searches are compared against.
+		template <typename GridT>
+		struct TestGridSearch {
+			const GridT * grid;
+
+			void notify_cost (const Vec2i &, float, float) {
+			}
+
+			template <typename NodeT, typename PathFinderT>
+			void add_steps_from (const NodeT * node, PathFinderT & path_finder) const {
+				for_each_test_grid_step(*grid, node->step, [&](const Vec2i & next) {
+					path_finder.add_step(next, node);
+				});
+			}
+
+			float estimate_path_cost (const Vec2i & from, const Vec2i & to) const {
+				return octile_distance(from, to);
+			}
+
+			float exact_path_cost (const Vec2i & from, const Vec2i & to) const {
+				return test_grid_step_cost(from, to);
+			}
+
+			template <typename PathFinderT>
+			bool is_goal_state (PathFinderT &, const Vec2i & from, const Vec2i & to) const {
+				return from == to;
+			}
+		};
+
+		// The cost of a path of adjacent cells, or -1 if it contains an invalid step.
+		template <typename GridT>
+		float test_grid_path_cost (const GridT & grid, const std::vector<Vec2i> & path) {
+			float cost = 0;
+
+			for (std::size_t i = 1; i < path.size(); i += 1) {
+				int dx = path[i][0] - path[i-1][0], dy = path[i][1] - path[i-1][1];
+
+				if (std::abs(dx) > 1 || std::abs(dy) > 1 || !grid.passable(path[i][0], path[i][1]))
+					return -1;
+
+				if (dx && dy && !(grid.passable(path[i-1][0] + dx, path[i-1][1]) && grid.passable(path[i-1][0], path[i-1][1] + dy)))
+					return -1;
+
+				cost += test_grid_step_cost(path[i-1], path[i]);
+			}
+
+			return cost;
+		}
+	}
+}
+
+#endif
+
+#endif
@@ -0,0 +1,531 @@
+//
+//  Text/DistanceField.cpp
+//  This file is part of the "Dream" project, and is released under the MIT license.
+//
+//  Created by agent on 18/10/26.
+//  Copyright (c) 2026 agent. All rights reserved.
+//
+//
+
+#include "DistanceField.h"
+
+#include <cmath>
+#include <algorithm>
+
+namespace Dream
+{
+	namespace Text
+	{
+		/// Computes the lower envelope of the parabolas rooted at each sample of f, storing the squared distance in d.
+		static void squared_distance_transform_1d (const float * f, float * d, std::size_t n, std::vector<std::size_t> & v, std::vector<double> & z)
+		{
+			std::size_t k = 0;
+
+			v[0] = 0;
+			z[0] = -DISTANCE_INFINITY;
+			z[1] = DISTANCE_INFINITY;
+
+			for (std::size_t q = 1; q < n; q += 1) {
+				double s = ((f[q] + double(q) * q) - (f[v[k]] + double(v[k]) * v[k])) / (2.0 * q - 2.0 * v[k]);
+
+				// Remove parabolas which are hidden by the new one:
+				while (s <= z[k]) {
+					k -= 1;
+					s = ((f[q] + double(q) * q) - (f[v[k]] + double(v[k]) * v[k])) / (2.0 * q - 2.0 * v[k]);
+				}
+
+				k += 1;
+				v[k] = q;
+				z[k] = s;
+				z[k+1] = DISTANCE_INFINITY;
+			}
+
+			k = 0;
+
+			for (std::size_t q = 0; q < n; q += 1) {
+				while (z[k+1] < q)
+					k += 1;
+
+				double offset = double(q) - double(v[k]);
+				d[q] = float(offset * offset + f[v[k]]);
+			}
+		}
+
+		void squared_distance_transform (std::vector<float> & grid, std::size_t width, std::size_t height)
+		{
+			DREAM_ASSERT(grid.size() == width * height);
+
+			std::size_t length = std::max(width, height);
+			std::vector<float> f(length), d(length);
+			std::vector<std::size_t> v(length);
+			std::vector<double> z(length + 1);
+
+			// Transform along columns:
+			for (std::size_t x = 0; x < width; x += 1) {
+				for (std::size_t y = 0; y < height; y += 1)
+					f[y] = grid[y * width + x];
+
+				squared_distance_transform_1d(f.data(), d.data(), height, v, z);
+
+				for (std::size_t y = 0; y < height; y += 1)
+					grid[y * width + x] = d[y];
+			}
+
+			// Transform along rows, which are contiguous:
+			for (std::size_t y = 0; y < height; y += 1) {
+				float * row = grid.data() + y * width;
+
+				std::copy(row, row + width, f.begin());
+				squared_distance_transform_1d(f.data(), row, width, v, z);
+			}
+		}
+
+		static ByteT encode_distance (RealT distance, RealT spread)
+		{
+			RealT value = 0.5 - distance / (2.0 * spread);
+
+			return ByteT(std::min<RealT>(std::max<RealT>(value, 0), 1) * 255 + 0.5);
+		}
+
+		Ref<Image> generate_distance_field (const IPixelBuffer & bitmap, std::size_t spread, std::size_t scale)
+		{
+			DREAM_ASSERT(bitmap.pixel_data_type() == DataType::BYTE);
+			DREAM_ASSERT(spread > 0 && scale > 0);
+
+			const std::size_t padding = spread * scale;
+			const std::size_t width = bitmap.size()[X] + padding * 2, height = bitmap.size()[Y] + padding * 2;
+
+			// The coverage is taken from the last channel, which is alpha for formats that have it:
+			const std::size_t channel = bitmap.bytes_per_pixel() - 1;
+
+			std::vector<bool> inside(width * height, false);
+
+			for (std::size_t y = 0; y < bitmap.size()[Y]; y += 1) {
+				for (std::size_t x = 0; x < bitmap.size()[X]; x += 1) {
+					const ByteT * pixel = bitmap.pixel_data() + bitmap.pixel_offset(PixelCoordinateT(x, y, 0));
+
+					inside[(y + padding) * width + x + padding] = pixel[channel] >= 128;
+				}
+			}
+
+			// The distance from outside cells to the shape, and from inside cells to the background:
+			std::vector<float> to_inside(width * height), to_outside(width * height);
+
+			for (std::size_t i = 0; i < inside.size(); i += 1) {
+				to_inside[i] = inside[i] ? 0 : DISTANCE_INFINITY;
+				to_outside[i] = inside[i] ? DISTANCE_INFINITY : 0;
+			}
+
+			squared_distance_transform(to_inside, width, height);
+			squared_distance_transform(to_outside, width, height);
+
+			Vec2u size((width + scale - 1) / scale, (height + scale - 1) / scale);
+			Ref<Image> field = new Image(size << 1U, PixelFormat::A, DataType::BYTE);
+
+			for (std::size_t y = 0; y < size[Y]; y += 1) {
+				for (std::size_t x = 0; x < size[X]; x += 1) {
+					// Sample the cell closest to the center of the output pixel:
+					std::size_t sx = std::min(x * scale + scale / 2, width - 1), sy = std::min(y * scale + scale / 2, height - 1);
+					std::size_t i = sy * width + sx;
+
+					// The edge is half a cell away from the nearest cell on the other side:
+					RealT distance = inside[i] ? -(std::sqrt(to_outside[i]) - 0.5) : std::sqrt(to_inside[i]) - 0.5;
+
+					*field->pixel_data_at(PixelCoordinateT(x, y, 0)) = encode_distance(distance / scale, spread);
+				}
+			}
+
+			return field;
+		}
+
+// MARK: -
+
+		static RealT cross (const Vec2 & a, const Vec2 & b)
+		{
+			return a[X] * b[Y] - a[Y] * b[X];
+		}
+
+		static RealT dot (const Vec2 & a, const Vec2 & b)
+		{
+			return a[X] * b[X] + a[Y] * b[Y];
+		}
+
+		DistanceFieldShape::DistanceFieldShape (std::size_t curve_segments) : _point(ZERO), _curve_segments(curve_segments), _curve_started(false)
+		{
+		}
+
+		void DistanceFieldShape::move_to (const Vec2 & point)
+		{
+			// Close the previous contour if required:
+			if (_contours.size() && _contours.back().size()) {
+				Vec2 start = _contours.back().front().from;
+
+				if (_point != start)
+					line_to(start);
+			}
+
+			_contours.push_back(ContourT());
+			_point = point;
+		}
+
+		void DistanceFieldShape::line_to (const Vec2 & point)
+		{
+			DREAM_ASSERT(_contours.size() > 0);
+
+			if (point == _point)
+				return;
+
+			_contours.back().push_back(Edge{_point, point, WHITE, false});
+			_point = point;
+		}
+
+		void DistanceFieldShape::curve_to (const Vec2 & point)
+		{
+			std::size_t count = _contours.back().size();
+
+			line_to(point);
+
+			// Segments after the first continue the curve smoothly, so they can't start at a corner:
+			if (_contours.back().size() > count && _curve_started)
+				_contours.back().back().continued = true;
+
+			_curve_started = true;
+		}
+
+		void DistanceFieldShape::quadratic_to (const Vec2 & control, const Vec2 & point)
+		{
+			Vec2 start = _point;
+			_curve_started = false;
+
+			for (std::size_t i = 1; i <= _curve_segments; i += 1) {
+				RealT t = RealT(i) / _curve_segments, s = 1 - t;
+
+				curve_to(start * (s * s) + control * (2 * s * t) + point * (t * t));
+			}
+		}
+
+		void DistanceFieldShape::cubic_to (const Vec2 & control1, const Vec2 & control2, const Vec2 & point)
+		{
+			Vec2 start = _point;
+			_curve_started = false;
+
+			for (std::size_t i = 1; i <= _curve_segments; i += 1) {
+				RealT t = RealT(i) / _curve_segments, s = 1 - t;
+
+				curve_to(start * (s * s * s) + control1 * (3 * s * s * t) + control2 * (3 * s * t * t) + point * (t * t * t));
+			}
+		}
+
+		void DistanceFieldShape::color_edges (RealT corner_angle)
+		{
+			// Close the last contour:
+			move_to(_point);
+			_contours.pop_back();
+
+			const unsigned char colors[3] = {GREEN | BLUE, RED | BLUE, RED | GREEN};
+			const RealT threshold = std::sin(corner_angle);
+
+			for (auto & contour : _contours) {
+				std::vector<std::size_t> corners;
+
+				for (std::size_t i = 0; i < contour.size(); i += 1) {
+					const Edge & previous = contour[(i + contour.size() - 1) % contour.size()];
+					const Edge & current = contour[i];
+
+					Vec2 a = (previous.to - previous.from).normalize(), b = (current.to - current.from).normalize();
+
+					if (!current.continued && (dot(a, b) <= 0 || std::abs(cross(a, b)) > threshold))
+						corners.push_back(i);
+				}
+
+				if (corners.empty()) {
+					// Smooth contours have no corners to preserve:
+					for (auto & edge : contour)
+						edge.channels = WHITE;
+				} else if (corners.size() == 1) {
+					// A single corner, such as a teardrop, is split into three differently colored parts:
+					for (std::size_t i = 0; i < contour.size(); i += 1)
+						contour[(corners[0] + i) % contour.size()].channels = colors[(3 * i) / contour.size()];
+				} else {
+					for (std::size_t c = 0; c < corners.size(); c += 1) {
+						unsigned char color = colors[c % 3];
+
+						// The last part is adjacent to the first, so they must be different:
+						if (c + 1 == corners.size() && c % 3 == 0)
+							color = colors[1];
+
+						for (std::size_t i = corners[c]; i != corners[(c + 1) % corners.size()]; i = (i + 1) % contour.size())
+							contour[i].channels = color;
+					}
+				}
+			}
+		}
+
+		bool DistanceFieldShape::is_corner (const ContourT & contour, std::size_t index, bool end) const
+		{
+			std::size_t neighbour = end ? (index + 1) % contour.size() : (index + contour.size() - 1) % contour.size();
+
+			return contour[neighbour].channels != contour[index].channels;
+		}
+
+		RealT DistanceFieldShape::signed_distance (const Vec2 & point) const
+		{
+			RealT distance = DISTANCE_INFINITY;
+			int winding = 0;
+
+			for (auto & contour : _contours) {
+				for (auto & edge : contour) {
+					Vec2 direction = edge.to - edge.from, offset = point - edge.from;
+					RealT t = std::min<RealT>(std::max<RealT>(dot(offset, direction) / dot(direction, direction), 0), 1);
+
+					distance = std::min(distance, (offset - direction * t).length());
+
+					// Non-zero winding rule:
+					if (edge.from[Y] <= point[Y]) {
+						if (edge.to[Y] > point[Y] && cross(direction, offset) > 0)
+							winding += 1;
+					} else {
+						if (edge.to[Y] <= point[Y] && cross(direction, offset) < 0)
+							winding -= 1;
+					}
+				}
+			}
+
+			return winding ? -distance : distance;
+		}
+
+		Ref<Image> DistanceFieldShape::generate (const Vec2u & size, RealT scale, const Vec2 & translate, RealT spread) const
+		{
+			Ref<Image> field = new Image(size << 1U, PixelFormat::RGB, DataType::BYTE);
+
+			// Inside is to the left of each edge for counter-clockwise outer contours, and to the right otherwise:
+			RealT area = 0;
+			for (auto & contour : _contours) {
+				for (auto & edge : contour)
+					area += cross(edge.from, edge.to);
+			}
+
+			RealT orientation = area > 0 ? 1 : -1;
+
+			struct Nearest {
+				RealT distance, orthogonality;
+				std::size_t contour, edge;
+				RealT t;
+			};
+
+			for (std::size_t y = 0; y < size[Y]; y += 1) {
+				for (std::size_t x = 0; x < size[X]; x += 1) {
+					// The first row is at the top of the shape:
+					Vec2 point = Vec2(x + 0.5, size[Y] - y - 0.5) / scale - translate;
+
+					Nearest nearest[3];
+					for (auto & channel : nearest)
+						channel = Nearest{DISTANCE_INFINITY, 0, 0, 0, 0};
+
+					for (std::size_t c = 0; c < _contours.size(); c += 1) {
+						const ContourT & contour = _contours[c];
+
+						for (std::size_t e = 0; e < contour.size(); e += 1) {
+							const Edge & edge = contour[e];
+
+							Vec2 direction = edge.to - edge.from, offset = point - edge.from;
+							RealT t = dot(offset, direction) / dot(direction, direction);
+							Vec2 closest = direction * std::min<RealT>(std::max<RealT>(t, 0), 1);
+
+							RealT distance = (offset - closest).length();
+							RealT orthogonality = distance > 0 ? std::abs(cross(direction.normalize(), (offset - closest) / distance)) : 1;
+
+							for (std::size_t i = 0; i < 3; i += 1) {
+								if ((edge.channels & (1 << i)) == 0) continue;
+
+								Nearest & channel = nearest[i];
+
+								// When two edges are equally close, such as at a shared vertex, prefer the one which faces the point:
+								if (distance < channel.distance - 1e-6 || (distance < channel.distance + 1e-6 && orthogonality > channel.orthogonality))
+									channel = Nearest{distance, orthogonality, c, e, t};
+							}
+						}
+					}
+
+					ByteT * pixel = field->pixel_data_at(PixelCoordinateT(x, y, 0));
+
+					for (std::size_t i = 0; i < 3; i += 1) {
+						Nearest & channel = nearest[i];
+
+						if (channel.distance == DISTANCE_INFINITY) {
+							pixel[i] = encode_distance(DISTANCE_INFINITY, spread);
+							continue;
+						}
+
+						const ContourT & contour = _contours[channel.contour];
+						const Edge & edge = contour[channel.edge];
+
+						Vec2 direction = (edge.to - edge.from).normalize();
+						RealT side = cross(direction, point - edge.from);
+						RealT distance = channel.distance;
+
+						// Beyond a corner, the distance to the extended edge (pseudo-distance) keeps the corner sharp:
+						if ((channel.t < 0 && is_corner(contour, channel.edge, false)) || (channel.t > 1 && is_corner(contour, channel.edge, true)))
+							distance = std::min(distance, std::abs(side));
+
+						distance *= (side * orientation > 0) ? -1 : 1;
+
+						pixel[i] = encode_distance(distance * scale, spread);
+					}
+				}
+			}
+
+			return field;
+		}
+
+// MARK: -
+// MARK: Unit Tests
+
+#ifdef ENABLE_TESTING
+		UNIT_TEST(DistanceTransform)
+		{
+			testing("Comparing with brute force");
+
+			const std::size_t width = 37, height = 23;
+			std::vector<float> grid(width * height);
+			std::vector<Vec2u> features;
+
+			unsigned seed = 7;
+			for (std::size_t i = 0; i < grid.size(); i += 1) {
+				seed = seed * 1103515245 + 12345;
+
+				if ((seed >> 16) % 29 == 0) {
+					grid[i] = 0;
+					features.push_back(Vec2u(i % width, i / width));
+				} else {
+					grid[i] = DISTANCE_INFINITY;
+				}
+			}
+
+			check(features.size() > 3) << "Grid has several features";
+
+			squared_distance_transform(grid, width, height);
+
+			std::size_t errors = 0;
+			for (std::size_t y = 0; y < height; y += 1) {
+				for (std::size_t x = 0; x < width; x += 1) {
+					float expected = DISTANCE_INFINITY;
+
+					for (auto feature : features) {
+						float dx = float(x) - feature[X], dy = float(y) - feature[Y];
+						expected = std::min(expected, dx * dx + dy * dy);
+					}
+
+					if (grid[y * width + x] != expected)
+						errors += 1;
+				}
+			}
+
+			check(errors == 0) << "Distances are exact";
+
+			testing("Signed distance field");
+
+			// A filled 20x10 rectangle:
+			Ref<Image> bitmap = new Image(PixelCoordinateT(20, 10, 1), PixelFormat::A, DataType::BYTE);
+			memset(bitmap->pixel_data(), 255, bitmap->pixel_data_length());
+
+			Ref<Image> field = generate_distance_field(*bitmap, 4);
+			check(field->size() == PixelCoordinateT(28, 18, 1)) << "Field is padded by spread";
+
+			auto decode = [&](std::size_t x, std::size_t y) {
+				return (0.5 - RealT(*field->pixel_data_at(PixelCoordinateT(x, y, 0))) / 255) * 8;
+			};
+
+			// The rectangle occupies pixels 4 to 23 horizontally, so the edge is at 3.5:
+			check(std::abs(decode(2, 9) - 1.5) < 0.05) << "Outside distance is correct";
+			check(std::abs(decode(6, 9) + 2.5) < 0.05) << "Inside distance is correct";
+			check(decode(0, 0) >= 3.9) << "Distance is clamped to spread";
+
+			testing("Downsampling");
+
+			Ref<Image> coarse = generate_distance_field(*bitmap, 2, 2);
+			check(coarse->size() == PixelCoordinateT(14, 9, 1)) << "Field is downsampled";
+		}
+
+		UNIT_TEST(MultiChannelDistanceField)
+		{
+			testing("Edge coloring");
+
+			DistanceFieldShape shape;
+			shape.move_to(Vec2(0, 0));
+			shape.line_to(Vec2(10, 0));
+			shape.line_to(Vec2(10, 10));
+			shape.line_to(Vec2(0, 10));
+			shape.color_edges();
+
+			check(shape.contours().size() == 1) << "Shape has one contour";
+			check(shape.contours()[0].size() == 4) << "Contour was closed";
+
+			bool adjacent_differ = true;
+			for (std::size_t i = 0; i < 4; i += 1) {
+				unsigned char a = shape.contours()[0][i].channels, b = shape.contours()[0][(i + 1) % 4].channels;
+				adjacent_differ = adjacent_differ && (a != b) && (a & b);
+			}
+
+			check(adjacent_differ) << "Adjacent edges share exactly one channel";
+
+			testing("Distances");
+
+			check(std::abs(shape.signed_distance(Vec2(5, 5)) + 5) < 1e-4) << "Inside distance is negative";
+			check(std::abs(shape.signed_distance(Vec2(13, 14)) - 5) < 1e-4) << "Outside distance is positive";
+
+			// Map the square to the center of a 20x20 field:
+			const RealT spread = 4;
+			Ref<Image> field = shape.generate(Vec2u(20, 20), 1, Vec2(5, 5), spread);
+
+			auto median = [&](std::size_t x, std::size_t y) {
+				const ByteT * pixel = field->pixel_data_at(PixelCoordinateT(x, y, 0));
+				RealT value = std::max(std::min(pixel[0], pixel[1]), std::min(std::max(pixel[0], pixel[1]), pixel[2]));
+
+				return (0.5 - value / 255) * 2 * spread;
+			};
+
+			std::size_t sign_errors = 0, distance_errors = 0;
+			for (std::size_t y = 0; y < 20; y += 1) {
+				for (std::size_t x = 0; x < 20; x += 1) {
+					Vec2 point = Vec2(x + 0.5, 20 - y - 0.5) - Vec2(5, 5);
+					RealT expected = shape.signed_distance(point);
+
+					if ((median(x, y) < 0) != (expected < 0))
+						sign_errors += 1;
+
+					// Away from the corners, the field matches the true distance:
+					bool beside_edge = (point[X] > 0 && point[X] < 10) || (point[Y] > 0 && point[Y] < 10);
+					if (beside_edge && std::abs(expected) < spread && std::abs(median(x, y) - expected) > 0.05)
+						distance_errors += 1;
+				}
+			}
+
+			check(sign_errors == 0) << "Inside and outside are correct";
+			check(distance_errors == 0) << "Distances match brute force";
+
+			// Diagonally beyond the corner, the true distance is rounded but the field keeps the corner sharp:
+			check(std::abs(median(16, 3) - 1.5) < 0.05) << "Corner is preserved";
+
+			testing("Smooth contours");
+
+			// A circle made from four quadratic curves:
+			DistanceFieldShape circle;
+			circle.move_to(Vec2(10, 0));
+			circle.quadratic_to(Vec2(10, 10), Vec2(0, 10));
+			circle.quadratic_to(Vec2(-10, 10), Vec2(-10, 0));
+			circle.quadratic_to(Vec2(-10, -10), Vec2(0, -10));
+			circle.quadratic_to(Vec2(10, -10), Vec2(10, 0));
+			circle.color_edges();
+
+			check(circle.contours()[0].size() == 32) << "Curves were flattened";
+
+			bool smooth = true;
+			for (auto & edge : circle.contours()[0])
+				smooth = smooth && edge.channels == DistanceFieldShape::WHITE;
+
+			check(smooth) << "Smooth contour has no corners";
+		}
+#endif
+	}
+}
@@ -0,0 +1,102 @@
+//
+//  Text/DistanceField.h
+//  This file is part of the "Dream" project, and is released under the MIT license.
+//
+//  Created by agent on 18/10/26.
+//  Copyright (c) 2026 agent. All rights reserved.
+//
+//
+
+#ifndef _DREAM_IMAGING_TEXT_DISTANCEFIELD_H
+#define _DREAM_IMAGING_TEXT_DISTANCEFIELD_H
+
+#include "../Imaging/Image.h"
+
+#include <vector>
+
+namespace Dream
+{
+	namespace Text
+	{
+		using namespace Dream::Imaging;
+
+		enum class DistanceFieldType {
+			/// A single channel signed distance field, generated from a high resolution bitmap.
+			SIGNED,
+			/// A three channel distance field, generated from the glyph outline, which preserves sharp corners.
+			MULTI_CHANNEL
+		};
+
+		/// The initial value for cells which are not features in a distance transform.
+		const float DISTANCE_INFINITY = 1e20f;
+
+		/// Computes the squared euclidean distance from each cell to the nearest feature, in place, using the linear time algorithm by Felzenszwalb and Huttenlocher. Feature cells should be 0, all other cells DISTANCE_INFINITY.
+		void squared_distance_transform (std::vector<float> & grid, std::size_t width, std::size_t height);
+
+		/**
+		 Generates a single channel signed distance field from a coverage bitmap, such as a glyph rendered by FreeType.
+
+		 The bitmap is thresholded at half coverage. The output is padded by spread pixels on each side and downsampled by the given scale, so a bitmap rendered at a high resolution produces a smooth field at the base size. Edges are encoded as 0.5, with values above inside the shape, and distances beyond spread pixels are clamped.
+		 */
+		Ref<Image> generate_distance_field (const IPixelBuffer & bitmap, std::size_t spread, std::size_t scale = 1);
+
+		/**
+		 A shape made of closed contours, used to generate multi-channel signed distance fields.
+
+		 Curves are flattened into line segments. Each edge is assigned a subset of the red, green and blue channels, so that the corners of the shape are preserved by taking the median of the three channels when the field is sampled.
+		 */
+		class DistanceFieldShape {
+		public:
+			enum Channels : unsigned char {
+				RED = 1,
+				GREEN = 2,
+				BLUE = 4,
+				WHITE = RED | GREEN | BLUE
+			};
+
+			struct Edge {
+				Vec2 from, to;
+				unsigned char channels;
+
+				/// Whether this edge continues a flattened curve from the previous edge.
+				bool continued;
+			};
+
+			typedef std::vector<Edge> ContourT;
+
+		protected:
+			std::vector<ContourT> _contours;
+			Vec2 _point;
+
+			std::size_t _curve_segments;
+			bool _curve_started;
+
+			void curve_to (const Vec2 & point);
+
+			/// Whether the edge at the given index in the contour has a corner at its start or end, i.e. the adjacent edge uses different channels.
+			bool is_corner (const ContourT & contour, std::size_t index, bool end) const;
+
+		public:
+			DistanceFieldShape (std::size_t curve_segments = 8);
+
+			void move_to (const Vec2 & point);
+			void line_to (const Vec2 & point);
+			void quadratic_to (const Vec2 & control, const Vec2 & point);
+			void cubic_to (const Vec2 & control1, const Vec2 & control2, const Vec2 & point);
+
+			const std::vector<ContourT> & contours () const { return _contours; }
+			bool empty () const { return _contours.empty(); }
+
+			/// Assigns channels to edges. Corners are points where the direction changes by more than the given angle, in radians.
+			void color_edges (RealT corner_angle = 3.0);
+
+			/// The true signed distance to the shape, negative inside. This is mostly useful for testing.
+			RealT signed_distance (const Vec2 & point) const;
+
+			/// Generates an RGB field of the given size with the first row at the top. Shape coordinates are mapped to pixels by (point + translate) * scale, and distances beyond spread pixels are clamped.
+			Ref<Image> generate (const Vec2u & size, RealT scale, const Vec2 & translate, RealT spread) const;
+		};
+	}
+}
+
+#endif
@@ -17,10 +17,23 @@
 #include "FontFace.h"
 #include "TextBlock.h"
 
+#include "../Core/Timer.h"
+#include "../Events/Logger.h"
+#include "../Events/Thread.h"
+
+#ifdef ENABLE_TESTING
+#include "TestFont.h"
+#endif
+
+#include <algorithm>
+#include <cstring>
+
 namespace Dream
 {
 	namespace Text
 	{
+		using namespace Events::Logging;
+
 		const char * ft2_error_message(int code);
 
 		static FT_Library freetype_library ()
@@ -52,7 +65,7 @@ namespace Dream
 			return new Font(data);
 		}
 
-		Font::Font (const Path & p) : _face(NULL)
+		Font::Font (const Path & p) : _face(NULL), _font_path(p)
 		{
 			FT_Face face;
 			FT_Error err = FT_New_Face(freetype_library(), p.to_local_path().c_str(), 0, &face);
@@ -134,6 +147,44 @@ namespace Dream
 			return _face->line_offset();
 		}
 
+		std::size_t Font::prewarm (const std::vector<CodePointT> & codepoints, Events::WorkerPool * pool)
+		{
+			DREAM_ASSERT(_face != NULL);
+
+			// Each worker opens the font again from the same source:
+			Detail::FontFace::OpenFaceT open_face;
+
+			if (_font_data) {
+				Shared<Buffer> buffer = _font_data->buffer();
+
+				open_face = [buffer](FT_Library library, FT_Face * face) {
+					return FT_New_Memory_Face(library, buffer->begin(), buffer->size(), 0, face);
+				};
+			} else {
+				StringT path = _font_path.to_local_path();
+
+				open_face = [path](FT_Library library, FT_Face * face) {
+					return FT_New_Face(library, path.c_str(), 0, face);
+				};
+			}
+
+			return _face->prewarm_glyphs(codepoints, open_face, pool);
+		}
+
+		std::size_t Font::prewarm_text (const std::string & text, Events::WorkerPool * pool)
+		{
+			std::vector<CodePointT> codepoints;
+
+			auto current = text.begin(), end = text.end();
+			while (current != end)
+				codepoints.push_back(utf8::next(current, end));
+
+			std::sort(codepoints.begin(), codepoints.end());
+			codepoints.erase(std::unique(codepoints.begin(), codepoints.end()), codepoints.end());
+
+			return prewarm(codepoints, pool);
+		}
+
 		// uses a method described in fterrors.h to build an error translation function
 #undef __FTERRORS_H__
 #define FT_ERRORDEF(e, v, s)            case v: return s;
@@ -149,5 +200,57 @@ namespace Dream
 			std::cerr << __PRETTY_FUNCTION__ << "unknown error code: " << code << std::endl;
 			return "unknown error";
 		}
+
+// MARK: -
+// MARK: Unit Tests
+
+#ifdef ENABLE_TESTING
+		UNIT_TEST(FontPrewarm)
+		{
+			Ref<Font> font = load_test_font(), reference = load_test_font();
+
+			if (!font) {
+				logger()->log(LOG_WARN, "Could not find a font, skipping prewarm tests.");
+				return;
+			}
+
+			testing("Prewarming glyphs");
+
+			std::vector<CodePointT> codepoints;
+			for (CodePointT codepoint = 32; codepoint < 256; codepoint += 1)
+				codepoints.push_back(codepoint);
+
+			Ref<Events::WorkerPool> pool = new Events::WorkerPool(3);
+			std::size_t count = font->prewarm(codepoints, pool.get());
+
+			check(count > 90) << "Glyphs were rendered";
+			check(font->font_face()->glyph_cache_size() == count) << "Glyphs were added to the cache";
+			check(font->font_face()->is_glyph_cached(font->font_face()->get_char_index('A'))) << "Glyph is cached";
+			check(font->prewarm_text("ABC", pool.get()) == 0) << "Cached glyphs are not rendered again";
+
+			Ref<Image> image = font->render_text("Prewarmed glyphs"), expected = reference->render_text("Prewarmed glyphs");
+			check(image->size() == expected->size() && memcmp(image->pixel_data(), expected->pixel_data(), image->pixel_data_length()) == 0) << "Prewarmed glyphs match glyphs loaded on demand";
+
+			testing("Prewarming performance");
+
+			Ref<Events::WorkerPool> automatic = new Events::WorkerPool;
+
+			auto measure = [&](Events::WorkerPool * pool) {
+				Ref<Font> fresh = load_test_font();
+				fresh->set_pixel_size(64);
+
+				Stopwatch stopwatch;
+				stopwatch.start();
+				fresh->prewarm(codepoints, pool);
+				stopwatch.pause();
+
+				return stopwatch.time();
+			};
+
+			TimeT single = measure(NULL), parallel = measure(automatic.get());
+
+			logger()->log(LOG_INFO, LogBuffer() << "Prewarming " << count << " glyphs: " << single * 1000.0 << "ms with one thread, " << parallel * 1000.0 << "ms with " << automatic->thread_count() << " threads.");
+		}
+#endif
 	}
 }
@@ -11,9 +11,17 @@
 #define _DREAM_IMAGING_TEXT_FONT_H
 
 #include "../Imaging/Image.h"
+#include "../Core/Strings.h"
+
+#include <vector>
 
 namespace Dream
 {
+	namespace Events
+	{
+		class WorkerPool;
+	}
+
 	namespace Text
 	{
 		using namespace Dream::Imaging;
@@ -39,6 +47,7 @@ namespace Dream
 		protected:
 			Detail::FontFace *_face;
 			Ref<IData> _font_data;
+			Path _font_path;
 
 			Vec2u compute_bounding_box (const std::string & text) const;
 
@@ -65,6 +74,12 @@ namespace Dream
 			// utf8 encoding is assumed.
 			Ref<Image> render_text (const std::string & text);
 			Ref<Image> render_text (const std::string & text, unsigned line_width);
+
+			/// Renders the glyphs for the given characters at the current pixel size, so that they don't need to be loaded the first time text is laid out. The glyphs are rendered in parallel on the given pool, or serially if there is no pool. Returns the number of glyphs which were added.
+			std::size_t prewarm (const std::vector<CodePointT> & codepoints, Events::WorkerPool * pool = NULL);
+
+			/// Prewarms the distinct characters in the given text, e.g. a character set file or a localization table.
+			std::size_t prewarm_text (const std::string & text, Events::WorkerPool * pool = NULL);
 		};
 	}
 }
@@ -10,6 +10,18 @@
 #include "FontFace.h"
 #include "TextBlock.h"
 #include "../Events/Logger.h"
+#include "../Events/Thread.h"
+#include "../Core/Strings.h"
+#include "../Core/Timer.h"
+
+#ifdef ENABLE_TESTING
+#include "TestFont.h"
+#endif
+
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include <atomic>
 
 namespace Dream
 {
@@ -69,11 +81,11 @@ namespace Dream
 				return glyph->format == FT_GLYPH_FORMAT_OUTLINE;
 			}
 
-			unsigned FontGlyph::hinting_adjustment(unsigned prev_rsbdelta) const
+			FT_Pos FontGlyph::hinting_adjustment(FT_Pos prev_rsbdelta) const
 			{
-				if (prev_rsbdelta - lsb_delta >= 32)
-					return 64;
-				else if (prev_rsbdelta - lsb_delta < -32)
+				if (prev_rsbdelta - lsb_delta > 32)
+					return -64;
+				else if (prev_rsbdelta - lsb_delta < -31)
 					return 64;
 
 				return 0;
@@ -81,8 +93,13 @@ namespace Dream
 
 // MARK: -
 
-			FontFace::FontFace (FT_Face _face, PixelFormat _fmt) : _face(_face), _pixel_format(_fmt)
+			/// Identifiers for the glyphs of each face in a glyph atlas.
+			static std::atomic<unsigned> next_atlas_identifier(0);
+
+			FontFace::FontFace (FT_Face _face, PixelFormat _fmt) : _face(_face), _pixel_format(_fmt), _run_cache_capacity(256), _run_cache_hits(0), _run_cache_misses(0)
 			{
+				// The key has 24 bits for the face, so identifiers wrap around:
+				_atlas_identifier = next_atlas_identifier++ & 0xFFFFFF;
 			}
 
 			FontFace::~FontFace ()
@@ -96,6 +113,9 @@ namespace Dream
 
 				FT_Done_Face(_face);
 
+				for (auto library : _worker_libraries)
+					FT_Done_FreeType(library);
+
 				logger()->log(LOG_INFO, LogBuffer() << "Freed " << count << " cached glyphs.");
 			}
 
@@ -135,29 +155,393 @@ namespace Dream
 				return _pixel_format;
 			}
 
+			static FT_Error render_glyph (FT_Face face, FT_UInt idx, FontGlyph * & glyph)
+			{
+				FT_Error err = FT_Load_Glyph(face, idx, FT_LOAD_RENDER);
+				if (err) return err;
+
+				glyph = new FontGlyph;
+
+				// Copy glyph into cache
+				FT_Get_Glyph(face->glyph, &glyph->glyph);
+				glyph->advance = face->glyph->advance;
+				glyph->lsb_delta = face->glyph->lsb_delta;
+				glyph->rsb_delta = face->glyph->rsb_delta;
+
+				return 0;
+			}
+
 			FontGlyph * FontFace::load_glyph_for_index (FT_UInt idx)
 			{
-				//FT_UInt idx = FT_Get_Char_Index(_face, c);
-				GlyphMapT::iterator itr = _glyph_cache.find(idx);
+				GlyphAtlas::KeyT key = GlyphAtlas::glyph_key(idx, _face->size->metrics.y_ppem);
+				GlyphMapT::iterator itr = _glyph_cache.find(key);
 
 				if (itr != _glyph_cache.end()) {
 					return itr->second;
 				}
 
+				FontGlyph * cache = NULL;
+
+				FT_Error err = render_glyph(_face, idx, cache);
+				if (err) throw TypographyException(err);
+
+				_glyph_cache[key] = cache;
+
+				return cache;
+			}
+
+			bool FontFace::is_glyph_cached (FT_UInt idx) const
+			{
+				return _glyph_cache.count(GlyphAtlas::glyph_key(idx, _face->size->metrics.y_ppem));
+			}
+
+			std::size_t FontFace::prewarm_glyphs (const std::vector<CodePointT> & codepoints, OpenFaceT open_face, Events::WorkerPool * pool)
+			{
+				// Find the distinct glyphs which are not already cached:
+				std::vector<FT_UInt> indices;
+
+				for (auto codepoint : codepoints) {
+					FT_UInt idx = get_char_index(codepoint);
+
+					if (idx != 0 && !is_glyph_cached(idx))
+						indices.push_back(idx);
+				}
+
+				std::sort(indices.begin(), indices.end());
+				indices.erase(std::unique(indices.begin(), indices.end()), indices.end());
+
+				if (indices.empty())
+					return 0;
+
+				// Opening a face is expensive, so there is one worker per thread, and the glyphs are shared between them:
+				std::size_t threads = std::min(pool ? pool->thread_count() : 1, indices.size());
+
+				struct Worker {
+					FT_Library library;
+					std::vector<std::pair<FT_UInt, FontGlyph*>> glyphs;
+				};
+
+				std::vector<Worker> workers(threads);
+				std::atomic<std::size_t> next(0);
+
+				FT_UInt width = _face->size->metrics.x_ppem, height = _face->size->metrics.y_ppem;
+
+				Events::parallel_for(pool, workers.size(), [&](std::size_t index) {
+					Worker & worker = workers[index];
+					worker.library = NULL;
+
+					if (FT_Init_FreeType(&worker.library))
+						return;
+
+					FT_Face face;
+					if (open_face(worker.library, &face))
+						return;
+
+					FT_Set_Pixel_Sizes(face, width, height);
+
+					for (std::size_t i = next++; i < indices.size(); i = next++) {
+						FontGlyph * glyph = NULL;
+
+						if (!render_glyph(face, indices[i], glyph))
+							worker.glyphs.push_back(std::make_pair(indices[i], glyph));
+					}
+
+					FT_Done_Face(face);
+				});
+
+				// Merge the results into the shared cache:
+				std::size_t count = 0;
+
+				for (auto & worker : workers) {
+					if (!worker.library) {
+						logger()->log(LOG_ERROR, "Could not initialize FreeType for glyph prewarming.");
+						continue;
+					}
+
+					for (auto & result : worker.glyphs) {
+						_glyph_cache[GlyphAtlas::glyph_key(result.first, height)] = result.second;
+						count += 1;
+					}
+
+					_worker_libraries.push_back(worker.library);
+				}
+
+				return count;
+			}
+
+			Ref<ShapedRun> FontFace::layout_run (const std::string & text, bool kerning)
+			{
+				Ref<ShapedRun> run = new ShapedRun;
+				run->text = text;
+
+				FT_Pos x = 0, prev_rsbdelta = 0;
+				FT_UInt previous = 0;
+
+				auto begin = text.begin(), current = begin, end = text.end();
+
+				// The text is decoded once, here:
+				while (current != end) {
+					ShapedGlyph shaped;
+
+					shaped.offset = current - begin;
+					shaped.codepoint = utf8::next(current, end);
+					shaped.index = get_char_index(shaped.codepoint);
+
+					FontGlyph * glyph = load_glyph_for_index(shaped.index);
+					shaped.glyph = glyph;
+
+					if (kerning && previous != 0 && shaped.index != 0) {
+						FT_Vector k;
+						FT_Get_Kerning(_face, previous, shaped.index, FT_KERNING_DEFAULT, &k);
+
+						x += k.x;
+					}
+
+					x += glyph->hinting_adjustment(prev_rsbdelta);
+
+					shaped.x = x;
+					shaped.leading = glyph->hinting_adjustment(0);
+
+					// We add one here to avoid problems where the box isn't quite wide enough due to anti-aliasing issues:
+					FT_BBox bbox;
+					glyph->get_cbox(FT_GLYPH_BBOX_PIXELS, &bbox);
+					shaped.right = (glyph->is_bitmap() ? ((FT_BitmapGlyph)glyph->glyph)->left : 0) + bbox.xMax + 1;
+
+					run->glyphs.push_back(shaped);
+
+					x += glyph->advance.x;
+
+					previous = shaped.index;
+					prev_rsbdelta = glyph->rsb_delta;
+				}
+
+				return run;
+			}
+
+			Ref<ShapedRun> FontFace::shape_text (const std::string & text, bool kerning, bool cache)
+			{
+				if (!cache)
+					return layout_run(text, kerning);
+
+				RunKey key = {pixel_size(), kerning, text};
+
+				auto iterator = _run_cache.find(key);
+
+				if (iterator != _run_cache.end()) {
+					_run_cache_hits += 1;
+
+					// Move the run to the front of the list:
+					_runs.splice(_runs.begin(), _runs, iterator->second);
+
+					return iterator->second->second;
+				}
+
+				_run_cache_misses += 1;
+
+				Ref<ShapedRun> run = layout_run(text, kerning);
+
+				if (_run_cache_capacity) {
+					if (_runs.size() >= _run_cache_capacity) {
+						_run_cache.erase(_runs.back().first);
+						_runs.pop_back();
+					}
+
+					_runs.push_front(std::make_pair(key, run));
+					_run_cache[key] = _runs.begin();
+				}
+
+				return run;
+			}
+
+			void FontFace::set_run_cache_capacity (std::size_t capacity)
+			{
+				_run_cache_capacity = capacity;
+
+				while (_runs.size() > _run_cache_capacity) {
+					_run_cache.erase(_runs.back().first);
+					_runs.pop_back();
+				}
+			}
+
+			void FontFace::clear_run_cache ()
+			{
+				_run_cache.clear();
+				_runs.clear();
+			}
+
+			static Ref<Image> copy_bitmap (const FT_Bitmap & bitmap)
+			{
+				Ref<Image> image = new Image(Vec3u(bitmap.width, bitmap.rows, 1), PixelFormat::A, DataType::BYTE);
+
+				for (std::size_t y = 0; y < bitmap.rows; y += 1) {
+					memcpy(image->pixel_data_at(Vec3u(0, y, 0)), bitmap.buffer + (int)y * bitmap.pitch, bitmap.width);
+				}
+
+				return image;
+			}
+
+			const GlyphAtlas::Glyph * FontFace::load_glyph_into_atlas (FT_UInt idx, GlyphAtlas & atlas)
+			{
+				GlyphAtlas::KeyT key = GlyphAtlas::glyph_key(idx, _face->size->metrics.y_ppem, _atlas_identifier);
+
+				const GlyphAtlas::Glyph * glyph = atlas.lookup(key);
+				if (glyph) return glyph;
+
 				FT_Error err = FT_Load_Glyph(_face, idx, FT_LOAD_RENDER);
 				if (err) throw TypographyException(err);
 
-				FontGlyph * cache = new FontGlyph;
+				FT_GlyphSlot slot = _face->glyph;
+				FT_Bitmap & bitmap = slot->bitmap;
 
-				// Copy glyph into cache
-				FT_Get_Glyph(_face->glyph, &cache->glyph);
-				cache->advance = _face->glyph->advance;
-				cache->lsb_delta = _face->glyph->lsb_delta;
-				cache->rsb_delta = _face->glyph->rsb_delta;
+				GlyphMetrics metrics;
+				metrics.left = slot->bitmap_left;
+				metrics.bottom = slot->bitmap_top - (int)bitmap.rows;
+				metrics.advance = slot->advance.x;
+				metrics.lsb_delta = slot->lsb_delta;
+				metrics.rsb_delta = slot->rsb_delta;
 
-				_glyph_cache[idx] = cache;
+				// The slot bitmap is copied directly, rather than creating an intermediate FT_Glyph:
+				glyph = atlas.insert(key, *copy_bitmap(bitmap), metrics);
 
-				return cache;
+				if (!glyph)
+					logger()->log(LOG_WARN, LogBuffer() << "Glyph " << idx << " could not be added to the glyph atlas.");
+
+				return glyph;
+			}
+
+			static Vec2 outline_point (const FT_Vector * point)
+			{
+				return Vec2(point->x / 64.0, point->y / 64.0);
+			}
+
+			static int outline_move_to (const FT_Vector * to, void * user)
+			{
+				((DistanceFieldShape *)user)->move_to(outline_point(to));
+				return 0;
+			}
+
+			static int outline_line_to (const FT_Vector * to, void * user)
+			{
+				((DistanceFieldShape *)user)->line_to(outline_point(to));
+				return 0;
+			}
+
+			static int outline_conic_to (const FT_Vector * control, const FT_Vector * to, void * user)
+			{
+				((DistanceFieldShape *)user)->quadratic_to(outline_point(control), outline_point(to));
+				return 0;
+			}
+
+			static int outline_cubic_to (const FT_Vector * control1, const FT_Vector * control2, const FT_Vector * to, void * user)
+			{
+				((DistanceFieldShape *)user)->cubic_to(outline_point(control1), outline_point(control2), outline_point(to));
+				return 0;
+			}
+
+			struct DistanceFieldJob {
+				GlyphAtlas::KeyT key;
+				GlyphMetrics metrics;
+
+				// The input, either a bitmap or an outline:
+				Ref<Image> bitmap;
+				DistanceFieldShape shape;
+				Vec2u size;
+				Vec2 translate;
+
+				Ref<Image> field;
+			};
+
+			void FontFace::load_distance_fields_into_atlas (const std::vector<FT_UInt> & indices, GlyphAtlas & atlas, DistanceFieldType type, std::size_t spread, std::size_t scale, Events::WorkerPool * pool)
+			{
+				std::vector<DistanceFieldJob> jobs;
+				jobs.reserve(indices.size());
+
+				// FreeType faces can't be used concurrently, so glyphs are loaded sequentially:
+				if (type == DistanceFieldType::SIGNED) {
+					FT_Matrix matrix = {(FT_Fixed)(scale << 16), 0, 0, (FT_Fixed)(scale << 16)};
+					FT_Set_Transform(_face, &matrix, NULL);
+				}
+
+				for (auto index : indices) {
+					GlyphAtlas::KeyT key = GlyphAtlas::glyph_key(index, _face->size->metrics.y_ppem, _atlas_identifier);
+
+					if (atlas.lookup(key)) continue;
+
+					jobs.push_back(DistanceFieldJob());
+					DistanceFieldJob & job = jobs.back();
+					job.key = key;
+
+					FT_Error err;
+					FT_GlyphSlot slot = _face->glyph;
+
+					if (type == DistanceFieldType::SIGNED) {
+						err = FT_Load_Glyph(_face, index, FT_LOAD_RENDER | FT_LOAD_NO_HINTING);
+
+						if (!err) {
+							job.bitmap = copy_bitmap(slot->bitmap);
+
+							// Convert the high resolution placement back to the current size, including the padding:
+							std::size_t height = (slot->bitmap.rows + spread * scale * 2 + scale - 1) / scale;
+							job.metrics.left = (int)std::floor(RealT(slot->bitmap_left) / scale) - (int)spread;
+							job.metrics.bottom = (int)std::floor(RealT(slot->bitmap_top) / scale) + (int)spread - (int)height;
+							job.metrics.advance = slot->advance.x / (FT_Pos)scale;
+						}
+					} else {
+						err = FT_Load_Glyph(_face, index, FT_LOAD_NO_BITMAP | FT_LOAD_NO_HINTING);
+
+						if (!err && slot->format == FT_GLYPH_FORMAT_OUTLINE) {
+							FT_Outline_Funcs functions = {outline_move_to, outline_line_to, outline_conic_to, outline_cubic_to, 0, 0};
+							FT_Outline_Decompose(&slot->outline, &functions, &job.shape);
+
+							FT_BBox box;
+							FT_Outline_Get_CBox(&slot->outline, &box);
+
+							int left = (int)std::floor(box.xMin / 64.0) - (int)spread, bottom = (int)std::floor(box.yMin / 64.0) - (int)spread;
+							int right = (int)std::ceil(box.xMax / 64.0) + (int)spread, top = (int)std::ceil(box.yMax / 64.0) + (int)spread;
+
+							job.size = Vec2u(right - left, top - bottom);
+							job.translate = Vec2(-left, -bottom);
+							job.metrics.left = left;
+							job.metrics.bottom = bottom;
+							job.metrics.advance = slot->advance.x;
+						}
+					}
+
+					job.metrics.lsb_delta = job.metrics.rsb_delta = 0;
+
+					if (err) {
+						if (type == DistanceFieldType::SIGNED)
+							FT_Set_Transform(_face, NULL, NULL);
+
+						throw TypographyException(err);
+					}
+				}
+
+				if (type == DistanceFieldType::SIGNED)
+					FT_Set_Transform(_face, NULL, NULL);
+
+				// Each field only depends on its own job, so they can be generated in parallel:
+				Events::parallel_for(pool, jobs.size(), [&](std::size_t i) {
+					DistanceFieldJob & job = jobs[i];
+
+					if (type == DistanceFieldType::SIGNED) {
+						if (job.bitmap->size()[X] && job.bitmap->size()[Y])
+							job.field = generate_distance_field(*job.bitmap, spread, scale);
+					} else {
+						if (!job.shape.empty()) {
+							job.shape.color_edges();
+							job.field = job.shape.generate(job.size, 1, job.translate, spread);
+						}
+					}
+				});
+
+				PixelFormat pixel_format = type == DistanceFieldType::SIGNED ? PixelFormat::A : PixelFormat::RGB;
+				Ref<Image> empty = new Image(Vec3u(0, 0, 1), pixel_format, DataType::BYTE);
+
+				for (auto & job : jobs) {
+					if (!atlas.insert(job.key, job.field ? *job.field : *empty, job.metrics))
+						logger()->log(LOG_WARN, "Distance field is too large for the glyph atlas.");
+				}
 			}
 
 			Vec2u FontFace::process_text(const std::string& text, Ref<Image> dst)
@@ -174,6 +558,95 @@ namespace Dream
 
 				return size;
 			}
+
+// MARK: -
+// MARK: Unit Tests
+
+#ifdef ENABLE_TESTING
+			UNIT_TEST(TextRunCache)
+			{
+				Ref<Font> font = load_test_font();
+
+				if (!font) {
+					logger()->log(LOG_WARN, "Could not find a font, skipping text run cache tests.");
+					return;
+				}
+
+				FontFace * face = font->font_face();
+
+				testing("Decoding UTF-8");
+
+				const std::string text = "Gr\xC3\xBC\xC3\x9F" "e";
+				Ref<ShapedRun> run = face->shape_text(text, true);
+
+				check(run->glyphs.size() == 5) << "Each character has one glyph";
+				check(run->glyphs[2].codepoint == 0xFC && run->glyphs[3].offset == 4) << "Characters were decoded";
+
+				TextBlock block(face);
+				block.set_text(text);
+
+				CharacterBoxes boxes;
+				Ref<Image> image = new Image(block.calculate_size() << 1U, PixelFormat::A, DataType::BYTE);
+				image->zero();
+				block.render(image, &boxes);
+
+				check(boxes.size() == 5) << "Each character was rendered once";
+				check(block.text() == text) << "Text is preserved";
+
+				testing("Caching runs");
+
+				std::size_t hits = face->run_cache_hits();
+				check(face->shape_text(text, true) == run) << "Run was cached";
+				check(face->run_cache_hits() == hits + 1) << "Cache hit was counted";
+				check(face->shape_text(text, false) != run) << "Kerning is part of the key";
+
+				font->set_pixel_size(20);
+				check(face->shape_text(text, true) != run) << "Pixel size is part of the key";
+				font->set_pixel_size(12);
+
+				face->set_run_cache_capacity(2);
+				face->shape_text("A", true);
+				face->shape_text("B", true);
+				check(face->shape_text(text, true) != run) << "Least recently used run was discarded";
+
+				testing("User interface workload");
+
+				std::vector<std::string> labels = {"New Game", "Continue", "Options", "Quit", "Player One", "Player Two", "FPS: 60", "Health", "Ammo: 30"};
+				for (std::size_t i = 0; i < 20; i += 1) {
+					StringStreamT score;
+					score << "Score: " << (i * 1250);
+					labels.push_back(score.str());
+				}
+
+				// Lays out every label as Font::render_text would, for a number of frames, and returns the time per frame:
+				auto measure = [&](std::size_t capacity) {
+					face->clear_run_cache();
+					face->set_run_cache_capacity(capacity);
+
+					Stopwatch stopwatch;
+					stopwatch.start();
+
+					const std::size_t frames = 200;
+					for (std::size_t frame = 0; frame < frames; frame += 1) {
+						for (auto & label : labels) {
+							TextBlock label_block(face);
+							label_block.set_text(label);
+							label_block.calculate_size();
+						}
+					}
+
+					stopwatch.pause();
+
+					return stopwatch.time() / frames;
+				};
+
+				TimeT uncached = measure(0), cached = measure(256);
+
+				logger()->log(LOG_INFO, LogBuffer() << "Laying out " << labels.size() << " labels: " << uncached * 1000000.0 << "us uncached, " << cached * 1000000.0 << "us cached.");
+
+				check(cached < uncached) << "Cached layout is faster";
+			}
+#endif
 		}
 	}
 }
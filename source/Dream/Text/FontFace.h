@@ -13,14 +13,19 @@
 // This is a private header, and should not be used as public API.
 
 #include "Font.h"
+#include "GlyphAtlas.h"
+#include "DistanceField.h"
 
-#include <map>
+#include <functional>
+#include <list>
+#include <unordered_map>
 
 // Should we hide these details?
 #include <ft2build.h>
 #include FT_FREETYPE_H
 #include FT_GLYPH_H
 #include FT_CACHE_H
+#include FT_OUTLINE_H
 
 namespace Dream
 {
@@ -46,17 +51,86 @@ namespace Dream
 				bool is_bitmap () const;
 				bool is_outline () const;
 
-				unsigned hinting_adjustment(unsigned prev_rsbdelta) const;
+				/// The adjustment to the pen position to compensate for hinting, given the right side bearing delta of the previous glyph.
+				FT_Pos hinting_adjustment(FT_Pos prev_rsbdelta) const;
+			};
+
+			struct ShapedGlyph {
+				CodePointT codepoint;
+				FT_UInt index;
+				const FontGlyph * glyph;
+
+				/// The byte offset of the character in the text.
+				std::size_t offset;
+
+				/// The pen position in 26.6 fixed point relative to the start of the run, including kerning and hinting adjustments.
+				FT_Pos x;
+
+				/// The hinting adjustment applied if this glyph starts a line.
+				FT_Pos leading;
+
+				/// The right edge of the glyph in pixels, relative to the pen position.
+				int right;
+			};
+
+			/// A string which has been decoded and laid out on a single line. Runs are immutable, so they can be shared by several lines and cached.
+			class ShapedRun : public Object {
+			public:
+				std::string text;
+				std::vector<ShapedGlyph> glyphs;
+
+				/// The pen position of the given glyph, for a line which starts at the glyph begin.
+				FT_Pos line_position (std::size_t begin, std::size_t index) const {
+					return glyphs[index].x - glyphs[begin].x + glyphs[begin].leading;
+				}
+
+				/// The width in pixels of the glyphs from begin up to end.
+				std::size_t line_width (std::size_t begin, std::size_t end) const {
+					if (begin == end) return 0;
+
+					return std::max<FT_Pos>((line_position(begin, end - 1) >> 6) + glyphs[end - 1].right, 0);
+				}
 			};
 
 			class FontFace {
 			protected:
-				typedef std::map<FT_UInt, FontGlyph*> GlyphMapT;
+				// Glyphs are cached for each pixel size, using the same keys as GlyphAtlas:
+				typedef std::unordered_map<GlyphAtlas::KeyT, FontGlyph*> GlyphMapT;
 				GlyphMapT _glyph_cache;
 
 				FT_Face _face;
 				PixelFormat _pixel_format; //ALPHA or INTENSITY
 
+				// Distinguishes the glyphs of this face from those of other faces in a shared atlas:
+				unsigned _atlas_identifier;
+
+				struct RunKey {
+					unsigned pixel_size;
+					bool kerning;
+					std::string text;
+
+					bool operator== (const RunKey & other) const {
+						return pixel_size == other.pixel_size && kerning == other.kerning && text == other.text;
+					}
+				};
+
+				struct RunKeyHash {
+					std::size_t operator() (const RunKey & key) const {
+						return std::hash<std::string>()(key.text) ^ (key.pixel_size << 1) ^ key.kerning;
+					}
+				};
+
+				// The most recently used runs are at the front of the list:
+				typedef std::list<std::pair<RunKey, Ref<ShapedRun>>> RunListT;
+				RunListT _runs;
+				std::unordered_map<RunKey, RunListT::iterator, RunKeyHash> _run_cache;
+				std::size_t _run_cache_capacity, _run_cache_hits, _run_cache_misses;
+
+				Ref<ShapedRun> layout_run (const std::string & text, bool kerning);
+
+				// Glyphs rendered by workers are allocated by their own library, which must outlive them:
+				std::vector<FT_Library> _worker_libraries;
+
 			public:
 				FontFace (FT_Face _face, PixelFormat _fmt);
 				virtual ~FontFace ();
@@ -73,8 +147,36 @@ namespace Dream
 
 				PixelFormat pixel_format ();
 
+				/// The current pixel size of the face, which determines the size of the glyphs and the layout of runs.
+				unsigned pixel_size () const { return _face->size->metrics.y_ppem; }
+
 				FontGlyph * load_glyph_for_index (FT_UInt c);
 
+				bool is_glyph_cached (FT_UInt c) const;
+				std::size_t glyph_cache_size () const { return _glyph_cache.size(); }
+
+				/// Opens a separate face for the same font using the given library.
+				typedef std::function<FT_Error (FT_Library library, FT_Face * face)> OpenFaceT;
+
+				/// Renders the glyphs for the given characters at the current pixel size and adds them to the glyph cache, using the pool if there is one. FreeType faces can't be shared between threads, so each worker opens its own library and face. Returns the number of glyphs which were added.
+				std::size_t prewarm_glyphs (const std::vector<CodePointT> & codepoints, OpenFaceT open_face, Events::WorkerPool * pool = NULL);
+
+				/// Decodes and lays out the text on a single line, or returns the cached run if the same text was laid out recently at the current size. If cache is false, the run is laid out without using the cache, e.g. for text which is unlikely to be repeated.
+				Ref<ShapedRun> shape_text (const std::string & text, bool kerning, bool cache = true);
+
+				/// The maximum number of runs kept in the cache, which is discarded in least recently used order.
+				void set_run_cache_capacity (std::size_t capacity);
+				void clear_run_cache ();
+
+				std::size_t run_cache_hits () const { return _run_cache_hits; }
+				std::size_t run_cache_misses () const { return _run_cache_misses; }
+
+				/// Renders the glyph directly into the atlas if it is not already present, at the current pixel size of the face.
+				const GlyphAtlas::Glyph * load_glyph_into_atlas (FT_UInt c, GlyphAtlas & atlas);
+
+				/// Generates distance fields for the given glyphs at the current pixel size and inserts them into the atlas, which should have a matching pixel format (A or RGB) and not be shared with regular glyphs. The glyphs are loaded sequentially, but the fields are generated in parallel if a pool is given. A signed distance field is generated from a bitmap rendered at scale times the current size.
+				void load_distance_fields_into_atlas (const std::vector<FT_UInt> & indices, GlyphAtlas & atlas, DistanceFieldType type, std::size_t spread = 4, std::size_t scale = 4, Events::WorkerPool * pool = NULL);
+
 				Vec2u process_text(const std::string & text, Ref<Image> dst);
 			};
 		}
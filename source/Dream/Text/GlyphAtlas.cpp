@@ -0,0 +1,322 @@
+//
+//  Text/GlyphAtlas.cpp
+//  This file is part of the "Dream" project, and is released under the MIT license.
+//
+//  Created by agent on 18/10/26.
+//  Copyright (c) 2026 agent. All rights reserved.
+//
+//
+
+#include "GlyphAtlas.h"
+#include "../Events/Logger.h"
+
+#include <cstring>
+
+namespace Dream
+{
+	namespace Text
+	{
+		using namespace Events::Logging;
+
+		/// When a page has more dirty regions than this, they are merged into a single region.
+		const std::size_t MAXIMUM_DIRTY_REGIONS = 16;
+
+		GlyphAtlas::GlyphAtlas (const Vec2u & page_size, std::size_t maximum_pages, std::size_t padding, PixelFormat pixel_format) : _page_size(page_size), _maximum_pages(maximum_pages), _padding(padding), _pixel_format(pixel_format), _frame(0), _evicted_pages(0)
+		{
+			DREAM_ASSERT(maximum_pages > 0);
+		}
+
+		GlyphAtlas::~GlyphAtlas ()
+		{
+		}
+
+		void GlyphAtlas::mark_dirty (Page & page, const AlignedBox2u & region)
+		{
+			page.dirty_regions.push_back(region);
+
+			if (page.dirty_regions.size() > MAXIMUM_DIRTY_REGIONS) {
+				Vec2u min = page.dirty_regions[0].min(), max = page.dirty_regions[0].max();
+
+				for (auto & dirty_region : page.dirty_regions) {
+					for (std::size_t i = 0; i < 2; i += 1) {
+						min[i] = std::min(min[i], dirty_region.min()[i]);
+						max[i] = std::max(max[i], dirty_region.max()[i]);
+					}
+				}
+
+				page.dirty_regions.clear();
+				page.dirty_regions.push_back(AlignedBox2u(min, max));
+			}
+		}
+
+		std::size_t GlyphAtlas::evict_page ()
+		{
+			std::size_t index = 0;
+
+			for (std::size_t i = 1; i < _pages.size(); i += 1) {
+				if (_pages[i].last_used < _pages[index].last_used)
+					index = i;
+			}
+
+			Page & page = _pages[index];
+
+			if (page.last_used == _frame) {
+				logger()->log(LOG_WARN, "Glyph atlas is full of glyphs used in the current frame, consider increasing the number of pages.");
+
+				return _pages.size();
+			}
+
+			for (auto key : page.glyphs)
+				_glyphs.erase(key);
+
+			page.glyphs.clear();
+			page.packer.reset();
+			page.image->clear();
+
+			page.dirty_regions.clear();
+			mark_dirty(page, AlignedBox2u(Vec2u(ZERO), _page_size));
+
+			_evicted_pages += 1;
+
+			return index;
+		}
+
+		bool GlyphAtlas::allocate (const Vec2u & size, std::size_t & page, Vec2u & origin)
+		{
+			if (size[X] > _page_size[X] || size[Y] > _page_size[Y])
+				return false;
+
+			for (page = 0; page < _pages.size(); page += 1) {
+				if (_pages[page].packer.allocate(size, origin))
+					return true;
+			}
+
+			if (_pages.size() < _maximum_pages) {
+				_pages.push_back(Page(_page_size));
+
+				Page & new_page = _pages.back();
+				new_page.image = new Image(_page_size << 1U, _pixel_format, DataType::BYTE);
+				new_page.image->clear();
+
+				mark_dirty(new_page, AlignedBox2u(Vec2u(ZERO), _page_size));
+			} else {
+				page = evict_page();
+
+				if (page == _pages.size())
+					return false;
+			}
+
+			return _pages[page].packer.allocate(size, origin);
+		}
+
+		const GlyphAtlas::Glyph * GlyphAtlas::lookup (KeyT key)
+		{
+			auto iterator = _glyphs.find(key);
+
+			if (iterator == _glyphs.end())
+				return NULL;
+
+			Glyph & glyph = iterator->second;
+
+			glyph.last_used = _frame;
+
+			// Empty glyphs don't keep any page in use:
+			if (glyph.page != NO_PAGE)
+				_pages[glyph.page].last_used = _frame;
+
+			return &glyph;
+		}
+
+		const GlyphAtlas::Glyph * GlyphAtlas::insert (KeyT key, const IPixelBuffer & bitmap, const GlyphMetrics & metrics)
+		{
+			DREAM_ASSERT(bitmap.pixel_format() == _pixel_format);
+
+			const Glyph * existing = lookup(key);
+			if (existing) return existing;
+
+			Glyph glyph;
+			Vec2u size(bitmap.size()[X], bitmap.size()[Y]);
+
+			glyph.page = NO_PAGE;
+			glyph.bounds = AlignedBox2u(Vec2u(ZERO), Vec2u(ZERO));
+			glyph.uv = AlignedBox2(Vec2(ZERO), Vec2(ZERO));
+			glyph.metrics = metrics;
+			glyph.last_used = _frame;
+
+			// Glyphs without a bitmap, such as spaces, only need metrics:
+			if (size[X] && size[Y]) {
+				Vec2u origin;
+
+				if (!allocate(size + (_padding * 2), glyph.page, origin))
+					return NULL;
+
+				Page & page = _pages[glyph.page];
+				origin += _padding;
+
+				// Copy the rows in reverse order, so that the bottom of the glyph is at the bottom of the page:
+				const std::size_t pixel_size = bitmap.bytes_per_pixel(), row_length = size[X] * pixel_size;
+				for (std::size_t y = 0; y < size[Y]; y += 1) {
+					const ByteT * source = bitmap.pixel_data() + bitmap.pixel_offset(PixelCoordinateT(0, size[Y] - 1 - y, 0));
+					memcpy(page.image->pixel_data_at(PixelCoordinateT(origin[X], origin[Y] + y, 0)), source, row_length);
+				}
+
+				glyph.bounds = AlignedBox2u(origin, origin + size);
+
+				for (std::size_t i = 0; i < 2; i += 1) {
+					glyph.uv.min()[i] = RealT(origin[i]) / _page_size[i];
+					glyph.uv.max()[i] = RealT(origin[i] + size[i]) / _page_size[i];
+				}
+
+				mark_dirty(page, glyph.bounds);
+
+				page.glyphs.push_back(key);
+				page.last_used = _frame;
+			}
+
+			return &(_glyphs[key] = glyph);
+		}
+
+		void GlyphAtlas::clear_dirty_regions ()
+		{
+			for (auto & page : _pages)
+				page.dirty_regions.clear();
+		}
+
+		RealT GlyphAtlas::occupancy () const
+		{
+			if (_pages.empty()) return 0;
+
+			std::size_t used_area = 0;
+
+			for (auto & page : _pages)
+				used_area += page.packer.used_area();
+
+			return RealT(used_area) / RealT(_pages.size() * _page_size[X] * _page_size[Y]);
+		}
+
+		void GlyphAtlas::clear ()
+		{
+			_pages.clear();
+			_glyphs.clear();
+
+			_frame = 0;
+			_evicted_pages = 0;
+		}
+
+// MARK: -
+// MARK: Unit Tests
+
+#ifdef ENABLE_TESTING
+		UNIT_TEST(GlyphAtlas)
+		{
+			testing("Inserting glyphs");
+
+			Ref<GlyphAtlas> atlas = new GlyphAtlas(Vec2u(64, 64), 2, 1);
+
+			// A 10x12 glyph where each row has a distinct value:
+			Ref<Image> bitmap = new Image(PixelCoordinateT(10, 12, 1), PixelFormat::A, DataType::BYTE);
+			for (std::size_t y = 0; y < 12; y += 1)
+				memset(bitmap->pixel_data_at(PixelCoordinateT(0, y, 0)), y + 1, 10);
+
+			GlyphMetrics metrics = {1, -2, 11 << 6, 0, 0};
+			const GlyphAtlas::Glyph * glyph = atlas->insert(GlyphAtlas::glyph_key(42, 12), *bitmap, metrics);
+
+			check(glyph != NULL) << "Glyph was inserted";
+			check(atlas->page_count() == 1) << "One page was allocated";
+			check(glyph->bounds.size() == Vec2u(10, 12)) << "Glyph bounds match bitmap size";
+			check(glyph->metrics.advance == (11 << 6)) << "Metrics were stored";
+
+			Vec2u origin = glyph->bounds.min();
+			Ptr<Image> page = atlas->page_image(0);
+			check(page->pixel_data_at(PixelCoordinateT(origin[X], origin[Y], 0))[0] == 12) << "Bottom row of glyph is at the bottom of the page";
+			check(page->pixel_data_at(PixelCoordinateT(origin[X], origin[Y] + 11, 0))[0] == 1) << "Top row of glyph is at the top";
+
+			check(glyph->uv.min()[X] == RealT(origin[X]) / 64) << "Texture coordinates are normalized";
+			check(glyph->uv.max()[Y] == RealT(origin[Y] + 12) / 64) << "Texture coordinates are normalized";
+
+			check(atlas->lookup(GlyphAtlas::glyph_key(42, 12)) == glyph) << "Glyph can be found";
+			check(atlas->lookup(GlyphAtlas::glyph_key(42, 14)) == NULL) << "Glyphs of different sizes are separate";
+
+			testing("Dirty regions");
+
+			check(atlas->dirty_regions(0).size() == 2) << "New page and glyph are dirty";
+			atlas->clear_dirty_regions();
+			check(atlas->dirty_regions(0).size() == 0) << "Dirty regions were cleared";
+
+			atlas->insert(GlyphAtlas::glyph_key(43, 12), *bitmap, metrics);
+			check(atlas->dirty_regions(0).size() == 1) << "Only the new glyph is dirty";
+
+			testing("Eviction");
+
+			// Each page holds 20 padded glyphs (5 x 4), so this almost fills both pages:
+			for (unsigned i = 0; i < 36; i += 1) {
+				atlas->next_frame();
+				atlas->insert(GlyphAtlas::glyph_key(100 + i, 12), *bitmap, metrics);
+			}
+
+			check(atlas->page_count() == 2) << "Page count is limited";
+			check(atlas->evicted_pages() == 0) << "No pages evicted yet";
+
+			// Keep the second page in use, so the first page is the least recently used:
+			atlas->next_frame();
+			atlas->lookup(GlyphAtlas::glyph_key(135, 12));
+
+			for (unsigned i = 0; i < 4; i += 1)
+				atlas->insert(GlyphAtlas::glyph_key(200 + i, 12), *bitmap, metrics);
+
+			check(atlas->evicted_pages() == 1) << "Least recently used page was evicted";
+			check(atlas->lookup(GlyphAtlas::glyph_key(42, 12)) == NULL) << "Evicted glyphs were removed";
+			check(atlas->lookup(GlyphAtlas::glyph_key(135, 12)) != NULL) << "Recently used glyphs were kept";
+
+			testing("Eviction within a frame");
+
+			// Both pages have been used in this frame, so once the remaining space is filled, nothing can be evicted:
+			unsigned inserted = 0;
+			while (inserted < 40 && atlas->insert(GlyphAtlas::glyph_key(300 + inserted, 12), *bitmap, metrics))
+				inserted += 1;
+
+			check(inserted == 18) << "The remaining space was filled";
+			check(atlas->insert(GlyphAtlas::glyph_key(400, 12), *bitmap, metrics) == NULL) << "Pages used in the current frame are not evicted";
+			check(atlas->lookup(GlyphAtlas::glyph_key(135, 12)) != NULL && atlas->evicted_pages() == 1) << "Glyphs used in the current frame were kept";
+
+			atlas->next_frame();
+			check(atlas->insert(GlyphAtlas::glyph_key(400, 12), *bitmap, metrics) != NULL && atlas->evicted_pages() == 2) << "Page is evicted in the next frame";
+
+			testing("Font faces");
+
+			check(GlyphAtlas::glyph_key(42, 12, 1) != GlyphAtlas::glyph_key(42, 12, 2)) << "Glyphs of different faces have different keys";
+			check(GlyphAtlas::glyph_key(42, 12, 1) != GlyphAtlas::glyph_key(42, 13, 1)) << "Glyphs of different sizes have different keys";
+
+			testing("Empty and oversized glyphs");
+
+			Ref<Image> empty = new Image(PixelCoordinateT(0, 0, 1), PixelFormat::A, DataType::BYTE);
+			check(atlas->insert(GlyphAtlas::glyph_key(32, 12), *empty, metrics) != NULL) << "Empty glyph was inserted";
+			check(atlas->lookup(GlyphAtlas::glyph_key(32, 12))->page == GlyphAtlas::NO_PAGE) << "Empty glyph doesn't occupy a page";
+
+			Ref<Image> large = new Image(PixelCoordinateT(80, 10, 1), PixelFormat::A, DataType::BYTE);
+			check(atlas->insert(GlyphAtlas::glyph_key(1, 12), *large, metrics) == NULL) << "Oversized glyph was rejected";
+
+			testing("Empty glyphs and eviction");
+
+			Ref<GlyphAtlas> small = new GlyphAtlas(Vec2u(16, 16), 1, 1);
+
+			small->insert(GlyphAtlas::glyph_key(32, 12), *empty, metrics);
+			small->insert(GlyphAtlas::glyph_key(42, 12), *bitmap, metrics);
+
+			// Drawing spaces in the next frame must not keep the only page in use:
+			small->next_frame();
+			small->lookup(GlyphAtlas::glyph_key(32, 12));
+
+			check(small->insert(GlyphAtlas::glyph_key(43, 12), *bitmap, metrics) != NULL) << "Page was evicted while only spaces were used";
+			check(small->evicted_pages() == 1) << "Page was evicted once";
+			check(small->lookup(GlyphAtlas::glyph_key(32, 12)) != NULL) << "Empty glyph was not evicted with the page";
+
+			testing("Clearing");
+
+			small->clear();
+			check(small->glyph_count() == 0 && small->page_count() == 0) << "Glyphs and pages were discarded";
+			check(small->evicted_pages() == 0) << "Eviction count was reset";
+		}
+#endif
+	}
+}
@@ -0,0 +1,148 @@
+//
+//  Text/GlyphAtlas.h
+//  This file is part of the "Dream" project, and is released under the MIT license.
+//
+//  Created by agent on 18/10/26.
+//  Copyright (c) 2026 agent. All rights reserved.
+//
+//
+
+#ifndef _DREAM_IMAGING_TEXT_GLYPHATLAS_H
+#define _DREAM_IMAGING_TEXT_GLYPHATLAS_H
+
+#include "../Imaging/Image.h"
+#include "../Imaging/SkylinePacker.h"
+
+#include <Euclid/Geometry/AlignedBox.h>
+
+#include <unordered_map>
+#include <vector>
+
+namespace Dream
+{
+	namespace Text
+	{
+		using namespace Dream::Imaging;
+		using Euclid::Geometry::AlignedBox2;
+		using Euclid::Geometry::AlignedBox2u;
+
+		/// Glyph placement information, in the same units as FreeType.
+		struct GlyphMetrics {
+			/// The offset in pixels from the pen position to the bottom-left corner of the bitmap.
+			int left, bottom;
+
+			/// The horizontal advance and hinting deltas, in 26.6 fixed point.
+			long advance, lsb_delta, rsb_delta;
+		};
+
+		/// A textured quad for a single glyph, ready to be batched.
+		struct GlyphQuad {
+			std::size_t page;
+
+			/// The position of the quad in pixels.
+			AlignedBox2 position;
+
+			/// The texture coordinates, min corresponds to the bottom-left of the glyph.
+			AlignedBox2 uv;
+		};
+
+		/**
+		 Packs rasterized glyphs into one or more image pages, which can be uploaded as textures and used to draw text as batched quads.
+
+		 Glyphs are allocated using a skyline packer. When all pages are full, the least recently used page is evicted and reused, unless it has been used in the current frame, as quads produced earlier in the frame may still refer to it. The changes to each page are recorded as a list of dirty regions, so only the modified parts need to be uploaded.
+		 */
+		class GlyphAtlas : public Object {
+		public:
+			typedef uint64_t KeyT;
+
+			/// Glyphs of different faces and sizes are kept separately, so the key includes the face and the pixel size. The face identifies the font face which rendered the glyph, so that several faces can share one atlas.
+			static KeyT glyph_key (unsigned glyph_index, unsigned pixel_size, unsigned face = 0)
+			{
+				DREAM_ASSERT(glyph_index < (1 << 24) && pixel_size < (1 << 16) && face < (1 << 24));
+
+				return ((KeyT)face << 40) | ((KeyT)pixel_size << 24) | glyph_index;
+			}
+
+			/// The page of glyphs without a bitmap, such as spaces, which don't occupy any page.
+			static const std::size_t NO_PAGE = std::size_t(-1);
+
+			struct Glyph {
+				/// The page containing the bitmap, or NO_PAGE if the glyph is empty.
+				std::size_t page;
+
+				/// The location of the bitmap within the page, in pixels.
+				AlignedBox2u bounds;
+
+				/// The texture coordinates of the bitmap within the page.
+				AlignedBox2 uv;
+
+				GlyphMetrics metrics;
+
+				uint64_t last_used;
+			};
+
+		protected:
+			struct Page {
+				Ref<Image> image;
+				SkylinePacker packer;
+
+				std::vector<AlignedBox2u> dirty_regions;
+				std::vector<KeyT> glyphs;
+
+				uint64_t last_used;
+
+				Page (const Vec2u & size) : packer(size), last_used(0) {}
+			};
+
+			Vec2u _page_size;
+			std::size_t _maximum_pages, _padding;
+			PixelFormat _pixel_format;
+
+			std::vector<Page> _pages;
+			std::unordered_map<KeyT, Glyph> _glyphs;
+
+			uint64_t _frame;
+			std::size_t _evicted_pages;
+
+			void mark_dirty (Page & page, const AlignedBox2u & region);
+
+			/// Clears the least recently used page and returns its index. Pages used in the current frame are not evicted, in which case the number of pages is returned.
+			std::size_t evict_page ();
+
+			/// Finds space for a bitmap of the given size, adding or evicting pages if required.
+			bool allocate (const Vec2u & size, std::size_t & page, Vec2u & origin);
+
+		public:
+			/// The pixel format should match the format of the glyph bitmaps, typically PixelFormat::A.
+			GlyphAtlas (const Vec2u & page_size = Vec2u(512, 512), std::size_t maximum_pages = 4, std::size_t padding = 1, PixelFormat pixel_format = PixelFormat::A);
+			virtual ~GlyphAtlas ();
+
+			/// Returns the glyph for the given key, or NULL if it is not in the atlas. The glyph is marked as used in the current frame.
+			const Glyph * lookup (KeyT key);
+
+			/// Copies the bitmap into the atlas. Returns NULL if the bitmap is larger than a page, or if the atlas is full and every page has been used in the current frame, in which case the glyph can't be drawn until the next frame. The returned pointer is valid until the next insertion.
+			const Glyph * insert (KeyT key, const IPixelBuffer & bitmap, const GlyphMetrics & metrics);
+
+			/// Advances the frame counter which is used to determine the least recently used page.
+			void next_frame () { _frame += 1; }
+
+			std::size_t page_count () const { return _pages.size(); }
+			Ptr<Image> page_image (std::size_t page) const { return _pages[page].image; }
+
+			/// The regions of the page which have changed since the dirty regions were last cleared.
+			const std::vector<AlignedBox2u> & dirty_regions (std::size_t page) const { return _pages[page].dirty_regions; }
+			void clear_dirty_regions ();
+
+			std::size_t glyph_count () const { return _glyphs.size(); }
+			std::size_t evicted_pages () const { return _evicted_pages; }
+
+			/// The fraction of all allocated pages which contain glyphs.
+			RealT occupancy () const;
+
+			/// Discard all glyphs and pages, and reset the frame counter.
+			void clear ();
+		};
+	}
+}
+
+#endif
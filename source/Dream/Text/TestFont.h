@@ -0,0 +1,41 @@
+//
+//  Text/TestFont.h
+//  This file is part of the "Dream" project, and is released under the MIT license.
+//
+//  Created by agent on 18/10/26.
+//  Copyright (c) 2026 agent. All rights reserved.
+//
+//
+
+#ifndef _DREAM_TEXT_TESTFONT_H
+#define _DREAM_TEXT_TESTFONT_H
+
+#ifdef ENABLE_TESTING
+
+#include "Font.h"
+
+namespace Dream {
+	namespace Text {
+		// There are no fonts in the repository, so unit tests use one provided by the system. Returns NULL if none could be found.
+		inline Ref<Font> load_test_font ()
+		{
+			const char * paths[] = {
+				"/Library/Fonts/Arial.ttf",
+				"/usr/share/fonts/truetype/dejavu/DejaVuSans.ttf",
+				"/usr/share/fonts/TTF/DejaVuSans.ttf",
+				NULL
+			};
+
+			for (const char ** path = paths; *path; path += 1) {
+				if (Path(*path).exists())
+					return new Font(Path(*path));
+			}
+
+			return NULL;
+		}
+	}
+}
+
+#endif
+
+#endif
@@ -16,201 +16,83 @@ namespace Dream
 {
 	namespace Text
 	{
-		class TextLineRenderer {
-		protected:
-			Detail::FontFace * _face;
-			bool kerning;
-
-			Vec2u pen;
-			Vec2u _extents;
-
-			FT_Pos prev_rsbdelta;
-
-			// Glyph Indices
-			FT_UInt current;
-			FT_UInt previous;
-
-			FT_Error err;
-
-			Ref<IMutablePixelBuffer> img;
-
-			unsigned _count;
-		public:
-			TextLineRenderer (Detail::FontFace * _face, bool _kerning) : _face(_face), kerning(_kerning), pen(ZERO), _extents(ZERO)
-			{
-				prev_rsbdelta = 0;
-
-				current = 0;
-				previous = 0;
-
-				err = 0;
-				_count = 0;
-			}
-
-			TextLineRenderer (const TextLineRenderer & other)
-			{
-				pen = other.pen;
-				_face = other._face;
-				prev_rsbdelta = other.prev_rsbdelta;
-				current = other.current;
-				previous = other.previous;
-				kerning = other.kerning;
-				img = other.img;
-				_extents = other._extents;
-				_count = other._count;
-			}
-
-			void set_image (Ptr<IMutablePixelBuffer> _img)
-			{
-				img = _img;
-			}
-
-			void set_origin(Vec2u _pen)
-			{
-				pen = Vec2u(_pen[X] << 6, _pen[Y] << 6);
-			}
-
-			Vec2u origin()
-			{
-				return Vec2u(pen[X] >> 6, pen[Y] >> 6);
-			}
-
-			const Vec2u & extents()
-			{
-				return _extents;
-			}
-
-			AlignedBox2u composite_character (const Detail::FontGlyph * glyph)
-			{
-				Vec2u origin = glyph->calculate_character_origin(pen);
-
-				// Update box extents
-				FT_BBox bbox;
-
-				// This incorrectly rounds down the box size.
-				glyph->get_cbox(FT_GLYPH_BBOX_PIXELS, &bbox);
-
-				// We add one here to avoid problems where the box isn't quite wide enough
-				// due to anti-aliasing issues.
-				_extents[X] = origin[X] + bbox.xMax + 1;
-				_extents[Y] = origin[Y] + bbox.yMax;
-
-				// Copy the bitmap
-				if (img)
-					glyph->composite_to_buffer(origin, img);
-
-				return AlignedBox2u(origin, _extents);
-			}
-
-			AlignedBox2u process_character (CodePointT c)
-			{
-				AlignedBox2u box;
-
-				current = _face->get_char_index(c);
-				Detail::FontGlyph * glyph = _face->load_glyph_for_index(current);
-
-				// Offset the first character a little bit
-				int delta = 0; //(_count == 0 ? 64 : 0);
-
-				if (kerning && previous != 0 && current != 0) {
-					FT_Vector k;
-					FT_Get_Kerning(_face->face(), previous, current, FT_KERNING_DEFAULT, &k);
-
-					// Increase the pen width by the kerning
-					delta += k.x;
-				}
-
-				// Subtract or add a pixel for better position
-				delta += glyph->hinting_adjustment(prev_rsbdelta);
-
-				pen[X] += delta;
-
-				box = composite_character(glyph);
-
-				pen[X] += glyph->advance.x;
-
-				// We need the previous character for calculating spacing
-				previous = current;
-				prev_rsbdelta = glyph->rsb_delta;
-
-				_count += 1;
-
-				return box;
-			}
-
-			unsigned advance_of_character (CodePointT c) {
-				TextLineRenderer t(*this);
-				t.set_image(NULL);
-
-				AlignedBox2u box = t.process_character(c);
-
-				// Ensure box calculation is correct
-				DREAM_ASSERT(box.size()[WIDTH] == t.extents()[X] - extents()[X]);
-
-				return t.extents()[X] - extents()[X];
-			}
-		};
-
 // MARK: -
 // MARK: TextLine Implementation
 
-		TextLine::TextLine (TextBlock * b) : _block(b), _width(0)
+		TextLine::TextLine (TextBlock * b) : _block(b), _begin(0), _end(0), _width(0), _terminated(false)
 		{
-			_renderer = new TextLineRenderer(_block->_face, _block->kerning_enabled());
+		}
+
+		TextLine::TextLine (TextBlock * b, Ref<Detail::ShapedRun> run, std::size_t begin, std::size_t end) : _block(b), _run(run), _begin(begin), _end(end), _terminated(false)
+		{
+			_width = _run->line_width(_begin, _end);
 		}
 
 		TextLine::~TextLine ()
 		{
-			delete _renderer;
 		}
 
-		bool TextLine::can_add_character (CodePointT c) const
+		std::string TextLine::text () const
 		{
-			unsigned w = _renderer->advance_of_character(c) + _width;
+			if (_begin == _end)
+				return std::string();
+
+			std::size_t from = _run->glyphs[_begin].offset;
+			std::size_t to = _end < _run->glyphs.size() ? _run->glyphs[_end].offset : _run->text.size();
 
-			return !(_block->is_line_width_fixed() && w > _block->line_width());
+			return _run->text.substr(from, to - from);
 		}
 
-		bool TextLine::add_character (CodePointT c)
+		void TextLine::composite_to_image (Ptr<IMutablePixelBuffer> img, Vec2u pen, CharacterBoxes * boxes)
 		{
-			//unsigned w = _renderer->advance_of_character(c) + _width;
+			for (std::size_t i = _begin; i < _end; i += 1) {
+				const Detail::FontGlyph * glyph = _run->glyphs[i].glyph;
 
-			TextLineRenderer tmp(*_renderer);
+				FT_Pos x = std::max<FT_Pos>((pen[X] << 6) + _run->line_position(_begin, i), 0);
+				Vec2u origin = glyph->calculate_character_origin(Vec2u(x, pen[Y] << 6));
 
-			_renderer->process_character(c);
+				// Copy the bitmap
+				if (img)
+					glyph->composite_to_buffer(origin, img);
 
-			unsigned w = _renderer->extents()[X];
+				if (boxes) {
+					// This incorrectly rounds down the box size.
+					FT_BBox bbox;
+					glyph->get_cbox(FT_GLYPH_BBOX_PIXELS, &bbox);
 
-			if (_block->is_line_width_fixed() && w > _block->line_width()) {
-				// Roll back the renderer state
-				*_renderer = tmp;
-				return false;
+					boxes->push_back(AlignedBox2u(origin, Vec2u(origin[X] + bbox.xMax + 1, origin[Y] + bbox.yMax)));
+				}
 			}
-
-			utf8::append(c, std::back_inserter(_chars));
-			_width = _renderer->extents()[X];
-
-			return true;
 		}
 
-		void TextLine::composite_to_image (Ptr<IMutablePixelBuffer> img, Vec2u pen, CharacterBoxes * boxes)
+		void TextLine::layout_glyphs (GlyphAtlas & atlas, Vec2u pen, std::vector<GlyphQuad> & quads)
 		{
-			TextLineRenderer r(_block->_face, _block->kerning_enabled());
+			for (std::size_t i = _begin; i < _end; i += 1) {
+				const GlyphAtlas::Glyph * glyph = _block->_face->load_glyph_into_atlas(_run->glyphs[i].index, atlas);
+
+				if (!glyph) continue;
+
+				Vec2u size = glyph->bounds.size();
 
-			r.set_image(img);
-			r.set_origin(pen);
+				if (size[X] && size[Y]) {
+					GlyphQuad quad;
 
-			for (auto character : _chars) {
-				AlignedBox2u box = r.process_character(character);
+					FT_Pos x = (pen[X] << 6) + _run->line_position(_begin, i);
+					Vec2 origin((x >> 6) + glyph->metrics.left, (int)pen[Y] + glyph->metrics.bottom);
 
-				if (boxes) boxes->push_back(box);
+					quad.page = glyph->page;
+					quad.position = AlignedBox2(origin, origin + Vec2(size[X], size[Y]));
+					quad.uv = glyph->uv;
+
+					quads.push_back(quad);
+				}
 			}
 		}
 
 // MARK: -
 // MARK: TextBlock Implementation
 
-		TextBlock::TextBlock (Detail::FontFace * face) : _face(face)
+		TextBlock::TextBlock (Detail::FontFace * face) : _cache_runs(true), _face(face)
 		{
 			clear();
 
@@ -333,31 +215,59 @@ namespace Dream
 			return _lines.back();
 		}
 
-		// We must normalize input to have \n line endings
-		void TextBlock::add_text (const std::string &str)
+		void TextBlock::layout_paragraph (const std::string & str, std::deque<TextLine*> & lines)
 		{
-			TextLine * line = last_line();
+			Ref<Detail::ShapedRun> run = _face->shape_text(str, kerning_enabled(), _cache_runs);
+			std::size_t count = run->glyphs.size();
 
-			auto current = str.begin(), end = str.end();
+			if (count == 0) {
+				lines.push_back(new TextLine(this));
+				return;
+			}
 
-			while (current != end) {
-				CodePointT codepoint = utf8::next(current, end);
+			for (std::size_t begin = 0, end; begin < count; begin = end) {
+				end = count;
 
-				if (codepoint == '\n') {
-					line = new TextLine(this);
-					_lines.push_back(line);
+				// Each line has at least one character, even if it is wider than the line:
+				if (is_line_width_fixed()) {
+					end = begin + 1;
 
-					continue;
+					while (end < count && run->line_width(begin, end + 1) <= line_width())
+						end += 1;
 				}
 
-				if (!line->add_character(codepoint)) {
-					line = new TextLine(this);
-					_lines.push_back(line);
+				lines.push_back(new TextLine(this, run, begin, end));
+			}
+		}
 
-					DREAM_ASSERT(line->can_add_character(codepoint));
-					line->add_character(codepoint);
-				}
+		void TextBlock::layout_text (const std::string & str, std::deque<TextLine*> & lines)
+		{
+			// The last line is laid out again with the new text appended:
+			std::string paragraph = lines.back()->text();
+
+			delete lines.back();
+			lines.pop_back();
+
+			std::size_t current = 0, next;
+
+			while ((next = str.find('\n', current)) != std::string::npos) {
+				paragraph.append(str, current, next - current);
+
+				layout_paragraph(paragraph, lines);
+				lines.back()->set_terminated();
+
+				paragraph.clear();
+				current = next + 1;
 			}
+
+			paragraph.append(str, current, std::string::npos);
+			layout_paragraph(paragraph, lines);
+		}
+
+		// We must normalize input to have \n line endings
+		void TextBlock::add_text (const std::string &str)
+		{
+			layout_text(str, _lines);
 		}
 
 		void TextBlock::set_text (const std::string &str)
@@ -366,18 +276,95 @@ namespace Dream
 			add_text(str);
 		}
 
+		void TextBlock::insert_text (std::size_t offset, const std::string & str, std::size_t & first, std::size_t & last)
+		{
+			auto length = [&](std::size_t index) {
+				return _lines[index]->text().size() + (_lines[index]->terminated() ? 1 : 0);
+			};
+
+			// Find the line containing the offset:
+			std::size_t index = 0, start = 0;
+			while (index + 1 < _lines.size() && start + length(index) <= offset) {
+				start += length(index);
+				index += 1;
+			}
+
+			// Lines are only wrapped within a paragraph, so the lines before and after it are not affected:
+			first = index;
+			while (first > 0 && !_lines[first - 1]->terminated()) {
+				first -= 1;
+				start -= length(first);
+			}
+
+			std::size_t end = index;
+			while (end + 1 < _lines.size() && !_lines[end]->terminated())
+				end += 1;
+
+			std::string paragraph;
+			for (std::size_t i = first; i <= end; i += 1) {
+				paragraph += _lines[i]->text();
+
+				if (_lines[i]->terminated())
+					paragraph += '\n';
+			}
+
+			paragraph.insert(std::min(offset - start, paragraph.size()), str);
+
+			std::deque<TextLine*> lines;
+			lines.push_back(new TextLine(this));
+			layout_text(paragraph, lines);
+
+			// The line following the paragraph already exists:
+			if (_lines[end]->terminated()) {
+				delete lines.back();
+				lines.pop_back();
+			}
+
+			for (std::size_t i = first; i <= end; i += 1)
+				delete _lines[i];
+
+			_lines.erase(_lines.begin() + first, _lines.begin() + end + 1);
+			_lines.insert(_lines.begin() + first, lines.begin(), lines.end());
+
+			if (lines.size() == end + 1 - first)
+				last = first + lines.size();
+			else
+				last = _lines.size();
+		}
+
+		void TextBlock::remove_lines (std::size_t first, std::size_t count)
+		{
+			DREAM_ASSERT(first + count <= _lines.size());
+
+			for (std::size_t i = first; i < first + count; i += 1)
+				delete _lines[i];
+
+			_lines.erase(_lines.begin() + first, _lines.begin() + first + count);
+
+			if (_lines.empty())
+				_lines.push_back(new TextLine(this));
+		}
+
 		std::string TextBlock::text () const
 		{
 			std::string str;
 
 			for (auto line : _lines) {
 				str += line->text();
+
+				if (line->terminated())
+					str += '\n';
 			}
 
 			return str;
 		}
 
 		void TextBlock::render (Ptr<IMutablePixelBuffer> pbuf, CharacterBoxes * boxes)
+		{
+			render_lines(pbuf, 0, _lines.size(), boxes);
+		}
+
+		void TextBlock::render_lines (Ptr<IMutablePixelBuffer> pbuf, std::size_t first, std::size_t last, CharacterBoxes * boxes)
 		{
 			Vec2u pen(ZERO);
 			Vec2u origin = pbuf->size().reduce() * text_origin();
@@ -394,7 +381,11 @@ namespace Dream
 
 			//std::cout << "Text Origin: " << text_origin() << std::endl;
 
-			for (auto line : _lines) {
+			pen[Y] += first * _face->line_offset();
+
+			for (std::size_t i = first; i < last; i += 1) {
+				TextLine * line = _lines[i];
+
 				if (_line_direction == TB) {
 					//std::cerr << "Line Origin: " << origin - pen << std::endl;
 					line->composite_to_image(pbuf, origin - pen, boxes);
@@ -409,6 +400,30 @@ namespace Dream
 			}
 		}
 
+		void TextBlock::layout_glyphs (GlyphAtlas & atlas, std::vector<GlyphQuad> & quads)
+		{
+			Vec2u pen(ZERO);
+			Vec2u origin = calculate_size() * text_origin();
+
+			if (_line_direction == TB) {
+				pen[Y] += _face->line_offset();
+				pen[Y] -= _face->descender_offset();
+			} else {
+				pen[Y] += _face->descender_offset();
+			}
+
+			for (auto line : _lines) {
+				if (_line_direction == TB) {
+					line->layout_glyphs(atlas, origin - pen, quads);
+				} else {
+					line->layout_glyphs(atlas, pen, quads);
+				}
+
+				pen[X] = 0;
+				pen[Y] += _face->line_offset();
+			}
+		}
+
 		Vec2u TextBlock::calculate_size () const
 		{
 			Vec2u result(ZERO);
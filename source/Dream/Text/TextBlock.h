@@ -15,6 +15,8 @@
 
 #include <Euclid/Geometry/AlignedBox.h>
 
+#include <deque>
+
 #include <ft2build.h>
 #include FT_FREETYPE_H
 #include FT_GLYPH_H
@@ -40,7 +42,7 @@ namespace Dream
 		protected:
 			Vec2u _extents;
 			unsigned _line_width;
-			std::vector<TextLine*> _lines;
+			std::deque<TextLine*> _lines;
 
 			Vec2u _horizontal_padding;
 			Vec2u _vertical_padding;
@@ -49,12 +51,19 @@ namespace Dream
 
 			// Freetype
 			bool _kerning;
+			bool _cache_runs;
 			Detail::FontFace * _face;
 
 			friend class TextLine;
 
 			void composite_characters(Ptr<IMutablePixelBuffer> pbuf, CharacterBoxes * boxes);
 
+			/// Lays out the text starting at the end of the last line, adding new lines as required.
+			void layout_text (const std::string & str, std::deque<TextLine*> & lines);
+
+			/// Lays out a single paragraph, wrapping it into lines if the line width is fixed.
+			void layout_paragraph (const std::string & str, std::deque<TextLine*> & lines);
+
 		public:
 			TextBlock (Detail::FontFace * font);
 			virtual ~TextBlock ();
@@ -71,6 +80,9 @@ namespace Dream
 			void set_kerning (bool enabled);
 			bool kerning_enabled ();
 
+			/// Whether paragraphs are shaped using the run cache of the font face. Text which is unlikely to be laid out again, such as console output, should not displace runs which are.
+			void set_run_caching (bool enabled) { _cache_runs = enabled; }
+
 			void set_line_width (const unsigned &w);
 			bool is_line_width_fixed () const;
 			unsigned line_width () const;
@@ -80,38 +92,60 @@ namespace Dream
 			void clear ();
 			TextLine * last_line ();
 
+			std::size_t line_count () const { return _lines.size(); }
+			const TextLine * line (std::size_t index) const { return _lines[index]; }
+
+			/// Removes lines from the block, e.g. to limit the scrollback of a console.
+			void remove_lines (std::size_t first, std::size_t count);
+
 			// We must normalize input to have \n line endings
 			void add_text (const std::string &str);
 			void set_text (const std::string &str);
 
+			/// Inserts text at the given byte offset. Only the paragraph containing the offset is laid out again. The range of lines which changed is returned in first and last; if the number of lines changed, last is the end of the block.
+			void insert_text (std::size_t offset, const std::string & str, std::size_t & first, std::size_t & last);
+
 			std::string text () const;
 
 			Vec2u calculate_size () const;
 
 			void render (Ptr<IMutablePixelBuffer> pbuf, CharacterBoxes * boxes = NULL);
-		};
 
-		class TextLineRenderer;
+			/// Renders the lines from first up to last, in the same position as render would.
+			void render_lines (Ptr<IMutablePixelBuffer> pbuf, std::size_t first, std::size_t last, CharacterBoxes * boxes = NULL);
+
+			/// Generates a textured quad for each visible glyph, using the same layout as render. Glyphs are loaded into the atlas as required.
+			void layout_glyphs (GlyphAtlas & atlas, std::vector<GlyphQuad> & quads);
+		};
 
+		/// A line of text, which refers to a range of glyphs in a shaped run. Lines which are wrapped from the same paragraph share the run.
 		class TextLine {
 			TextBlock * _block;
 
+			Ref<Detail::ShapedRun> _run;
+			std::size_t _begin, _end;
+
 			std::size_t _width;
-			std::string _chars;
 
-			TextLineRenderer * _renderer;
+			// Whether the line was ended by a new line character, rather than wrapping.
+			bool _terminated;
 
 		public:
 			TextLine (TextBlock * b);
+			TextLine (TextBlock * b, Ref<Detail::ShapedRun> run, std::size_t begin, std::size_t end);
 			virtual ~TextLine ();
 
-			const std::string & text () const { return _chars; }
+			std::string text () const;
 			std::size_t width () const { return _width; }
 
-			bool can_add_character (CodePointT c) const;
+			/// The number of characters in the line.
+			std::size_t length () const { return _end - _begin; }
+
+			bool terminated () const { return _terminated; }
+			void set_terminated () { _terminated = true; }
 
-			bool add_character (CodePointT c);
 			void composite_to_image (Ptr<IMutablePixelBuffer> img, Vec2u pen, CharacterBoxes * boxes = NULL);
+			void layout_glyphs (GlyphAtlas & atlas, Vec2u pen, std::vector<GlyphQuad> & quads);
 		};
 	}
 }
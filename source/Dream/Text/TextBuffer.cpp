@@ -10,80 +10,365 @@
 #include "TextBuffer.h"
 #include "TextBlock.h"
 
+#include "../Core/Timer.h"
+#include "../Events/Logger.h"
+
+#ifdef ENABLE_TESTING
+#include "TestFont.h"
+#endif
+
+#include <cstring>
+
 namespace Dream
 {
 	namespace Text
 	{
 		using namespace Euclid::Numerics::Constants;
+		using namespace Events::Logging;
 
 // MARK: -
 
-		TextBuffer::TextBuffer (Ref<Font> font) : _font(font), _text_updated(true), _use_static_size(false)
+		TextBuffer::TextBuffer (Ref<Font> font) : _font(font), _block(new TextBlock(font->font_face())), _dirty_begin(0), _dirty_end(0), _redraw(true), _scrollback(0), _use_static_size(false)
 		{
+			_block->set_run_caching(false);
+			_pixel_size = _font->font_face()->pixel_size();
 		}
 
 		TextBuffer::~TextBuffer ()
 		{
 		}
 
+		void TextBuffer::mark_dirty (std::size_t begin, std::size_t end)
+		{
+			if (_dirty_begin < _dirty_end) {
+				_dirty_begin = std::min(_dirty_begin, begin);
+				_dirty_end = std::max(_dirty_end, end);
+			} else {
+				_dirty_begin = begin;
+				_dirty_end = end;
+			}
+		}
+
+		void TextBuffer::update_pixel_size ()
+		{
+			unsigned pixel_size = _font->font_face()->pixel_size();
+
+			if (pixel_size != _pixel_size) {
+				_pixel_size = pixel_size;
+
+				_block->set_text(_block->text());
+				_redraw = true;
+			}
+		}
+
 		void TextBuffer::set_static_size (Vec2u size) {
 			_size = size;
 			_use_static_size = true;
+
+			_pixel_size = _font->font_face()->pixel_size();
+
+			_block->set_line_width(_size[X]);
+			_block->set_text(_block->text());
+			_redraw = true;
 		}
 
 		void TextBuffer::set_dynamic_size () {
 			_size = 0;
 			_use_static_size = false;
+
+			_pixel_size = _font->font_face()->pixel_size();
+
+			_block->set_line_width(0);
+			_block->set_text(_block->text());
+			_redraw = true;
 		}
 
 		void TextBuffer::set_text (const std::string & text)
 		{
-			if (_text != text) {
-				_text = text;
-				_text_updated = true;
+			update_pixel_size();
+
+			if (_block->text() != text) {
+				_block->set_text(text);
+				_redraw = true;
+			}
+		}
+
+		std::string TextBuffer::text () const
+		{
+			return _block->text();
+		}
+
+		void TextBuffer::append_text (const std::string & text)
+		{
+			update_pixel_size();
+
+			// The last line may change, and any new lines are added after it:
+			std::size_t first = _block->line_count() - 1;
+
+			_block->add_text(text);
+
+			mark_dirty(first, _block->line_count());
+
+			// Remove lines in batches, so that the cost of redrawing the image is amortized:
+			if (_scrollback && _block->line_count() > _scrollback + _scrollback / 4) {
+				_block->remove_lines(0, _block->line_count() - _scrollback);
+				_redraw = true;
 			}
 		}
 
+		void TextBuffer::set_scrollback (std::size_t lines)
+		{
+			_scrollback = lines;
+		}
+
+		std::size_t TextBuffer::line_count () const
+		{
+			return _block->line_count();
+		}
+
 		void TextBuffer::insert_character_at_offset (unsigned offset, unsigned character) {
-			_text_updated = true;
-			_text.insert(_text.begin()+offset, character);
+			update_pixel_size();
+
+			std::string str;
+			utf8::append(character, std::back_inserter(str));
+
+			std::size_t count = _block->line_count(), first, last;
+			_block->insert_text(offset, str, first, last);
+
+			// If the paragraph became shorter, the lines at the end need to be cleared:
+			if (last == _block->line_count())
+				last = std::max(last, count);
+
+			mark_dirty(first, last);
 		}
 
 		unsigned TextBuffer::offset_for_point (const Vec2u offset) {
-			return _text.size();
+			return _block->text().size();
+		}
+
+		void TextBuffer::resize_image (const Vec2u & size)
+		{
+			Ref<Image> image = new Image(size << 1U, PixelFormat::L, DataType::BYTE);
+			image->clear();
+
+			// The text is aligned to the top of the image, which is the end of the pixel data:
+			Vec2u previous_size = _image->size().reduce();
+			std::size_t row_length = std::min(size[X], previous_size[X]) * image->bytes_per_pixel();
+
+			for (std::size_t y = 0; y < previous_size[Y]; y += 1) {
+				memcpy(image->pixel_data_at(PixelCoordinateT(0, y + size[Y] - previous_size[Y], 0)), _image->pixel_data_at(PixelCoordinateT(0, y, 0)), row_length);
+			}
+
+			_image = image;
 		}
 
 		Ref<IPixelBuffer> TextBuffer::render_text (bool & regenerated)
 		{
 			regenerated = false;
 
-			if (_text_updated) {
-				if (_image_text != _text) {
-					TextBlock text_block(_font->font_face());
+			update_pixel_size();
+
+			if (!_image)
+				_redraw = true;
+
+			if (_redraw) {
+				Vec2u text_block_size = _block->calculate_size();
+
+				if (_image)
+					_image->allocate(text_block_size << 1, PixelFormat::L, DataType::BYTE);
+				else
+					_image = new Image(text_block_size << 1, PixelFormat::L, DataType::BYTE);
 
-					if (_use_static_size) {
-						text_block.set_line_width(_size[X]);
-					}
+				_image->clear();
 
-					text_block.set_text(_text);
-					Vec2u text_block_size = text_block.calculate_size();
+				_block->render(_image);
+				regenerated = true;
+			} else if (_dirty_begin < _dirty_end) {
+				std::size_t line_offset = _font->font_face()->line_offset();
+				Vec2u size = _image->size().reduce(), required_size(size[X], _block->line_count() * line_offset);
 
-					if (_image)
-						_image->allocate(text_block_size << 1, PixelFormat::L, DataType::BYTE);
-					else
-						_image = new Image(text_block_size << 1, PixelFormat::L, DataType::BYTE);
+				if (!_use_static_size) {
+					for (std::size_t i = _dirty_begin; i < std::min(_dirty_end, _block->line_count()); i += 1)
+						required_size[X] = std::max(required_size[X], _block->line(i)->width());
+				}
+
+				// Grow the image geometrically, so that appending is amortized constant time:
+				if (required_size[X] > size[X] || required_size[Y] > size[Y]) {
+					if (required_size[X] > size[X])
+						size[X] = std::max(required_size[X], size[X] + size[X] / 2);
 
-					_image->clear();
+					if (required_size[Y] > size[Y])
+						size[Y] = std::max(required_size[Y], size[Y] * 2);
 
-					text_block.render(_image);
-					regenerated = true;
+					resize_image(size);
 				}
 
-				_image_text = _text;
-				_text_updated = false;
+				// Clear the dirty lines and composite them again:
+				std::size_t bottom = size[Y] - _dirty_end * line_offset;
+				memset(_image->pixel_data_at(PixelCoordinateT(0, bottom, 0)), 0, (_dirty_end - _dirty_begin) * line_offset * size[X] * _image->bytes_per_pixel());
+
+				_block->render_lines(_image, _dirty_begin, std::min(_dirty_end, _block->line_count()));
+				regenerated = true;
 			}
 
+			_redraw = false;
+			_dirty_begin = _dirty_end = 0;
+
 			return _image;
 		}
+
+// MARK: -
+// MARK: Unit Tests
+
+#ifdef ENABLE_TESTING
+		static bool same_pixels (Ptr<IPixelBuffer> a, Ptr<IPixelBuffer> b)
+		{
+			return a->size() == b->size() && memcmp(a->pixel_data(), b->pixel_data(), a->pixel_data_length()) == 0;
+		}
+
+		UNIT_TEST(TextBuffer)
+		{
+			Ref<Font> font = load_test_font();
+
+			if (!font) {
+				logger()->log(LOG_WARN, "Could not find a font, skipping text buffer tests.");
+				return;
+			}
+
+			font->set_pixel_size(12);
+
+			testing("Incremental rendering");
+
+			Ref<TextBuffer> buffer = new TextBuffer(font);
+			buffer->set_static_size(Vec2u(200, 0));
+
+			bool regenerated = false;
+
+			for (std::size_t i = 0; i < 20; i += 1) {
+				StringStreamT line;
+				line << "Line " << i << " jumps over the lazy dog, again and again.";
+
+				buffer->append_line(line.str());
+				buffer->render_text(regenerated);
+			}
+
+			check(regenerated) << "Image was updated";
+			check(buffer->line_count() > 21) << "Long lines were wrapped";
+
+			auto render_from_scratch = [&](const PixelCoordinateT & size) {
+				TextBlock block(font->font_face());
+				block.set_line_width(200);
+				block.set_text(buffer->text());
+
+				Ref<Image> image = new Image(size, PixelFormat::L, DataType::BYTE);
+				image->clear();
+				block.render(image);
+
+				return image;
+			};
+
+			Ref<IPixelBuffer> image = buffer->render_text(regenerated);
+			check(!regenerated) << "Image was not updated when nothing changed";
+			check(same_pixels(image, render_from_scratch(image->size()))) << "Incremental rendering matches rendering from scratch";
+
+			testing("Inserting characters");
+
+			std::string text = buffer->text();
+			std::size_t offset = text.find("Line 3 ");
+
+			buffer->insert_character_at_offset(offset, 'X');
+			text.insert(offset, "X");
+
+			image = buffer->render_text(regenerated);
+			check(buffer->text() == text) << "Character was inserted";
+			check(same_pixels(image, render_from_scratch(image->size()))) << "Inserting matches rendering from scratch";
+
+			testing("Scrollback");
+
+			buffer->set_scrollback(10);
+
+			for (std::size_t i = 0; i < 40; i += 1)
+				buffer->append_line("Short line");
+
+			check(buffer->line_count() >= 10 && buffer->line_count() <= 13) << "Scrollback is bounded";
+
+			image = buffer->render_text(regenerated);
+			check(same_pixels(image, render_from_scratch(image->size()))) << "Scrollback matches rendering from scratch";
+
+			testing("Changing the font size");
+
+			font->set_pixel_size(16);
+			image = buffer->render_text(regenerated);
+			check(regenerated) << "Image was updated when the font size changed";
+			check(same_pixels(image, render_from_scratch(image->size()))) << "Text was laid out again at the new size";
+
+			buffer->append_line("Short line");
+			image = buffer->render_text(regenerated);
+			check(same_pixels(image, render_from_scratch(image->size()))) << "Appending after changing the font size matches rendering from scratch";
+
+			font->set_pixel_size(12);
+
+			testing("Run cache");
+
+			Detail::FontFace * face = font->font_face();
+			std::size_t hits = face->run_cache_hits(), misses = face->run_cache_misses();
+
+			for (std::size_t i = 0; i < 10; i += 1)
+				buffer->append_line("Console output");
+
+			check(face->run_cache_hits() == hits && face->run_cache_misses() == misses) << "Appended lines don't use the shared run cache";
+		}
+
+		UNIT_TEST(TextBufferAppendPerformance)
+		{
+			Ref<Font> font = load_test_font();
+
+			if (!font) {
+				logger()->log(LOG_WARN, "Could not find a font, skipping text buffer benchmark.");
+				return;
+			}
+
+			font->set_pixel_size(8);
+
+			testing("Appending to a large buffer");
+
+			// Returns the time taken to append and render a line, for a buffer which already contains the given number of lines:
+			auto measure = [&](std::size_t lines) {
+				Ref<TextBuffer> buffer = new TextBuffer(font);
+				buffer->set_static_size(Vec2u(160, 0));
+
+				bool regenerated;
+
+				for (std::size_t i = 0; i < lines; i += 1)
+					buffer->append_line("The quick brown fox.");
+
+				buffer->render_text(regenerated);
+
+				// The first append after rendering from scratch grows the image:
+				buffer->append_line("The quick brown fox.");
+				buffer->render_text(regenerated);
+
+				Stopwatch stopwatch;
+				stopwatch.start();
+
+				const std::size_t count = 100;
+				for (std::size_t i = 0; i < count; i += 1) {
+					buffer->append_line("The quick brown fox.");
+					buffer->render_text(regenerated);
+				}
+
+				stopwatch.pause();
+
+				return stopwatch.time() / count;
+			};
+
+			TimeT small = measure(100), large = measure(10000);
+
+			logger()->log(LOG_INFO, LogBuffer() << "Append and render: " << small * 1000000.0 << "us with 100 lines, " << large * 1000000.0 << "us with 10000 lines.");
+
+			// If appending were linear in the size of the buffer, the large buffer would be 100 times slower, so allow plenty of margin for timing noise:
+			check(large < small * 20) << "Appending is independent of the size of the buffer";
+		}
+#endif
 	}
 }
@@ -13,41 +13,74 @@
 #include "Font.h"
 #include "../Core/Strings.h"
 
+#include <memory>
+
 namespace Dream
 {
 	namespace Text
 	{
+		class TextBlock;
+
+		/**
+		 Maintains the layout of some text and renders it into an image.
+
+		 The layout is updated incrementally: appending text only lays out the last line onwards, and inserting text only lays out the affected paragraph. Only the lines which changed are composited into the image. To make appending efficient, the image may be taller than the text, which is always aligned to the top of the image.
+
+		 The text is laid out at the pixel size of the font, so if the size of the font is changed, all the text is laid out again. Lines are shaped without the run cache of the font face, since text in a buffer, such as console output, is rarely repeated.
+		 */
 		class TextBuffer : public Object {
 		protected:
 			Ref<Font> _font;
 			Ref<Image> _image;
-			std::string _image_text;
 
-			std::string _text;
-			bool _text_updated;
+			std::unique_ptr<TextBlock> _block;
+
+			// The pixel size of the font when the text was laid out:
+			unsigned _pixel_size;
+
+			// The range of lines which need to be composited into the image:
+			std::size_t _dirty_begin, _dirty_end;
+			bool _redraw;
+
+			std::size_t _scrollback;
 
 			bool _use_static_size;
 			Vec2u _size;
 
+			void mark_dirty (std::size_t begin, std::size_t end);
+
+			/// Lays out all the text again if the pixel size of the font has changed.
+			void update_pixel_size ();
+
+			/// Resizes the image, keeping the existing lines in place.
+			void resize_image (const Vec2u & size);
+
 		public:
 			TextBuffer (Ref<Font> font);
 			virtual ~TextBuffer ();
 
 			void set_text (const std::string & text);
+			std::string text () const;
+
+			void append_text (const std::string & text);
 
 			template <typename StringT>
 			void append_text (const StringT & text)
 			{
-				set_text(_text + convert_string_to_utf16(text));
+				append_text(std::string(text));
 			}
 
 			template <typename StringT>
-			void append_line (const StringT & str)
+			void append_line (const StringT & text)
 			{
-				append_text(str);
+				append_text(text);
 				append_text("\n");
 			}
 
+			/// Limits the number of lines kept when appending text. Lines are removed in batches, so up to a quarter more lines may be kept. Zero means unlimited.
+			void set_scrollback (std::size_t lines);
+			std::size_t line_count () const;
+
 			void insert_character_at_offset (unsigned offset, unsigned character);
 			unsigned offset_for_point (const Vec2u offset);
 